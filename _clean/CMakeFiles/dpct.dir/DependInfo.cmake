@@ -0,0 +1,39 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/src/arc.cpp" "CMakeFiles/dpct.dir/src/arc.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/arc.cpp.o.d"
+  "/root/repo/src/binarymodel.cpp" "CMakeFiles/dpct.dir/src/binarymodel.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/binarymodel.cpp.o.d"
+  "/root/repo/src/compiledmodel.cpp" "CMakeFiles/dpct.dir/src/compiledmodel.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/compiledmodel.cpp.o.d"
+  "/root/repo/src/flowgraph.cpp" "CMakeFiles/dpct.dir/src/flowgraph.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/flowgraph.cpp.o.d"
+  "/root/repo/src/graph.cpp" "CMakeFiles/dpct.dir/src/graph.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/graph.cpp.o.d"
+  "/root/repo/src/graphreader.cpp" "CMakeFiles/dpct.dir/src/graphreader.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/graphreader.cpp.o.d"
+  "/root/repo/src/iarcnotifier.cpp" "CMakeFiles/dpct.dir/src/iarcnotifier.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/iarcnotifier.cpp.o.d"
+  "/root/repo/src/jsoncpp.cpp" "CMakeFiles/dpct.dir/src/jsoncpp.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/jsoncpp.cpp.o.d"
+  "/root/repo/src/jsongraphreader.cpp" "CMakeFiles/dpct.dir/src/jsongraphreader.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/jsongraphreader.cpp.o.d"
+  "/root/repo/src/jsonstreamparser.cpp" "CMakeFiles/dpct.dir/src/jsonstreamparser.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/jsonstreamparser.cpp.o.d"
+  "/root/repo/src/magnusson.cpp" "CMakeFiles/dpct.dir/src/magnusson.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/magnusson.cpp.o.d"
+  "/root/repo/src/memorystatistics.cpp" "CMakeFiles/dpct.dir/src/memorystatistics.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/memorystatistics.cpp.o.d"
+  "/root/repo/src/node.cpp" "CMakeFiles/dpct.dir/src/node.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/node.cpp.o.d"
+  "/root/repo/src/pruninggraphbuilder.cpp" "CMakeFiles/dpct.dir/src/pruninggraphbuilder.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/pruninggraphbuilder.cpp.o.d"
+  "/root/repo/src/residualgraph.cpp" "CMakeFiles/dpct.dir/src/residualgraph.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/residualgraph.cpp.o.d"
+  "/root/repo/src/solvertelemetry.cpp" "CMakeFiles/dpct.dir/src/solvertelemetry.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/solvertelemetry.cpp.o.d"
+  "/root/repo/src/streamingflowtracker.cpp" "CMakeFiles/dpct.dir/src/streamingflowtracker.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/streamingflowtracker.cpp.o.d"
+  "/root/repo/src/temporalblockflowgraphbuilder.cpp" "CMakeFiles/dpct.dir/src/temporalblockflowgraphbuilder.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/temporalblockflowgraphbuilder.cpp.o.d"
+  "/root/repo/src/trackingalgorithm.cpp" "CMakeFiles/dpct.dir/src/trackingalgorithm.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/trackingalgorithm.cpp.o.d"
+  "/root/repo/src/userdata.cpp" "CMakeFiles/dpct.dir/src/userdata.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/userdata.cpp.o.d"
+  "/root/repo/src/workerpool.cpp" "CMakeFiles/dpct.dir/src/workerpool.cpp.o" "gcc" "CMakeFiles/dpct.dir/src/workerpool.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
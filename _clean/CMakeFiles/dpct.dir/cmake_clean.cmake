@@ -0,0 +1,51 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/dpct.dir/src/arc.cpp.o"
+  "CMakeFiles/dpct.dir/src/arc.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/binarymodel.cpp.o"
+  "CMakeFiles/dpct.dir/src/binarymodel.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/compiledmodel.cpp.o"
+  "CMakeFiles/dpct.dir/src/compiledmodel.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/flowgraph.cpp.o"
+  "CMakeFiles/dpct.dir/src/flowgraph.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/graph.cpp.o"
+  "CMakeFiles/dpct.dir/src/graph.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/graphreader.cpp.o"
+  "CMakeFiles/dpct.dir/src/graphreader.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/iarcnotifier.cpp.o"
+  "CMakeFiles/dpct.dir/src/iarcnotifier.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/jsoncpp.cpp.o"
+  "CMakeFiles/dpct.dir/src/jsoncpp.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/jsongraphreader.cpp.o"
+  "CMakeFiles/dpct.dir/src/jsongraphreader.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/jsonstreamparser.cpp.o"
+  "CMakeFiles/dpct.dir/src/jsonstreamparser.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/magnusson.cpp.o"
+  "CMakeFiles/dpct.dir/src/magnusson.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/memorystatistics.cpp.o"
+  "CMakeFiles/dpct.dir/src/memorystatistics.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/node.cpp.o"
+  "CMakeFiles/dpct.dir/src/node.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/pruninggraphbuilder.cpp.o"
+  "CMakeFiles/dpct.dir/src/pruninggraphbuilder.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/residualgraph.cpp.o"
+  "CMakeFiles/dpct.dir/src/residualgraph.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/solvertelemetry.cpp.o"
+  "CMakeFiles/dpct.dir/src/solvertelemetry.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/streamingflowtracker.cpp.o"
+  "CMakeFiles/dpct.dir/src/streamingflowtracker.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/temporalblockflowgraphbuilder.cpp.o"
+  "CMakeFiles/dpct.dir/src/temporalblockflowgraphbuilder.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/trackingalgorithm.cpp.o"
+  "CMakeFiles/dpct.dir/src/trackingalgorithm.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/userdata.cpp.o"
+  "CMakeFiles/dpct.dir/src/userdata.cpp.o.d"
+  "CMakeFiles/dpct.dir/src/workerpool.cpp.o"
+  "CMakeFiles/dpct.dir/src/workerpool.cpp.o.d"
+  "libdpct.pdb"
+  "libdpct.so"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/dpct.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,13 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/bench.dir/bench.cpp.o"
+  "CMakeFiles/bench.dir/bench.cpp.o.d"
+  "CMakeFiles/bench.dir/syntheticgraphreader.cpp.o"
+  "CMakeFiles/bench.dir/syntheticgraphreader.cpp.o.d"
+  "bench"
+  "bench.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/bench.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
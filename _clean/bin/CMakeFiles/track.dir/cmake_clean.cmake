@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/track.dir/track.cpp.o"
+  "CMakeFiles/track.dir/track.cpp.o.d"
+  "track"
+  "track.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/track.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
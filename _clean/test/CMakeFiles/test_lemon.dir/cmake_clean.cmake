@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_lemon.dir/test_lemon.cpp.o"
+  "CMakeFiles/test_lemon.dir/test_lemon.cpp.o.d"
+  "test_lemon"
+  "test_lemon.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_lemon.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_magnusson.dir/test_magnusson.cpp.o"
+  "CMakeFiles/test_magnusson.dir/test_magnusson.cpp.o.d"
+  "test_magnusson"
+  "test_magnusson.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_magnusson.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
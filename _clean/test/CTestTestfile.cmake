@@ -0,0 +1,12 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/test
+# Build directory: /root/repo/_clean/test
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(test_graph "test_graph")
+set_tests_properties(test_graph PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;14;add_test;/root/repo/test/CMakeLists.txt;0;")
+add_test(test_lemon "test_lemon")
+set_tests_properties(test_lemon PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;14;add_test;/root/repo/test/CMakeLists.txt;0;")
+add_test(test_magnusson "test_magnusson")
+set_tests_properties(test_magnusson PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/test/CMakeLists.txt;14;add_test;/root/repo/test/CMakeLists.txt;0;")
@@ -0,0 +1,316 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <boost/program_options.hpp>
+
+#include "graph.h"
+#include "magnusson.h"
+#include "flowgraph.h"
+#include "flowgraphbuilder.h"
+#include "magnussongraphbuilder.h"
+#include "solvertelemetry.h"
+#include "syntheticgraphreader.h"
+
+using namespace dpct;
+
+typedef std::chrono::steady_clock Clock;
+
+/// what one benchmark run reports back to the parent process
+struct RunResult
+{
+	double buildSeconds;
+	double trackSeconds;
+	double energy;
+	uint64_t iterations;
+	uint64_t numDivisions;
+};
+
+struct RunSettings
+{
+	size_t maxNumPaths = 0;
+	size_t numThreads = 1;
+};
+
+static double secondsSince(const Clock::time_point& start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// run one of the tracking methods of the track tool on the generated model
+static RunResult runMethod(const std::string& method, const SyntheticGraphReader::Parameters& params, const RunSettings& settings)
+{
+	RunResult result;
+	SolverTelemetry telemetry(method);
+	Clock::time_point start = Clock::now();
+
+	if(method == "flow" || method == "flow-flow")
+	{
+		FlowGraph graph;
+		FlowGraphBuilder graphBuilder(&graph);
+		SyntheticGraphReader reader(params, &graphBuilder);
+		reader.createGraph();
+		result.numDivisions = reader.getNumDivisions();
+		result.buildSeconds = secondsSince(start);
+
+		start = Clock::now();
+		graph.setTelemetry(&telemetry);
+		if(method == "flow")
+			result.energy = graph.maxFlowMinCostTracking(reader.getInitialStateEnergy(), true, settings.maxNumPaths, true, true, false, false, settings.numThreads);
+		else
+		{
+			double energy = graph.maxFlowMinCostTracking(reader.getInitialStateEnergy(), false, settings.maxNumPaths, true, true, false, false, settings.numThreads);
+			result.energy = graph.maxFlowMinCostTracking(energy, true, settings.maxNumPaths, true, true, false, false, settings.numThreads);
+		}
+		result.trackSeconds = secondsSince(start);
+	}
+	else if(method == "magnusson" || method == "magnusson-flow")
+	{
+		Graph::Configuration config(true, true, true);
+		Graph graph(config);
+		MagnussonGraphBuilder graphBuilder(&graph);
+		SyntheticGraphReader reader(params, &graphBuilder);
+		reader.createGraph();
+		result.numDivisions = reader.getNumDivisions();
+		result.buildSeconds = secondsSince(start);
+
+		start = Clock::now();
+		Magnusson tracker(&graph, true, true, false);
+		tracker.setNumThreads(settings.numThreads);
+		tracker.setTelemetry(&telemetry);
+		if(settings.maxNumPaths > 0)
+			tracker.setMaxNumberOfPaths(settings.maxNumPaths);
+		std::vector<TrackingAlgorithm::Path> paths;
+		double score = tracker.track(paths);
+		result.energy = reader.getInitialStateEnergy() - score;
+		result.trackSeconds = secondsSince(start);
+
+		if(method == "magnusson-flow")
+		{
+			// the flow graph is built just like in the track tool, after magnusson is done
+			start = Clock::now();
+			FlowGraph flowGraph;
+			FlowGraphBuilder flowGraphBuilder(&flowGraph);
+			SyntheticGraphReader flowReader(params, &flowGraphBuilder);
+			flowReader.createGraph();
+			result.buildSeconds += secondsSince(start);
+
+			start = Clock::now();
+			flowGraph.initializeResidualGraph(true, true, false, false, false);
+			std::vector<FlowGraph::Path> flowPaths = graphBuilder.translateSolution(paths, flowGraphBuilder);
+			for(auto p : flowPaths)
+			{
+				flowGraph.augmentUnitFlow(p);
+				flowGraph.updateEnabledArcs(p);
+			}
+
+			flowGraph.setTelemetry(&telemetry);
+			result.energy = flowGraph.maxFlowMinCostTracking(result.energy, true, settings.maxNumPaths, true, true, false, false, settings.numThreads);
+			result.trackSeconds += secondsSince(start);
+		}
+	}
+	else
+		throw std::runtime_error("Unknown tracking method selected: " + method);
+
+	result.iterations = telemetry.getIterations().size();
+	return result;
+}
+
+/**
+ * @brief Run the method in a child process, such that its peak memory can be measured in isolation
+ * and runs that exceed the time limit can be stopped.
+ * @return false if the run failed or timed out, with the reason in status
+ */
+static bool runIsolated(
+	const std::string& method,
+	const SyntheticGraphReader::Parameters& params,
+	const RunSettings& settings,
+	size_t timeoutSeconds,
+	bool verbose,
+	RunResult& result,
+	long& peakRssKilobytes,
+	std::string& status)
+{
+	int resultPipe[2];
+	if(pipe(resultPipe) != 0)
+		throw std::runtime_error("Could not create pipe for benchmark results");
+
+	pid_t child = fork();
+	if(child < 0)
+		throw std::runtime_error("Could not fork benchmark process");
+
+	if(child == 0)
+	{
+		close(resultPipe[0]);
+		if(!verbose)
+		{
+			int devNull = open("/dev/null", O_WRONLY);
+			dup2(devNull, STDOUT_FILENO);
+			close(devNull);
+		}
+		if(timeoutSeconds > 0)
+			alarm(timeoutSeconds);
+
+		try
+		{
+			RunResult childResult = runMethod(method, params, settings);
+			ssize_t written = write(resultPipe[1], &childResult, sizeof(RunResult));
+			_exit(written == sizeof(RunResult) ? 0 : 1);
+		}
+		catch(std::exception& e)
+		{
+			std::cerr << "Benchmark run " << method << " failed: " << e.what() << std::endl;
+			_exit(1);
+		}
+	}
+
+	close(resultPipe[1]);
+	size_t numRead = 0;
+	char* buffer = reinterpret_cast<char*>(&result);
+	while(numRead < sizeof(RunResult))
+	{
+		ssize_t n = read(resultPipe[0], buffer + numRead, sizeof(RunResult) - numRead);
+		if(n <= 0)
+			break;
+		numRead += n;
+	}
+	close(resultPipe[0]);
+
+	int childStatus = 0;
+	struct rusage usage;
+	wait4(child, &childStatus, 0, &usage);
+	// Linux reports the maximum resident set size in kilobytes
+	peakRssKilobytes = usage.ru_maxrss;
+
+	if(WIFSIGNALED(childStatus))
+		status = WTERMSIG(childStatus) == SIGALRM ? "timeout" : "killed";
+	else if(!WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0 || numRead != sizeof(RunResult))
+		status = "failed";
+	else
+		status = "ok";
+	return status == "ok";
+}
+
+static std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	std::stringstream s(list);
+	std::string item;
+	while(std::getline(s, item, ','))
+		if(!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+int main(int argc, char** argv) {
+	namespace po = boost::program_options;
+
+	std::string sizes("1000,10000,100000,1000000,10000000");
+	std::string methods("flow,flow-flow,magnusson,magnusson-flow");
+	std::string outputFilename;
+	std::string modelFilename;
+	std::string weightsFilename("weights.json");
+	SyntheticGraphReader::Parameters params;
+	params.numFrames = 20;
+	RunSettings settings;
+	size_t timeoutSeconds = 600;
+	bool verbose = false;
+
+	// Declare the supported options.
+	po::options_description description("Allowed options");
+	description.add_options()
+	    ("help", "produce help message")
+	    ("sizes", po::value<std::string>(&sizes), "comma separated numbers of detections to benchmark, rounded up to full frames. (default=1000,...,10000000)")
+	    ("methods,e", po::value<std::string>(&methods), "comma separated methods of the track tool to benchmark. (default=flow,flow-flow,magnusson,magnusson-flow)")
+	    ("frames", po::value<size_t>(&params.numFrames), "number of frames, the objects per frame follow from the size. (default=20)")
+	    ("links", po::value<size_t>(&params.linksPerDetection), "number of links from every detection into the next frame. (default=3)")
+	    ("divisionRate", po::value<double>(&params.divisionRate), "fraction of detections that may divide. (default=0.05)")
+	    ("mergerRate", po::value<double>(&params.mergerRate), "fraction of detections that likely contain several objects. (default=0.05)")
+	    ("maxCellCount", po::value<size_t>(&params.maxCellCount), "maximum number of objects per detection and link, the number of states is one more. (default=2)")
+	    ("seed", po::value<uint64_t>(&params.seed), "seed of the generated models. (default=42)")
+	    ("maxNumPaths,n", po::value<size_t>(&settings.maxNumPaths), "maximum number of paths to find, default=0=no limit")
+	    ("threads,t", po::value<size_t>(&settings.numThreads), "number of threads given to the solvers, 0=all cores. (default=1)")
+	    ("timeout", po::value<size_t>(&timeoutSeconds), "stop runs after this many seconds, 0=never. (default=600)")
+	    ("output,o", po::value<std::string>(&outputFilename), "additionally write the results to this CSV file")
+	    ("writeModel", po::value<std::string>(&modelFilename), "write the model of the first size to this JSON file, and its weights to --writeWeights, then exit")
+	    ("writeWeights", po::value<std::string>(&weightsFilename), "filename of the weights written with --writeModel. (default=weights.json)")
+	    ("verbose", po::value<bool>(&verbose), "show the output of the solvers? (default=false)")
+	;
+
+	po::variables_map variableMap;
+	po::store(po::parse_command_line(argc, argv, description), variableMap);
+	po::notify(variableMap);
+
+	if (variableMap.count("help"))
+	{
+	    std::cout << description << std::endl;
+	    return 1;
+	}
+
+	std::vector<size_t> numDetections;
+	for(const std::string& s : splitList(sizes))
+		numDetections.push_back(size_t(std::stod(s)));
+	if(numDetections.empty() || params.numFrames == 0)
+	{
+		std::cout << "At least one size and one frame have to be specified!" << std::endl;
+		return 1;
+	}
+
+	if (variableMap.count("writeModel"))
+	{
+		params.objectsPerFrame = (numDetections[0] + params.numFrames - 1) / params.numFrames;
+		SyntheticGraphReader reader(params, nullptr);
+		reader.writeJson(modelFilename, weightsFilename);
+		std::cout << "Wrote model with " << params.getNumDetections() << " detections and "
+				  << params.getNumLinks() << " links to " << modelFilename << std::endl;
+		return 0;
+	}
+
+	std::ofstream csv;
+	if(!outputFilename.empty())
+	{
+		csv.open(outputFilename.c_str());
+		if(!csv.good())
+			throw std::runtime_error("Could not open benchmark output file: " + outputFilename);
+		csv << "detections,links,divisions,method,status,buildSeconds,trackSeconds,peakRssMB,iterations,energy" << std::endl;
+		csv.precision(10);
+	}
+
+	std::cout << std::setw(10) << "detections" << std::setw(11) << "links" << std::setw(10) << "divisions"
+			  << std::setw(16) << "method" << std::setw(9) << "status" << std::setw(10) << "build[s]" << std::setw(10) << "track[s]"
+			  << std::setw(12) << "peakRSS[MB]" << std::setw(12) << "iterations" << std::setw(16) << "energy" << std::endl;
+
+	for(size_t n : numDetections)
+	{
+		params.objectsPerFrame = std::max<size_t>(1, (n + params.numFrames - 1) / params.numFrames);
+		for(const std::string& method : splitList(methods))
+		{
+			RunResult result = {0.0, 0.0, 0.0, 0, 0};
+			long peakRssKilobytes = 0;
+			std::string status;
+			runIsolated(method, params, settings, timeoutSeconds, verbose, result, peakRssKilobytes, status);
+
+			double peakRssMegabytes = peakRssKilobytes / 1024.0;
+			std::cout << std::setw(10) << params.getNumDetections() << std::setw(11) << params.getNumLinks() << std::setw(10) << result.numDivisions
+					  << std::setw(16) << method << std::setw(9) << status
+					  << std::fixed << std::setprecision(3) << std::setw(10) << result.buildSeconds << std::setw(10) << result.trackSeconds
+					  << std::setprecision(1) << std::setw(12) << peakRssMegabytes << std::setw(12) << result.iterations
+					  << std::setprecision(4) << std::setw(16) << result.energy << std::defaultfloat << std::endl;
+			if(csv.is_open())
+				csv << params.getNumDetections() << "," << params.getNumLinks() << "," << result.numDivisions << "," << method << "," << status << ","
+					<< result.buildSeconds << "," << result.trackSeconds << "," << peakRssMegabytes << "," << result.iterations << "," << result.energy << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,254 @@
+#include "syntheticgraphreader.h"
+#include "graphbuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace dpct
+{
+
+/// the different random values that are drawn for every hypothesis, increments are drawn per state
+enum RandomValue : uint64_t {Probability = 0, Merger, Division, DivisionProbability, Appearance, Disappearance,
+	DetectionIncrements = 1 << 16, AppearanceIncrements = 2 << 16, DisappearanceIncrements = 3 << 16, LinkIncrements = 4 << 16};
+static const uint64_t LinkKeyOffset = uint64_t(1) << 63;
+
+static uint64_t splitMix64(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+/// cost difference between using a hypothesis or not, for the given probability of it being used
+static double probabilityToCostDelta(double p)
+{
+	return std::log((1.0 - p) / p);
+}
+
+size_t SyntheticGraphReader::Parameters::getNumLinksPerDetection() const
+{
+	return std::min(linksPerDetection, objectsPerFrame);
+}
+
+size_t SyntheticGraphReader::Parameters::getNumLinks() const
+{
+	if(numFrames < 2)
+		return 0;
+	return (numFrames - 1) * objectsPerFrame * getNumLinksPerDetection();
+}
+
+SyntheticGraphReader::SyntheticGraphReader(const Parameters& parameters, GraphBuilder* graphBuilder):
+	GraphReader(graphBuilder),
+	parameters_(parameters),
+	numDivisions_(0)
+{
+	if(parameters_.maxCellCount < 1)
+		throw std::runtime_error("Synthetic models need a maximum cell count of at least one");
+	if(parameters_.objectsPerFrame == 0 || parameters_.numFrames == 0)
+		throw std::runtime_error("Synthetic models need at least one object and one frame");
+	weights_.assign(5, 1.0);
+}
+
+double SyntheticGraphReader::uniform(uint64_t key, uint64_t value) const
+{
+	return double(splitMix64(splitMix64(parameters_.seed ^ splitMix64(key)) ^ value) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void SyntheticGraphReader::convexFeatures(ValueType firstDelta, ValueType minIncrement, ValueType maxIncrement, uint64_t key, uint64_t firstIncrement, StateFeatureVector& features) const
+{
+	features.resize(parameters_.maxCellCount + 1);
+	features[0].assign(1, 0.0);
+	ValueType delta = firstDelta;
+	for(size_t state = 1; state < features.size(); state++)
+	{
+		features[state].assign(1, features[state - 1][0] + delta);
+		delta += minIncrement + (maxIncrement - minIncrement) * uniform(key, firstIncrement + state);
+	}
+}
+
+void SyntheticGraphReader::generateDetection(size_t frame, size_t index, Detection& detection) const
+{
+	detection.id = getDetectionId(frame, index);
+	detection.frame = int(frame);
+	uint64_t key = detection.id;
+
+	// mergers are likely to hold more than one object, so adding further objects is cheap
+	bool merger = uniform(key, Merger) < parameters_.mergerRate;
+	double p = 0.55 + 0.44 * uniform(key, Probability);
+	if(merger)
+		convexFeatures(probabilityToCostDelta(p), 0.05, 0.5, key, DetectionIncrements, detection.features);
+	else
+		convexFeatures(probabilityToCostDelta(p), 2.0, 5.0, key, DetectionIncrements, detection.features);
+
+	// objects may enter in the first and leave in the last frame for free
+	double appearanceCost = frame == 0 ? 0.0 : 2.0 + 3.0 * uniform(key, Appearance);
+	double disappearanceCost = frame + 1 == parameters_.numFrames ? 0.0 : 2.0 + 3.0 * uniform(key, Disappearance);
+	convexFeatures(appearanceCost, 1.0, 2.0, key, AppearanceIncrements, detection.appearanceFeatures);
+	convexFeatures(disappearanceCost, 1.0, 2.0, key, DisappearanceIncrements, detection.disappearanceFeatures);
+
+	detection.divisionFeatures.clear();
+	if(frame + 1 < parameters_.numFrames
+		&& parameters_.getNumLinksPerDetection() > 1
+		&& uniform(key, Division) < parameters_.divisionRate)
+	{
+		double q = 0.3 + 0.6 * uniform(key, DivisionProbability);
+		detection.divisionFeatures = {{0.0}, {probabilityToCostDelta(q)}};
+	}
+}
+
+void SyntheticGraphReader::generateLink(size_t frame, size_t index, size_t linkIndex, size_t& destId, StateFeatureVector& features) const
+{
+	// link to a window of the closest detections in the next frame
+	size_t numLinks = parameters_.getNumLinksPerDetection();
+	size_t firstDest = index < numLinks / 2 ? 0 : std::min(index - numLinks / 2, parameters_.objectsPerFrame - numLinks);
+	size_t destIndex = firstDest + linkIndex;
+	destId = getDetectionId(frame + 1, destIndex);
+
+	uint64_t key = LinkKeyOffset + getDetectionId(frame, index) * numLinks + linkIndex;
+	size_t distance = destIndex > index ? destIndex - index : index - destIndex;
+	double p = (0.5 + 0.45 * uniform(key, Probability)) / (1.0 + distance);
+	convexFeatures(probabilityToCostDelta(p), 1.0, 3.0, key, LinkIncrements, features);
+}
+
+void SyntheticGraphReader::createGraph()
+{
+	const Parameters& params = parameters_;
+	initialStateEnergy_ = 0.0;
+	numDivisions_ = 0;
+
+	// same weight layout as the JSON models: link, detection, division, appearance, disappearance
+	const size_t linkWeightOffset = 0;
+	const size_t detWeightOffset = 1;
+	const size_t divWeightOffset = 2;
+	const size_t appWeightOffset = 3;
+	const size_t disWeightOffset = 4;
+
+	// divisions are only known after generating the detections, so only reserve for the expected number
+	graphBuilder_->reserve(params.getNumDetections(), params.getNumLinks(), size_t(params.divisionRate * params.getNumDetections()));
+
+	Detection detection;
+	std::vector<std::pair<size_t, StateFeatureVector> > divisions;
+	for(size_t frame = 0; frame < params.numFrames; frame++)
+	{
+		for(size_t index = 0; index < params.objectsPerFrame; index++)
+		{
+			generateDetection(frame, index, detection);
+			graphBuilder_->setNodeTimesteps(detection.id, std::make_pair(detection.frame, detection.frame));
+
+			FeatureVector detCosts = weightedSumOfFeatures(detection.features, weights_, detWeightOffset, true);
+			FeatureVector detCostDeltas = costsToScoreDeltas(detCosts);
+			FeatureVector appearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(detection.appearanceFeatures, weights_, appWeightOffset, true));
+			FeatureVector disappearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(detection.disappearanceFeatures, weights_, disWeightOffset, true));
+			graphBuilder_->addNode(detection.id, detCosts, detCostDeltas, appearanceCostDeltas, disappearanceCostDeltas, 0);
+
+			// divisions are added after all links, as the readers do
+			if(!detection.divisionFeatures.empty())
+				divisions.push_back(std::make_pair(detection.id, detection.divisionFeatures));
+		}
+	}
+
+	StateFeatureVector linkFeatures;
+	size_t destId;
+	for(size_t frame = 0; frame + 1 < params.numFrames; frame++)
+	{
+		for(size_t index = 0; index < params.objectsPerFrame; index++)
+		{
+			for(size_t linkIndex = 0; linkIndex < params.getNumLinksPerDetection(); linkIndex++)
+			{
+				generateLink(frame, index, linkIndex, destId, linkFeatures);
+				graphBuilder_->addArc(getDetectionId(frame, index), destId,
+					costsToScoreDeltas(weightedSumOfFeatures(linkFeatures, weights_, linkWeightOffset, true)));
+			}
+		}
+	}
+
+	for(auto& d : divisions)
+		graphBuilder_->allowMitosis(d.first, costsToScoreDelta(weightedSumOfFeatures(d.second, weights_, divWeightOffset, true)));
+	numDivisions_ = divisions.size();
+}
+
+static void writeFeatures(std::ostream& out, const GraphReader::StateFeatureVector& features)
+{
+	out << "[";
+	for(size_t state = 0; state < features.size(); state++)
+	{
+		out << (state > 0 ? ", [" : "[");
+		for(size_t i = 0; i < features[state].size(); i++)
+			out << (i > 0 ? ", " : "") << features[state][i];
+		out << "]";
+	}
+	out << "]";
+}
+
+void SyntheticGraphReader::writeJson(const std::string& modelFilename, const std::string& weightsFilename) const
+{
+	const Parameters& params = parameters_;
+	std::ofstream out(modelFilename.c_str());
+	if(!out.good())
+		throw std::runtime_error("Could not open JSON model file for saving: " + modelFilename);
+	// store features exactly, such that tracking the file gives the same result as the generated model
+	out.precision(std::numeric_limits<double>::max_digits10);
+
+	out << "{\n\t\"" << JsonTypeNames[JsonTypes::Settings] << "\" : {\"" << JsonTypeNames[JsonTypes::StatesShareWeights] << "\" : true},\n";
+	out << "\t\"" << JsonTypeNames[JsonTypes::Segmentations] << "\" : [\n";
+	Detection detection;
+	for(size_t frame = 0; frame < params.numFrames; frame++)
+	{
+		for(size_t index = 0; index < params.objectsPerFrame; index++)
+		{
+			generateDetection(frame, index, detection);
+			out << "\t\t{\"" << JsonTypeNames[JsonTypes::Id] << "\" : " << detection.id
+				<< ", \"" << JsonTypeNames[JsonTypes::Timestep] << "\" : [" << detection.frame << ", " << detection.frame << "]"
+				<< ", \"" << JsonTypeNames[JsonTypes::Features] << "\" : ";
+			writeFeatures(out, detection.features);
+			out << ", \"" << JsonTypeNames[JsonTypes::AppearanceFeatures] << "\" : ";
+			writeFeatures(out, detection.appearanceFeatures);
+			out << ", \"" << JsonTypeNames[JsonTypes::DisappearanceFeatures] << "\" : ";
+			writeFeatures(out, detection.disappearanceFeatures);
+			if(!detection.divisionFeatures.empty())
+			{
+				out << ", \"" << JsonTypeNames[JsonTypes::DivisionFeatures] << "\" : ";
+				writeFeatures(out, detection.divisionFeatures);
+			}
+			bool last = frame + 1 == params.numFrames && index + 1 == params.objectsPerFrame;
+			out << (last ? "}\n" : "},\n");
+		}
+	}
+	out << "\t],\n";
+
+	out << "\t\"" << JsonTypeNames[JsonTypes::Links] << "\" : [\n";
+	StateFeatureVector linkFeatures;
+	size_t destId;
+	for(size_t frame = 0; frame + 1 < params.numFrames; frame++)
+	{
+		for(size_t index = 0; index < params.objectsPerFrame; index++)
+		{
+			for(size_t linkIndex = 0; linkIndex < params.getNumLinksPerDetection(); linkIndex++)
+			{
+				generateLink(frame, index, linkIndex, destId, linkFeatures);
+				out << "\t\t{\"" << JsonTypeNames[JsonTypes::SrcId] << "\" : " << getDetectionId(frame, index)
+					<< ", \"" << JsonTypeNames[JsonTypes::DestId] << "\" : " << destId
+					<< ", \"" << JsonTypeNames[JsonTypes::Features] << "\" : ";
+				writeFeatures(out, linkFeatures);
+				bool last = frame + 2 == params.numFrames && index + 1 == params.objectsPerFrame
+					&& linkIndex + 1 == params.getNumLinksPerDetection();
+				out << (last ? "}\n" : "},\n");
+			}
+		}
+	}
+	out << "\t]\n}\n";
+
+	std::ofstream weightsOut(weightsFilename.c_str());
+	if(!weightsOut.good())
+		throw std::runtime_error("Could not open JSON weights file for saving: " + weightsFilename);
+	weightsOut << "{\n\t\"" << JsonTypeNames[JsonTypes::Weights] << "\" : [";
+	for(size_t i = 0; i < weights_.size(); i++)
+		weightsOut << (i > 0 ? ", " : "") << weights_[i];
+	weightsOut << "]\n}\n";
+}
+
+} // end namespace dpct
@@ -0,0 +1,94 @@
+#ifndef SYNTHETIC_GRAPH_READER
+#define SYNTHETIC_GRAPH_READER
+
+#include <cstdint>
+#include <string>
+
+#include "graphreader.h"
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief A graph reader that generates a random tracking model instead of reading one,
+ * such that the solvers can be benchmarked on models of any size.
+ *
+ * Every frame holds the same number of detections, ordered along one axis, and every detection
+ * links to the closest detections of the next frame. Features are cost differences between consecutive
+ * numbers of objects, chosen such that all score setups are convex. The features of each hypothesis
+ * only depend on the seed and the hypothesis index, so the same parameters always give the same model,
+ * no matter how often or into which graph builder it is generated.
+ *
+ * All states share their weights, and the weights are all one: link, detection, division, appearance, disappearance.
+ */
+class SyntheticGraphReader : public GraphReader
+{
+public:
+	struct Parameters
+	{
+		size_t objectsPerFrame = 100;
+		size_t numFrames = 10;
+		/// number of links from every detection to the next frame, at most objectsPerFrame
+		size_t linksPerDetection = 3;
+		/// fraction of detections that may divide
+		double divisionRate = 0.05;
+		/// fraction of detections that are likely to contain more than one object
+		double mergerRate = 0.05;
+		/// maximum number of objects per detection and link, the number of states is one more
+		size_t maxCellCount = 2;
+		uint64_t seed = 42;
+
+		size_t getNumDetections() const { return objectsPerFrame * numFrames; }
+		size_t getNumLinksPerDetection() const;
+		size_t getNumLinks() const;
+	};
+
+	SyntheticGraphReader(const Parameters& parameters, GraphBuilder* graphBuilder);
+
+	/**
+	 * @brief Add all generated nodes, links and divisions to the graph builder.
+	 * Costs are computed from features times weights
+	 */
+	void createGraph();
+
+	/// @return the number of division hypotheses, known after createGraph
+	size_t getNumDivisions() const { return numDivisions_; }
+
+	/**
+	 * @brief Write the generated model and its weights as JSON files that can be given to the track tool
+	 */
+	void writeJson(const std::string& modelFilename, const std::string& weightsFilename) const;
+
+private:
+	/// the generated features of one detection: one feature per state
+	struct Detection
+	{
+		size_t id;
+		int frame;
+		StateFeatureVector features;
+		StateFeatureVector appearanceFeatures;
+		StateFeatureVector disappearanceFeatures;
+		/// empty if the detection cannot divide
+		StateFeatureVector divisionFeatures;
+	};
+
+	void generateDetection(size_t frame, size_t index, Detection& detection) const;
+	void generateLink(size_t frame, size_t index, size_t linkIndex, size_t& destId, StateFeatureVector& features) const;
+
+	/// state features that start at zero and grow by firstDelta for the first object and by increasingly more afterwards
+	void convexFeatures(ValueType firstDelta, ValueType minIncrement, ValueType maxIncrement, uint64_t key, uint64_t firstIncrement, StateFeatureVector& features) const;
+
+	/// uniform value in [0,1) that only depends on the seed, the key of the hypothesis and which of its values is drawn
+	double uniform(uint64_t key, uint64_t value) const;
+
+	size_t getDetectionId(size_t frame, size_t index) const { return frame * parameters_.objectsPerFrame + index + 1; }
+
+private:
+	Parameters parameters_;
+	size_t numDivisions_;
+};
+
+} // end namespace dpct
+
+#endif // SYNTHETIC_GRAPH_READER
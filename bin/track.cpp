@@ -1,4 +1,17 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
 
 #include <boost/program_options.hpp>
 
@@ -7,21 +20,662 @@
 #include "flowgraph.h"
 #include "jsongraphreader.h"
 #include "flowgraphbuilder.h"
+#include "componentflowgraphbuilder.h"
+#include "temporalblockflowgraphbuilder.h"
 #include "magnussongraphbuilder.h"
+#include "pruninggraphbuilder.h"
 
 using namespace dpct;
 
+namespace
+{
+
+/// the solver settings of the command line, used for every model that is tracked
+struct TrackingOptions
+{
+	bool swap = true;
+	bool useOrderedNodeListInBF = true;
+	bool partialBFUpdates = true;
+	bool staticResidualArcs = false;
+	bool csrBackend = false;
+	bool dijkstra = false;
+	size_t maxNumPaths = 0;
+	size_t numThreads = 1;
+	/// whether numThreads is replaced by the optimizerNumThreads of each model's settings
+	bool useModelNumThreads = true;
+	size_t pathBatchSize = 1;
+	double pathBatchRatio = 0.95;
+	bool compareSequential = false;
+	bool arenaStorage = false;
+	bool incrementalUpdates = false;
+	bool recycleSwapArcs = false;
+	size_t pathsPerSweep = 1;
+	double pathScoreRatio = 0.8;
+	bool components = false;
+	/// timesteps per block when every block of timesteps is tracked in its own flow graph, 0 for one graph
+	size_t blockLength = 0;
+	size_t blockOverlap = 2;
+	/// the only block a worker tracks and saves to the output, -1 to track all blocks
+	int solveBlock = -1;
+	/// results of all blocks, as saved by the workers, to stitch instead of tracking the blocks
+	std::vector<std::string> blockResultFilenames;
+	double timeBudget = 0.0;
+	double energyGap = 0.0;
+	bool cycleRepair = false;
+	/// whether every detection of a flow graph is an in- and an out-node, instead of one node that carries its costs
+	bool splitDetections = true;
+	/// store results in the binary format instead of JSON
+	bool binaryResult = false;
+	/// remove dominated and unreachable hypotheses before the graph is built
+	bool prune = false;
+	/// where the removed hypotheses of every built graph are written to, empty for none
+	std::string pruneReportFilename;
+};
+
+/// one model to track: where it and its weights are read from, where the result goes and which method is used
+struct TrackingJob
+{
+	std::string modelFilename;
+	std::string weightsFilename;
+	std::string outputFilename;
+	std::string method;
+	/// weights that were already read from weightsFilename, nullptr to read them when the model is built
+	const GraphReader::FeatureVector* weights = nullptr;
+	/// estimated peak memory of tracking the model, in bytes
+	size_t estimatedBytes = 0;
+};
+
+std::unique_ptr<JsonGraphReader> createReader(const TrackingJob& job, GraphBuilder* graphBuilder)
+{
+	if(job.weights != nullptr)
+		return std::unique_ptr<JsonGraphReader>(new JsonGraphReader(job.modelFilename, *job.weights, graphBuilder));
+	return std::unique_ptr<JsonGraphReader>(new JsonGraphReader(job.modelFilename, job.weightsFilename, graphBuilder));
+}
+
+/// a reader that built a model, with the builder in between that pruned its hypotheses, if any
+struct ModelReader
+{
+	std::unique_ptr<PruningGraphBuilder> pruner;
+	std::unique_ptr<JsonGraphReader> reader;
+};
+
+/// read the model of the job into the graph builder, and prune its hypotheses first if the options ask for it
+ModelReader readModel(const TrackingOptions& options, const TrackingJob& job, GraphBuilder* graphBuilder)
+{
+	ModelReader model;
+	if(options.prune)
+	{
+		model.pruner.reset(new PruningGraphBuilder(graphBuilder));
+		graphBuilder = model.pruner.get();
+	}
+	model.reader = createReader(job, graphBuilder);
+	model.reader->createGraphFromJson();
+
+	if(model.pruner)
+	{
+		model.pruner->prune();
+		model.pruner->getReport().writeSummary(std::cout);
+		if(!options.pruneReportFilename.empty())
+			model.pruner->getReport().save(options.pruneReportFilename);
+	}
+	return model;
+}
+
+void saveResult(const TrackingOptions& options, JsonGraphReader& jsonReader, const std::string& filename)
+{
+	if(options.binaryResult)
+		jsonReader.saveResultBinary(filename);
+	else
+		jsonReader.saveResultJson(filename);
+}
+
+size_t estimateTrackingBytes(const JsonGraphReader::HypothesisCounts& counts, const std::string& method)
+{
+	return MemoryStatistics::estimateTrackingBytes(counts.numSegmentations, counts.numLinks, counts.numDivisions, method);
+}
+
+double toMB(size_t bytes)
+{
+	return double(bytes) / (1024.0 * 1024.0);
+}
+
+/**
+ * @brief Track one model with the selected method and store the result.
+ * If memoryPointer is set, the containers of the graphs are added to it after tracking (not for components or time blocks).
+ * @return the energy of the tracking result
+ */
+double trackModel(const TrackingOptions& options, const TrackingJob& job, SolverTelemetry* telemetryPointer, MemoryStatistics* memoryPointer)
+{
+	const std::string& method = job.method;
+	size_t numThreads = options.numThreads;
+	double energy = 0.0;
+
+	if(method == "flow" && options.blockLength > 0)
+	{
+	    TemporalBlockFlowGraphBuilder graphBuilder(options.blockLength, options.blockOverlap, options.splitDetections);
+	    if(options.solveBlock >= 0)
+	    	graphBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Block, options.solveBlock);
+	    else if(!options.blockResultFilenames.empty())
+	    	graphBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Overlaps);
+	    ModelReader model = readModel(options, job, &graphBuilder);
+	    JsonGraphReader* jsonReader = model.reader.get();
+	    std::cout << "Model has state zero energy: " << jsonReader->getInitialStateEnergy() << std::endl;
+	    if(options.useModelNumThreads)
+	    	numThreads = jsonReader->getNumThreads();
+	    // the threads work on different blocks, every block runs a sequential Bellman-Ford
+	    auto solver = [&](FlowGraph& g){
+	    	g.setLocalCycleRepair(options.cycleRepair);
+	    	g.setPathBatchCostRatio(options.pathBatchRatio);
+	    	return g.maxFlowMinCostTracking(0.0, options.swap, options.maxNumPaths, options.useOrderedNodeListInBF, options.partialBFUpdates, options.staticResidualArcs, options.csrBackend, 1, options.dijkstra, options.pathBatchSize);
+	    };
+
+	    if(options.solveBlock >= 0)
+	    {
+	    	BlockResult block = graphBuilder.solveBlock(options.solveBlock, solver);
+	    	block.save(job.outputFilename);
+	    	std::cout << "Tracked time block " << block.block << " of " << graphBuilder.getNumBlocks()
+	    			  << ", energy of its hypotheses: " << block.energy << std::endl;
+	    	return block.energy;
+	    }
+
+	    if(options.blockResultFilenames.empty())
+	    	energy = graphBuilder.solve(solver, numThreads);
+	    else
+	    {
+	    	std::vector<BlockResult> blocks;
+	    	for(const std::string& filename : options.blockResultFilenames)
+	    		blocks.push_back(BlockResult::load(filename));
+	    	// blocks that must be tracked together are read again, this process only kept their overlaps
+	    	auto solveSpan = [&](size_t firstBlock, size_t lastBlock){
+	    		TemporalBlockFlowGraphBuilder spanBuilder(options.blockLength, options.blockOverlap, options.splitDetections);
+	    		spanBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Block, firstBlock, lastBlock);
+	    		ModelReader spanModel = readModel(options, job, &spanBuilder);
+	    		return spanBuilder.solveBlocks(firstBlock, lastBlock, solver);
+	    	};
+	    	energy = graphBuilder.stitch(blocks, solver, solveSpan);
+	    }
+	    energy += jsonReader->getInitialStateEnergy();
+	    std::cout << "Tracked and stitched " << graphBuilder.getNumBlocks() << " time blocks ("
+	    		  << graphBuilder.getNumMergedOverlaps() << " overlaps tracked with their blocks instead of stitched, "
+	    		  << graphBuilder.getNumSkippedLinks() << " links skip an overlap), final energy: " << energy << std::endl;
+	    saveResult(options, *jsonReader, job.outputFilename);
+	}
+	else if(method == "flow" && options.components)
+	{
+	    ComponentFlowGraphBuilder graphBuilder(256, options.splitDetections);
+	    ModelReader model = readModel(options, job, &graphBuilder);
+	    JsonGraphReader* jsonReader = model.reader.get();
+	    std::cout << "Model has state zero energy: " << jsonReader->getInitialStateEnergy() << std::endl;
+	    if(options.useModelNumThreads)
+	    	numThreads = jsonReader->getNumThreads();
+	    // the threads work on different components, every component runs a sequential Bellman-Ford
+	    energy = jsonReader->getInitialStateEnergy() + graphBuilder.solve([&](FlowGraph& g){
+	    	g.setLocalCycleRepair(options.cycleRepair);
+	    	g.setPathBatchCostRatio(options.pathBatchRatio);
+	    	return g.maxFlowMinCostTracking(0.0, options.swap, options.maxNumPaths, options.useOrderedNodeListInBF, options.partialBFUpdates, options.staticResidualArcs, options.csrBackend, 1, options.dijkstra, options.pathBatchSize);
+	    }, numThreads);
+	    std::cout << "Tracked " << graphBuilder.getNumComponentGraphs() << " component flow graphs, final energy: " << energy << std::endl;
+	    saveResult(options, *jsonReader, job.outputFilename);
+	}
+	else if(method == "flow")
+	{
+	    FlowGraph graph(options.splitDetections);
+	    FlowGraphBuilder graphBuilder(&graph);
+	    ModelReader model = readModel(options, job, &graphBuilder);
+	    JsonGraphReader* jsonReader = model.reader.get();
+	    std::cout << "Model has state zero energy: " << jsonReader->getInitialStateEnergy() << std::endl;
+	    if(options.useModelNumThreads)
+	    	numThreads = jsonReader->getNumThreads();
+	    graph.setTelemetry(telemetryPointer);
+	    graph.setAnytimeLimits(options.timeBudget, options.energyGap);
+	    graph.setLocalCycleRepair(options.cycleRepair);
+	    graph.setPathBatchCostRatio(options.pathBatchRatio);
+	    energy = graph.maxFlowMinCostTracking(jsonReader->getInitialStateEnergy(), options.swap, options.maxNumPaths, options.useOrderedNodeListInBF, options.partialBFUpdates, options.staticResidualArcs, options.csrBackend, numThreads, options.dijkstra, options.pathBatchSize);
+	    if(memoryPointer != nullptr)
+	    	graph.collectMemoryStatistics(*memoryPointer);
+	    saveResult(options, *jsonReader, job.outputFilename);
+
+	    if(options.compareSequential && options.pathBatchSize > 1)
+	    {
+	    	FlowGraph sequentialGraph(options.splitDetections);
+	    	FlowGraphBuilder sequentialGraphBuilder(&sequentialGraph);
+	    	ModelReader sequentialModel = readModel(options, job, &sequentialGraphBuilder);
+	    	JsonGraphReader* sequentialJsonReader = sequentialModel.reader.get();
+	    	double sequentialEnergy = sequentialGraph.maxFlowMinCostTracking(sequentialJsonReader->getInitialStateEnergy(), options.swap, options.maxNumPaths, options.useOrderedNodeListInBF, options.partialBFUpdates, options.staticResidualArcs, options.csrBackend, numThreads, options.dijkstra, 1);
+	    	std::cout << "Batched energy: " << energy << ", sequential energy: " << sequentialEnergy
+	    			  << ", difference: " << energy - sequentialEnergy << std::endl;
+	    }
+	}
+	else if(method == "flow-flow")
+	{
+	    FlowGraph graph(options.splitDetections);
+	    FlowGraphBuilder graphBuilder(&graph);
+	    ModelReader model = readModel(options, job, &graphBuilder);
+	    JsonGraphReader* jsonReader = model.reader.get();
+	    std::cout << "Model has state zero energy: " << jsonReader->getInitialStateEnergy() << std::endl;
+	    if(options.useModelNumThreads)
+	    	numThreads = jsonReader->getNumThreads();
+	    graph.setTelemetry(telemetryPointer);
+	    graph.setAnytimeLimits(options.timeBudget, options.energyGap);
+	    graph.setLocalCycleRepair(options.cycleRepair);
+	    graph.setPathBatchCostRatio(options.pathBatchRatio);
+	    energy = graph.maxFlowMinCostTracking(jsonReader->getInitialStateEnergy(), false, options.maxNumPaths, options.useOrderedNodeListInBF, options.partialBFUpdates, options.staticResidualArcs, options.csrBackend, numThreads, options.dijkstra, options.pathBatchSize);
+	    energy = graph.maxFlowMinCostTracking(energy, true, options.maxNumPaths, options.useOrderedNodeListInBF, options.partialBFUpdates, options.staticResidualArcs, options.csrBackend, numThreads, options.dijkstra, options.pathBatchSize);
+	    if(memoryPointer != nullptr)
+	    	graph.collectMemoryStatistics(*memoryPointer);
+	    saveResult(options, *jsonReader, job.outputFilename);
+	}
+	else if(method == "magnusson")
+	{
+		Graph::Configuration config(true, true, true, options.arenaStorage);
+		Graph graph(config);
+	    MagnussonGraphBuilder graphBuilder(&graph);
+	    ModelReader model = readModel(options, job, &graphBuilder);
+	    JsonGraphReader* jsonReader = model.reader.get();
+	    std::cout << "Model has state zero energy: " << jsonReader->getInitialStateEnergy() << std::endl;
+
+	    if(options.useModelNumThreads)
+	    	numThreads = jsonReader->getNumThreads();
+	    Magnusson tracker(&graph, options.swap, true, false);
+	    tracker.setIncrementalUpdates(options.incrementalUpdates);
+	    tracker.setNumThreads(numThreads);
+	    tracker.setRecycleStaleSwapArcs(options.recycleSwapArcs);
+	    tracker.setPathsPerSweep(options.pathsPerSweep, options.pathScoreRatio);
+	    tracker.setTelemetry(telemetryPointer);
+	    if(options.maxNumPaths > 0)
+	    	tracker.setMaxNumberOfPaths(options.maxNumPaths);
+
+	    std::vector<TrackingAlgorithm::Path> paths;
+	    double score = tracker.track(paths);
+	    energy = jsonReader->getInitialStateEnergy() - score;
+	    std::cout << "\nTracking finished in " << tracker.getElapsedSeconds() << " secs with score "
+	    		  << energy << std::endl;
+	    if(memoryPointer != nullptr)
+	    	tracker.collectMemoryStatistics(*memoryPointer);
+	    graphBuilder.getSolutionFromPaths(paths);
+	    saveResult(options, *jsonReader, job.outputFilename);
+	}
+	else if(method == "magnusson-flow")
+	{
+		double zeroEnergy, score;
+
+		// set up magnusson
+		Graph::Configuration config(true, true, true, options.arenaStorage);
+		Graph graph(config);
+	    MagnussonGraphBuilder graphBuilder(&graph);
+	    std::vector<TrackingAlgorithm::Path> paths;
+
+	    { // scope needed due to weird model scores that show up otherwise
+		    ModelReader model = readModel(options, job, &graphBuilder);
+		    JsonGraphReader* jsonReader = model.reader.get();
+		    zeroEnergy = jsonReader->getInitialStateEnergy();
+		    std::cout << "Model has state zero energy: " << zeroEnergy << std::endl;
+
+		    // track magnusson
+		    if(options.useModelNumThreads)
+		    	numThreads = jsonReader->getNumThreads();
+		    Magnusson tracker(&graph, options.swap, true, false);
+		    tracker.setIncrementalUpdates(options.incrementalUpdates);
+		    tracker.setNumThreads(numThreads);
+		    tracker.setRecycleStaleSwapArcs(options.recycleSwapArcs);
+		    tracker.setPathsPerSweep(options.pathsPerSweep, options.pathScoreRatio);
+		    tracker.setTelemetry(telemetryPointer);
+		    if(options.maxNumPaths > 0)
+		    	tracker.setMaxNumberOfPaths(options.maxNumPaths);
+
+		    score = tracker.track(paths);
+		    std::cout << "\nTracking finished in " << tracker.getElapsedSeconds() << " secs with score "
+		    		  << zeroEnergy - score << std::endl;
+
+		    if(memoryPointer != nullptr)
+		    	tracker.collectMemoryStatistics(*memoryPointer);
+		    std::cout << "Extracting solution" << std::endl;
+		}
+
+	    // set up flow
+	    FlowGraph flowGraph(options.splitDetections);
+	    FlowGraphBuilder flowGraphBuilder(&flowGraph);
+	    ModelReader flowModel = readModel(options, job, &flowGraphBuilder);
+	    JsonGraphReader* flowJsonReader = flowModel.reader.get();
+	    std::cout << "Model has state zero energy: " << flowJsonReader->getInitialStateEnergy() << std::endl;
+	    if(options.useModelNumThreads)
+	    	numThreads = flowJsonReader->getNumThreads();
+
+	    // initialize flow with magnusson's result
+	    std::cout << "initializing flow solver" << std::endl;
+	    flowGraph.initializeResidualGraph(true, options.useOrderedNodeListInBF, options.staticResidualArcs, options.csrBackend, options.dijkstra);
+
+	    std::vector<FlowGraph::Path> flowPaths = graphBuilder.translateSolution(paths, flowGraphBuilder);
+	    for(auto p : flowPaths)
+	    {
+	    	flowGraph.augmentUnitFlow(p);
+	    	flowGraph.updateEnabledArcs(p);
+	    }
+
+	    // track flow, its iterations follow those of magnusson in the telemetry
+	    std::cout << "beginning tracking" << std::endl;
+	    flowGraph.setTelemetry(telemetryPointer);
+	    flowGraph.setAnytimeLimits(options.timeBudget, options.energyGap);
+	    flowGraph.setLocalCycleRepair(options.cycleRepair);
+	    flowGraph.setPathBatchCostRatio(options.pathBatchRatio);
+		energy = flowGraph.maxFlowMinCostTracking(zeroEnergy - score, true, options.maxNumPaths, options.useOrderedNodeListInBF, options.partialBFUpdates, options.staticResidualArcs, options.csrBackend, numThreads, options.dijkstra, options.pathBatchSize);
+	    if(memoryPointer != nullptr)
+	    	flowGraph.collectMemoryStatistics(*memoryPointer);
+	    saveResult(options, *flowJsonReader, job.outputFilename);
+	}
+	else
+		throw std::runtime_error("Unknown tracking method selected");
+
+	return energy;
+}
+
+/**
+ * @brief Read the jobs of a batch manifest: one job per line, given as
+ * "model weights output [method]" separated by whitespace. Empty lines and lines starting with '#' are skipped.
+ */
+std::vector<TrackingJob> readManifest(const std::string& filename, const std::string& defaultMethod)
+{
+	std::ifstream input(filename.c_str());
+	if(!input.good())
+		throw std::runtime_error("Could not open batch manifest for reading: " + filename);
+
+	std::vector<TrackingJob> jobs;
+	std::string line;
+	for(size_t lineNumber = 1; std::getline(input, line); lineNumber++)
+	{
+		std::istringstream fields(line);
+		TrackingJob job;
+		if(!(fields >> job.modelFilename) || job.modelFilename[0] == '#')
+			continue;
+		if(!(fields >> job.weightsFilename >> job.outputFilename))
+		{
+			std::stringstream s;
+			s << "Line " << lineNumber << " of batch manifest " << filename << " needs model, weights and output filenames";
+			throw std::runtime_error(s.str());
+		}
+		if(!(fields >> job.method))
+			job.method = defaultMethod;
+		jobs.push_back(job);
+	}
+	return jobs;
+}
+
+/**
+ * @brief Runs the jobs of a batch on a fixed number of threads.
+ * All jobs are dealt to per-thread queues up front. Every thread works on the front of its own queue,
+ * and once that is empty it steals from the back of the other queues.
+ * A job only starts when its estimated memory fits into the budget next to the running jobs,
+ * jobs larger than the whole budget run while no other job is running.
+ */
+class BatchScheduler
+{
+public:
+	BatchScheduler(size_t numThreads, size_t memoryBudget):
+		queues_(std::max<size_t>(numThreads, 1)),
+		memoryBudget_(memoryBudget),
+		usedMemory_(0),
+		numRunning_(0)
+	{}
+
+	/**
+	 * @brief run job(i) for the given job indices, the queues are filled round robin in this order
+	 * @param jobBytes estimated memory of each job
+	 */
+	void run(const std::vector<size_t>& order, const std::vector<size_t>& jobBytes, const std::function<void(size_t)>& job)
+	{
+		for(size_t i = 0; i < order.size(); i++)
+			queues_[i % queues_.size()].jobs.push_back(order[i]);
+
+		std::vector<std::thread> threads;
+		for(size_t t = 0; t < queues_.size(); t++)
+		{
+			threads.push_back(std::thread([&, t](){
+				size_t index;
+				while(takeJob(t, index))
+				{
+					acquireMemory(jobBytes[index]);
+					job(index);
+					releaseMemory(jobBytes[index]);
+				}
+			}));
+		}
+		for(auto& t : threads)
+			t.join();
+	}
+
+private:
+	struct JobQueue
+	{
+		std::mutex mutex;
+		std::deque<size_t> jobs;
+	};
+
+	bool takeJob(size_t thread, size_t& index)
+	{
+		{
+			JobQueue& own = queues_[thread];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if(!own.jobs.empty())
+			{
+				index = own.jobs.front();
+				own.jobs.pop_front();
+				return true;
+			}
+		}
+		for(size_t i = 1; i < queues_.size(); i++)
+		{
+			JobQueue& victim = queues_[(thread + i) % queues_.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if(!victim.jobs.empty())
+			{
+				index = victim.jobs.back();
+				victim.jobs.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void acquireMemory(size_t bytes)
+	{
+		std::unique_lock<std::mutex> lock(memoryMutex_);
+		memoryAvailable_.wait(lock, [&](){ return numRunning_ == 0 || usedMemory_ + bytes <= memoryBudget_; });
+		usedMemory_ += bytes;
+		numRunning_++;
+	}
+
+	void releaseMemory(size_t bytes)
+	{
+		{
+			std::lock_guard<std::mutex> lock(memoryMutex_);
+			usedMemory_ -= bytes;
+			numRunning_--;
+		}
+		memoryAvailable_.notify_all();
+	}
+
+private:
+	std::vector<JobQueue> queues_;
+	size_t memoryBudget_;
+	size_t usedMemory_;
+	size_t numRunning_;
+	std::mutex memoryMutex_;
+	std::condition_variable memoryAvailable_;
+};
+
+/**
+ * @brief Track all jobs of the manifest concurrently.
+ * Every weights file is read once, and the hypotheses of every model are counted before tracking starts
+ * to estimate its memory.
+ * @return the number of jobs that failed
+ */
+size_t trackBatch(const TrackingOptions& options, std::vector<TrackingJob>& jobs, size_t numJobThreads, size_t memoryBudget)
+{
+	typedef std::chrono::steady_clock Clock;
+	std::vector<std::string> errors(jobs.size());
+
+	// weight vectors are shared by all jobs using the same file
+	std::map<std::string, GraphReader::FeatureVector> weightsCache;
+	std::map<std::string, std::string> weightsErrors;
+	for(size_t i = 0; i < jobs.size(); i++)
+	{
+		const std::string& filename = jobs[i].weightsFilename;
+		if(weightsCache.count(filename) == 0 && weightsErrors.count(filename) == 0)
+		{
+			try
+			{
+				weightsCache[filename] = JsonGraphReader::readWeightsFromJson(filename);
+			}
+			catch(std::exception& e)
+			{
+				weightsErrors[filename] = e.what();
+			}
+		}
+		if(weightsErrors.count(filename) > 0)
+			errors[i] = weightsErrors[filename];
+		else
+			jobs[i].weights = &weightsCache[filename];
+	}
+	std::cout << "Read " << weightsCache.size() << " weight files for " << jobs.size() << " jobs" << std::endl;
+
+	// count the hypotheses of all models in parallel, the graph builders are not needed for that
+	std::vector<size_t> jobBytes(jobs.size(), 0);
+	{
+		std::mutex nextMutex;
+		size_t next = 0;
+		std::vector<std::thread> threads;
+		for(size_t t = 0; t < numJobThreads; t++)
+		{
+			threads.push_back(std::thread([&](){
+				while(true)
+				{
+					size_t i;
+					{
+						std::lock_guard<std::mutex> lock(nextMutex);
+						if(next == jobs.size())
+							return;
+						i = next++;
+					}
+					if(!errors[i].empty())
+						continue;
+					try
+					{
+						JsonGraphReader countingReader(jobs[i].modelFilename, jobs[i].weightsFilename, nullptr);
+						jobs[i].estimatedBytes = estimateTrackingBytes(countingReader.countHypotheses(), jobs[i].method);
+						jobBytes[i] = jobs[i].estimatedBytes;
+					}
+					catch(std::exception& e)
+					{
+						errors[i] = e.what();
+					}
+				}
+			}));
+		}
+		for(auto& t : threads)
+			t.join();
+	}
+
+	// the largest jobs start first, such that small ones fill the gaps at the end
+	std::vector<size_t> order;
+	for(size_t i = 0; i < jobs.size(); i++)
+		if(errors[i].empty())
+			order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return jobBytes[a] > jobBytes[b]; });
+
+	std::mutex reportMutex;
+	std::vector<double> energies(jobs.size(), 0.0);
+	BatchScheduler scheduler(numJobThreads, memoryBudget);
+	scheduler.run(order, jobBytes, [&](size_t i){
+		Clock::time_point start = Clock::now();
+		MemoryStatistics memory;
+		try
+		{
+			energies[i] = trackModel(options, jobs[i], nullptr, &memory);
+		}
+		catch(std::exception& e)
+		{
+			errors[i] = e.what();
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(reportMutex);
+		std::cout << "Batch job " << i + 1 << "/" << jobs.size() << " (" << jobs[i].method << ", " << jobs[i].modelFilename << ") ";
+		if(errors[i].empty())
+			std::cout << "finished in " << seconds << " secs with energy " << energies[i] << ", using "
+				<< toMB(memory.getTotalBytes()) << " MB in containers (estimated " << toMB(jobs[i].estimatedBytes) << " MB)" << std::endl;
+		else
+			std::cout << "failed: " << errors[i] << std::endl;
+	});
+
+	size_t numFailed = 0;
+	for(size_t i = 0; i < jobs.size(); i++)
+	{
+		if(errors[i].empty())
+			continue;
+		numFailed++;
+		std::cout << "Failed job " << i + 1 << " (" << jobs[i].modelFilename << "): " << errors[i] << std::endl;
+	}
+	std::cout << "Batch finished: " << jobs.size() - numFailed << " of " << jobs.size() << " jobs succeeded" << std::endl;
+	return numFailed;
+}
+
+/**
+ * @brief Count the hypotheses of every job and print the estimated memory of tracking it, without building any graph
+ * @return the number of jobs whose model could not be read
+ */
+size_t estimateJobs(const std::vector<TrackingJob>& jobs)
+{
+	size_t numFailed = 0;
+	size_t totalBytes = 0;
+	for(const TrackingJob& job : jobs)
+	{
+		try
+		{
+			JsonGraphReader countingReader(job.modelFilename, job.weightsFilename, nullptr);
+			JsonGraphReader::HypothesisCounts counts = countingReader.countHypotheses();
+			size_t bytes = estimateTrackingBytes(counts, job.method);
+			totalBytes += bytes;
+			std::cout << job.modelFilename << " (" << job.method << "): " << counts.numSegmentations << " segmentations, "
+				<< counts.numLinks << " links, " << counts.numDivisions << " divisions, estimated " << toMB(bytes) << " MB" << std::endl;
+		}
+		catch(std::exception& e)
+		{
+			numFailed++;
+			std::cout << job.modelFilename << ": " << e.what() << std::endl;
+		}
+	}
+	if(jobs.size() > 1)
+		std::cout << "Estimated " << toMB(totalBytes) << " MB for all " << jobs.size() << " jobs" << std::endl;
+	return numFailed;
+}
+
+/// half of the physical memory, or no limit if it is unknown
+size_t getDefaultMemoryBudget()
+{
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long pageSize = sysconf(_SC_PAGE_SIZE);
+	if(pages <= 0 || pageSize <= 0)
+		return std::numeric_limits<size_t>::max();
+	return size_t(pages) * size_t(pageSize) / 2;
+}
+
+} // end anonymous namespace
+
 int main(int argc, char** argv) {
 	namespace po = boost::program_options;
 
 	std::string modelFilename;
 	std::string weightsFilename;
 	std::string outputFilename;
+	std::string binaryFilename;
+	std::string telemetryFilename;
+	std::string memoryStatsFilename;
+	bool dryRun = false;
+	std::string batchFilename;
 	std::string method("flow");
-	bool swap = true;
-	bool useOrderedNodeListInBF = true;
-	bool partialBFUpdates = true;
-	size_t maxNumPaths = 0;
+	TrackingOptions options;
+	size_t numJobThreads = 0;
+	size_t memoryBudgetMB = 0;
 
 	// Declare the supported options.
 	po::options_description description("Allowed options");
@@ -30,124 +684,157 @@ int main(int argc, char** argv) {
 	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json file")
 	    ("weights,w", po::value<std::string>(&weightsFilename), "filename of the weights stored as Json file")
 	    ("output,o", po::value<std::string>(&outputFilename), "filename where the resulting tracking (as links) will be stored as Json file")
+	    ("binaryResult", po::value<bool>(&options.binaryResult), "store the resulting tracking in the compact binary result format instead of JSON? (default=false)")
+	    ("convert", po::value<std::string>(&binaryFilename), "store the model in the binary format under this filename and exit, binary models can be given as model instead of JSON files")
 	    ("method,e", po::value<std::string>(&method), "method to use for tracking: 'flow' (default), 'flow-flow', 'magnusson-flow' or 'magnusson'")
-	    ("swap,s", po::value<bool>(&swap), "whether swap arcs are enabled (default=true)")
-	    ("maxNumPaths,n", po::value<size_t>(&maxNumPaths), "maximum number of paths to find, default=0=no limit")
-	    ("orderNodes", po::value<bool>(&useOrderedNodeListInBF), "use ordered node list in BF? flow only. (default=true)")
-	    ("partialBF", po::value<bool>(&partialBFUpdates), "check which parts of the graph were influenced by last path and only update there? flow only. (default=true)")
+	    ("swap,s", po::value<bool>(&options.swap), "whether swap arcs are enabled (default=true)")
+	    ("maxNumPaths,n", po::value<size_t>(&options.maxNumPaths), "maximum number of paths to find, default=0=no limit")
+	    ("orderNodes", po::value<bool>(&options.useOrderedNodeListInBF), "use ordered node list in BF? flow only. (default=true)")
+	    ("partialBF", po::value<bool>(&options.partialBFUpdates), "check which parts of the graph were influenced by last path and only update there? flow only. (default=true)")
+	    ("staticArcs", po::value<bool>(&options.staticResidualArcs), "allocate all residual arcs once and search a timestep-sorted CSR view that skips the disabled ones? flow only. (default=false)")
+	    ("csr", po::value<bool>(&options.csrBackend), "run Bellman-Ford on a static, timestep-sorted CSR copy of the residual graph? same as staticArcs, flow only. (default=false)")
+	    ("dijkstra", po::value<bool>(&options.dijkstra), "search paths with Dijkstra on costs reduced by the previous distances, and only fall back to Bellman-Ford if needed? flow only. (default=false)")
+	    ("pathBatch", po::value<size_t>(&options.pathBatchSize), "augment up to this many disjoint paths of one shortest path tree per iteration. flow only. (default=1)")
+	    ("pathBatchRatio", po::value<double>(&options.pathBatchRatio), "with pathBatch, only take further paths that cost at least this fraction of the shortest path. flow only. (default=0.95)")
+	    ("compareSequential", po::value<bool>(&options.compareSequential), "additionally run strictly sequential tracking and report the energy difference to the batched run? flow only. (default=false)")
+	    ("arena", po::value<bool>(&options.arenaStorage), "store magnusson's nodes, arcs and scores in per-timestep arenas instead of single heap blocks? magnusson only. (default=false)")
+	    ("incremental", po::value<bool>(&options.incrementalUpdates), "after each path only update the scores of the nodes that could have changed, instead of sweeping the whole graph? magnusson only. (default=false)")
+	    ("recycleSwapArcs", po::value<bool>(&options.recycleSwapArcs), "release swap arcs as soon as the arc they cut lost a use, and reuse their memory? magnusson only. (default=false)")
+	    ("pathsPerSweep", po::value<size_t>(&options.pathsPerSweep), "augment up to this many paths that share no nodes after every sweep, which needs fewer sweeps but may find a worse solution. magnusson only. (default=1)")
+	    ("pathScoreRatio", po::value<double>(&options.pathScoreRatio), "with pathsPerSweep, only take further paths that score at least this fraction of the best path of the sweep. magnusson only. (default=0.8)")
+	    ("components", po::value<bool>(&options.components), "track every connected component of the model in its own flow graph, with the components distributed over the threads? flow only. (default=false)")
+	    ("timeBlocks", po::value<size_t>(&options.blockLength), "track every block of this many timesteps in its own flow graph, with the blocks distributed over the threads, and stitch their overlaps? flow only. (default=0=one graph)")
+	    ("blockOverlap", po::value<size_t>(&options.blockOverlap), "number of timesteps consecutive time blocks share, at most half of timeBlocks. (default=2)")
+	    ("solveBlock", po::value<int>(&options.solveBlock), "only read the hypotheses of this time block, track it and store its result in the output file, to be stitched with --blockResults. Not for batches.")
+	    ("blockResults", po::value<std::vector<std::string>>(&options.blockResultFilenames)->multitoken(), "stitch the results of all time blocks stored by --solveBlock instead of tracking the blocks, only reads the hypotheses of the overlaps, and those of blocks that must be tracked together when they are needed. Not for batches.")
+	    ("telemetry", po::value<std::string>(&telemetryFilename), "write the counters and timers of every solver iteration to this file, as JSON if it ends with .json and as CSV otherwise. Not for components, time blocks or batches.")
+	    ("memoryStats", po::value<std::string>(&memoryStatsFilename), "print the node and arc counts and the memory of all containers of the graphs after tracking, and write them to this file, as JSON if it ends with .json and as CSV otherwise. Not for components, time blocks or batches.")
+	    ("prune", po::value<bool>(&options.prune), "remove links that are never better than a disappearance and an appearance, and states that no object can reach, before building the graph? Keeps the optimal energy and prints what was removed. (default=false)")
+	    ("pruneReport", po::value<std::string>(&options.pruneReportFilename), "write the ids of all pruned hypotheses to this JSON file, implies prune. Not for batches.")
+	    ("dryRun", po::value<bool>(&dryRun), "only count the hypotheses of the model, or of all models of the batch, and print the memory tracking them is estimated to need? (default=false)")
+	    ("timeBudget", po::value<double>(&options.timeBudget), "stop tracking with the solution found so far once this many seconds are used up, checked after every iteration of each flow run. flow only, not for components or time blocks. (default=0=no limit)")
+	    ("energyGap", po::value<double>(&options.energyGap), "stop tracking once the next path would decrease the energy by less than this. flow only, not for components or time blocks. (default=0=until converged)")
+	    ("cycleRepair", po::value<bool>(&options.cycleRepair), "after a negative cycle, only invalidate the distances behind the cycle instead of restarting Bellman-Ford from scratch? Needs partial BF updates, flow only. (default=false)")
+	    ("splitNodes", po::value<bool>(&options.splitDetections), "represent every detection of the flow graph by an in- and an out-node joined by its arc? Otherwise the node carries its costs itself, which the shortest path search crosses without residual arcs. Same result, except that magnusson-flow can cancel other negative cycles. flow methods only. (default=true)")
+	    ("threads,t", po::value<size_t>(&options.numThreads), "number of threads relaxing each Bellman-Ford round, or updating the nodes of a timestep in magnusson, 0=all cores. (default=optimizerNumThreads of the model settings, or 1; 1 in batches)")
+	    ("batch", po::value<std::string>(&batchFilename), "track all jobs listed in this manifest file instead of a single model. Every line holds 'model weights output [method]', the method defaults to --method, lines starting with # are skipped")
+	    ("jobs,j", po::value<size_t>(&numJobThreads), "number of models of a batch that are tracked at the same time, 0=all cores. (default=0)")
+	    ("memoryBudget", po::value<size_t>(&memoryBudgetMB), "MB the models of a batch that are tracked at the same time may use together, as estimated from their numbers of hypotheses. (default=0=half of the physical memory)")
 	;
 
 	po::variables_map variableMap;
 	po::store(po::parse_command_line(argc, argv, description), variableMap);
 	po::notify(variableMap);
 
-	if (variableMap.count("help")) 
+	if (variableMap.count("help"))
 	{
 	    std::cout << description << std::endl;
 	    return 1;
 	}
 
-	if (!variableMap.count("model") || !variableMap.count("output") || !variableMap.count("weights")) 
+	if (variableMap.count("convert"))
+	{
+		if (!variableMap.count("model"))
+		{
+			std::cout << "A model filename has to be specified for conversion!" << std::endl;
+			return 1;
+		}
+		FlowGraph graph;
+		FlowGraphBuilder graphBuilder(&graph);
+		JsonGraphReader jsonReader(modelFilename, weightsFilename, &graphBuilder);
+		jsonReader.convertToBinary(binaryFilename);
+		return 0;
+	}
+
+	options.useModelNumThreads = !variableMap.count("threads");
+	if(variableMap.count("pruneReport"))
+		options.prune = true;
+
+	if (variableMap.count("batch"))
+	{
+		std::vector<TrackingJob> jobs = readManifest(batchFilename, method);
+		if(dryRun)
+			return estimateJobs(jobs) > 0 ? 1 : 0;
+		if(variableMap.count("telemetry"))
+			std::cout << "Telemetry is not collected when tracking batches" << std::endl;
+		if(!options.pruneReportFilename.empty())
+		{
+			std::cout << "Pruning reports are not written when tracking batches" << std::endl;
+			options.pruneReportFilename.clear();
+		}
+		if(options.solveBlock >= 0 || !options.blockResultFilenames.empty())
+		{
+			std::cout << "Single time blocks are not tracked or stitched in batches, all blocks are tracked instead" << std::endl;
+			options.solveBlock = -1;
+			options.blockResultFilenames.clear();
+		}
+
+		// the jobs run in parallel, so each one is tracked sequentially unless requested otherwise
+		if(options.useModelNumThreads)
+		{
+			options.useModelNumThreads = false;
+			options.numThreads = 1;
+		}
+		if(numJobThreads == 0)
+			numJobThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		size_t memoryBudget = memoryBudgetMB > 0 ? memoryBudgetMB * 1024 * 1024 : getDefaultMemoryBudget();
+		return trackBatch(options, jobs, numJobThreads, memoryBudget) > 0 ? 1 : 0;
+	}
+
+	if (dryRun)
+	{
+		if (!variableMap.count("model"))
+		{
+			std::cout << "A model filename has to be specified for a dry run!" << std::endl;
+			return 1;
+		}
+		TrackingJob job;
+		job.modelFilename = modelFilename;
+		job.method = method;
+		return estimateJobs({job}) > 0 ? 1 : 0;
+	}
+
+	if (!variableMap.count("model") || !variableMap.count("output") || !variableMap.count("weights"))
 	{
 	    std::cout << "Model, Weights and Output filenames have to be specified!" << std::endl;
 	    std::cout << description << std::endl;
-	} 
-	else 
-	{
-		if(method == "flow")
-		{
-		    FlowGraph graph;
-		    FlowGraphBuilder graphBuilder(&graph);
-		    JsonGraphReader jsonReader(modelFilename, weightsFilename, &graphBuilder);
-		    jsonReader.createGraphFromJson();
-		    std::cout << "Model has state zero energy: " << jsonReader.getInitialStateEnergy() << std::endl;
-		    graph.maxFlowMinCostTracking(jsonReader.getInitialStateEnergy(), swap, maxNumPaths, useOrderedNodeListInBF, partialBFUpdates);
-		    jsonReader.saveResultJson(outputFilename);
-		}
-		else if(method == "flow-flow")
-		{
-		    FlowGraph graph;
-		    FlowGraphBuilder graphBuilder(&graph);
-		    JsonGraphReader jsonReader(modelFilename, weightsFilename, &graphBuilder);
-		    jsonReader.createGraphFromJson();
-		    std::cout << "Model has state zero energy: " << jsonReader.getInitialStateEnergy() << std::endl;
-		    double energy = graph.maxFlowMinCostTracking(jsonReader.getInitialStateEnergy(), false, maxNumPaths, useOrderedNodeListInBF, partialBFUpdates);
-		    graph.maxFlowMinCostTracking(energy, true, maxNumPaths, useOrderedNodeListInBF, partialBFUpdates);
-		    jsonReader.saveResultJson(outputFilename);
-		}
-		else if(method == "magnusson")
-		{
-			Graph::Configuration config(true, true, true);
-    		Graph graph(config);
-		    MagnussonGraphBuilder graphBuilder(&graph);
-		    JsonGraphReader jsonReader(modelFilename, weightsFilename, &graphBuilder);
-		    jsonReader.createGraphFromJson();
-		    std::cout << "Model has state zero energy: " << jsonReader.getInitialStateEnergy() << std::endl;
-
-		    Magnusson tracker(&graph, swap, true, false);
-		    if(maxNumPaths > 0)
-		    	tracker.setMaxNumberOfPaths(maxNumPaths);
-		    
-		    std::vector<TrackingAlgorithm::Path> paths;
-		    double score = tracker.track(paths);
-		    std::cout << "\nTracking finished in " << tracker.getElapsedSeconds() << " secs with score " 
-		    		  << jsonReader.getInitialStateEnergy() - score << std::endl;
-		    graphBuilder.getSolutionFromPaths(paths);
-		    jsonReader.saveResultJson(outputFilename);
-		}
-		else if(method == "magnusson-flow")
-		{
-			double zeroEnergy, score;
-
-			// set up magnusson
-			Graph::Configuration config(true, true, true);
-    		Graph graph(config);
-		    MagnussonGraphBuilder graphBuilder(&graph);
-		    std::vector<TrackingAlgorithm::Path> paths;
-
-		    { // scope needed due to weird model scores that show up otherwise
-			    JsonGraphReader jsonReader(modelFilename, weightsFilename, &graphBuilder);
-			    jsonReader.createGraphFromJson();
-			    zeroEnergy = jsonReader.getInitialStateEnergy();
-			    std::cout << "Model has state zero energy: " << zeroEnergy << std::endl;
-
-			    // track magnusson
-			    Magnusson tracker(&graph, swap, true, false);
-			    if(maxNumPaths > 0)
-			    	tracker.setMaxNumberOfPaths(maxNumPaths);
-			    
-			    score = tracker.track(paths);
-			    std::cout << "\nTracking finished in " << tracker.getElapsedSeconds() << " secs with score " 
-			    		  << zeroEnergy - score << std::endl;
-
-			    std::cout << "Extracting solution" << std::endl;
-			}
+	}
+	else
+	{
+		SolverTelemetry telemetry(method);
+		SolverTelemetry* telemetryPointer = variableMap.count("telemetry") ? &telemetry : nullptr;
+
+		TrackingJob job;
+		job.modelFilename = modelFilename;
+		job.weightsFilename = weightsFilename;
+		job.outputFilename = outputFilename;
+		job.method = method;
+		MemoryStatistics memory;
+		MemoryStatistics* memoryPointer = variableMap.count("memoryStats") ? &memory : nullptr;
+		trackModel(options, job, telemetryPointer, memoryPointer);
+
+		if(telemetryPointer != nullptr)
+		{
+			if(method == "flow" && options.components)
+				std::cout << "Telemetry is not collected when tracking components" << std::endl;
+			else if(method == "flow" && options.blockLength > 0)
+				std::cout << "Telemetry is not collected when tracking time blocks" << std::endl;
+			else
+				telemetry.save(telemetryFilename);
+		}
 
-		    // set up flow
-		    FlowGraph flowGraph;
-		    FlowGraphBuilder flowGraphBuilder(&flowGraph);
-		    JsonGraphReader flowJsonReader(modelFilename, weightsFilename, &flowGraphBuilder);
-		    flowJsonReader.createGraphFromJson();
-		    std::cout << "Model has state zero energy: " << flowJsonReader.getInitialStateEnergy() << std::endl;
-
-		    // initialize flow with magnusson's result
-		    std::cout << "initializing flow solver" << std::endl;
-		    flowGraph.initializeResidualGraph(true, useOrderedNodeListInBF);
-
-		    std::vector<FlowGraph::Path> flowPaths = graphBuilder.translateSolution(paths, flowGraphBuilder);
-		    for(auto p : flowPaths)
-		    {
-		    	flowGraph.augmentUnitFlow(p);
-		    	flowGraph.updateEnabledArcs(p);
-		    }
-		    flowGraph.synchronizeDivisionDuplicateArcFlows();
-
-		    // track flow
-		    std::cout << "beginning tracking" << std::endl;
-			flowGraph.maxFlowMinCostTracking(zeroEnergy - score, true, maxNumPaths, useOrderedNodeListInBF, partialBFUpdates);
-		    flowJsonReader.saveResultJson(outputFilename);
+		if(memoryPointer != nullptr)
+		{
+			if(method == "flow" && options.components)
+				std::cout << "Memory statistics are not collected when tracking components" << std::endl;
+			else if(method == "flow" && options.blockLength > 0)
+				std::cout << "Memory statistics are not collected when tracking time blocks" << std::endl;
+			else
+			{
+				memory.updatePeakResidentBytes();
+				memory.writeSummary(std::cout);
+				memory.save(memoryStatsFilename);
+			}
 		}
-		else
-			throw std::runtime_error("Unknown tracking method selected");
 	}
 }
@@ -5,6 +5,7 @@
 #include <iostream>
 #include "userdata.h"
 #include "iarcnotifier.h"
+#include "arena.h"
 
 namespace dpct
 {
@@ -31,12 +32,14 @@ public:
     Arc(const Arc&) = delete;
 
 	// creating an arc automatically registers it at source and target node!
+	// If a score pool is given, the score deltas are stored there instead of in their own heap block.
 	Arc(Node* source,
 		Node* target,
 		Type type,
 		const std::vector<double>& scoreDeltas,
 		Node* dependsOnCellInNode = nullptr,
-        UserDataPtr data = UserDataPtr()
+        UserDataPtr data = UserDataPtr(),
+        ScorePool* scorePool = nullptr
 		);
 
     Arc(const Arc& a,
@@ -76,6 +79,9 @@ public:
 
     Node* getObservedNode() const { return dependsOnCellInNode_; }
 
+    // bytes of the arc and its score table, without user data
+    size_t memoryBytes() const { return sizeof(Arc) + scoreDeltas_.capacity() * sizeof(double); }
+
     std::string typeAsString() const;
 
     friend class Node;
@@ -88,7 +94,7 @@ protected:
 	Node* sourceNode_;
 	Node* targetNode_;
 	Type type_;
-	std::vector<double> scoreDeltas_;
+	ScoreDeltaVector scoreDeltas_;
 	double currentScore_;
 	bool enabled_;
 	size_t used_;
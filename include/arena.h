@@ -0,0 +1,300 @@
+#ifndef DPCT_ARENA_H
+#define DPCT_ARENA_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Chunked storage for objects that must never move once created.
+ *
+ * Objects are placement-constructed into chunks that grow geometrically,
+ * so all objects created in a row are contiguous in memory and no single object
+ * is ever relocated. All objects are destroyed together with the arena, in creation order.
+ */
+template<typename T>
+class Arena
+{
+public:
+	Arena(size_t initialChunkSize = 64):
+		size_(0),
+		nextChunkSize_(std::max<size_t>(initialChunkSize, 1)),
+		chunkFill_(0)
+	{}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	~Arena()
+	{
+		clear();
+	}
+
+	/// construct a new object at the end of the arena, the returned pointer stays valid until destruction
+	template<typename... Args>
+	T* emplace(Args&&... args)
+	{
+		if(chunks_.empty() || chunkFill_ == chunks_.back().second)
+			addChunk(nextChunkSize_);
+
+		T* object = reinterpret_cast<T*>(chunks_.back().first.get() + chunkFill_);
+		new(object) T(std::forward<Args>(args)...);
+		chunkFill_++;
+		size_++;
+		return object;
+	}
+
+	/// make sure that the next n objects end up in the same chunk
+	void reserve(size_t n)
+	{
+		size_t remaining = chunks_.empty() ? 0 : chunks_.back().second - chunkFill_;
+		if(remaining < n)
+			addChunk(n);
+	}
+
+	/// destroy all objects and release the memory
+	void clear()
+	{
+		for(size_t c = 0; c < chunks_.size(); ++c)
+		{
+			size_t numObjects = (c + 1 == chunks_.size()) ? chunkFill_ : chunks_[c].second;
+			T* objects = reinterpret_cast<T*>(chunks_[c].first.get());
+			for(size_t i = 0; i < numObjects; ++i)
+				objects[i].~T();
+		}
+		chunks_.clear();
+		chunkFill_ = 0;
+		size_ = 0;
+	}
+
+	size_t size() const { return size_; }
+	size_t getNumChunks() const { return chunks_.size(); }
+
+private:
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+	typedef std::pair<std::unique_ptr<Slot[]>, size_t> Chunk;
+
+	void addChunk(size_t capacity)
+	{
+		// a chunk that is left behind early only contains its constructed objects
+		if(!chunks_.empty())
+			chunks_.back().second = chunkFill_;
+		chunks_.push_back(Chunk(std::unique_ptr<Slot[]>(new Slot[capacity]), capacity));
+		chunkFill_ = 0;
+		nextChunkSize_ = std::max(nextChunkSize_, capacity) * 2;
+	}
+
+	std::vector<Chunk> chunks_;
+	size_t size_;
+	size_t nextChunkSize_;
+	size_t chunkFill_;
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Arena whose objects can be released one by one, their slots are reused by later objects.
+ */
+template<typename T>
+class RecyclingArena
+{
+public:
+	RecyclingArena(size_t initialChunkSize = 64):
+		slots_(initialChunkSize),
+		numAlive_(0)
+	{}
+
+	RecyclingArena(const RecyclingArena&) = delete;
+	RecyclingArena& operator=(const RecyclingArena&) = delete;
+
+	~RecyclingArena()
+	{
+		clear();
+	}
+
+	/// construct a new object, preferably in the slot of a released one
+	template<typename... Args>
+	T* emplace(Args&&... args)
+	{
+		Slot* slot;
+		if(freeSlots_.empty())
+		{
+			slot = slots_.emplace();
+			allSlots_.push_back(slot);
+		}
+		else
+		{
+			slot = freeSlots_.back();
+			freeSlots_.pop_back();
+		}
+
+		T* object = new(&slot->storage) T(std::forward<Args>(args)...);
+		slot->alive = true;
+		numAlive_++;
+		return object;
+	}
+
+	/// destroy an object created by this arena and make its slot available again
+	void release(T* object)
+	{
+		Slot* slot = reinterpret_cast<Slot*>(object);
+		object->~T();
+		slot->alive = false;
+		freeSlots_.push_back(slot);
+		numAlive_--;
+	}
+
+	/// destroy all objects that were not released yet
+	void clear()
+	{
+		for(Slot* slot : allSlots_)
+		{
+			if(slot->alive)
+				reinterpret_cast<T*>(&slot->storage)->~T();
+		}
+		allSlots_.clear();
+		freeSlots_.clear();
+		slots_.clear();
+		numAlive_ = 0;
+	}
+
+	size_t size() const { return numAlive_; }
+	size_t getNumSlots() const { return allSlots_.size(); }
+
+private:
+	// the storage comes first, such that an object pointer is also a pointer to its slot
+	struct Slot
+	{
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+		bool alive = false;
+	};
+
+	Arena<Slot> slots_;
+	std::vector<Slot*> allSlots_;
+	std::vector<Slot*> freeSlots_;
+	size_t numAlive_;
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Bump allocator for arrays of trivially destructible values.
+ *
+ * Arrays are handed out back to back from large chunks and are only released
+ * when the pool is destroyed.
+ */
+template<typename T>
+class ArrayPool
+{
+	static_assert(std::is_trivially_destructible<T>::value, "ArrayPool can only hold trivially destructible values");
+public:
+	ArrayPool(size_t chunkSize = 4096):
+		chunkSize_(std::max<size_t>(chunkSize, 1)),
+		chunkFill_(0),
+		chunkCapacity_(0),
+		size_(0)
+	{}
+
+	ArrayPool(const ArrayPool&) = delete;
+	ArrayPool& operator=(const ArrayPool&) = delete;
+
+	/// get uninitialized memory for n consecutive values
+	T* allocate(size_t n)
+	{
+		if(chunkCapacity_ - chunkFill_ < n)
+			addChunk(std::max(chunkSize_, n));
+		T* values = chunks_.back().get() + chunkFill_;
+		chunkFill_ += n;
+		size_ += n;
+		return values;
+	}
+
+	/// make sure the next n values are served from the same chunk
+	void reserve(size_t n)
+	{
+		if(chunkCapacity_ - chunkFill_ < n)
+			addChunk(n);
+	}
+
+	/// number of values handed out so far
+	size_t size() const { return size_; }
+
+private:
+	void addChunk(size_t capacity)
+	{
+		chunks_.push_back(std::unique_ptr<T[]>(new T[capacity]));
+		chunkFill_ = 0;
+		chunkCapacity_ = capacity;
+	}
+
+	std::vector<std::unique_ptr<T[]>> chunks_;
+	size_t chunkSize_;
+	size_t chunkFill_;
+	size_t chunkCapacity_;
+	size_t size_;
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief STL allocator serving from an ArrayPool if one is given, and from the heap otherwise.
+ * Deallocation of pooled memory is a no-op, it is released together with the pool.
+ */
+template<typename T>
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+
+	PoolAllocator(ArrayPool<T>* pool = nullptr):
+		pool_(pool)
+	{}
+
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other):
+		pool_(nullptr)
+	{}
+
+	T* allocate(size_t n)
+	{
+		if(pool_ != nullptr)
+			return pool_->allocate(n);
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		if(pool_ == nullptr)
+			std::allocator<T>().deallocate(p, n);
+	}
+
+	ArrayPool<T>* getPool() const { return pool_; }
+
+private:
+	ArrayPool<T>* pool_;
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+	return (void*)lhs.getPool() == (void*)rhs.getPool();
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+	return !(lhs == rhs);
+}
+
+/// score delta tables of nodes and arcs, optionally living in a graph-wide pool
+typedef ArrayPool<double> ScorePool;
+typedef std::vector<double, PoolAllocator<double>> ScoreDeltaVector;
+
+} // namespace dpct
+
+#endif // DPCT_ARENA_H
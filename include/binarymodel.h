@@ -0,0 +1,128 @@
+#ifndef BINARY_MODEL
+#define BINARY_MODEL
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Layout of the binary tracking model, which stores the same information as the JSON model.
+ *
+ * The file starts with the header, followed by the array of all detections, the array of all links,
+ * and a pool of doubles holding all features. The features of a hypothesis are stored at their offset
+ * in the pool as: number of states, then for each state the number of features followed by the features.
+ * All values use the byte order of the machine that converted the model.
+ */
+struct BinaryModelHeader
+{
+	static const uint32_t CurrentVersion = 1;
+	static const char* magic() { return "DPCTMDL"; }
+
+	/// type indices of the feature shapes
+	enum FeatureType {LinkFeatures = 0, DetectionFeatures, DivisionFeatures, AppearanceFeatures, DisappearanceFeatures, NumFeatureTypes};
+
+	char magicBytes[8];
+	uint32_t version;
+	uint32_t statesShareWeights;
+	uint64_t numThreads;
+	uint64_t numSegmentations;
+	uint64_t numLinks;
+	uint64_t numDivisions;
+	/// number of features of the first state and of all states, which determine the weight layout
+	uint64_t featureShapes[NumFeatureTypes][2];
+	uint64_t numFeatureValues;
+
+	bool hasValidMagic() const { return std::memcmp(magicBytes, magic(), sizeof(magicBytes)) == 0; }
+
+	/// total file size implied by the header
+	uint64_t getFileSize() const;
+};
+
+struct BinaryModelNode
+{
+	enum Flags {HasTimestep = 1, HasDivision = 2, HasAppearance = 4, HasDisappearance = 8};
+	static const uint64_t NoFeatures = UINT64_MAX;
+
+	uint64_t id;
+	int32_t timesteps[2];
+	uint32_t targetIdx;
+	uint32_t flags;
+	/// offsets of the detection, division, appearance and disappearance features in the feature pool
+	uint64_t features[4];
+};
+
+struct BinaryModelLink
+{
+	uint64_t srcId;
+	uint64_t destId;
+	uint64_t features;
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Layout of the binary tracking result, a columnar alternative to the JSON result for downstream tools.
+ *
+ * The header is followed by uint64 columns, each sorted like the JSON result: the ids and the values of all
+ * used detections, the source ids, target ids and values of all used links, and the ids of all dividing detections.
+ * All values use the byte order of the machine that wrote the result.
+ */
+struct BinaryResultHeader
+{
+	static const uint32_t CurrentVersion = 1;
+	static const char* magic() { return "DPCTRES"; }
+
+	char magicBytes[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t numDetections;
+	uint64_t numLinks;
+	uint64_t numDivisions;
+
+	bool hasValidMagic() const { return std::memcmp(magicBytes, magic(), sizeof(magicBytes)) == 0; }
+};
+
+inline uint64_t BinaryModelHeader::getFileSize() const
+{
+	return sizeof(BinaryModelHeader)
+		+ numSegmentations * sizeof(BinaryModelNode)
+		+ numLinks * sizeof(BinaryModelLink)
+		+ numFeatureValues * sizeof(double);
+}
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief A file mapped into memory, read-only for existing files or writable for newly created ones.
+ */
+class MappedFile
+{
+public:
+	/// map an existing file read-only, the pages are shared with all other processes mapping it
+	MappedFile(const std::string& filename);
+
+	/// create (or truncate) a file of the given size and map it writable
+	MappedFile(const std::string& filename, size_t size);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile();
+
+	const char* getData() const { return data_; }
+	char* getData() { return data_; }
+	size_t getSize() const { return size_; }
+
+private:
+	void map(const std::string& filename, bool writable);
+
+	int fileDescriptor_;
+	char* data_;
+	size_t size_;
+};
+
+} // end namespace dpct
+
+#endif // BINARY_MODEL
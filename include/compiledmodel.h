@@ -0,0 +1,93 @@
+#ifndef COMPILED_MODEL
+#define COMPILED_MODEL
+
+#include <vector>
+
+#include "flowgraphbuilder.h"
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief A flow graph builder that keeps the features behind all costs, such that the built graph
+ * can be tracked again for other weights without reading the model and building the graph again,
+ * e.g. when sweeping over weights in structured learning or grid searches.
+ *
+ * Build the graph once with any graph reader, then call setWeights before each tracking run.
+ * All state costs are stored as feature times weight index in flat arrays, and are recomputed in one pass.
+ * The weights must have the same layout as the ones the graph was read with.
+ */
+class CompiledModel : public FlowGraphBuilder {
+public:
+	CompiledModel(FlowGraph* graph);
+
+	bool keepsCostTerms() const { return true; }
+
+	void addCostTerms(const std::vector<CostTerm>& termPerState, size_t numWeights);
+
+	void addNode(
+		size_t id,
+		const CostDeltaVector& detectionCosts,
+		const CostDeltaVector& detectionCostDeltas,
+		const CostDeltaVector& appearanceCostDeltas,
+		const CostDeltaVector& disappearanceCostDeltas,
+		size_t targetIdx=0);
+
+	void addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas);
+
+	void allowMitosis(size_t id, ValueType divisionCostDelta);
+
+	/// the number of weights the model was built with
+	size_t getNumWeights() const { return numWeights_; }
+
+	/**
+	 * @brief recompute the costs of all arcs for the given weights and remove all flow,
+	 *        such that the next maxFlowMinCostTracking solves the model for these weights from scratch
+	 */
+	void setWeights(const std::vector<ValueType>& weights);
+
+	/// @return the energy of the state without any flow for the weights of the last setWeights call
+	double getInitialStateEnergy() const { return initialStateEnergy_; }
+
+private:
+	/// an arc, or with an INVALID arc an unsplit detection node, whose costs are given by the cost vector with the given index
+	struct CostTarget
+	{
+		FlowGraph::Arc arc;
+		FlowGraph::Node node;
+		size_t costVector;
+	};
+
+	/// let the arc (or node, if the arc is INVALID) take its costs from the given cost vector, 
+	/// which must match the number of cost deltas of the arc
+	void addCostTarget(const FlowGraph::Arc& arc, size_t costVector, size_t numCostDeltas, 
+		const FlowGraph::Node& node=lemon::INVALID);
+
+	/// take the cost vectors that arrived since the last hypothesis was added
+	/// @return the index of the first one
+	size_t assignCostVectors(size_t minNumVectors, size_t maxNumVectors);
+
+private:
+	size_t numWeights_;
+	double initialStateEnergy_;
+
+	/// cost terms of all states of all cost vectors. The weight index numWeights_ stands for a zero weight
+	std::vector<ValueType> features_;
+	std::vector<size_t> weightIndices_;
+
+	/// where the states of each cost vector start in the term arrays, with one extra entry at the end
+	std::vector<size_t> costVectorOffsets_;
+	size_t numAssignedCostVectors_;
+
+	std::vector<CostTarget> costTargets_;
+
+	/// buffers reused by setWeights
+	std::vector<ValueType> weights_;
+	std::vector<ValueType> costs_;
+	FlowGraph::CostVector costDeltas_;
+};
+
+} // end namespace dpct
+
+#endif // COMPILED_MODEL
@@ -0,0 +1,290 @@
+#ifndef COMPONENT_FLOW_GRAPH_BUILDER
+#define COMPONENT_FLOW_GRAPH_BUILDER
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+#include "graphbuilder.h"
+#include "flowgraph.h"
+#include "flowgraphbuilder.h"
+#include "log.h"
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Graph builder that splits the model into its connected components, ignoring source and sink,
+ * and tracks each of them in its own flow graph, in parallel.
+ *
+ * All hypotheses are buffered until solve() is called. Components with fewer than minNodesPerGraph detections
+ * share flow graphs, so that many tiny components do not each pay the setup costs of a flow graph.
+ * The value maps contain the merged results of all components.
+ */
+class ComponentFlowGraphBuilder : public GraphBuilder {
+public:
+	/// tracks one flow graph and returns its energy, without the initial state energy
+	typedef std::function<double(FlowGraph&)> SolverFunction;
+
+	/// @param splitDetections whether the detections of the component flow graphs are split into two nodes, see FlowGraph
+	ComponentFlowGraphBuilder(size_t minNodesPerGraph = 256, bool splitDetections = true):
+		minNodesPerGraph_(std::max(minNodesPerGraph, size_t(1))),
+		splitDetections_(splitDetections)
+	{}
+
+	void reserve(size_t numDetections, size_t numLinks, size_t numDivisions)
+	{
+		GraphBuilder::reserve(numDetections, numLinks, numDivisions);
+		nodes_.reserve(numDetections);
+		links_.reserve(numLinks);
+		divisions_.reserve(numDivisions);
+	}
+
+	void addNode(
+		size_t id,
+		const CostDeltaVector& detectionCosts,
+		const CostDeltaVector& detectionCostDeltas,
+		const CostDeltaVector& appearanceCostDeltas,
+		const CostDeltaVector& disappearanceCostDeltas,
+		size_t targetIdx=0)
+	{
+		idToNodeIndexMap_[id] = nodes_.size();
+		nodes_.push_back(NodeHypothesis{id, detectionCosts, detectionCostDeltas, appearanceCostDeltas,
+							disappearanceCostDeltas, targetIdx, idToTimestepsMap_[id]});
+	}
+
+	void addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas)
+	{
+		if(idToNodeIndexMap_.find(srcId) == idToNodeIndexMap_.end())
+			throw std::runtime_error("Trying to add link but source node is not present in map");
+		if(idToNodeIndexMap_.find(destId) == idToNodeIndexMap_.end())
+			throw std::runtime_error("Trying to add link but destination node is not present in map");
+		links_.push_back(LinkHypothesis{srcId, destId, costDeltas});
+	}
+
+	void allowMitosis(size_t id, ValueType divisionCostDelta)
+	{
+		divisions_.push_back(std::make_pair(id, divisionCostDelta));
+	}
+
+	/**
+	 * @brief split the buffered model into components, build their flow graphs,
+	 *        and run the solver on all of them, on numThreads threads (0 = all cores)
+	 * @return the sum of the energies of all components
+	 */
+	double solve(SolverFunction solver, size_t numThreads = 0)
+	{
+		buildComponentGraphs();
+		if(numThreads == 0)
+			numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		numThreads = std::min(numThreads, components_.size());
+
+		// the components are sorted by decreasing size, every thread picks the next one when it is done
+		std::vector<double> energies(components_.size(), 0.0);
+		std::atomic<size_t> nextComponent(0);
+		auto worker = [&](){
+			for(size_t c = nextComponent++; c < components_.size(); c = nextComponent++)
+				energies[c] = solver(components_[c]->graph);
+		};
+
+		if(numThreads <= 1)
+			worker();
+		else
+		{
+			std::vector<std::thread> threads;
+			for(size_t i = 0; i < numThreads; ++i)
+				threads.push_back(std::thread(worker));
+			for(std::thread& t : threads)
+				t.join();
+		}
+
+		return std::accumulate(energies.begin(), energies.end(), 0.0);
+	}
+
+	/// number of flow graphs the model was split into by the last call to solve()
+	size_t getNumComponentGraphs() const { return components_.size(); }
+
+	NodeValueMap getNodeValues()
+	{
+		NodeValueMap nodeValueMap;
+		for(auto& component : components_)
+		{
+			NodeValueMap values = component->builder.getNodeValues();
+			nodeValueMap.insert(values.begin(), values.end());
+		}
+		return nodeValueMap;
+	}
+
+	ArcValueMap getArcValues()
+	{
+		ArcValueMap arcValueMap;
+		for(auto& component : components_)
+		{
+			ArcValueMap values = component->builder.getArcValues();
+			arcValueMap.insert(values.begin(), values.end());
+		}
+		return arcValueMap;
+	}
+
+	DivisionValueMap getDivisionValues()
+	{
+		DivisionValueMap divisionValueMap;
+		for(auto& component : components_)
+		{
+			DivisionValueMap values = component->builder.getDivisionValues();
+			divisionValueMap.insert(values.begin(), values.end());
+		}
+		return divisionValueMap;
+	}
+
+	/// the components' used hypotheses are merged and sorted, the full value maps are never built
+	void visitNodeValues(const NodeValueVisitor& visitor)
+	{
+		std::vector<std::pair<size_t, size_t> > values;
+		for(auto& component : components_)
+			component->builder.visitNodeValues([&](size_t id, size_t value){ values.push_back(std::make_pair(id, value)); });
+		std::sort(values.begin(), values.end());
+		for(const auto& v : values)
+			visitor(v.first, v.second);
+	}
+
+	void visitArcValues(const ArcValueVisitor& visitor)
+	{
+		std::vector<std::pair<std::pair<size_t, size_t>, size_t> > values;
+		for(auto& component : components_)
+			component->builder.visitArcValues([&](size_t srcId, size_t destId, size_t value){
+				values.push_back(std::make_pair(std::make_pair(srcId, destId), value));
+			});
+		std::sort(values.begin(), values.end());
+		for(const auto& v : values)
+			visitor(v.first.first, v.first.second, v.second);
+	}
+
+	void visitDivisions(const DivisionVisitor& visitor)
+	{
+		std::vector<size_t> ids;
+		for(auto& component : components_)
+			component->builder.visitDivisions([&](size_t id){ ids.push_back(id); });
+		std::sort(ids.begin(), ids.end());
+		for(size_t id : ids)
+			visitor(id);
+	}
+
+private:
+	struct NodeHypothesis
+	{
+		size_t id;
+		CostDeltaVector detectionCosts;
+		CostDeltaVector detectionCostDeltas;
+		CostDeltaVector appearanceCostDeltas;
+		CostDeltaVector disappearanceCostDeltas;
+		size_t targetIdx;
+		std::pair<size_t, size_t> timesteps;
+	};
+
+	struct LinkHypothesis
+	{
+		size_t srcId;
+		size_t destId;
+		CostDeltaVector costDeltas;
+	};
+
+	/// a flow graph with the builder that maps the hypothesis ids of its components to it
+	struct ComponentGraph
+	{
+		FlowGraph graph;
+		FlowGraphBuilder builder;
+		ComponentGraph(bool splitDetections): graph(splitDetections), builder(&graph) {}
+	};
+
+	size_t findRoot(std::vector<size_t>& parents, size_t n)
+	{
+		while(parents[n] != n)
+		{
+			parents[n] = parents[parents[n]];
+			n = parents[n];
+		}
+		return n;
+	}
+
+	/// union-find over the links, then distribute the hypotheses to the component graphs in their original order
+	void buildComponentGraphs()
+	{
+		std::vector<size_t> parents(nodes_.size());
+		std::iota(parents.begin(), parents.end(), 0);
+		for(const LinkHypothesis& link : links_)
+		{
+			size_t a = findRoot(parents, idToNodeIndexMap_[link.srcId]);
+			size_t b = findRoot(parents, idToNodeIndexMap_[link.destId]);
+			if(a != b)
+				parents[std::max(a, b)] = std::min(a, b);
+		}
+
+		std::map<size_t, size_t> rootSizes;
+		for(size_t n = 0; n < nodes_.size(); ++n)
+			rootSizes[findRoot(parents, n)]++;
+
+		// largest components first, the small ones are packed together
+		std::vector<std::pair<size_t, size_t>> sizedRoots;
+		for(auto& rootSize : rootSizes)
+			sizedRoots.push_back(std::make_pair(rootSize.second, rootSize.first));
+		std::stable_sort(sizedRoots.begin(), sizedRoots.end(),
+			[](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b){ return a.first > b.first; });
+
+		components_.clear();
+		std::map<size_t, size_t> rootToGraphMap;
+		size_t currentGraphSize = minNodesPerGraph_;
+		for(auto& sizedRoot : sizedRoots)
+		{
+			if(currentGraphSize >= minNodesPerGraph_)
+			{
+				components_.push_back(std::unique_ptr<ComponentGraph>(new ComponentGraph(splitDetections_)));
+				currentGraphSize = 0;
+			}
+			rootToGraphMap[sizedRoot.second] = components_.size() - 1;
+			currentGraphSize += sizedRoot.first;
+		}
+		DEBUG_MSG("Split model with " << nodes_.size() << " detections into " << rootSizes.size()
+			<< " components, tracked in " << components_.size() << " flow graphs");
+
+		auto graphOf = [&](size_t id) -> ComponentGraph& {
+			return *components_[rootToGraphMap[findRoot(parents, idToNodeIndexMap_[id])]];
+		};
+
+		for(const NodeHypothesis& node : nodes_)
+		{
+			ComponentGraph& component = graphOf(node.id);
+			component.builder.setNodeTimesteps(node.id, node.timesteps);
+			component.builder.addNode(node.id, node.detectionCosts, node.detectionCostDeltas,
+				node.appearanceCostDeltas, node.disappearanceCostDeltas, node.targetIdx);
+		}
+		for(const LinkHypothesis& link : links_)
+			graphOf(link.srcId).builder.addArc(link.srcId, link.destId, link.costDeltas);
+		for(const std::pair<size_t, ValueType>& division : divisions_)
+			graphOf(division.first).builder.allowMitosis(division.first, division.second);
+	}
+
+private:
+	size_t minNodesPerGraph_;
+	bool splitDetections_;
+
+	/// buffered hypotheses
+	std::vector<NodeHypothesis> nodes_;
+	std::vector<LinkHypothesis> links_;
+	std::vector<std::pair<size_t, ValueType>> divisions_;
+	std::unordered_map<size_t, size_t> idToNodeIndexMap_;
+
+	/// the flow graphs of the components, the largest first
+	std::vector<std::unique_ptr<ComponentGraph>> components_;
+};
+
+} // end namespace dpct
+
+#endif // COMPONENT_FLOW_GRAPH_BUILDER
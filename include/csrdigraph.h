@@ -0,0 +1,356 @@
+#ifndef DPCT_CSRDIGRAPH_H
+#define DPCT_CSRDIGRAPH_H
+
+#include <lemon/core.h>
+#include <vector>
+#include <initializer_list>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <assert.h>
+
+namespace dpct
+{
+
+/**
+ * A static digraph in compressed sparse row format. Nodes are sorted by an order key (e.g. the timestep),
+ * the out arcs of each node are stored contiguously, and all per node and per arc data lives in plain
+ * vectors indexed by id. It provides the part of LEMON's digraph concept that the EarlyStoppingBellmanFord uses,
+ * so that a weak round on a time-layered tracking graph becomes a mostly sequential sweep over memory.
+ * The topology cannot be changed after construction, but arcs can be disabled in O(1): the out and in
+ * arcs of each node are stored in slots with the enabled ones first, and OutArcIt and InArcIt only
+ * visit those, so a search never touches an arc that cannot carry flow.
+ */
+class CsrDigraph {
+public: // typedefs
+	class Node {
+		friend class CsrDigraph;
+	protected:
+		int id_;
+	public:
+		Node(): id_(-1) {}
+		Node(lemon::Invalid): id_(-1) {}
+		explicit Node(int id): id_(id) {}
+		bool operator==(const Node& n) const { return id_ == n.id_; }
+		bool operator!=(const Node& n) const { return id_ != n.id_; }
+		bool operator<(const Node& n) const { return id_ < n.id_; }
+	};
+
+	class Arc {
+		friend class CsrDigraph;
+	protected:
+		int id_;
+	public:
+		Arc(): id_(-1) {}
+		Arc(lemon::Invalid): id_(-1) {}
+		explicit Arc(int id): id_(id) {}
+		bool operator==(const Arc& a) const { return id_ == a.id_; }
+		bool operator!=(const Arc& a) const { return id_ != a.id_; }
+		bool operator<(const Arc& a) const { return id_ < a.id_; }
+	};
+
+	class NodeIt : public Node {
+	public:
+		NodeIt(): graph_(nullptr) {}
+		NodeIt(lemon::Invalid i): Node(i), graph_(nullptr) {}
+		explicit NodeIt(const CsrDigraph& g): Node(g.nodeNum() > 0 ? 0 : -1), graph_(&g) {}
+		NodeIt(const CsrDigraph& g, const Node& n): Node(n), graph_(&g) {}
+		NodeIt& operator++() { id_ = (id_ + 1 < graph_->nodeNum()) ? id_ + 1 : -1; return *this; }
+	private:
+		const CsrDigraph* graph_;
+	};
+
+	class ArcIt : public Arc {
+	public:
+		ArcIt(): graph_(nullptr) {}
+		ArcIt(lemon::Invalid i): Arc(i), graph_(nullptr) {}
+		explicit ArcIt(const CsrDigraph& g): Arc(g.arcNum() > 0 ? 0 : -1), graph_(&g) {}
+		ArcIt(const CsrDigraph& g, const Arc& a): Arc(a), graph_(&g) {}
+		ArcIt& operator++() { id_ = (id_ + 1 < graph_->arcNum()) ? id_ + 1 : -1; return *this; }
+	private:
+		const CsrDigraph* graph_;
+	};
+
+	/// enabled out arcs of a node are listed in outArcs_[firstOut_[n]], ..., outArcs_[enabledOutEnd_[n]-1]
+	class OutArcIt : public Arc {
+	public:
+		OutArcIt(): graph_(nullptr), pos_(-1), end_(-1) {}
+		OutArcIt(lemon::Invalid i): Arc(i), graph_(nullptr), pos_(-1), end_(-1) {}
+		OutArcIt(const CsrDigraph& g, const Node& n):
+			graph_(&g), pos_(g.firstOut_[n.id_]), end_(g.enabledOutEnd_[n.id_])
+		{
+			id_ = (pos_ < end_) ? g.outArcs_[pos_] : -1;
+		}
+		OutArcIt(const CsrDigraph& g, const Arc& a):
+			Arc(a), graph_(&g), pos_(g.outSlots_[a.id_]), end_(g.enabledOutEnd_[g.sources_[a.id_]]) {}
+		OutArcIt& operator++() { id_ = (++pos_ < end_) ? graph_->outArcs_[pos_] : -1; return *this; }
+	private:
+		const CsrDigraph* graph_;
+		int pos_;
+		int end_;
+	};
+
+	/// enabled in arcs of a node are listed in inArcs_[firstIn_[n]], ..., inArcs_[enabledInEnd_[n]-1]
+	class InArcIt : public Arc {
+	public:
+		InArcIt(): graph_(nullptr), pos_(-1), end_(-1) {}
+		InArcIt(lemon::Invalid i): Arc(i), graph_(nullptr), pos_(-1), end_(-1) {}
+		InArcIt(const CsrDigraph& g, const Node& n):
+			graph_(&g), pos_(g.firstIn_[n.id_]), end_(g.enabledInEnd_[n.id_])
+		{
+			id_ = (pos_ < end_) ? g.inArcs_[pos_] : -1;
+		}
+		InArcIt& operator++() { id_ = (++pos_ < end_) ? graph_->inArcs_[pos_] : -1; return *this; }
+	private:
+		const CsrDigraph* graph_;
+		int pos_;
+		int end_;
+	};
+
+	/// dense map storing one value per item in a contiguous vector
+	template<typename K, typename V>
+	class VectorMap {
+	public:
+		typedef K Key;
+		typedef V Value;
+		typedef typename std::vector<V>::reference Reference;
+		typedef typename std::vector<V>::const_reference ConstReference;
+
+		VectorMap(size_t size, const V& value): values_(size, value) {}
+		Reference operator[](const K& k) { return values_[CsrDigraph::id(k)]; }
+		ConstReference operator[](const K& k) const { return values_[CsrDigraph::id(k)]; }
+		void set(const K& k, const V& v) { values_[CsrDigraph::id(k)] = v; }
+
+		/// raw access to the underlying array
+		std::vector<V>& data() { return values_; }
+		const std::vector<V>& data() const { return values_; }
+	private:
+		std::vector<V> values_;
+	};
+
+	template<typename V>
+	class NodeMap : public VectorMap<Node, V> {
+	public:
+		explicit NodeMap(const CsrDigraph& g, const V& value = V()): VectorMap<Node, V>(g.nodeNum(), value) {}
+	};
+
+	template<typename V>
+	class ArcMap : public VectorMap<Arc, V> {
+	public:
+		explicit ArcMap(const CsrDigraph& g, const V& value = V()): VectorMap<Arc, V>(g.arcNum(), value) {}
+	};
+
+	/**
+	 * @brief Groups the nodes by their order key, with the same interface as the lemon::IterableValueMap
+	 * that EarlyStoppingBellmanFord::addSource() and update() use to traverse the nodes in topological order.
+	 * As the nodes are sorted by key already, each group is a consecutive id range.
+	 */
+	class NodeOrderMap {
+	public:
+		typedef Node Key;
+		typedef size_t Value;
+		typedef std::vector<size_t>::const_iterator ValueIt;
+
+		explicit NodeOrderMap(const CsrDigraph& g): graph_(&g) {}
+		ValueIt beginValue() const { return graph_->layerKeys_.begin(); }
+		ValueIt endValue() const { return graph_->layerKeys_.end(); }
+		size_t operator[](const Node& n) const { return graph_->nodeKeys_[n.id_]; }
+
+		class ItemIt : public Node {
+		public:
+			ItemIt(lemon::Invalid i): Node(i), end_(-1) {}
+			ItemIt(const NodeOrderMap& map, size_t key): end_(-1)
+			{
+				const CsrDigraph& g = *map.graph_;
+				ValueIt layer = std::lower_bound(g.layerKeys_.begin(), g.layerKeys_.end(), key);
+				if(layer == g.layerKeys_.end() || *layer != key)
+					return;
+				size_t l = layer - g.layerKeys_.begin();
+				id_ = g.layerBegin_[l];
+				end_ = g.layerBegin_[l + 1];
+			}
+			ItemIt& operator++() { if(++id_ == end_) id_ = -1; return *this; }
+		private:
+			int end_;
+		};
+	private:
+		const CsrDigraph* graph_;
+	};
+
+	typedef lemon::True NodeNumTag;
+	typedef lemon::True ArcNumTag;
+
+public: // API
+	/**
+	 * @brief Build the CSR representation of a LEMON digraph
+	 * @param g the digraph to copy, can be any type providing NodeIt, ArcIt and id()
+	 * @param nodeKeys readable node map of the order key, nodes with lower keys get lower ids (stable)
+	 */
+	template<typename GR, typename KeyMap>
+	CsrDigraph(const GR& g, const KeyMap& nodeKeys);
+
+	int nodeNum() const { return (int)nodeKeys_.size(); }
+	int arcNum() const { return (int)targets_.size(); }
+	int maxNodeId() const { return nodeNum() - 1; }
+	int maxArcId() const { return arcNum() - 1; }
+	int maxId(Node) const { return maxNodeId(); }
+	int maxId(Arc) const { return maxArcId(); }
+
+	static int id(const Node& n) { return n.id_; }
+	static int id(const Arc& a) { return a.id_; }
+	static Node nodeFromId(int id) { return Node(id); }
+	static Arc arcFromId(int id) { return Arc(id); }
+
+	Node source(const Arc& a) const { return Node(sources_[a.id_]); }
+	Node target(const Arc& a) const { return Node(targets_[a.id_]); }
+
+	/// the id of the node/arc in the digraph this CSR was built from
+	int inputNodeId(const Node& n) const { return inputNodeIds_[n.id_]; }
+	int inputArcId(const Arc& a) const { return inputArcIds_[a.id_]; }
+
+	/// the CSR node/arc corresponding to an id in the digraph this CSR was built from
+	Node nodeFromInputId(int inputId) const { return Node(nodeFromInput_[inputId]); }
+	Arc arcFromInputId(int inputId) const { return Arc(arcFromInput_[inputId]); }
+
+	/// bytes of all arrays of this graph
+	size_t memoryBytes() const
+	{
+		size_t bytes = (nodeKeys_.capacity() + layerKeys_.capacity()) * sizeof(size_t);
+		for(const std::vector<int>* v : {&layerBegin_, &firstOut_, &sources_, &targets_, &outArcs_, &outSlots_,
+			&enabledOutEnd_, &firstIn_, &inArcs_, &inSlots_, &enabledInEnd_,
+			&inputNodeIds_, &inputArcIds_, &nodeFromInput_, &arcFromInput_})
+			bytes += v->capacity() * sizeof(int);
+		return bytes;
+	}
+
+	/// the order key the node was sorted by
+	size_t orderKey(const Node& n) const { return nodeKeys_[n.id_]; }
+
+	/// whether OutArcIt and InArcIt visit the arc, all arcs are enabled after construction
+	bool arcEnabled(const Arc& a) const { return outSlots_[a.id_] < enabledOutEnd_[sources_[a.id_]]; }
+
+	/// enable or disable an arc by moving it to the other side of the enabled slots of its source and target
+	void setArcEnabled(const Arc& a, bool enabled)
+	{
+		if(arcEnabled(a) == enabled)
+			return;
+		moveSlot(outArcs_, outSlots_, enabledOutEnd_[sources_[a.id_]], a.id_, enabled);
+		moveSlot(inArcs_, inSlots_, enabledInEnd_[targets_[a.id_]], a.id_, enabled);
+	}
+
+private:
+	/// swap the arc with the first disabled (enabling) or last enabled (disabling) slot and move the boundary
+	static void moveSlot(std::vector<int>& arcs, std::vector<int>& slots, int& enabledEnd, int arc, bool enabled)
+	{
+		int slot = slots[arc];
+		int boundary = enabled ? enabledEnd : enabledEnd - 1;
+		std::swap(arcs[slot], arcs[boundary]);
+		slots[arcs[slot]] = slot;
+		slots[arc] = boundary;
+		enabledEnd += enabled ? 1 : -1;
+	}
+
+	/// order key of every node, sorted ascending
+	std::vector<size_t> nodeKeys_;
+	/// the distinct order keys, and the first node id of each key group (plus one past the end)
+	std::vector<size_t> layerKeys_;
+	std::vector<int> layerBegin_;
+
+	/// CSR offsets into the arc arrays, size nodeNum()+1
+	std::vector<int> firstOut_;
+	/// source and target node of every arc, arcs are sorted by source
+	std::vector<int> sources_;
+	std::vector<int> targets_;
+	/// out arcs by source, enabled ones before enabledOutEnd_[n], and the slot of every arc
+	std::vector<int> outArcs_;
+	std::vector<int> outSlots_;
+	std::vector<int> enabledOutEnd_;
+	/// in arcs by target, same layout
+	std::vector<int> firstIn_;
+	std::vector<int> inArcs_;
+	std::vector<int> inSlots_;
+	std::vector<int> enabledInEnd_;
+
+	/// mappings to and from the ids of the input digraph, -1 if not present
+	std::vector<int> inputNodeIds_;
+	std::vector<int> inputArcIds_;
+	std::vector<int> nodeFromInput_;
+	std::vector<int> arcFromInput_;
+};
+
+template<typename GR, typename KeyMap>
+CsrDigraph::CsrDigraph(const GR& g, const KeyMap& nodeKeys)
+{
+	// sort nodes by key
+	std::vector< std::pair<size_t, int> > keyedNodes;
+	for(typename GR::NodeIt n(g); n != lemon::INVALID; ++n)
+		keyedNodes.push_back(std::make_pair(nodeKeys[n], g.id(n)));
+	std::stable_sort(keyedNodes.begin(), keyedNodes.end(),
+		[](const std::pair<size_t, int>& a, const std::pair<size_t, int>& b){ return a.first < b.first; });
+
+	int numNodes = keyedNodes.size();
+	nodeKeys_.resize(numNodes);
+	inputNodeIds_.resize(numNodes);
+	nodeFromInput_.assign(g.maxId(typename GR::Node()) + 1, -1);
+	for(int i = 0; i < numNodes; ++i)
+	{
+		nodeKeys_[i] = keyedNodes[i].first;
+		inputNodeIds_[i] = keyedNodes[i].second;
+		nodeFromInput_[keyedNodes[i].second] = i;
+		if(i == 0 || nodeKeys_[i] != nodeKeys_[i - 1])
+		{
+			layerKeys_.push_back(nodeKeys_[i]);
+			layerBegin_.push_back(i);
+		}
+	}
+	layerBegin_.push_back(numNodes);
+
+	// count out and in degrees
+	firstOut_.assign(numNodes + 1, 0);
+	firstIn_.assign(numNodes + 1, 0);
+	int numArcs = 0;
+	for(typename GR::ArcIt a(g); a != lemon::INVALID; ++a)
+	{
+		++firstOut_[nodeFromInput_[g.id(g.source(a))] + 1];
+		++firstIn_[nodeFromInput_[g.id(g.target(a))] + 1];
+		++numArcs;
+	}
+	std::partial_sum(firstOut_.begin(), firstOut_.end(), firstOut_.begin());
+	std::partial_sum(firstIn_.begin(), firstIn_.end(), firstIn_.begin());
+
+	// place arcs in the slots of their source / target
+	sources_.resize(numArcs);
+	targets_.resize(numArcs);
+	inputArcIds_.resize(numArcs);
+	inArcs_.resize(numArcs);
+	arcFromInput_.assign(g.maxId(typename GR::Arc()) + 1, -1);
+	std::vector<int> nextOut(firstOut_.begin(), firstOut_.end() - 1);
+	for(typename GR::ArcIt a(g); a != lemon::INVALID; ++a)
+	{
+		int s = nodeFromInput_[g.id(g.source(a))];
+		int index = nextOut[s]++;
+		sources_[index] = s;
+		targets_[index] = nodeFromInput_[g.id(g.target(a))];
+		inputArcIds_[index] = g.id(a);
+		arcFromInput_[g.id(a)] = index;
+	}
+
+	std::vector<int> nextIn(firstIn_.begin(), firstIn_.end() - 1);
+	inSlots_.resize(numArcs);
+	for(int a = 0; a < numArcs; ++a)
+	{
+		inSlots_[a] = nextIn[targets_[a]];
+		inArcs_[nextIn[targets_[a]]++] = a;
+	}
+
+	// arcs are sorted by source, so every arc starts in the slot of its own id
+	outArcs_.resize(numArcs);
+	std::iota(outArcs_.begin(), outArcs_.end(), 0);
+	outSlots_ = outArcs_;
+	enabledOutEnd_.assign(firstOut_.begin() + 1, firstOut_.end());
+	enabledInEnd_.assign(firstIn_.begin() + 1, firstIn_.end());
+}
+
+} // end namespace dpct
+
+#endif
@@ -33,8 +33,12 @@
 #include <limits>
 #include <unordered_set>
 #include <set>
+#include <algorithm>
+#include <queue>
+#include <functional>
 
 #include "log.h"
+#include "workerpool.h"
 
 namespace lemon {
 
@@ -214,6 +218,11 @@ namespace lemon {
     typedef typename TR::DistMap DistMap;
     /// The type of the paths.
     typedef PredMapPath<Digraph, PredMap> Path;
+    /// \brief The type of the map that stores the partner of every node
+    /// that has a transit, see \ref nodeTransits().
+    typedef typename Digraph::template NodeMap<typename Digraph::Node> TransitPartnerMap;
+    /// \brief The type of the map that stores the transit lengths.
+    typedef typename Digraph::template NodeMap<Value> TransitLengthMap;
     ///\brief The \ref lemon::EarlyStoppingBellmanFordDefaultOperationTraits
     /// "operation traits class" of the algorithm.
     typedef typename TR::OperationTraits OperationTraits;
@@ -229,6 +238,7 @@ namespace lemon {
     typedef typename Digraph::NodeIt NodeIt;
     typedef typename Digraph::Arc Arc;
     typedef typename Digraph::OutArcIt OutArcIt;
+    typedef typename Digraph::InArcIt InArcIt;
 
     // Pointer to the underlying digraph.
     const Digraph *_gr;
@@ -249,9 +259,64 @@ namespace lemon {
     typedef typename Digraph::template NodeMap<bool> MaskMap;
     MaskMap *_mask;
 
+    // Position of a node in the shortest path tree, which is kept as a list
+    // of its nodes in preorder, such that the subtree of a node follows it
+    // directly. Nodes outside of the tree have depth -1.
+    struct TreeLinks {
+      Node prev;
+      Node next;
+      int depth;
+      TreeLinks() : prev(INVALID), next(INVALID), depth(-1) {}
+    };
+    typedef typename Digraph::template NodeMap<TreeLinks> TreeMap;
+    TreeMap *_tree;
+    // Whether the tree matches the predecessor map, otherwise it is rebuilt
+    // before the next round
+    bool _treeValid;
+    // The node whose relaxation closed a negative cycle in the last round, INVALID if none
+    Node _cycleNode;
+
+    // Partner and length of the transit of each node, not set if there are none
+    const TransitPartnerMap* _transitPartner;
+    const TransitLengthMap* _transitLength;
+    // Whether a node was reached over the transit from its partner, its
+    // predecessor arc is INVALID then. Chars, as layers are pulled in parallel.
+    typedef typename Digraph::template NodeMap<char> TransitFlagMap;
+    TransitFlagMap* _viaTransit;
+
     std::vector<Node>& _process;
     std::vector<Node>& _nextProcess;
 
+    // Number of threads relaxing the nodes of a weak round, and the minimal
+    // number of nodes in _process per chunk of a round relaxed against the
+    // distances of the previous round
+    size_t _numThreads;
+    size_t _minNodesPerThread;
+    // Threads running the parallel rounds, started once and reused by all of them
+    dpct::WorkerPool* _pool;
+    bool _local_pool;
+
+    // An improving relaxation found by one thread during a parallel weak round,
+    // along a transit if the arc is INVALID
+    struct Relaxation {
+      Node source;
+      Node target;
+      Arc arc;
+      Value dist;
+      Relaxation(Node s, Node t, Arc a, Value d) : source(s), target(t), arc(a), dist(d) {}
+    };
+    // One buffer of relaxations per thread, kept to reuse the memory
+    std::vector< std::vector<Relaxation> > _relaxations;
+
+    // Nodes invalidated by the last update(), kept to reuse the memory
+    std::vector<Node> _invalidated;
+    // Nodes that were still waiting to be processed before the last update(keepPending=true)
+    std::vector<Node> _pending;
+
+    // Work counters since the last resetCounters(), see numRounds() and numRelaxations()
+    size_t _numRounds;
+    size_t _numRelaxations;
+
     // Creates the maps if necessary.
     void create_maps() {
       if(!_pred) {
@@ -265,6 +330,208 @@ namespace lemon {
       if(!_mask) {
         _mask = new MaskMap(*_gr);
       }
+      if(!_tree) {
+        _tree = new TreeMap(*_gr);
+      }
+    }
+
+    // Deletes the pool if it was created by numThreads().
+    void releasePool() {
+      if(_local_pool) {
+        delete _pool;
+        _local_pool = false;
+      }
+      _pool = 0;
+    }
+
+    // The node that the transit of v leads to, INVALID if v has none
+    Node transitPartner(Node v) const {
+      return _transitPartner ? (*_transitPartner)[v] : Node(INVALID);
+    }
+
+    // Whether v was reached over the transit from its partner
+    bool isViaTransit(Node v) const {
+      return _viaTransit && (*_viaTransit)[v];
+    }
+
+    // Sets the predecessor arc of v, which is then not reached over a transit
+    void setPredArc(Node v, Arc a) {
+      _pred->set(v, a);
+      if (_viaTransit) {
+        _viaTransit->set(v, false);
+      }
+    }
+
+    // Marks v as reached over the transit from its partner
+    void setPredTransit(Node v) {
+      _pred->set(v, INVALID);
+      _viaTransit->set(v, true);
+    }
+
+    // Relaxes the transit from u to its partner within a round that relaxes
+    // in place, see relaxation of arcs in processNextWeakRound().
+    // \return \c false if it closes a negative cycle
+    bool relaxTransit(Node u, size_t& numRelaxations) {
+      Node p = transitPartner(u);
+      if (p == INVALID) {
+        return true;
+      }
+      Value relaxed = OperationTraits::plus((*_dist)[u], (*_transitLength)[u]);
+      if (!OperationTraits::less(relaxed, (*_dist)[p])) {
+        return true;
+      }
+      ++numRelaxations;
+      bool closesCycle = !moveInTree(u, p);
+      setPredTransit(p);
+      _dist->set(p, relaxed);
+      if (closesCycle) {
+        _cycleNode = p;
+        return false;
+      }
+      if (!(*_mask)[p]) {
+        _mask->set(p, true);
+        _nextProcess.push_back(p);
+      }
+      return true;
+    }
+
+    // A node on the negative cycle closed in the last round, otherwise on a
+    // cycle of the predecessor map, INVALID if there is none
+    Node findCycleNode() const {
+      if (_cycleNode != INVALID) {
+        return _cycleNode;
+      }
+      typename Digraph::template NodeMap<int> state(*_gr, -1);
+      for (int i = 0; i < int(_process.size()); ++i) {
+        if (state[_process[i]] != -1) continue;
+        for (Node v = _process[i]; v != INVALID; v = predNode(v)) {
+          if (state[v] == i) {
+            return v;
+          }
+          else if (state[v] >= 0) {
+            break;
+          }
+          state[v] = i;
+        }
+      }
+      return INVALID;
+    }
+
+    // Removes a node from the tree, its subtree must have been removed already.
+    void unlinkTreeNode(Node v) {
+      TreeLinks& links = (*_tree)[v];
+      if (links.prev != INVALID) {
+        (*_tree)[links.prev].next = links.next;
+      }
+      if (links.next != INVALID) {
+        (*_tree)[links.next].prev = links.prev;
+      }
+      links = TreeLinks();
+    }
+
+    // Inserts a node that is not in the tree as first child of parent.
+    void linkTreeNode(Node v, Node parent) {
+      TreeLinks& parentLinks = (*_tree)[parent];
+      TreeLinks& links = (*_tree)[v];
+      links.prev = parent;
+      links.next = parentLinks.next;
+      links.depth = parentLinks.depth + 1;
+      if (parentLinks.next != INVALID) {
+        (*_tree)[parentLinks.next].prev = v;
+      }
+      parentLinks.next = v;
+    }
+
+    // Moves target below u in the tree after its distance improved over an
+    // arc from u (subtree disassembly). The subtree of target is removed from
+    // the tree, its nodes keep their distances and predecessors and rejoin the
+    // tree once they are relaxed from a node in the tree again. Until then
+    // their distances are known to be too large, so the rounds skip them.
+    // As every removed node was inserted before, this costs amortized O(1)
+    // per relaxation.
+    // \return \c false if u lies in the subtree of target, then the arc
+    // closes a negative cycle and the tree is left in an undefined state.
+    bool moveInTree(Node u, Node target) {
+      if (u == target) {
+        return false;
+      }
+      int depth = (*_tree)[target].depth;
+      if (depth >= 0) {
+        Node w = (*_tree)[target].next;
+        while (w != INVALID && (*_tree)[w].depth > depth) {
+          if (w == u) {
+            return false;
+          }
+          Node next = (*_tree)[w].next;
+          (*_tree)[w] = TreeLinks();
+          w = next;
+        }
+        Node prev = (*_tree)[target].prev;
+        if (prev != INVALID) {
+          (*_tree)[prev].next = w;
+        }
+        if (w != INVALID) {
+          (*_tree)[w].prev = prev;
+        }
+        (*_tree)[target] = TreeLinks();
+      }
+      if ((*_tree)[u].depth >= 0) {
+        linkTreeNode(target, u);
+      }
+      return true;
+    }
+
+    // Builds the tree from the predecessor map, rooted at all reached nodes
+    // without predecessor. Nodes on or behind cycles of the predecessor map
+    // stay outside of the tree.
+    void rebuildTree() {
+      std::vector<Node> stack;
+      for (NodeIt it(*_gr); it != INVALID; ++it) {
+        (*_tree)[it] = TreeLinks();
+      }
+      for (NodeIt it(*_gr); it != INVALID; ++it) {
+        if ((*_pred)[it] == INVALID && !isViaTransit(it) && reached(it)) {
+          (*_tree)[it].depth = 0;
+          stack.push_back(it);
+        }
+      }
+      // depth first, such that every subtree is contiguous in the list
+      Node last = INVALID;
+      while (!stack.empty()) {
+        Node u = stack.back();
+        stack.pop_back();
+        (*_tree)[u].prev = last;
+        if (last != INVALID) {
+          (*_tree)[last].next = u;
+        }
+        last = u;
+        for (OutArcIt it(*_gr, u); it != INVALID; ++it) {
+          Node v = _gr->target(it);
+          if ((*_pred)[v] == it && (*_tree)[v].depth < 0) {
+            (*_tree)[v].depth = (*_tree)[u].depth + 1;
+            stack.push_back(v);
+          }
+        }
+        Node p = transitPartner(u);
+        if (p != INVALID && isViaTransit(p) && (*_tree)[p].depth < 0) {
+          (*_tree)[p].depth = (*_tree)[u].depth + 1;
+          stack.push_back(p);
+        }
+      }
+      _treeValid = true;
+    }
+
+    // Stops the current round after a negative cycle was closed. The nodes
+    // of this round from firstUnfinished on are processed again next.
+    void interruptRound(size_t firstUnfinished) {
+      for (size_t i = firstUnfinished; i < _process.size(); ++i) {
+        if (!(*_mask)[_process[i]]) {
+          _mask->set(_process[i], true);
+          _nextProcess.push_back(_process[i]);
+        }
+      }
+      _process.swap(_nextProcess);
+      _treeValid = false;
     }
 
   public :
@@ -357,7 +624,12 @@ namespace lemon {
       _pred(0), _local_pred(false),
       _dist(0), _local_dist(false), 
       _mask(0),
-      _process(process), _nextProcess(nextProcess)
+      _tree(0), _treeValid(false), _cycleNode(INVALID),
+      _transitPartner(0), _transitLength(0), _viaTransit(0),
+      _process(process), _nextProcess(nextProcess),
+      _numThreads(1), _minNodesPerThread(1024),
+      _pool(0), _local_pool(false),
+      _numRounds(0), _numRelaxations(0)
        {}
 
     ///Destructor.
@@ -365,6 +637,9 @@ namespace lemon {
       if(_local_pred) delete _pred;
       if(_local_dist) delete _dist;
       if(_mask) delete _mask;
+      if(_local_pool) delete _pool;
+      if(_tree) delete _tree;
+      if(_viaTransit) delete _viaTransit;
     }
 
     /// \brief Sets the length map.
@@ -411,6 +686,99 @@ namespace lemon {
       return *this;
     }
 
+    /// \brief Sets the transits between pairs of nodes.
+    ///
+    /// A node \c v with a valid \c partners[v] can be left towards its
+    /// partner at the cost \c lengths[v], without an arc, and an infinite
+    /// length disables the transit. Partners are mutual, such that a node
+    /// pair can hold a quantity whose cost changes in both directions, like
+    /// the capacity and costs of a node of the flow graph that is represented
+    /// by an in- and an out-side. Each round relaxes the transit of every
+    /// node it scans after its out arcs, at the place the arc between the
+    /// two sides would be relaxed, so the rounds are the same as for such an
+    /// arc while the digraph holds none. A node reached over its
+    /// transit has an \c INVALID predecessor arc, see \ref predTransit().
+    /// The maps are read during the search and may change between searches
+    /// like the length map, \ref update() has to be told about the nodes
+    /// behind changed transits.
+    /// \return <tt>(*this)</tt>
+    EarlyStoppingBellmanFord &nodeTransits(const TransitPartnerMap& partners, const TransitLengthMap& lengths) {
+      _transitPartner = &partners;
+      _transitLength = &lengths;
+      if (!_viaTransit) {
+        _viaTransit = new TransitFlagMap(*_gr, false);
+      }
+      return *this;
+    }
+
+    /// \brief Sets the number of threads used in each weak round.
+    ///
+    /// A weak round whose list of active nodes holds at least
+    /// \c minNodesPerThread nodes is relaxed against the distances of the
+    /// previous round, in consecutive chunks of at least that many nodes that
+    /// run in parallel on up to \c numThreads threads. The improving
+    /// relaxations are collected per chunk and merged in the order of the
+    /// active node list. Smaller rounds relax in place. Which rounds do what
+    /// only depends on the number of active nodes, so the distances and
+    /// predecessors are the same for any number of threads and scheduling.
+    /// The threads are started here and reused by all rounds, unless a
+    /// pool is given with \ref workerPool().
+    /// \return <tt>(*this)</tt>
+    EarlyStoppingBellmanFord &numThreads(size_t numThreads, size_t minNodesPerThread = 1024) {
+      releasePool();
+      _numThreads = std::max(numThreads, size_t(1));
+      _minNodesPerThread = std::max(minNodesPerThread, size_t(1));
+      if(_numThreads > 1) {
+        _local_pool = true;
+        _pool = new dpct::WorkerPool(_numThreads);
+      }
+      return *this;
+    }
+
+    /// \brief Runs the weak rounds on the threads of the given pool.
+    ///
+    /// Sets the number of threads to the size of the pool, see
+    /// \ref numThreads(). The pool can be shared with other algorithms as
+    /// long as they do not run at the same time, and must outlive this one.
+    /// \return <tt>(*this)</tt>
+    EarlyStoppingBellmanFord &workerPool(dpct::WorkerPool& pool, size_t minNodesPerThread = 1024) {
+      releasePool();
+      _pool = &pool;
+      _numThreads = pool.getNumThreads();
+      _minNodesPerThread = std::max(minNodesPerThread, size_t(1));
+      return *this;
+    }
+
+    /// \brief The number of threads used in each weak round.
+    size_t numThreads() const { return _numThreads; }
+
+    /// \brief The number of weak rounds, layered sweeps and Dijkstra
+    /// searches run since the last \ref resetCounters().
+    size_t numRounds() const { return _numRounds; }
+
+    /// \brief The number of relaxations that improved the distance of a
+    /// node since the last \ref resetCounters().
+    size_t numRelaxations() const { return _numRelaxations; }
+
+    /// \brief Approximate number of bytes of the maps and buffers that the
+    /// algorithm allocated itself, without the maps that were given to it.
+    size_t workBytes() const {
+      size_t numNodes = size_t(_gr->maxNodeId() + 1);
+      size_t bytes = 0;
+      if (_local_pred) bytes += numNodes * sizeof(Arc);
+      if (_local_dist) bytes += numNodes * sizeof(Value);
+      if (_mask) bytes += numNodes * sizeof(bool);
+      if (_tree) bytes += numNodes * sizeof(TreeLinks);
+      if (_viaTransit) bytes += numNodes * sizeof(char);
+      for (size_t i = 0; i < _relaxations.size(); ++i)
+        bytes += _relaxations[i].capacity() * sizeof(Relaxation);
+      bytes += (_invalidated.capacity() + _pending.capacity()) * sizeof(Node);
+      return bytes;
+    }
+
+    /// \brief Resets the work counters.
+    void resetCounters() { _numRounds = 0; _numRelaxations = 0; }
+
     /// \name Execution Control
     /// The simplest way to execute the Bellman-Ford algorithm is to use
     /// one of the member functions called \ref run().\n
@@ -429,9 +797,18 @@ namespace lemon {
     void init(const Value value = OperationTraits::infinity()) {
       create_maps();
       for (NodeIt it(*_gr); it != INVALID; ++it) {
-        _pred->set(it, INVALID);
+        setPredArc(it, INVALID);
         _dist->set(it, value);
+        (*_tree)[it] = TreeLinks();
+      }
+      // with finite initial distances every node is a root
+      _treeValid = !OperationTraits::less(value, OperationTraits::infinity());
+      if (_treeValid) {
+        for (NodeIt it(*_gr); it != INVALID; ++it) {
+          (*_tree)[it].depth = 0;
+        }
       }
+      _cycleNode = INVALID;
       _process.clear();
       // _process.reserve(lemon::countNodes(*_gr));
       // _nextProcess.reserve(lemon::countNodes(*_gr));
@@ -447,35 +824,55 @@ namespace lemon {
       }
     }
 
+    /// \brief Invalidates the shortest path subtrees of the given nodes.
+    ///
+    /// Resets the distances of all nodes whose shortest path passes through
+    /// one of the dirty nodes, and fills the list of nodes to process next
+    /// with the nodes that have an arc or transit into the invalidated
+    /// subtrees, sorted by \c nodeUpdateOrderMap. The order map must provide \c operator[]
+    /// like \ref IterableValueMap.
+    ///
+    /// Only the invalidated nodes and their in arcs are visited, so the cost
+    /// is proportional to the size of the invalidated subtrees instead of the
+    /// whole digraph.
+    ///
+    /// If \c keepPending is set, the nodes that were still waiting to be
+    /// processed are processed next as well, such that a search that was
+    /// stopped early, e.g. at a negative cycle, is continued instead of
+    /// only repaired around the dirty nodes.
+    template <typename OrderMap>
     void update(const std::vector<typename Digraph::Node>& dirtyNodes, 
-      IterableValueMap<Digraph, typename Digraph::Node, size_t>& nodeUpdateOrderMap)
+      OrderMap& nodeUpdateOrderMap, bool keepPending = false)
     {
-      // unmask all nodes
-      for(NodeIt it(*_gr); it != INVALID; ++it) {
-        _mask->set(it, false);
+      // only the nodes waiting in _process can still be masked
+      for (int i = 0; i < int(_process.size()); ++i) {
+        _mask->set(_process[i], false);
+      }
+      _pending.clear();
+      if (keepPending) {
+        _pending.swap(_process);
       }
       _process.clear();
+      _invalidated.clear();
 
-      // mark dirty nodes and put them into process, and reset source
+      // mark dirty nodes as invalidated, and reset source
       for(auto n : dirtyNodes)
       {
         _dist->set(n, OperationTraits::infinity());
-        _pred->set(n, INVALID);
-        if(n != _source)
+        setPredArc(n, INVALID);
+        if(n != _source && !(*_mask)[n])
         {
           _mask->set(n, true);
-          _process.push_back(n);
+          _invalidated.push_back(n);
         }
       }
 
       // invalidate all nodes on shortest paths from dirty nodes,
-      // because we mask nodes that have been updated already, 
-      // each node can only be part of _process once
-      while(!_process.empty())
+      // because we mask nodes that have been invalidated already, 
+      // each node can only be part of _invalidated once
+      for(size_t i = 0; i < _invalidated.size(); ++i)
       {
-        Node u = _process.back();
-        _process.pop_back();
-
+        Node u = _invalidated[i];
         for(OutArcIt outArcIt(*_gr, u); outArcIt != INVALID; ++outArcIt)
         {
           Node t = _gr->target(outArcIt);
@@ -484,33 +881,61 @@ namespace lemon {
             _dist->set(t, OperationTraits::infinity());
             _pred->set(t, INVALID);
             _mask->set(t, true);
-            _process.push_back(t);
+            _invalidated.push_back(t);
           }
         }
+        Node p = transitPartner(u);
+        if(p != INVALID && isViaTransit(p) && !(*_mask)[p])
+        {
+          _dist->set(p, OperationTraits::infinity());
+          setPredArc(p, INVALID);
+          _mask->set(p, true);
+          _invalidated.push_back(p);
+        }
       }
       _dist->set(_source, 0);
+      _cycleNode = INVALID;
 
-      // fill process for the next run of BF:
-      for(auto v_it = nodeUpdateOrderMap.beginValue(); 
-          v_it != nodeUpdateOrderMap.endValue(); 
-          ++ v_it)
+      // the invalidated nodes form whole subtrees, so the remaining tree stays intact
+      if (_treeValid) {
+        for (const Node& v : _invalidated) {
+          if ((*_tree)[v].depth >= 0) {
+            unlinkTreeNode(v);
+          }
+        }
+        if ((*_tree)[_source].depth < 0) {
+          (*_tree)[_source].depth = 0;
+        }
+      }
+
+      // fill process for the next run of BF with all nodes pointing into the invalidated subtrees
+      std::vector< std::pair<typename OrderMap::Value, int> > candidates;
+      for(const Node& v : _invalidated)
       {
-        // std::cout << "Inserting value " << *v_it << std::endl; 
-        typename IterableValueMap<Digraph, typename Digraph::Node, size_t>::ItemIt i_it(nodeUpdateOrderMap, *v_it);
-        for (; i_it != lemon::INVALID; ++i_it)
+        for(InArcIt inArcIt(*_gr, v); inArcIt != INVALID; ++inArcIt)
         {
-          for(OutArcIt outArcIt(*_gr, i_it); outArcIt != INVALID; ++outArcIt)
-          {
-            if((*_mask)[_gr->target(outArcIt)])
-            {
-              _process.push_back(i_it);
-              break;
-            }
-          }
+          Node u = _gr->source(inArcIt);
+          candidates.push_back(std::make_pair(nodeUpdateOrderMap[u], _gr->id(u)));
         }
+        Node p = transitPartner(v);
+        if(p != INVALID && OperationTraits::less((*_transitLength)[p], OperationTraits::infinity()))
+        {
+          candidates.push_back(std::make_pair(nodeUpdateOrderMap[p], _gr->id(p)));
+        }
+      }
+      for(const Node& u : _pending)
+      {
+        candidates.push_back(std::make_pair(nodeUpdateOrderMap[u], _gr->id(u)));
+      }
+      std::sort(candidates.begin(), candidates.end());
+      candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+      for(const auto& c : candidates)
+      {
+        _process.push_back(_gr->nodeFromId(c.second));
       }
-      for(NodeIt it(*_gr); it != INVALID; ++it) {
-        _mask->set(it, false);
+
+      for(const Node& v : _invalidated) {
+        _mask->set(v, false);
       }
     }
 
@@ -518,20 +943,24 @@ namespace lemon {
     ///
     /// This function adds a new source node. The optional second parameter
     /// is the initial distance of the node.
+    template <typename OrderMap>
     void addSource(
       Node source, 
-      IterableValueMap<Digraph, typename Digraph::Node, size_t>& nodeUpdateOrderMap, 
+      OrderMap& nodeUpdateOrderMap, 
       Value dst = OperationTraits::zero()) 
     {
       _source = source;
       _dist->set(source, dst);
+      if ((*_tree)[source].depth < 0) {
+        (*_tree)[source].depth = 0;
+      }
 
       for(auto v_it = nodeUpdateOrderMap.beginValue(); 
           v_it != nodeUpdateOrderMap.endValue(); 
           ++ v_it)
       {
         // std::cout << "Inserting value " << *v_it << std::endl; 
-        typename IterableValueMap<Digraph, typename Digraph::Node, size_t>::ItemIt i_it(nodeUpdateOrderMap, *v_it);
+        typename OrderMap::ItemIt i_it(nodeUpdateOrderMap, *v_it);
         for (; i_it != lemon::INVALID; ++i_it)
         {
           _process.push_back(i_it);
@@ -556,6 +985,9 @@ namespace lemon {
     {
       _source = source;
       _dist->set(source, dst);
+      if ((*_tree)[source].depth < 0) {
+        (*_tree)[source].depth = 0;
+      }
 
       if (!(*_mask)[source]) {
         _process.push_back(source);
@@ -573,29 +1005,160 @@ namespace lemon {
     /// path distances exactly for paths consisting of at most \c k arcs,
     /// this is why it is called weak round.
     ///
+    /// Rounds with at least as many active nodes as set per thread with
+    /// \ref numThreads() relax against the distances of the previous round,
+    /// see \ref processNextParallelWeakRound(), also on a single thread.
+    ///
+    /// The transits of the scanned nodes are relaxed after their out arcs,
+    /// see \ref nodeTransits().
+    ///
+    /// Every improving relaxation also moves its target in the shortest
+    /// path tree (subtree disassembly), so a negative cycle is detected in
+    /// the round in which it closes. The round stops then, and
+    /// \ref negativeCycle() returns the cycle. Active nodes that were
+    /// removed from the tree are skipped, their distances decrease again.
+    ///
     /// \return \c true when the algorithm have not found more shorter
     /// paths.
     ///
     /// \see ActiveIt
     bool processNextWeakRound() {
+      ++_numRounds;
+      _cycleNode = INVALID;
+      if (!_treeValid) {
+        rebuildTree();
+      }
+      if (_process.size() >= _minNodesPerThread)
+        return processNextParallelWeakRound();
+
       for (int i = 0; i < int(_process.size()); ++i) {
         _mask->set(_process[i], false);
       }
       _nextProcess.clear();
+      size_t numRelaxations = 0;
       for (int i = 0; i < int(_process.size()); ++i) {
         Node& element = _process[i];
+        // removed from the tree with the subtree of an improved ancestor,
+        // it is scanned once it was relabelled from the tree again
+        if ((*_tree)[element].depth < 0) {
+          continue;
+        }
         for (OutArcIt it(*_gr, element); it != INVALID; ++it) {
           Node target = _gr->target(it);
           Value relaxed =
             OperationTraits::plus((*_dist)[element], (*_length)[it]);
           if (OperationTraits::less(relaxed, (*_dist)[target])) {
-            _pred->set(target, it);
+            ++numRelaxations;
+            bool closesCycle = !moveInTree(element, target);
+            setPredArc(target, it);
             _dist->set(target, relaxed);
+            if (closesCycle) {
+              _cycleNode = target;
+              _numRelaxations += numRelaxations;
+              interruptRound(i);
+              return false;
+            }
             
             if (!(*_mask)[target]) {
               _mask->set(target, true);
               _nextProcess.push_back(target);
             }
+
+          }
+        }
+        if (!relaxTransit(element, numRelaxations)) {
+          _numRelaxations += numRelaxations;
+          interruptRound(i);
+          return false;
+        }
+      }
+      _numRelaxations += numRelaxations;
+
+      _process.swap(_nextProcess);
+      return _process.empty();
+    }
+
+    /// \brief Executes one weak round using all configured threads.
+    ///
+    /// Each thread relaxes the out arcs and transits of a consecutive chunk
+    /// of the active nodes, only reading the distance map, and stores the improving
+    /// relaxations in its own buffer. The buffers are then applied in chunk
+    /// order, so among equally short relaxations of a node the one of the
+    /// earliest active node wins, independent of the number of chunks and
+    /// the thread scheduling. A single chunk is relaxed on the calling thread.
+    /// As all threads see the distances of the previous round, this is a
+    /// weak round in the same sense as \ref processNextWeakRound(). The tree
+    /// is updated while merging, so negative cycles are detected the same way.
+    ///
+    /// \return \c true when the algorithm have not found more shorter
+    /// paths.
+    bool processNextParallelWeakRound() {
+      for (int i = 0; i < int(_process.size()); ++i) {
+        _mask->set(_process[i], false);
+      }
+      _nextProcess.clear();
+
+      size_t numChunks = std::max(size_t(1), std::min(_numThreads, _process.size() / _minNodesPerThread));
+      size_t chunkSize = (_process.size() + numChunks - 1) / numChunks;
+      _relaxations.resize(numChunks);
+
+      auto relaxChunk = [this, chunkSize](size_t chunk) {
+        std::vector<Relaxation>& relaxations = _relaxations[chunk];
+        relaxations.clear();
+        size_t end = std::min(_process.size(), (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i) {
+          Node element = _process[i];
+          if ((*_tree)[element].depth < 0) {
+            continue;
+          }
+          Value elementDist = (*_dist)[element];
+          for (OutArcIt it(*_gr, element); it != INVALID; ++it) {
+            Node target = _gr->target(it);
+            Value relaxed = OperationTraits::plus(elementDist, (*_length)[it]);
+            if (OperationTraits::less(relaxed, (*_dist)[target])) {
+              relaxations.push_back(Relaxation(element, target, it, relaxed));
+            }
+          }
+          Node partner = transitPartner(element);
+          if (partner != INVALID) {
+            Value relaxed = OperationTraits::plus(elementDist, (*_transitLength)[element]);
+            if (OperationTraits::less(relaxed, (*_dist)[partner])) {
+              relaxations.push_back(Relaxation(element, partner, INVALID, relaxed));
+            }
+          }
+        }
+      };
+
+      if (numChunks > 1) {
+        _pool->run(numChunks, relaxChunk);
+      } else {
+        relaxChunk(0);
+      }
+
+      // deterministic merge in the order of the active nodes
+      for (size_t chunk = 0; chunk < numChunks; ++chunk) {
+        for (const Relaxation& r : _relaxations[chunk]) {
+          // the source may have been disassembled by an earlier relaxation of the merge
+          if ((*_tree)[r.source].depth >= 0 
+              && OperationTraits::less(r.dist, (*_dist)[r.target])) {
+            ++_numRelaxations;
+            bool closesCycle = !moveInTree(r.source, r.target);
+            if (r.arc == INVALID) {
+              setPredTransit(r.target);
+            } else {
+              setPredArc(r.target, r.arc);
+            }
+            _dist->set(r.target, r.dist);
+            if (closesCycle) {
+              _cycleNode = r.target;
+              interruptRound(0);
+              return false;
+            }
+
+            if (!(*_mask)[r.target]) {
+              _mask->set(r.target, true);
+              _nextProcess.push_back(r.target);
+            }
           }
         }
       }
@@ -604,6 +1167,238 @@ namespace lemon {
       return _process.empty();
     }
 
+    /// \brief Computes the distances with a single sweep over the layers
+    /// of the given node order.
+    ///
+    /// If every arc and transit of finite length leads from a node of lower
+    /// order to a node of strictly higher order, the digraph is acyclic and visiting the
+    /// layers in increasing order yields the exact distances in O(n+m).
+    /// Each node pulls its distance over its in arcs, whose sources are final
+    /// already, so the nodes of one layer are independent and a large layer
+    /// is split among the threads set by \ref numThreads().
+    /// The order map must provide the \c beginValue(), \c endValue() and
+    /// \c ItemIt interface of \ref IterableValueMap.
+    ///
+    /// \return \c false if an arc or transit of finite length violates the order. The
+    /// distances are not exact then, and the search has to be restarted with
+    /// init(), addSource() and one of the start functions.
+    ///
+    /// \pre init() must be called and the root node should be added with
+    /// addSource() before using this function.
+    template <typename OrderMap>
+    bool layeredStart(const OrderMap& nodeOrderMap) {
+      ++_numRounds;
+      _treeValid = false;
+      std::vector<Node> layer;
+      for (auto v_it = nodeOrderMap.beginValue(); 
+          v_it != nodeOrderMap.endValue(); 
+          ++v_it)
+      {
+        layer.clear();
+        for (typename OrderMap::ItemIt i_it(nodeOrderMap, *v_it); i_it != INVALID; ++i_it) {
+          layer.push_back(i_it);
+        }
+
+        bool valid = true;
+        if (_numThreads > 1 && layer.size() >= _numThreads * _minNodesPerThread) {
+          size_t chunkSize = (layer.size() + _numThreads - 1) / _numThreads;
+          std::vector<char> chunkValid(_numThreads, true);
+          std::vector<size_t> chunkRelaxations(_numThreads, 0);
+          _pool->run(_numThreads, [&](size_t chunk) {
+            chunkValid[chunk] = pullDistances(layer, chunk * chunkSize, 
+              std::min(layer.size(), (chunk + 1) * chunkSize), nodeOrderMap, chunkRelaxations[chunk]);
+          });
+          valid = std::find(chunkValid.begin(), chunkValid.end(), false) == chunkValid.end();
+          for (size_t numRelaxations : chunkRelaxations) {
+            _numRelaxations += numRelaxations;
+          }
+        } else {
+          valid = pullDistances(layer, 0, layer.size(), nodeOrderMap, _numRelaxations);
+        }
+
+        if (!valid) {
+          return false;
+        }
+      }
+
+      for (int i = 0; i < int(_process.size()); ++i) {
+        _mask->set(_process[i], false);
+      }
+      _process.clear();
+      return true;
+    }
+
+    /// \brief Computes the distances with Dijkstra's algorithm on reduced
+    /// arc lengths.
+    ///
+    /// The nodes are scanned in the order of their reduced distance
+    /// <tt>dist(v) - potential[v]</tt>. If the potentials are the distances
+    /// of a previous search, the reduced length
+    /// <tt>length(u,v) + potential[u] - potential[v]</tt> of all arcs that
+    /// did not change is non-negative, and every node is scanned once.
+    /// Arcs whose reduced length became negative are handled by scanning
+    /// the affected nodes again when their distance improves, so the result
+    /// is exact for any finite potentials as long as there is no negative
+    /// cycle.
+    ///
+    /// \param potential finite potential of every node
+    /// \param maxNumScans limit of node scans, which bounds the work spent
+    /// on negative reduced lengths and negative cycles
+    /// \return \c false if a negative cycle through the root was found or
+    /// the scan limit was hit. The distances are not exact then.
+    /// At the scan limit, the nodes whose distance improved since they were
+    /// scanned last become the active nodes, such that \ref checkedStart()
+    /// continues from the distances found so far and only relaxes the arcs
+    /// behind them, which also locates negative cycles. A cycle through the
+    /// root leaves a predecessor at the root, the search then has to be
+    /// restarted with init(), addSource() and one of the Bellman-Ford start
+    /// functions.
+    ///
+    /// \pre init() must be called and the root node should be added with
+    /// addSource() before using this function.
+    template <typename PotentialMap>
+    bool potentialStart(const PotentialMap& potential, size_t maxNumScans) {
+      ++_numRounds;
+      _treeValid = false;
+      for (int i = 0; i < int(_process.size()); ++i) {
+        _mask->set(_process[i], false);
+      }
+      _process.clear();
+
+      // min-heap of (reduced distance, node id), outdated entries are skipped when popped
+      typedef std::pair<Value, int> HeapItem;
+      std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem> > heap;
+      heap.push(HeapItem((*_dist)[_source] - potential[_source], _gr->id(_source)));
+
+      size_t numScans = 0;
+      while (!heap.empty()) {
+        HeapItem top = heap.top();
+        heap.pop();
+        Node u = _gr->nodeFromId(top.second);
+        Value uDist = (*_dist)[u];
+        if (OperationTraits::less(uDist - potential[u], top.first)) {
+          continue;
+        }
+
+        if (++numScans > maxNumScans) {
+          heap.push(top);
+          while (!heap.empty()) {
+            Node v = _gr->nodeFromId(heap.top().second);
+            if (!(*_mask)[v] && !OperationTraits::less(heap.top().first, (*_dist)[v] - potential[v])) {
+              _mask->set(v, true);
+              _process.push_back(v);
+            }
+            heap.pop();
+          }
+          return false;
+        }
+
+        for (OutArcIt it(*_gr, u); it != INVALID; ++it) {
+          Node v = _gr->target(it);
+          Value relaxed = OperationTraits::plus(uDist, (*_length)[it]);
+          if (OperationTraits::less(relaxed, (*_dist)[v])) {
+            ++_numRelaxations;
+            setPredArc(v, it);
+            _dist->set(v, relaxed);
+            if (v == _source) {
+              return false;
+            }
+            heap.push(HeapItem(relaxed - potential[v], _gr->id(v)));
+          }
+        }
+
+        Node p = transitPartner(u);
+        if (p != INVALID) {
+          Value relaxed = OperationTraits::plus(uDist, (*_transitLength)[u]);
+          if (OperationTraits::less(relaxed, (*_dist)[p])) {
+            ++_numRelaxations;
+            setPredTransit(p);
+            _dist->set(p, relaxed);
+            heap.push(HeapItem(relaxed - potential[p], _gr->id(p)));
+          }
+        }
+      }
+      return true;
+    }
+
+    /// \brief Stores the distance of every reached node as its potential.
+    ///
+    /// Unreached nodes keep their previous potential, so all potentials
+    /// stay finite.
+    template <typename PotentialMap>
+    void updatePotentials(PotentialMap& potential) const {
+      for (NodeIt it(*_gr); it != INVALID; ++it) {
+        if (reached(it)) {
+          potential.set(it, (*_dist)[it]);
+        }
+      }
+    }
+
+  private:
+
+    // Sets the distance and predecessor of the nodes layer[begin..end) from
+    // their in arcs and the transit of their partner, returns false if an arc
+    // or transit of finite length does not come from a lower layer. Improving relaxations are added to numRelaxations.
+    template <typename OrderMap>
+    bool pullDistances(const std::vector<Node>& layer, size_t begin, size_t end,
+      const OrderMap& nodeOrderMap, size_t& numRelaxations)
+    {
+      for (size_t i = begin; i < end; ++i) {
+        Node v = layer[i];
+        if (v == _source) {
+          continue;
+        }
+
+        Value best = (*_dist)[v];
+        Arc bestArc = (*_pred)[v];
+        bool bestTransit = isViaTransit(v);
+        for (InArcIt ia(*_gr, v); ia != INVALID; ++ia) {
+          Value length = (*_length)[ia];
+          if (!OperationTraits::less(length, OperationTraits::infinity())) {
+            continue;
+          }
+          Node u = _gr->source(ia);
+          if (!(nodeOrderMap[u] < nodeOrderMap[v])) {
+            return false;
+          }
+          Value sourceDist = (*_dist)[u];
+          if (!OperationTraits::less(sourceDist, OperationTraits::infinity())) {
+            continue;
+          }
+          Value relaxed = OperationTraits::plus(sourceDist, length);
+          if (OperationTraits::less(relaxed, best)) {
+            ++numRelaxations;
+            best = relaxed;
+            bestArc = ia;
+            bestTransit = false;
+          }
+        }
+
+        Node p = transitPartner(v);
+        if (p != INVALID && OperationTraits::less((*_transitLength)[p], OperationTraits::infinity())) {
+          if (!(nodeOrderMap[p] < nodeOrderMap[v])) {
+            return false;
+          }
+          Value relaxed = OperationTraits::plus((*_dist)[p], (*_transitLength)[p]);
+          if (OperationTraits::less((*_dist)[p], OperationTraits::infinity())
+              && OperationTraits::less(relaxed, best)) {
+            ++numRelaxations;
+            best = relaxed;
+            bestTransit = true;
+          }
+        }
+        _dist->set(v, best);
+        if (bestTransit) {
+          setPredTransit(v);
+        } else {
+          setPredArc(v, bestArc);
+        }
+      }
+      return true;
+    }
+
+  public:
+
     /// \brief Executes the algorithm.
     ///
     /// Executes the algorithm.
@@ -636,37 +1431,41 @@ namespace lemon {
     /// - the shortest path tree (forest),
     /// - the distance of each node from the root(s).
     ///
+    /// Negative cycles are detected by the rounds as soon as they close, see
+    /// \ref processNextWeakRound(). As the rounds skip disassembled nodes
+    /// until they rejoin the tree, a cycle cannot close outside of the tree.
+    /// Only nodes left on cycles of the predecessor map when the tree is
+    /// rebuilt run into the round limit, then \ref negativeCycle() finds
+    /// their cycle in the predecessor map.
+    ///
+    /// \param numIterations maximal number of rounds, 0 = number of nodes
     /// \return \c false if there is a negative cycle in the digraph.
     ///
     /// \pre init() must be called and at least one root node should be
     /// added with addSource() before using this function.
-    bool checkedStart(int numIterationsBetweenNegativeCycleChecks, int numIterations) {
+    bool checkedStart(int numIterations = 0) {
       int num = (numIterations <= 0) ? countNodes(*_gr) : numIterations;
 
       bool result;
       for (int i = 0; i < num; ++i) {
         result = processNextWeakRound();
 
-        if((*_pred)[_source] != INVALID)
+        if(predNode(_source) != INVALID)
         {
           LOG_MSG("\tCycle returned to source with negative cost " << (*_dist)[_source] << " in iteration " << i);
           return false;
         }
 
-        if(result)
+        if(_cycleNode != INVALID)
         {
-          // std::cout << "\tFinished after " << i << " iterations" << std::endl; 
-          return true;
+          DEBUG_MSG("\t!!! Found negative cycle in iteration " << i);
+          return false;
         }
 
-        if(i > 0 && i % numIterationsBetweenNegativeCycleChecks == 0)
+        if(result)
         {
-          lemon::Path<Digraph> cycle = negativeCycle();
-          if(cycle.length() > 0)
-          {
-              DEBUG_MSG("\t!!! Found negative cycle in iteration " << i);
-              return false;
-          }
+          // std::cout << "\tFinished after " << i << " iterations" << std::endl; 
+          return true;
         }
       }
       // std::cout << "\tFinished after " << num << " iterations" << std::endl; 
@@ -786,7 +1585,8 @@ namespace lemon {
     /// This function returns the 'previous arc' of the shortest path
     /// tree for node \c v, i.e. it returns the last arc of a
     /// shortest path from a root to \c v. It is \c INVALID if \c v
-    /// is not reached from the root(s) or if \c v is a root.
+    /// is not reached from the root(s), if \c v is a root, or if it was
+    /// reached over a transit, see \ref predTransit().
     ///
     /// The shortest path tree used here is equal to the shortest path
     /// tree used in \ref predNode() and \ref predMap().
@@ -809,9 +1609,19 @@ namespace lemon {
     /// \pre Either \ref run() or \ref init() must be called before
     /// using this function.
     Node predNode(Node v) const {
+      if (isViaTransit(v)) {
+        return (*_transitPartner)[v];
+      }
       return (*_pred)[v] == INVALID ? INVALID : _gr->source((*_pred)[v]);
     }
 
+    /// \brief Whether the shortest path to the given node ends with the
+    /// transit from its partner, see \ref nodeTransits().
+    ///
+    /// \pre Either \ref run() or \ref init() must be called before
+    /// using this function.
+    bool predTransit(Node v) const { return isViaTransit(v); }
+
     /// \brief Returns a const reference to the node map that stores the
     /// distances of the nodes.
     ///
@@ -847,26 +1657,40 @@ namespace lemon {
     /// This function gives back a directed cycle with negative total
     /// length if the algorithm has already found one.
     /// Otherwise it gives back an empty path.
+    ///
+    /// The cycle closed in the last round is returned in O(length), otherwise
+    /// the predecessor map is searched for a cycle.
+    /// A cycle through a transit has no arc for it, use
+    /// \ref negativeCycleNodes() with \ref nodeTransits().
     lemon::Path<Digraph> negativeCycle() const {
-      typename Digraph::template NodeMap<int> state(*_gr, -1);
       lemon::Path<Digraph> cycle;
-      for (int i = 0; i < int(_process.size()); ++i) {
-        if (state[_process[i]] != -1) continue;
-        for (Node v = _process[i]; (*_pred)[v] != INVALID;
-             v = _gr->source((*_pred)[v])) {
-          if (state[v] == i) {
-            cycle.addFront((*_pred)[v]);
-            for (Node u = _gr->source((*_pred)[v]); u != v;
-                 u = _gr->source((*_pred)[u])) {
-              cycle.addFront((*_pred)[u]);
-            }
-            return cycle;
-          }
-          else if (state[v] >= 0) {
-            break;
-          }
-          state[v] = i;
-        }
+      Node v = findCycleNode();
+      if (v != INVALID) {
+        Node u = v;
+        do {
+          cycle.addFront((*_pred)[u]);
+          u = _gr->source((*_pred)[u]);
+        } while (u != v);
+      }
+      return cycle;
+    }
+
+    /// \brief Gives back the nodes of a negative cycle.
+    ///
+    /// Like \ref negativeCycle(), but lists the nodes of the cycle in its
+    /// direction, such that every node is entered from the one before it,
+    /// and the first one from the last one, over its predecessor arc or
+    /// its transit, see \ref predTransit(). Empty if there is no cycle.
+    std::vector<Node> negativeCycleNodes() const {
+      std::vector<Node> cycle;
+      Node v = findCycleNode();
+      if (v != INVALID) {
+        Node u = v;
+        do {
+          cycle.push_back(u);
+          u = predNode(u);
+        } while (u != v);
+        std::reverse(cycle.begin(), cycle.end());
       }
       return cycle;
     }
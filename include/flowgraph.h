@@ -9,8 +9,10 @@
 #include <tuple>
 #include <memory>
 #include <chrono>
+#include <functional>
 
 #include "residualgraph.h"
+#include "solvertelemetry.h"
 #include "log.h"
 
 namespace dpct
@@ -20,6 +22,10 @@ namespace dpct
  * A flow graph manages nodes and arcs with attached costs, capacities and flow. 
  * It can run min cost max flow tracking based on the bellman ford shortest path algorithm,
  * but alters the residual graph in each iteration such that it obeys all consistency constraints.
+ * Detections are either split into an in- and an out-node joined by an arc that carries their costs and capacity,
+ * or kept as a single node that carries them itself. The residual graph then crosses such a node along its transits,
+ * which the shortest path search relaxes without residual arcs. Both find the same flow when tracking starts from zero flow,
+ * from a given flow they can cancel negative cycles in another order.
  */
 class FlowGraph {
 public: // typedefs
@@ -28,7 +34,8 @@ public: // typedefs
     typedef Graph::Arc Arc;
 
     /**
-     * @brief Detections in the flow graph are represented as two nodes with a connected arc
+     * @brief Detections in the flow graph are represented as two nodes with a connected arc, 
+     *        or, if detections are not split, as a single node u = v with an INVALID arc
      */
     struct FullNode{
     	Node u;
@@ -41,12 +48,45 @@ public: // typedefs
     typedef Graph::ArcMap<int> CapacityMap;
     typedef std::vector<double> CostVector;
     typedef std::map<Node, CostVector> NodeCostMap;
-	typedef std::map<Arc, CostVector> ArcCostMap;
+    typedef std::vector<size_t> NodeTimestepMap; // indexed by node id
+    typedef std::pair<size_t, size_t> CostRange; // offset and number of costs in the cost pool
+	/// arcs with their flow delta, +-ResidualGraph::SharedStep for the steps of a division duplicate along its parent's arcs
 	typedef std::vector< std::pair<Arc, int> > Path;
 	typedef std::chrono::time_point<std::chrono::high_resolution_clock> TimePoint;
 
+	/// the state of a tracking run after an iteration that augmented flow
+	struct Progress
+	{
+		size_t iteration;
+		size_t numPaths;
+		double energy;
+		/// since tracking was started, including the setup of the residual graph
+		double elapsedSeconds;
+	};
+
+	/// called after every iteration that augmented flow, while the flow map holds this feasible solution.
+	/// Return false to stop tracking with the current solution
+	typedef std::function<bool(const Progress&)> ProgressCallback;
+
+	/// why the last tracking run stopped
+	enum class StopReason {Converged, MaxNumPaths, TimeBudget, EnergyGap, Callback};
+
 public: // API
-	FlowGraph();
+	/// @param splitDetections whether detections get an in- and an out-node, otherwise they are a single node with costs
+	FlowGraph(bool splitDetections=true);
+
+	/// whether detections are split into an in- and an out-node joined by an arc carrying their costs
+	bool splitsDetections() const { return splitDetections_; }
+
+	/**
+	 * @brief pre-size all node and arc containers for a model with the given number of hypotheses,
+	 *        to avoid reallocations while the graph is built. Counts are estimates, more can be added anyway.
+	 * @param numDetections number of detection hypotheses, each becomes two nodes (one if unsplit) with appearance and disappearance arcs
+	 * @param numLinks number of linking hypotheses
+	 * @param numDivisions number of detections that can divide, each gets a duplicate node with a division arc
+	 * @param numCostsPerArc expected length of the cost vectors, i.e. the number of states per variable
+	 */
+	void reserve(size_t numDetections, size_t numLinks, size_t numDivisions, size_t numCostsPerArc=2);
 
 	/// add a node to the graph at a certain timestep
 	FullNode addNode(const CostVector& costs, size_t timestep=0);
@@ -55,10 +95,49 @@ public: // API
 	Arc addArc(Node source, Node target, const CostVector& costs);
 	Arc addArc(FullNode source, FullNode target, const CostVector& costs);
 
-	/// create duplicated parent node for the given node with the given cost
-	/// ATTENTION: needs to be called AFTER adding all other arcs or it will copy too few
+	/// create duplicated parent node for the given node with the given cost.
+	/// The duplicate has no out arcs of its own, the residual graph lets it use each out arc of the parent once,
+	/// except the disappearance. This includes arcs added to the parent later on.
+	/// The flow of the duplicate along these arcs is kept in the shared flow map, apart from the parent's own flow.
 	Arc allowMitosis(FullNode parent, double divisionCost);
 
+	/**
+	 * @brief change the costs of an arc, also of an already tracked graph. 
+	 *        Use setNodeCosts to change the costs of a detection.
+	 *        Tracks through the arc and its end points are removed, to be found again by maxFlowMinCostRetracking.
+	 */
+	void setArcCosts(Arc a, const CostVector& costs);
+
+	/// change the costs of a detection, on its arc or, if unsplit, on its node. Like setArcCosts
+	void setNodeCosts(const FullNode& n, const CostVector& costs);
+
+	/**
+	 * @brief remove an arc. If it carries flow, every unit of flow running through it 
+	 *        is removed along its whole track first. Arcs of detections can only be removed with their node.
+	 */
+	void removeArc(Arc a);
+
+	/// remove a detection together with all its arcs, its division duplicate, and the tracks running through it
+	void removeNode(FullNode n);
+
+	/**
+	 * @brief remove all flow, such that the next maxFlowMinCostTracking starts from scratch,
+	 *        e.g. after all costs were changed. Not possible once nodes were frozen.
+	 */
+	void resetFlow();
+
+	/// @return the energy of the current flow, that is the initialStateEnergy plus the costs of all units of flow
+	double getFlowEnergy(double initialStateEnergy=0.0) const;
+
+	/**
+	 * @brief remove detections together with all their arcs, but keep the tracks that leave them:
+	 *        the flow they send into remaining detections enters from the source instead, 
+	 *        along frozen arcs whose costs are so low that they are always used. Their costs are not part 
+	 *        of the flow energy. Remaining detections must not send flow into the removed ones.
+	 * @return the energy of the flow along all removed arcs
+	 */
+	double freezeNodes(const std::vector<FullNode>& nodes);
+
 	/**
 	 * @brief run tracking by finding sugmenting shortest paths in the residual graph
 	 * @param initialStateEnergy the energy of the system if no objects are sent through (state 0)
@@ -66,19 +145,57 @@ public: // API
 	 * @param maxNumPaths if >0 this  limits the number of augmenting shortest paths that should be found
 	 * @param useOrderedNodeListInBF uses the time steps of the nodes to infer a topological ordering
 	 * @param partialBFUpdates update only the nodes which might have changed in the last iteration
+	 * @param useStaticResidualArcs allocate all residual arcs once and toggle them instead of erasing/adding them,
+	 *        the search runs on a timestep-sorted CSR view of the residual graph that skips the disabled arcs
+	 * @param useCsrBackend run the shortest path search on that CSR view (same as useStaticResidualArcs)
+	 * @param numThreads number of threads relaxing the nodes of each Bellman-Ford round, 0 = all cores
+	 * @param useDijkstra search every path with Dijkstra on reduced costs, using the distances of the previous
+	 *        search as node potentials. Bellman-Ford is only run if that fails. Ignores partialBFUpdates.
+	 * @param maxPathsPerIteration if >1, up to this many non-conflicting negative paths are taken from the
+	 *        shortest path tree of each search and augmented together before the next (partial) search.
+	 *        This can end in a different energy than the strictly sequential version (=1).
 	 */
 	double maxFlowMinCostTracking(
 		double initialStateEnergy=0.0, 
 		bool useBackArcs=true, 
 		size_t maxNumPaths=0,
 		bool useOrderedNodeListInBF=true,
-		bool partialBFUpdates=true);
+		bool partialBFUpdates=true,
+		bool useStaticResidualArcs=false,
+		bool useCsrBackend=false,
+		size_t numThreads=1,
+		bool useDijkstra=false,
+		size_t maxPathsPerIteration=1);
+
+	/**
+	 * @brief re-optimize the current flow after the graph was changed by setArcCosts, addNode, addArc, 
+	 *        allowMitosis, removeArc or removeNode, instead of tracking from scratch. 
+	 *        All tracks that touch a modification were removed, the others are kept. 
+	 *        If no flow changed, the residual graph and its last shortest path tree are kept, otherwise
+	 *        the residual graph is rebuilt from the current flow. The optimum is then repaired 
+	 *        by augmenting along negative paths and cancelling negative cycles.
+	 *        Takes the same parameters as maxFlowMinCostTracking, which only apply if the residual graph is rebuilt.
+	 * @return the energy of the repaired flow (not only the improvement)
+	 */
+	double maxFlowMinCostRetracking(
+		double initialStateEnergy=0.0, 
+		bool useBackArcs=true, 
+		size_t maxNumPaths=0,
+		bool useOrderedNodeListInBF=true,
+		bool partialBFUpdates=true,
+		bool useStaticResidualArcs=false,
+		bool useCsrBackend=false,
+		size_t numThreads=1,
+		bool useDijkstra=false,
+		size_t maxPathsPerIteration=1);
 
 	/**
 	 * @brief Instead of finding paths until the energy doesn't decrease any more, this method
 	 * first finds the maximum amount of possible flow, and then finds the min-cost way of sending
 	 * the maximum amount of flow though the graph. 
 	 * ATTENTION: assumes that the arc capacities are all equal to one!
+	 * Divisions are never used, division duplicates only get out arcs in the residual graph.
+	 * Needs split detections, a min cost flow knows no node costs.
 	 * @return cost of the flow, the flowMap is also filled.
 	 */
 	double maxFlow();
@@ -89,17 +206,58 @@ public: // API
 	Node getTarget(size_t index=0);
 	/// check whether this node is any of the target nodes
 	bool isTarget(Node t) const;
-	/// @return the sum of flow along out arcs of n
+	/// @return the sum of flow along out arcs of n, without the flow of its division duplicate
 	int sumOutFlow(Node n) const;
-	/// @return the sum of flow along in arcs of n
+	/// @return the sum of flow along in arcs of n, including the flow of division duplicates entering n
 	int sumInFlow(Node n) const;
 
+	/// @return the number of objects passing through a detection: the flow along its arc, or the in-flow of its node
+	int getNodeFlow(const FullNode& n) const { return n.a == lemon::INVALID ? sumInFlow(n.u) : flowMap_[n.a]; }
+
 	/// return the full flow map, which can be indexed by arc
 	FlowMap& getFlowMap() { return flowMap_; }
 
+	/// the flow of the division duplicate of each arc's source along that arc, indexed by the parent's arc
+	const FlowMap& getSharedFlowMap() const { return sharedFlowMap_; }
+
+	/// the number of objects moving along an arc: its own flow and that of the division duplicate sharing it
+	int getLinkFlow(const Arc& a) const { return flowMap_[a] + sharedFlowMap_[a]; }
+
 	/// get the graph (used in test)
 	Graph& getGraph() { return baseGraph_; }
 
+	/// collect the counters and timers of every iteration of the following tracking runs, nullptr to stop
+	void setTelemetry(SolverTelemetry* telemetry) { telemetry_ = telemetry; }
+
+	/// add the node and arc counts and the containers of this flow graph and, once tracking built it, of its residual graph
+	void collectMemoryStatistics(MemoryStatistics& stats) const;
+
+	/**
+	 * @brief let the following tracking runs stop early with the feasible flow found so far
+	 * @param timeBudgetSeconds stop after the first iteration that ends later than this many seconds
+	 *        after tracking was started, 0 = no limit. A running shortest path search is not interrupted.
+	 * @param energyGapTolerance stop as soon as the next path would decrease the energy by less than this,
+	 *        0 = only stop when no path decreases the energy
+	 */
+	void setAnytimeLimits(double timeBudgetSeconds, double energyGapTolerance);
+
+	/// call this function after every iteration of the following tracking runs that augmented flow, empty to stop
+	void setProgressCallback(const ProgressCallback& callback) { progressCallback_ = callback; }
+
+	/// @return why the last tracking run stopped
+	StopReason getStopReason() const { return stopReason_; }
+
+	/// after negative cycles, repair only the shortest path subtrees behind the cycle instead of
+	/// restarting the search from scratch, in the following tracking runs with partial BF updates
+	void setLocalCycleRepair(bool localCycleRepair) { localCycleRepair_ = localCycleRepair; }
+
+	/**
+	 * @brief with maxPathsPerIteration > 1, only augment further paths of a shortest path tree whose cost is
+	 *        at least this fraction of the shortest path's cost. Much cheaper paths break the optimality of the
+	 *        tree and have to be undone by later paths. Default 0.95, 0 takes every negative path.
+	 */
+	void setPathBatchCostRatio(double ratio) { pathBatchCostRatio_ = ratio; }
+
 	/// augment flow along a path or cycle, adding one unit of flow forward, and subtracting one backwards
 	void augmentUnitFlow(const Path& p);
 
@@ -108,14 +266,13 @@ public: // API
 	/// ATTENTION: assumes flow has been augmented for this path already!
 	void updateEnabledArcs(const Path& p);
 
-	/**
-	 * @brief when specifying a flow map from the outside, call this method to make sure flows
-	 *        of out arcs of duplicated division nodes are in sync with those of the parent
-	 */
-	void synchronizeDivisionDuplicateArcFlows();
-
 	/// create residual graph and set up all arc flows etc
-	void initializeResidualGraph(bool useBackArcs, bool useOrderedNodeListInBF);
+	void initializeResidualGraph(
+		bool useBackArcs, 
+		bool useOrderedNodeListInBF, 
+		bool useStaticResidualArcs=false,
+		bool useCsrBackend=false,
+		bool useDijkstra=false);
 
 private:
 	/// updates the arc availability in residual graph for this arc
@@ -123,17 +280,99 @@ private:
 	/// ATTENTION: assumes flow has been augmented for this path already!
 	void updateEnabledArc(const Arc& a);
 
+	/// like updateEnabledArc, after the flow of the division duplicate along its parent's arc changed
+	void updateEnabledSharedArc(const Arc& a);
+
 	/// enable an arc according to our division / appearance / disappearance constraints
 	void enableArc(const Arc& a, bool state);
 
 	/// update capacity and cost of residual graph arc
 	void updateArc(const Arc& a);
 
+	/// update capacity and cost of both transits of an unsplit detection in the residual graph
+	void updateNode(const Node& n);
+
 	double getArcCost(const Arc& a, int flow);
+	double getNodeCost(const Node& n, int flow) const;
+
+	/// number of entries in the cost vector of an arc = its maximal capacity
+	size_t numArcCosts(const Arc& a) const { return arcCostRanges_[baseGraph_.id(a)].second; }
+
+	/// number of entries in the cost vector of an unsplit detection = its maximal capacity, 0 for all other nodes
+	size_t numNodeCosts(const Node& n) const 
+	{ 
+		size_t index = baseGraph_.id(n);
+		return index < nodeCostRanges_.size() ? nodeCostRanges_[index].second : 0; 
+	}
+
+	/// whether the node is an unsplit detection that carries costs itself
+	bool isDetectionNode(const Node& n) const { return numNodeCosts(n) > 0; }
+
+	/// whether the arc connects the in- and out-node of a detection
+	bool isIntermediateArc(const Arc& a) const 
+	{ 
+		return (size_t)baseGraph_.id(a) < intermediateArcs_.size() && intermediateArcs_[baseGraph_.id(a)]; 
+	}
+
+	/// whether the arc carries the fixed inflow of a track that started at frozen nodes
+	bool isFrozenArc(const Arc& a) const 
+	{ 
+		return (size_t)baseGraph_.id(a) < frozenArcs_.size() && frozenArcs_[baseGraph_.id(a)]; 
+	}
+
+	/// add an arc and its costs, without any of the bookkeeping of addArc
+	Arc createArc(const Node& source, const Node& target, const CostVector& costs);
+
+	/// the costs of the current flow along one arc
+	double getArcFlowEnergy(const Arc& a) const;
+
+	/// the costs of the current flow through an unsplit detection
+	double getNodeFlowEnergy(const Node& n) const;
+
+	/// store costs in the pool, reusing the range if the length stays the same, otherwise appending
+	void assignCosts(CostRange& range, const CostVector& costs);
+
+	/// drop the costs of removed arcs from the pool once they make up more than half of it
+	void compactArcCostPool();
+
+	/// erase a node of the base graph and drop its costs, node ids are reused
+	void eraseNode(const Node& n);
+
+	/// set the timestep of a node, growing the timestep map as needed
+	void setNodeTimestep(const Node& n, size_t timestep);
+
+	/// the residual graph cannot follow structural changes, it is rebuilt from the current flow when tracking next time
+	void invalidateResidualGraph() { residualGraph_.reset(); }
+
+	/// remove flow along complete tracks until there is no more flow along the given arc
+	/// @return whether any flow was removed
+	bool removeFlowThrough(const Arc& a);
+
+	/// remove the tracks running through the detection of a node, such that they can be rerouted freely.
+	/// For an unsplit detection these are all tracks entering it.
+	/// Otherwise the appearance/disappearance constraints might prevent them from using a modified arc.
+	bool releaseTracksAt(const Node& n);
+
+	/// per node id the key of paths through it, paths touching the same key interact through flow coupling
+	/// or arc toggling: a node and its duplicate, as well as the in- and out-node of a detection share one key
+	std::vector<int> conflictKeys() const;
 	
 	void printPath(const Path& p);
 	void printAllFlows();
 
+	/// @return true if the anytime limits or the progress callback end tracking after the given iteration
+	bool stopAnytime(size_t iteration, size_t numPaths, double energy, const TimePoint& startTime);
+
+	/// add the telemetry of one tracking iteration, if telemetry is collected
+	void recordIteration(
+		size_t iteration,
+		const TimePoint& startTime,
+		const TimePoint& searchEndTime,
+		const ResidualGraph::ShortestPathResult& result,
+		size_t numAugmentedPaths,
+		size_t numToggledArcsBefore,
+		double energy);
+
 	// define functions for enabling / disabling arcs (could be done easier by deriving the proper capacities)
 	void toggleOutArcs(const Node& n, bool state);
 	void toggleInArcs(const Node& n, bool state);
@@ -161,21 +400,54 @@ private:
 	/// current arc flow
 	FlowMap flowMap_;
 
+	/// the flow of division duplicates along the arcs of their parents, 0 or 1. Together with flowMap_ it is conserved
+	/// at every node, the duplicate's in-flow along its division arc leaves along the parent's arcs
+	FlowMap sharedFlowMap_;
+
 	/// capacities of arcs
 	CapacityMap capacityMap_;
 
-	/// store cost of arcs and nodes
-	ArcCostMap arcCosts_;
+	/// the cost vectors of all arcs and unsplit detections stored back to back in one pool, 
+	/// arcCostRanges_ holds offset and length into the pool indexed by arc id, nodeCostRanges_ indexed by node id
+	std::vector<double> arcCostPool_;
+	std::vector<CostRange> arcCostRanges_;
+	std::vector<CostRange> nodeCostRanges_;
+
+	/// whether detections are split into an in- and an out-node
+	bool splitDetections_;
 
 	/// mapping between parent and duplicated parent nodes
 	std::map<Node, Node> parentToDuplicateMap_;
 	std::map<Node, Node> duplicateToParentMap_;
 
-	/// store a set of the arcs which are actually just used to emplace the node costs
-	std::set<Arc> intermediateArcs_;
+	/// flag per arc id whether the arc is actually just used to emplace the node costs
+	std::vector<bool> intermediateArcs_;
+
+	/// flag per arc id whether the arc carries the fixed inflow of tracks leaving frozen nodes
+	std::vector<bool> frozenArcs_;
+
+	/// the (negative) cost of every unit of frozen inflow
+	double frozenArcCost_;
 
-	/// store the (internal!) timestep of each node (including the duplicates)
-	std::map<Node, size_t> nodeTimestepMap_;
+	/// store the (internal!) timestep of each node (including the duplicates), indexed by node id
+	NodeTimestepMap nodeTimestepMap_;
+
+	/// receives the telemetry of all tracking iterations, if set
+	SolverTelemetry* telemetry_;
+
+	/// anytime limits of tracking runs, 0 = disabled
+	double timeBudgetSeconds_;
+	double energyGapTolerance_;
+	/// minimal cost of further batched paths relative to the shortest path
+	double pathBatchCostRatio_;
+	ProgressCallback progressCallback_;
+	StopReason stopReason_;
+
+	/// whether the residual graph repairs the search locally after negative cycles
+	bool localCycleRepair_;
+
+	/// whether the graph got flow or a residual graph, only then modifications have tracks to release
+	bool tracked_;
 };
 
 // define functions for enabling / disabling
@@ -190,7 +462,11 @@ inline void FlowGraph::toggleInArcs(const Node& n, bool state)
 {
 	DEBUG_MSG("Setting in arcs of " << baseGraph_.id(n) << " to " << (state?"true":"false"));
 	for(Graph::InArcIt ia(baseGraph_, n); ia != lemon::INVALID; ++ia)
+	{
 		enableArc(ia, state);
+		// the division duplicate of the arc's source enters n through the arc as well
+		residualGraph_->enableSharedArc(ia, state);
+	}
 }
 
 inline void FlowGraph::restrictOutArcCapacity(const Node& n, bool state)
@@ -198,7 +474,7 @@ inline void FlowGraph::restrictOutArcCapacity(const Node& n, bool state)
 	DEBUG_MSG("Restricting Out arc capacities of " << baseGraph_.id(n) << ": " << (state?"true":"false"));
 	for(Graph::OutArcIt oa(baseGraph_, n); oa != lemon::INVALID; ++oa)
 	{
-		capacityMap_[oa] = (state ? 1 : arcCosts_[oa].size());
+		capacityMap_[oa] = (state ? 1 : numArcCosts(oa));
 		updateArc(oa);
 	}
 }
@@ -234,7 +510,10 @@ inline void FlowGraph::toggleInArcsBut(const Node& n, const Node& exception, boo
 	for(Graph::InArcIt ia(baseGraph_, n); ia != lemon::INVALID; ++ia)
 	{
 		if(baseGraph_.source(ia) != exception)
+		{
 			enableArc(ia, state);
+			residualGraph_->enableSharedArc(ia, state);
+		}
 	}
 }
 
@@ -301,7 +580,7 @@ inline int FlowGraph::sumInFlow(Node n) const
 {
 	int flow = 0;
 	for(Graph::InArcIt ia(baseGraph_, n); ia != lemon::INVALID; ++ia)
-		flow += flowMap_[ia];
+		flow += getLinkFlow(ia);
 	return flow;
 }
 
@@ -310,12 +589,20 @@ inline FlowGraph::Node FlowGraph::getTarget(size_t index)
 	while(index >= targets_.size())
 	{
 		targets_.push_back(baseGraph_.addNode());
-		nodeTimestepMap_[targets_.back()] = nodeTimestepMap_[targets_.front()];
+		setNodeTimestep(targets_.back(), nodeTimestepMap_[baseGraph_.id(targets_.front())]);
 	}
 
  	return targets_[index];
 }
 
+inline void FlowGraph::setNodeTimestep(const Node& n, size_t timestep)
+{
+	size_t index = baseGraph_.id(n);
+	if(index >= nodeTimestepMap_.size())
+		nodeTimestepMap_.resize(index + 1, 0);
+	nodeTimestepMap_[index] = timestep;
+}
+
 inline bool FlowGraph::isTarget(Node t) const
 {
 	for(auto n : targets_)
@@ -328,11 +615,21 @@ inline void FlowGraph::enableArc(const Arc& a, bool state)
 	residualGraph_->enableArc(a, state);
 }
 
+inline double FlowGraph::getNodeCost(const Node& n, int flow) const
+{
+	const CostRange& range = nodeCostRanges_[baseGraph_.id(n)];
+	if(flow >= 0 && (size_t)flow < range.second)
+		return arcCostPool_[range.first + flow];
+	else
+		return std::numeric_limits<double>::infinity();
+}
+
 inline double FlowGraph::getArcCost(const Arc& a, int flow)
 {
-	if(flow >= 0 && (size_t)flow < arcCosts_[a].size())
+	const CostRange& range = arcCostRanges_[baseGraph_.id(a)];
+	if(flow >= 0 && (size_t)flow < range.second)
 	{
-		return arcCosts_[a][flow];
+		return arcCostPool_[range.first + flow];
 	}
 	else
 		return std::numeric_limits<double>::infinity();
@@ -344,8 +641,8 @@ inline double FlowGraph::getArcCost(const Arc& a, int flow)
  * @param stream output stream
  * @param feats the vector of stuff
  */
-template<class T>
-std::ostream& operator<<(std::ostream& stream, const std::vector<T>& feats)
+template<class T, class A>
+std::ostream& operator<<(std::ostream& stream, const std::vector<T, A>& feats)
 {
 	stream << "(";
 	for(auto f_it = feats.begin(); f_it != feats.end(); ++f_it)
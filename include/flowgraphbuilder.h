@@ -1,6 +1,8 @@
 #ifndef FLOW_GRAPH_BUILDER
 #define FLOW_GRAPH_BUILDER
 
+#include <algorithm>
+
 #include "graphbuilder.h"
 #include "flowgraph.h"
 
@@ -18,6 +20,15 @@ public:
 		graph_(graph)
 	{}
 
+	void reserve(size_t numDetections, size_t numLinks, size_t numDivisions)
+	{
+		GraphBuilder::reserve(numDetections, numLinks, numDivisions);
+		graph_->reserve(numDetections, numLinks, numDivisions);
+		idToFlowGraphNodeMap_.reserve(numDetections);
+		idToFlowGraphDivisionArcMap_.reserve(numDivisions);
+		idTupleToFlowGraphArcMap_.reserve(numLinks);
+	}
+
 	void addNode(
 		size_t id,
 		const CostDeltaVector& detectionCosts,
@@ -51,11 +62,9 @@ public:
 	NodeValueMap getNodeValues()
 	{
 		NodeValueMap nodeValueMap;
-		const FlowGraph::FlowMap& flowMap = graph_->getFlowMap();
-
 		for(auto iter : idToFlowGraphNodeMap_)
 		{
-			nodeValueMap[iter.first] = flowMap[iter.second.a];
+			nodeValueMap[iter.first] = graph_->getNodeFlow(iter.second);
 		}
 
 		return nodeValueMap;
@@ -64,11 +73,9 @@ public:
 	ArcValueMap getArcValues()
 	{
 		ArcValueMap arcValueMap;
-		const FlowGraph::FlowMap& flowMap = graph_->getFlowMap();
-
 		for(auto iter : idTupleToFlowGraphArcMap_)
 		{
-			arcValueMap[iter.first] = flowMap[iter.second];
+			arcValueMap[iter.first] = graph_->getLinkFlow(iter.second);
 		}
 
 		return arcValueMap;
@@ -87,6 +94,52 @@ public:
 		return divisionValueMap;
 	}
 
+	/// the values of the used hypotheses are read straight from the flow graph, only those are copied for sorting
+	void visitNodeValues(const NodeValueVisitor& visitor)
+	{
+		std::vector<std::pair<size_t, size_t> > values;
+		for(const auto& iter : idToFlowGraphNodeMap_)
+		{
+			int flow = graph_->getNodeFlow(iter.second);
+			if(flow > 0)
+				values.push_back(std::make_pair(iter.first, size_t(flow)));
+		}
+
+		std::sort(values.begin(), values.end());
+		for(const auto& v : values)
+			visitor(v.first, v.second);
+	}
+
+	void visitArcValues(const ArcValueVisitor& visitor)
+	{
+		std::vector<std::pair<std::pair<size_t, size_t>, size_t> > values;
+		for(const auto& iter : idTupleToFlowGraphArcMap_)
+		{
+			int flow = graph_->getLinkFlow(iter.second);
+			if(flow > 0)
+				values.push_back(std::make_pair(iter.first, size_t(flow)));
+		}
+
+		std::sort(values.begin(), values.end());
+		for(const auto& v : values)
+			visitor(v.first.first, v.first.second, v.second);
+	}
+
+	void visitDivisions(const DivisionVisitor& visitor)
+	{
+		const FlowGraph::FlowMap& flowMap = graph_->getFlowMap();
+		std::vector<size_t> ids;
+		for(const auto& iter : idToFlowGraphDivisionArcMap_)
+		{
+			if(flowMap[iter.second] == 1)
+				ids.push_back(iter.first);
+		}
+
+		std::sort(ids.begin(), ids.end());
+		for(size_t id : ids)
+			visitor(id);
+	}
+
 	FlowGraph::Arc getAppearanceArc(size_t nodeId)
 	{
 		for(FlowGraph::Graph::InArcIt ia(graph_->getGraph(), idToFlowGraphNodeMap_[nodeId].u); ia != lemon::INVALID; ++ia)
@@ -111,6 +164,7 @@ public:
 		throw std::runtime_error("could not find disappearance arc");
 	}
 
+	/// the arc carrying the costs of a detection, INVALID if the graph does not split detections
 	FlowGraph::Arc getNodeArc(size_t nodeId)
 	{
 		return idToFlowGraphNodeMap_[nodeId].a;
@@ -121,9 +175,11 @@ public:
 		return idTupleToFlowGraphArcMap_[ids];
 	}
 
+	/// the division arc of the parent and its arc to the child, which the division duplicate uses as shared arc,
+	/// see ResidualGraph::SharedStep
 	std::pair<FlowGraph::Arc, FlowGraph::Arc> getDivisionArcs(size_t parent, size_t child)
 	{
-		for(FlowGraph::Graph::OutArcIt oa(graph_->getGraph(), graph_->getGraph().target(idToFlowGraphDivisionArcMap_[parent])); 
+		for(FlowGraph::Graph::OutArcIt oa(graph_->getGraph(), idToFlowGraphNodeMap_[parent].v); 
 			oa != lemon::INVALID; ++oa)
 		{
 			if(graph_->getGraph().target(oa) == idToFlowGraphNodeMap_[child].u)
@@ -134,18 +190,18 @@ public:
 		throw std::runtime_error("could not find division arc");
 	}
 
-private:
+protected:
 	/// pointer to original flow graph
 	FlowGraph* graph_;
 
 	/// mapping from id to flowgraph nodes
-	std::map<size_t, FlowGraph::FullNode> idToFlowGraphNodeMap_;
+	std::unordered_map<size_t, FlowGraph::FullNode> idToFlowGraphNodeMap_;
 
 	/// mapping from id to flowgraph division arc
-	std::map<size_t, FlowGraph::Arc> idToFlowGraphDivisionArcMap_;
+	std::unordered_map<size_t, FlowGraph::Arc> idToFlowGraphDivisionArcMap_;
 
 	/// mapping from tuple (id,id) to flowgraph arc
-	std::map<std::pair<size_t, size_t>, FlowGraph::Arc> idTupleToFlowGraphArcMap_;
+	std::unordered_map<std::pair<size_t, size_t>, FlowGraph::Arc, IdPairHash> idTupleToFlowGraphArcMap_;
 };
 
 }
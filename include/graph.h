@@ -4,10 +4,15 @@
 #include <memory>
 #include <functional>
 #include <map>
+#include <algorithm>
+#include <assert.h>
 
 #include "node.h"
 #include "arc.h"
 #include "userdata.h"
+#include "arena.h"
+#include "memorystatistics.h"
+#include "workerpool.h"
 
 namespace dpct
 {
@@ -30,11 +35,15 @@ public:
 	public:
 		Configuration(bool enableAppearance, 
 					bool enableDisappearance, 
-                    bool enableDivision);
+                    bool enableDivision,
+                    bool useArenaStorage = false);
 
  		bool withAppearance;
 		bool withDisappearance;
 		bool withDivision;
+		// store nodes contiguously per timestep, arcs in per-timestep slabs
+		// and all score tables in one pool, instead of one heap block each
+		bool withArenaStorage;
 	};
 
 public:
@@ -69,16 +78,30 @@ public:
                         Node* child,
                         double divisionScoreDelta);
 
+	// announce the expected graph size such that containers and pools are allocated at once
+	void reserve(size_t numArcs, size_t numScoreDeltas = 0);
+
 	// get number of arcs and user defined nodes
 	size_t getNumArcs() const { return arcs_.size(); }
 	size_t getNumNodes() const { return numNodes_; }
 	size_t getNumTimesteps() const { return nodesPerTimestep_.size(); }
+	// bound of all node indices, which are never reused, such that flat arrays can be indexed by Node::getIndex()
+	size_t getNumNodeIndices() const { return numNodeIndices_; }
 	const Configuration getConfig() const { return config_; }
 
+	// add the node and arc counts and the bytes of all nodes, arcs and containers of this graph
+	void collectMemoryStatistics(MemoryStatistics& stats) const;
+
 	// access for tracking algorithms
     Node& getSourceNode() { return sourceNode_; }
     Node& getSinkNode() { return sinkNode_; }
 	void visitNodesInTimestep(size_t timestep, VisitorFunction func);
+	// visit the nodes of a timestep in consecutive chunks on the threads of the pool, if there are at least
+	// minNodesPerThread nodes per thread. The visitor must only write to the node and its out arcs.
+	void visitNodesInTimestep(size_t timestep, VisitorFunction func, WorkerPool* pool, size_t minNodesPerThread = 256);
+	// same as visitNodesInTimestep, but the visitor is passed by type such that it can be inlined
+	template<class Visitor>
+	void forEachNodeInTimestep(size_t timestep, Visitor&& func, WorkerPool* pool = nullptr, size_t minNodesPerThread = 256);
     void visitSpecialNodes(VisitorFunction func);
     bool isSpecialNode(const Node *n) const;
 
@@ -91,14 +114,33 @@ public:
 protected:
     //--------------------------------------
     // methods
+    // with arena storage, removed nodes and arcs are only destroyed together with the graph
     bool removeArc(Arc *a); // remove arc and unregister it from source and target nodes
     bool removeNode(Node *n); // remove node that has no in and out arcs! (assertion in DEBUG mode)
 
+    // create nodes and arcs either on the heap or in the arenas, depending on the configuration.
+    // Arcs are stored in the slab of the timestep of their target, or their source if it is the sink.
+    NodePtr createNode(size_t timestep, const std::vector<double>& cellCountScoreDelta, UserDataPtr data);
+    ArcPtr createArc(Node* source,
+                     Node* target,
+                     Arc::Type type,
+                     const std::vector<double>& scoreDeltas,
+                     Node* dependsOnCellInNode = nullptr,
+                     UserDataPtr data = UserDataPtr());
+
 protected:
     //--------------------------------------
     // members
 	Configuration config_;
 
+	// arena storage, must outlive all nodes and arcs (thus declared first).
+	// Node and arc pointers handed out in arena mode share the control block of arenaOwner_,
+	// and the objects are only destroyed together with the graph.
+	ScorePool scorePool_;
+	std::vector<std::unique_ptr<Arena<Node>>> nodeArenas_;
+	std::vector<std::unique_ptr<Arena<Arc>>> arcArenas_;
+	std::shared_ptr<void> arenaOwner_;
+
 	Node sourceNode_;
 	Node sinkNode_;
 
@@ -107,11 +149,34 @@ protected:
 	NodeVectorVector nodesPerTimestep_;
 	ArcVector arcs_;
 	size_t numNodes_;
+	size_t numNodeIndices_;
     
 public:
     friend class LemonGraph;
 };
 
+template<class Visitor>
+inline void Graph::forEachNodeInTimestep(size_t timestep, Visitor&& func, WorkerPool* pool, size_t minNodesPerThread)
+{
+	assert(timestep < nodesPerTimestep_.size());
+
+	NodeVector& nodes = nodesPerTimestep_[timestep];
+	size_t numThreads = pool != nullptr ? pool->getNumThreads() : 1;
+	if(numThreads <= 1 || nodes.size() < numThreads * std::max(minNodesPerThread, size_t(1)))
+	{
+		for(NodeVector::iterator it = nodes.begin(); it != nodes.end(); ++it)
+			func(it->get());
+		return;
+	}
+
+	size_t chunkSize = (nodes.size() + numThreads - 1) / numThreads;
+	pool->run((nodes.size() + chunkSize - 1) / chunkSize, [&nodes, &func, chunkSize](size_t chunk){
+		size_t end = std::min((chunk + 1) * chunkSize, nodes.size());
+		for(size_t i = chunk * chunkSize; i < end; ++i)
+			func(nodes[i].get());
+	});
+}
+
 } // namespace dpct
 
 #endif // DPCT_GRAPH_H
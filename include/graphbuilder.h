@@ -1,8 +1,11 @@
 #ifndef GRAPH_BUILDER
 #define GRAPH_BUILDER
 
+#include <cstddef>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <functional>
 
 namespace dpct
 {
@@ -14,28 +17,68 @@ class GraphBuilder {
 public:
 	typedef double ValueType;
 	typedef std::vector<ValueType> CostDeltaVector;
-	typedef std::map<size_t, size_t> NodeValueMap;
-	typedef std::map<size_t, bool> DivisionValueMap;
-	typedef std::map<size_t, size_t> AppearanceValueMap;
-	typedef std::map<size_t, size_t> DisappearanceValueMap;
-	typedef std::map<std::pair<size_t, size_t>, size_t> ArcValueMap;
+	typedef std::map<std::size_t, std::size_t> NodeValueMap;
+	typedef std::map<std::size_t, bool> DivisionValueMap;
+	typedef std::map<std::size_t, std::size_t> AppearanceValueMap;
+	typedef std::map<std::size_t, std::size_t> DisappearanceValueMap;
+	typedef std::map<std::pair<std::size_t, std::size_t>, std::size_t> ArcValueMap;
+	/// a feature value and the index of the weight it is multiplied with
+	typedef std::pair<ValueType, std::size_t> CostTerm;
+	/// receive (node id, value), (src node id, target node id, value) and dividing node ids of a solution
+	typedef std::function<void(std::size_t, std::size_t)> NodeValueVisitor;
+	typedef std::function<void(std::size_t, std::size_t, std::size_t)> ArcValueVisitor;
+	typedef std::function<void(std::size_t)> DivisionVisitor;
 
+	/// hash of a (source id, target id) pair, to index links in unordered maps
+	struct IdPairHash
+	{
+		std::size_t operator()(const std::pair<std::size_t, std::size_t>& ids) const
+		{
+			return std::hash<std::size_t>()(ids.first) * 31 + std::hash<std::size_t>()(ids.second);
+		}
+	};
+
+	virtual ~GraphBuilder() {}
+
+	/**
+	 * @brief announce how many hypotheses will be added, such that all containers can be allocated at once.
+	 * The counts are only a hint, adding more elements is still possible.
+	 */
+	virtual void reserve(std::size_t numDetections, std::size_t numLinks, std::size_t numDivisions)
+	{
+		idToTimestepsMap_.reserve(numDetections);
+	}
+
+
+	/// whether the builder wants to receive the cost terms of all hypotheses through addCostTerms
+	virtual bool keepsCostTerms() const { return false; }
+
+	/**
+	 * @brief receive the terms defining the cost of every state of the hypothesis that is added next,
+	 *        such that the costs can be recomputed for other weights. Cost vectors arrive in the order 
+	 *        they are computed: detection, appearance (if any) and disappearance (if any) before addNode, 
+	 *        the link before addArc and the division before allowMitosis.
+	 * @param termPerState the cost of state i is termPerState[i].first * weights[termPerState[i].second],
+	 *        a state without features refers to the weight index numWeights, which stands for a zero weight
+	 * @param numWeights the number of weights of the model
+	 */
+	virtual void addCostTerms(const std::vector<CostTerm>& termPerState, std::size_t numWeights) {}
 
 	/**
 	 * @brief add a node which can be indexed by its id. Costs 
 	 */
 	virtual void addNode(
-		size_t id,
+		std::size_t id,
 		const CostDeltaVector& detectionCosts,
 		const CostDeltaVector& detectionCostDeltas, 
 		const CostDeltaVector& appearanceCostDeltas, 
 		const CostDeltaVector& disappearanceCostDeltas,
-		size_t targetIdx) = 0;
+		std::size_t targetIdx) = 0;
 
 	/**
 	 * @brief Specify in which timestep a node lies. Must be called before adding the respective node
 	 */
-	void setNodeTimesteps(size_t id, std::pair<size_t, size_t> timesteps)
+	void setNodeTimesteps(std::size_t id, std::pair<std::size_t, std::size_t> timesteps)
 	{
 		idToTimestepsMap_[id] = timesteps;
 	}
@@ -43,12 +86,12 @@ public:
 	/**
 	 * @brief add a move arc between the given nodes with the specified cost deltas
 	 */
-	virtual void addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas) = 0;
+	virtual void addArc(std::size_t srcId, std::size_t destId, const CostDeltaVector& costDeltas) = 0;
 
 	/**
 	 * @brief allow a node to divide with the specified cost change
 	 */
-	virtual void allowMitosis(size_t id, ValueType divisionCostDelta) = 0;
+	virtual void allowMitosis(std::size_t id, ValueType divisionCostDelta) = 0;
 
 	/**
 	 * @brief return a mapping from node id to value in solution
@@ -71,9 +114,36 @@ public:
 	 */
 	virtual DivisionValueMap getDivisionValues() = 0;
 
+	/**
+	 * @brief call the visitor for every node with a nonzero value in the solution, by increasing id
+	 * @details the default goes through getNodeValues(), builders override it to skip building the full map
+	 */
+	virtual void visitNodeValues(const NodeValueVisitor& visitor)
+	{
+		for(const auto& iter : getNodeValues())
+			if(iter.second > 0)
+				visitor(iter.first, iter.second);
+	}
+
+	/// call the visitor for every link with a nonzero value in the solution, by increasing (src id, target id)
+	virtual void visitArcValues(const ArcValueVisitor& visitor)
+	{
+		for(const auto& iter : getArcValues())
+			if(iter.second > 0)
+				visitor(iter.first.first, iter.first.second, iter.second);
+	}
+
+	/// call the visitor for every dividing node of the solution, by increasing id
+	virtual void visitDivisions(const DivisionVisitor& visitor)
+	{
+		for(const auto& iter : getDivisionValues())
+			if(iter.second)
+				visitor(iter.first);
+	}
+
 protected:
 	/// mapping from id to timesteps
-	std::map<size_t, std::pair<size_t, size_t> > idToTimestepsMap_;
+	std::unordered_map<std::size_t, std::pair<std::size_t, std::size_t> > idToTimestepsMap_;
 };
 
 } // end namespace dpct
@@ -22,6 +22,14 @@ public:
 	typedef std::vector<ValueType> FeatureVector;
 	typedef std::vector<FeatureVector> StateFeatureVector;
 
+	/// numbers of hypotheses of a model, known before the graph is built
+	struct HypothesisCounts
+	{
+		size_t numSegmentations = 0;
+		size_t numLinks = 0;
+		size_t numDivisions = 0;
+	};
+
 protected:
 	/// Enumerate the strings for attributes used in the Json files and python dicts
 	enum class JsonTypes {Segmentations, 
@@ -61,8 +69,15 @@ public:
 	 */
 	const double getInitialStateEnergy() const { return initialStateEnergy_; }
 
+	/**
+	 * @return the number of optimizer threads requested in the model settings, 0 = all cores, defaults to 1
+	 */
+	size_t getNumThreads() const { return numThreads_; }
+
 protected:
 	GraphReader(GraphBuilder* graphBuilder):
+		initialStateEnergy_(0.0),
+		numThreads_(1),
 		graphBuilder_(graphBuilder)
 	{}
 
@@ -78,6 +93,12 @@ protected:
 	/// store the model's energy of the initial solution = all zeros
 	double initialStateEnergy_;
 
+	/// number of optimizer threads from the model settings
+	size_t numThreads_;
+
+	/// reused buffer of the cost terms handed to builders that keep them
+	std::vector<std::pair<ValueType, size_t> > costTerms_;
+
 	/// the graph builder instance which provides the graph specific node/arc 
 	/// creation methods as well as result parsing
 	GraphBuilder* graphBuilder_;
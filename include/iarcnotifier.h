@@ -15,7 +15,12 @@ class IArcNotifier
 public:
 	typedef std::function<void(Arc*)> NotificationFunction;
 
+	typedef std::function<bool(const Arc*)> ArcPredicate;
+
 	void registerObserverArc(Arc* arc);
+	bool unregisterObserverArc(Arc* arc);
+	// unregister all observers matching the predicate in one pass
+	void unregisterObserverArcsIf(const ArcPredicate& pred);
 
 	void visitObserverArcs(NotificationFunction notificationFunc);
 
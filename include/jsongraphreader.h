@@ -2,11 +2,13 @@
 #define JSON_GRAPH_READER 
 
 #include <json/json.h>
+#include <functional>
 
 #include "graphreader.h"
 #include "trackingalgorithm.h"
 #include "log.h"
 #include "graphbuilder.h"
+#include "jsonstreamparser.h"
 
 namespace dpct
 {
@@ -27,9 +29,17 @@ public:
 	 */
 	JsonGraphReader(const std::string& modelFilename, const std::string& weightsFilename, GraphBuilder* graphBuilder);
 
+	/**
+	 * @brief Construct a json graph reader that combines the model file with weights that were already read,
+	 * e.g. by readWeightsFromJson() once for many models
+	 */
+	JsonGraphReader(const std::string& modelFilename, const FeatureVector& weights, GraphBuilder* graphBuilder);
+
 	/**
 	 * @brief Add nodes and arcs to the graph builder according to the model file. 
-	 * Costs are computed from features times weights
+	 * Costs are computed from features times weights.
+	 * The file is streamed instead of loaded as a whole, so hypotheses are added while they are parsed.
+	 * Binary models written by convertToBinary() are detected and memory mapped instead.
 	 */
 	void createGraphFromJson();
 
@@ -40,21 +50,123 @@ public:
 	 */
 	void saveResultJson(const std::string& filename);
 
+	/**
+	 * @brief Save the result in the compact, columnar binary format described by BinaryResultHeader,
+	 * which only holds the detections, links and divisions that are used
+	 *
+	 * @param filename filename where the results will be stored
+	 */
+	void saveResultBinary(const std::string& filename);
+
 	/**
 	 * @return the energy of the initial state of flow based solving: no objects tracked at all
 	 */
 	const double getInitialStateEnergy() const { return initialStateEnergy_; }
 
+	/**
+	 * @brief Store the model in the binary format, which createGraphFromJson() loads without parsing.
+	 * The features are kept, so the binary model can be combined with any weights.
+	 *
+	 * @param filename filename of the binary model
+	 */
+	void convertToBinary(const std::string& filename);
+
+	/**
+	 * @brief Count the hypotheses of the model file without building a graph or reading weights.
+	 * JSON models are scanned once, binary models only need their header.
+	 */
+	HypothesisCounts countHypotheses();
+
+	/// read the weight vector stored in a JSON file
+	static FeatureVector readWeightsFromJson(const std::string& filename);
+
 private:
-	StateFeatureVector extractFeatures(const Json::Value& entry, JsonTypes type);
-	FeatureVector readWeightsFromJson(const std::string& filename);
-	size_t getNumWeights(const Json::Value& jsonHyp, JsonTypes type, bool statesShareWeights);
+	/// number of values of the first state and of all states in a features entry
+	struct FeatureShape
+	{
+		size_t firstState = 0;
+		size_t total = 0;
+		size_t numStates = 0;
+	};
+
+	/// everything about the model file that is needed before the first hypothesis can be added
+	struct ModelSummary
+	{
+		bool statesShareWeights = false;
+		size_t numSegmentations = 0;
+		size_t numLinks = 0;
+		size_t numDivisions = 0;
+		size_t numExclusions = 0;
+		/// number of doubles needed to store all features in the binary format
+		size_t numFeatureValues = 0;
+		bool linksBeforeSegmentations = false;
+		FeatureShape detShape, divShape, appShape, disShape, linkShape;
+	};
+
+	/// position of the weights of each hypothesis type in the weight vector
+	struct WeightOffsets
+	{
+		size_t link, det, div, app, dis;
+	};
+
+	/// a parsed detection, the feature buffers are reused for all detections
+	struct SegmentationHypothesis
+	{
+		size_t id;
+		size_t targetIdx;
+		std::pair<int, int> timeRange;
+		bool hasTimestep;
+		bool hasDivision;
+		bool hasAppearance;
+		bool hasDisappearance;
+		StateFeatureVector features, divFeatures, appFeatures, disFeatures;
+	};
+
+	struct LinkHypothesis
+	{
+		size_t srcId;
+		size_t destId;
+		StateFeatureVector features;
+	};
+
+	typedef std::function<void(const SegmentationHypothesis&)> SegmentationCallback;
+	typedef std::function<void(const LinkHypothesis&)> LinkCallback;
+
+	/// first pass over the model file: read the settings, count the hypotheses and the weights they need
+	ModelSummary scanModel();
+
+	/// stream the hypotheses of the model file to the callbacks, in the order of the file
+	void streamHypotheses(bool readSegmentations, bool readLinks, const SegmentationCallback& onSegmentation, const LinkCallback& onLink);
+
+	/// stream all hypotheses, with the links after the detections
+	void streamAllHypotheses(const ModelSummary& summary, const SegmentationCallback& onSegmentation, const LinkCallback& onLink);
+
+	/**
+	 * @brief read the features per state of the value that starts after the current key,
+	 *        into stateFeatures if it is given, and return their shape
+	 */
+	FeatureShape readFeatures(JsonStreamParser& parser, JsonTypes type, StateFeatureVector* stateFeatures);
+	size_t getNumWeights(const FeatureShape& shape, bool statesShareWeights);
+
+	/// the weights given to the constructor, or the ones from the weights file
+	FeatureVector loadWeights();
+
+	/// check that the weights fit to the model and find where each hypothesis type's weights start
+	WeightOffsets getWeightOffsets(const ModelSummary& summary, const FeatureVector& weights);
+
+	/// combine features and weights to costs and hand the hypotheses to the graph builder
+	void addSegmentation(const SegmentationHypothesis& hyp, const FeatureVector& weights, const WeightOffsets& offsets, bool statesShareWeights);
+	void addLink(const LinkHypothesis& hyp, const FeatureVector& weights, const WeightOffsets& offsets, bool statesShareWeights);
+
+	/// whether the model file starts with the magic bytes of the binary format
+	bool isBinaryModel();
+	void createGraphFromBinary();
 
 private:
 	/// filename where the model is stored in json
 	std::string modelFilename_;
 
-	/// filename where the wheights are stored in json
+	/// filename where the wheights are stored in json, empty if the weights were given directly
 	std::string weightsFilename_;
 };
 
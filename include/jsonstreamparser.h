@@ -0,0 +1,67 @@
+#ifndef JSON_STREAM_PARSER
+#define JSON_STREAM_PARSER
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Pull parser that reads JSON token by token from a stream, without building a document tree.
+ *
+ * Understands the dialect of our model files, including C and C++ style comments.
+ * Commas and colons are only treated as separators, so the structure is not validated strictly.
+ */
+class JsonStreamParser
+{
+public:
+	enum class Token {BeginObject, EndObject, BeginArray, EndArray, Key, String, Number, True, False, Null, EndOfInput};
+
+	JsonStreamParser(std::istream& input, size_t bufferSize = 1 << 20);
+
+	/// advance to the next token and return it
+	Token next();
+
+	/// the current token
+	Token getToken() const { return token_; }
+
+	/// text of the current Key or String token
+	const std::string& getString() const { return string_; }
+
+	/// value of the current Number token
+	double getNumber() const { return number_; }
+
+	/// skip the value starting at the current token, afterwards the current token is the last one of that value
+	void skipValue();
+
+	/// throw a runtime error at the current line
+	void error(const std::string& message) const;
+
+private:
+	bool fillBuffer();
+	int peekChar() { return (pos_ < end_ || fillBuffer()) ? (unsigned char)buffer_[pos_] : -1; }
+	int getChar() { return (pos_ < end_ || fillBuffer()) ? (unsigned char)buffer_[pos_++] : -1; }
+
+	/// skip white space and comments, and also commas and colons if separators is set
+	void skipWhitespace(bool separators);
+	void readString();
+	void readNumber();
+	void readLiteral(const char* literal, Token token);
+
+	std::istream& input_;
+	std::vector<char> buffer_;
+	size_t pos_;
+	size_t end_;
+	size_t line_;
+
+	Token token_;
+	std::string string_;
+	double number_;
+};
+
+} // end namespace dpct
+
+#endif // JSON_STREAM_PARSER
@@ -2,9 +2,17 @@
 #define DPCT_MAGNUSSON_H
 
 #include <functional>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <assert.h>
 
 #include "trackingalgorithm.h"
+#include "solvertelemetry.h"
 #include "userdata.h"
+#include "arena.h"
+#include "workerpool.h"
+#include "log.h"
 
 namespace dpct
 {
@@ -20,17 +28,28 @@ public:
                              Arc* replacementB):
         arc_(cutArc),
         replacementA_(replacementA),
-        replacementB_(replacementB)
+        replacementB_(replacementB),
+        cutArcUseCount_(cutArc->getUseCount()),
+        storeIndex_(0)
     {}
     Arc* getCutArc() const { return arc_; }
     Arc* getReplacementAArc() const { return replacementA_; }
     Arc* getReplacementBArc() const { return replacementB_; }
 
+    // the swap arc is stale once the arc it cuts was used less often than when it was inserted
+    bool isStale() const { return arc_->getUseCount() < cutArcUseCount_; }
+
+    // position of the swap arc in Magnusson's list of swap arcs
+    size_t getStoreIndex() const { return storeIndex_; }
+    void setStoreIndex(size_t index) { storeIndex_ = index; }
+
     virtual std::string toString() const { return "Magnusson Swap Arc"; }
 private:
     Arc* arc_;
     Arc* replacementA_;
     Arc* replacementB_;
+    size_t cutArcUseCount_;
+    size_t storeIndex_;
 };
 
 // Klas Magnusson's cell tracking algorithm as in:
@@ -46,12 +65,17 @@ public:
     // typedefs
     typedef std::function<Arc*(Node*)> SelectorFunction;
     typedef std::function<double(Node*, Node*, Node*)> MotionModelScoreFunction;
+    // scores all move arcs leaving a node at once: gets the predecessor, the node and the move arc targets,
+    // and fills in one score per target. Source and sink are passed as nullptr.
+    typedef std::function<void(Node*, Node*, const std::vector<Node*>&, std::vector<double>&)> BatchMotionModelScoreFunction;
 
 public:
     //--------------------------------------
     // API
     // WARNING: setting usedArcsScoreZero=false yields undefined behaviour at the moment!
     Magnusson(Graph* graph, bool withSwap, bool usedArcsScoreZero = true, bool useFastFirstIter = false);
+    // removes all remaining swap arcs from the graph, which thus has to outlive the tracker
+    ~Magnusson();
 
     // specify a strategy to pick a path that starts from a node
     // through an arc.
@@ -60,26 +84,108 @@ public:
 
     // specify a motion model. This will be added to the score of each
     // arc while building up paths, so is only evaluated once per arc
-    // even though it gets 2 predecessors as input
-    void setMotionModelScoreFunction(MotionModelScoreFunction func);
+    // even though it gets 2 predecessors as input.
+    // Only a thread safe motion model is evaluated concurrently in a parallel sweep,
+    // otherwise it is called for all nodes of a timestep from one thread after their update.
+    void setMotionModelScoreFunction(MotionModelScoreFunction func, bool threadSafe = false);
+
+    // specify a motion model that scores all move arcs of a node in one call. Takes precedence over
+    // a motion model set via setMotionModelScoreFunction.
+    void setBatchMotionModelScoreFunction(BatchMotionModelScoreFunction func, bool threadSafe = false);
+
+    // update the nodes of each timestep on several threads, if there are at least
+    // minNodesPerThread nodes per thread in that timestep. 0 uses all cores.
+    // Nodes of one timestep must only have in arcs from earlier timesteps (or the source)
+    void setNumThreads(size_t numThreads, size_t minNodesPerThread = 256);
+
+    // release swap arcs as soon as the arc they would cut lost a use, instead of keeping them
+    // disabled in the graph until the end of tracking. Their slots are reused by new swap arcs.
+    void setRecycleStaleSwapArcs(bool recycle) { recycleStaleSwapArcs_ = recycle; }
 
     // only track a certain amount of cells
     void setMaxNumberOfPaths(size_t maxNumPaths) { maxNumPaths_ = maxNumPaths; }
 
+    // the state of a tracking run after an iteration that added paths, the energy is the negative overall score
+    struct Progress
+    {
+        size_t iteration;
+        size_t numPaths;
+        double energy;
+        double elapsedSeconds; // since tracking was started
+    };
+    typedef std::function<bool(const Progress&)> ProgressCallback;
+
+    // call this function after every iteration of the following tracking runs that added paths, empty to stop.
+    // If it returns false, tracking stops with the paths found so far
+    void setProgressCallback(const ProgressCallback& callback) { progressCallback_ = callback; }
+
+    // collect the counters and timers of every found path in the following tracking runs, nullptr to stop.
+    // The energy of an iteration is the negative overall score, the path cost the negative score of the path
+    void setTelemetry(SolverTelemetry* telemetry) { telemetry_ = telemetry; }
+
+    // after each path, only recompute the nodes downstream of the arcs whose use changed,
+    // and stop propagating where best in-arc and score stay the same, instead of sweeping the full graph
+    void setIncrementalUpdates(bool incremental) { incrementalUpdates_ = incremental; }
+
+    // after every sweep, augment up to this many paths instead of only the best one. Further paths are followed
+    // back from the other in arcs of the sink, best first, and only taken if they share no node with the paths
+    // augmented before them and use no swap arc, such that their scores are still exact. They must also score
+    // at least minScoreRatio times the best path, as weak paths block nodes that later paths would need.
+    // Needs far fewer sweeps, but the result can be worse than with one path per sweep (the default).
+    void setPathsPerSweep(size_t pathsPerSweep, double minScoreRatio = 0.8)
+    {
+        pathsPerSweep_ = std::max(pathsPerSweep, size_t(1));
+        minPathScoreRatio_ = minScoreRatio;
+    }
+
+    // add the containers of the graph, and the swap arcs and work arrays of the last tracking run.
+    // Swap arcs are counted with all slots their store ever allocated
+    void collectMemoryStatistics(MemoryStatistics& stats) const;
+
     // Find a set of paths through the graph that maximize the score.
     // Iterates until no path with positive score change can be found any more.
+    // Uses the callbacks set above, and picks the matching statically dispatched implementation.
     virtual double track(Solution& paths);
 
+    // Same as above, but with the motion model and path start selector given as policy objects,
+    // such that they can be inlined into the sweeps (see NoMotionModel and BestInArcSelector below).
+    // The callbacks set above are ignored.
+    template<class MotionModel, class Selector>
+    double track(Solution& paths, const MotionModel& motionModel, const Selector& selector);
+
 private:
     //--------------------------------------
     // methods
-	void updateNode(Node* n);
+    template<class MotionModel>
+	void updateNode(Node* n, const MotionModel& motionModel);
+    template<class MotionModel>
+    void updateOutArcs(Node* n, const MotionModel& motionModel);
+    template<class MotionModel>
+    void updateNodesByTimestep(const MotionModel& motionModel);
+    template<class MotionModel>
+    void batchFirstIteration(double& score, Solution& paths, const MotionModel& motionModel);
+    template<class Selector>
+    void backtrack(Node* start, Path& p, const Selector& selector);
+    // augment up to maxNumPaths paths of the last sweep that do not interact with the augmented path first,
+    // nor with each other, and return the sum of their scores
+    double augmentIndependentPaths(const Path& first, size_t maxNumPaths, Solution& newPaths);
+    template<class MotionModel>
+    double trackWithSelectorFunction(Solution& paths, const MotionModel& motionModel);
 	void increaseCellCount(Node* n);
-    void backtrack(Node* start,
-                   Path& p,
-                   TrackingAlgorithm::VisitorFunction nodeVisitor);
-    void batchFirstIteration(double& score, Solution& paths);
-    void updateNodesByTimestep();
+
+    // add the telemetry of one iteration, if telemetry is collected
+    typedef std::chrono::time_point<std::chrono::high_resolution_clock> TimePoint;
+    void recordIteration(size_t iteration, const TimePoint& startTime, const TimePoint& augmentEndTime,
+        size_t dirtyNodes, size_t numPaths, const Path& p, double pathScore, double score);
+
+    // hand the state after an iteration to the progress callback, if set. Returns false if tracking should stop
+    bool reportProgress(size_t iteration, size_t numPaths, double score);
+
+    // incremental score propagation
+    void markNodeDirty(Node* n, bool forceOutArcs);
+    void markArcUseChanged(Arc* a);
+    template<class MotionModel>
+    void updateDirtyNodes(const MotionModel& motionModel);
 
     // swap arc methods
     void insertSwapArcsForNewUsedPath(Path& p);
@@ -87,8 +193,10 @@ private:
     void insertAppearanceSwapArcs(Arc* a);
     void insertDisappearanceSwapArcs(Arc* a);
     void cleanUpUsedSwapArcs(Path& p, std::vector<Path> &paths);
+    void addSwapArc(Node* source, Node* target, double score, Arc* cutArc, Arc* replacementA, Arc* replacementB);
     void removeSwapArcs();
     void removeSwapArc(Arc* a);
+    void removeStaleSwapArcs(Arc* cutArc);
     void removeArc(Arc *a);
 
 private:
@@ -100,15 +208,426 @@ private:
     bool usedArcsScoreZero_;
     SelectorFunction selectorFunction_;
     size_t maxNumPaths_;
+    size_t pathsPerSweep_;
+    double minPathScoreRatio_;
 
     // motion model
     MotionModelScoreFunction motionModelScoreFunction_;
+    BatchMotionModelScoreFunction batchMotionModelScoreFunction_;
+    bool motionModelThreadSafe_;
+
+    // parallel sweep
+    size_t numThreads_;
+    size_t minNodesPerThread_;
+    /// threads of the parallel sweep, started once per run
+    std::unique_ptr<WorkerPool> workerPool_;
 
     // swap arc members
     bool useFastFirstIter_;
-    std::vector<Arc*> swapArcs_;
+    bool recycleStaleSwapArcs_;
+    RecyclingArena<Arc> swapArcStore_;
+    std::vector<Arc*> swapArcs_; // every swap arc knows its index here, see MagnussonSwapArcUserData
+
+    // incremental update members: dirty nodes per timestep, and whether all their out arcs
+    // must be propagated because the enabled state or use count of an out arc changed
+    bool incrementalUpdates_;
+    std::vector< std::vector<Node*> > dirtyNodesPerTimestep_;
+    std::unordered_map<Node*, bool> dirtyNodes_;
+    std::vector<double> previousArcScores_;
+
+    // receives the telemetry of all iterations, if set
+    SolverTelemetry* telemetry_;
+    ProgressCallback progressCallback_;
+};
+
+
+// ----------------------------------------------------------------------------------------
+// Policies for Magnusson::track(paths, motionModel, selector).
+//
+// A motion model policy provides
+//   static const bool enabled;  // whether move arcs get an additional score at all
+//   bool isThreadSafe() const;  // whether scoreMoveArcs may be called concurrently in a parallel sweep
+//   void scoreMoveArcs(Node* predecessor, Node* node, const std::vector<Node*>& targets, std::vector<double>& scores) const;
+// where scores is zero initialized with the size of targets, and source or sink nodes are passed as nullptr.
+// A selector policy provides Arc* operator()(Node* n) const, picking the arc through which the next path reaches the sink.
+
+/// no motion model, move arcs only get the score of their source
+struct NoMotionModel
+{
+    static const bool enabled = false;
+    bool isThreadSafe() const { return true; }
+    void scoreMoveArcs(Node*, Node*, const std::vector<Node*>&, std::vector<double>&) const {}
+};
+
+/// type erased motion model, called once per move arc
+class FunctionMotionModel
+{
+public:
+    static const bool enabled = true;
+    FunctionMotionModel(const Magnusson::MotionModelScoreFunction& func, bool threadSafe):
+        func_(func),
+        threadSafe_(threadSafe)
+    {}
+    bool isThreadSafe() const { return threadSafe_; }
+    void scoreMoveArcs(Node* predecessor, Node* node, const std::vector<Node*>& targets, std::vector<double>& scores) const
+    {
+        for(size_t i = 0; i < targets.size(); ++i)
+            scores[i] = func_(predecessor, node, targets[i]);
+    }
+private:
+    const Magnusson::MotionModelScoreFunction& func_;
+    bool threadSafe_;
+};
+
+/// type erased motion model, called once per node for all its move arcs
+class BatchFunctionMotionModel
+{
+public:
+    static const bool enabled = true;
+    BatchFunctionMotionModel(const Magnusson::BatchMotionModelScoreFunction& func, bool threadSafe):
+        func_(func),
+        threadSafe_(threadSafe)
+    {}
+    bool isThreadSafe() const { return threadSafe_; }
+    void scoreMoveArcs(Node* predecessor, Node* node, const std::vector<Node*>& targets, std::vector<double>& scores) const
+    {
+        func_(predecessor, node, targets, scores);
+    }
+private:
+    const Magnusson::BatchMotionModelScoreFunction& func_;
+    bool threadSafe_;
+};
+
+/// start paths through the best in arc, same as selectBestInArc
+struct BestInArcSelector
+{
+    Arc* operator()(Node* n) const { return n->getBestInArc(); }
 };
 
+/// type erased path start selector
+class FunctionSelector
+{
+public:
+    FunctionSelector(const Magnusson::SelectorFunction& func):
+        func_(func)
+    {}
+    Arc* operator()(Node* n) const { return func_(n); }
+private:
+    const Magnusson::SelectorFunction& func_;
+};
+
+// ----------------------------------------------------------------------------------------
+// template implementation
+
+template<class MotionModel>
+inline void Magnusson::updateNode(Node* n, const MotionModel& motionModel)
+{
+    // do not try to find best in arc of source as there is none (yields -inf score otherwise)
+    if(n != &graph_->getSourceNode())
+	   n->updateBestInArcAndScore();
+
+    updateOutArcs(n, motionModel);
+}
+
+template<class MotionModel>
+inline void Magnusson::updateOutArcs(Node* n, const MotionModel& motionModel)
+{
+    if(!MotionModel::enabled)
+    {
+        for(Node::ArcIt outArc = n->getOutArcsBegin(); outArc != n->getOutArcsEnd(); ++outArc)
+        {
+            (*outArc)->update();
+        }
+        return;
+    }
+
+    // reused per thread, as a parallel sweep updates several nodes at once
+    static thread_local std::vector<Node*> targets;
+    static thread_local std::vector<double> scores;
+
+    Node* predecessor = nullptr;
+    Arc* a = n->getBestInArc();
+    if(a && !graph_->isSpecialNode(a->getSourceNode()))
+        predecessor = a->getSourceNode();
+    Node* node = graph_->isSpecialNode(n) ? nullptr : n;
+
+    targets.clear();
+    for(Node::ArcIt outArc = n->getOutArcsBegin(); outArc != n->getOutArcsEnd(); ++outArc)
+    {
+        if((*outArc)->getType() == Arc::Move)
+        {
+            Node* target = (*outArc)->getTargetNode();
+            targets.push_back(graph_->isSpecialNode(target) ? nullptr : target);
+        }
+    }
+
+    scores.assign(targets.size(), 0.0);
+    if(!targets.empty())
+        motionModel.scoreMoveArcs(predecessor, node, targets, scores);
+
+    size_t moveArcIdx = 0;
+    for(Node::ArcIt outArc = n->getOutArcsBegin(); outArc != n->getOutArcsEnd(); ++outArc)
+    {
+        if((*outArc)->getType() == Arc::Move)
+            (*outArc)->update(scores[moveArcIdx++]);
+        else
+            (*outArc)->update();
+    }
+}
+
+template<class MotionModel>
+inline void Magnusson::updateNodesByTimestep(const MotionModel& motionModel)
+{
+    updateNode(&graph_->getSourceNode(), motionModel);
+
+    // nodes of one timestep only read their in arcs from earlier timesteps and write their own out arcs,
+    // so they can be updated concurrently. A motion model that is not thread safe is evaluated afterwards.
+    bool serialOutArcs = MotionModel::enabled && !motionModel.isThreadSafe();
+    for(size_t t = 0; t < graph_->getNumTimesteps(); ++t)
+    {
+        if(numThreads_ > 1 && serialOutArcs)
+        {
+            graph_->forEachNodeInTimestep(t, [](Node* n){ n->updateBestInArcAndScore(); }, workerPool_.get(), minNodesPerThread_);
+            graph_->forEachNodeInTimestep(t, [&](Node* n){ updateOutArcs(n, motionModel); });
+        }
+        else
+            graph_->forEachNodeInTimestep(t, [&](Node* n){ updateNode(n, motionModel); }, workerPool_.get(), minNodesPerThread_);
+    }
+    updateNode(&graph_->getSourceNode(), motionModel);
+    updateNode(&graph_->getSinkNode(), motionModel);
+}
+
+template<class MotionModel>
+inline void Magnusson::batchFirstIteration(double& score, Solution& paths, const MotionModel& motionModel)
+{
+    DEBUG_MSG("Finding all good tracks from sink for first iteration");
+    Solution availablePaths;
+    double scoreDelta;
+    
+    findNonintersectingBackwardPaths(&graph_->getSourceNode(), &graph_->getSinkNode(), availablePaths, numThreads_);
+
+    // insert all paths at once
+    for(Path& p : availablePaths)
+    {
+        // only add path if they increase the overall score
+        scoreDelta = p.back()->getCurrentScore();
+        if(scoreDelta < 0)
+            continue;
+
+        // update cell counts and score
+        increaseCellCount(p.front()->getSourceNode());
+        for(Arc* a : p)
+            increaseCellCount(a->getTargetNode());
+
+        score += scoreDelta;
+
+        if(withSwap_)
+        {
+            // insert swap arcs
+            insertSwapArcsForNewUsedPath(p);
+        }
+
+        // add to solution
+        paths.push_back(p);
+        DEBUG_MSG("Adding path of length " << p.size() << " has score: " << p.back()->getCurrentScore());
+        DEBUG_MSG("\rFound " << paths.size() << " paths...");
+    }
+
+    // update only once
+    updateNodesByTimestep(motionModel);
+}
+
+template<class MotionModel>
+inline void Magnusson::updateDirtyNodes(const MotionModel& motionModel)
+{
+    // all arcs point forward in time, so every node is final once its timestep was processed
+    for(size_t t = 0; t < dirtyNodesPerTimestep_.size(); ++t)
+    {
+        std::vector<Node*>& dirtyNodes = dirtyNodesPerTimestep_[t];
+        // nodes of the same timestep may be appended while iterating
+        for(size_t i = 0; i < dirtyNodes.size(); ++i)
+        {
+            Node* n = dirtyNodes[i];
+            bool forceOutArcs = dirtyNodes_[n];
+
+            Arc* previousBestInArc = n->getBestInArc();
+            double previousScore = n->getCurrentScore();
+            n->updateBestInArcAndScore();
+
+            // nothing changed for the successors, stop propagating here
+            if(!forceOutArcs && n->getBestInArc() == previousBestInArc && n->getCurrentScore() == previousScore)
+                continue;
+
+            previousArcScores_.clear();
+            for(Node::ArcIt outArc = n->getOutArcsBegin(); outArc != n->getOutArcsEnd(); ++outArc)
+                previousArcScores_.push_back((*outArc)->getCurrentScore());
+
+            updateOutArcs(n, motionModel);
+
+            size_t arcIdx = 0;
+            for(Node::ArcIt outArc = n->getOutArcsBegin(); outArc != n->getOutArcsEnd(); ++outArc, ++arcIdx)
+            {
+                if(forceOutArcs || (*outArc)->getCurrentScore() != previousArcScores_[arcIdx])
+                {
+                    Node* target = (*outArc)->getTargetNode();
+                    if(target->getTimestep() >= t)
+                        markNodeDirty(target, false);
+                }
+            }
+
+            // divisions observing this node could have been toggled
+            if(forceOutArcs)
+                n->visitObserverArcs([&](Arc* o){ markNodeDirty(o->getTargetNode(), false); });
+        }
+        dirtyNodes.clear();
+    }
+    dirtyNodes_.clear();
+
+    updateNode(&graph_->getSinkNode(), motionModel);
+}
+
+template<class Selector>
+inline void Magnusson::backtrack(Node* start, TrackingAlgorithm::Path& p, const Selector& selector)
+{
+	p.clear();
+	Node* current = start;
+
+    while(current != &(graph_->getSourceNode()))
+	{
+        increaseCellCount(current);
+        Arc* bestArc = nullptr;
+        if(current == start)
+            bestArc = selector(current);
+        else
+            bestArc = current->getBestInArc();
+
+		assert(bestArc != nullptr);
+        assert(bestArc->isEnabled());
+
+        if(bestArc->getType() != Arc::Dummy)
+            bestArc->markUsed();
+		p.push_back(bestArc);
+		current = bestArc->getSourceNode();
+	}
+
+    increaseCellCount(current);
+	std::reverse(p.begin(), p.end());
+}
+
+template<class MotionModel, class Selector>
+inline double Magnusson::track(Solution& paths, const MotionModel& motionModel, const Selector& selector)
+{
+    tic();
+    workerPool_.reset(numThreads_ > 1 ? new WorkerPool(numThreads_) : nullptr);
+	paths.clear();
+	double score = 0;
+    double scoreDelta = 0.0;
+    size_t iteration = 0;
+    bool stopped = false;
+
+	// update scores from timestep 0 to the end
+	updateNodesByTimestep(motionModel);
+    dirtyNodesPerTimestep_.resize(graph_->getNumTimesteps());
+    if(telemetry_ != nullptr)
+        telemetry_->addSetupSeconds(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime_).count());
+
+    if(useFastFirstIter_)
+    {
+        TimePoint iterationStartTime = std::chrono::high_resolution_clock::now();
+        batchFirstIteration(score, paths, motionModel);
+        recordIteration(iteration, iterationStartTime, std::chrono::high_resolution_clock::now(), 0, paths.size(), Path(), score, score);
+        stopped = !reportProgress(iteration++, paths.size(), score);
+    }
+
+    while(!stopped && paths.size() < maxNumPaths_)
+    {
+        TimePoint iterationStartTime = std::chrono::high_resolution_clock::now();
+
+        // backtrack best path, increase cell counts -> invalidates scores!
+        Path p;
+        backtrack(&(graph_->getSinkNode()), p, selector);
+
+        DEBUG_MSG("Current best path of length " << p.size() << " has score: " << p.back()->getCurrentScore());
+        printPath(p);
+        scoreDelta = p.back()->getCurrentScore();
+
+        // only continue if this path adds to the overall score
+        if(scoreDelta < 0)
+        {
+            DEBUG_MSG("Path has negative reward, stopping here with a total number of " << paths.size() << " cells added");
+            TimePoint iterationEndTime = std::chrono::high_resolution_clock::now();
+            recordIteration(iteration++, iterationStartTime, iterationEndTime, 0, 0, p, scoreDelta, score);
+            break;
+        }
+
+        if(incrementalUpdates_)
+        {
+            for(Arc* a : p)
+                markArcUseChanged(a);
+        }
+
+        // cleaning up swap arcs reroutes earlier paths, after which the scores of the sweep are not exact any more
+        bool usesSwapArc = std::any_of(p.begin(), p.end(), [](Arc* a){ return a->getType() == Arc::Swap; });
+
+        // insert swap arcs
+        if(withSwap_)
+        {
+            cleanUpUsedSwapArcs(p, paths);
+
+            // make sure no swap arcs are left in the paths, otherwise we'll access free'd memory lateron
+            for(Path& path : paths)
+            { 
+                for(Node::ArcIt p_it = path.begin(); p_it != path.end(); ++p_it)
+                {
+                    assert((*p_it)->getType() != Arc::Swap);
+                }
+            }
+
+            size_t numSwapArcs = swapArcs_.size();
+            insertSwapArcsForNewUsedPath(p);
+
+            if(incrementalUpdates_)
+            {
+                for(size_t i = numSwapArcs; i < swapArcs_.size(); ++i)
+                    markNodeDirty(swapArcs_[i]->getTargetNode(), false);
+            }
+        }
+
+        // take more paths from the same sweep
+        Solution newPaths;
+        if(pathsPerSweep_ > 1 && !usesSwapArc)
+            scoreDelta += augmentIndependentPaths(p, std::min(pathsPerSweep_, maxNumPaths_ - paths.size()) - 1, newPaths);
+
+        // update scores from timestep 0 to the end, or only where they could have changed
+        TimePoint augmentEndTime = std::chrono::high_resolution_clock::now();
+        size_t numDirtyNodes = dirtyNodes_.size();
+        if(incrementalUpdates_)
+            updateDirtyNodes(motionModel);
+        else
+            updateNodesByTimestep(motionModel);
+
+        // add path to solution
+        paths.push_back(p);
+        paths.insert(paths.end(), newPaths.begin(), newPaths.end());
+        score += scoreDelta;
+        recordIteration(iteration, iterationStartTime, augmentEndTime, numDirtyNodes, 1 + newPaths.size(), p, scoreDelta, score);
+        if(!reportProgress(iteration++, paths.size(), score))
+        {
+            LOG_MSG("Tracking stopped by the progress callback after " << paths.size() << " paths");
+            break;
+        }
+        // std::chrono::time_point<std::chrono::high_resolution_clock> td = std::chrono::high_resolution_clock::now();
+        DEBUG_MSG("Found " << paths.size() << " paths... overall score=" << score << " after " << toc() << " secs");
+    }
+    LOG_MSG("Found " << paths.size() << " paths... overall score=" << score << " after " << toc() << " secs");
+
+    // done
+    // removeSwapArcs(); // TODO: try leaving this out, looks like this takes 100 seconds for rapoport?!
+    toc();
+    workerPool_.reset();
+
+    return score;
+}
 
 // path selection strategies
 Arc* selectBestInArc(Node* n);
@@ -17,6 +17,13 @@ public:
 		graph_(graph)
 	{}
 
+	void reserve(size_t numDetections, size_t numLinks, size_t numDivisions)
+	{
+		GraphBuilder::reserve(numDetections, numLinks, numDivisions);
+		// every detection gets an appearance and a disappearance arc, and three score tables of usually two states
+		graph_->reserve(2 * numDetections + numLinks + numDivisions, 2 * (3 * numDetections + numLinks) + numDivisions);
+	}
+
 	/**
 	 * @brief Magnusson performs score maximization, so we have to multiply our cost deltas by -1
 	 */
@@ -42,7 +49,7 @@ public:
 		size_t timestep = idToTimestepsMap_[id].second;
 		Graph::NodePtr n = graph_->addNode(timestep, flipSign(detectionCosts), flipSign(appearanceCostDeltas), flipSign(disappearanceCostDeltas), false, false);
 		idToGraphNodeMap_[id] = n;
-		graphNodeToIdMap_[n] = id;
+		graphNodeToIdMap_[n.get()] = id;
 	}
 
 	void addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas)
@@ -154,6 +161,13 @@ public:
 	    for(const TrackingAlgorithm::Path& p : paths)
 	    {
 	    	FlowGraph::Path flowPath;
+	    	// unsplit detections have no arc, their flow follows from the arcs entering them
+	    	auto addNodeArc = [&](const Node* n)
+	    	{
+	    		FlowGraph::Arc nodeArc = builder.getNodeArc(graphNodeToIdMap_[n]);
+	    		if(nodeArc != lemon::INVALID)
+	    			flowPath.push_back(std::make_pair(nodeArc, 1));
+	    	};
 	        // a path starts at the dummy-source and goes to the dummy-sink. these arcs are of type dummy, and thus skipped
 	        bool first_arc_on_path = true;
 	        for(const Arc* a : p)
@@ -169,24 +183,24 @@ public:
 	                    // send one cell through the nodes
 	                    if(first_arc_on_path)
 	                    {
-	                        flowPath.push_back(std::make_pair(builder.getAppearanceArc(graphNodeToIdMap_[a->getSourceNode()->getSharedPtr()]), 1));
-	                        flowPath.push_back(std::make_pair(builder.getNodeArc(graphNodeToIdMap_[a->getSourceNode()->getSharedPtr()]), 1));
+	                        flowPath.push_back(std::make_pair(builder.getAppearanceArc(graphNodeToIdMap_[a->getSourceNode()]), 1));
+	                        addNodeArc(a->getSourceNode());
 	                        first_arc_on_path = false;
 	                    }
 
 	                    // set arc to active
 	                    flowPath.push_back(std::make_pair(
-	                    	builder.getMoveArc(std::make_pair(graphNodeToIdMap_[a->getSourceNode()->getSharedPtr()], 
-	                    									  graphNodeToIdMap_[a->getTargetNode()->getSharedPtr()])), 
+	                    	builder.getMoveArc(std::make_pair(graphNodeToIdMap_[a->getSourceNode()], 
+	                    									  graphNodeToIdMap_[a->getTargetNode()])), 
 	                    	1));
-	                    flowPath.push_back(std::make_pair(builder.getNodeArc(graphNodeToIdMap_[a->getTargetNode()->getSharedPtr()]), 1));
+	                    addNodeArc(a->getTargetNode());
 	                }
 	                break;
 	                case Arc::Appearance:
 	                {
 	                    // the node that appeared is set active here, so detections without further path are active as well
-	                    flowPath.push_back(std::make_pair(builder.getAppearanceArc(graphNodeToIdMap_[a->getTargetNode()->getSharedPtr()]), 1));
-                        flowPath.push_back(std::make_pair(builder.getNodeArc(graphNodeToIdMap_[a->getTargetNode()->getSharedPtr()]), 1));
+	                    flowPath.push_back(std::make_pair(builder.getAppearanceArc(graphNodeToIdMap_[a->getTargetNode()]), 1));
+                        addNodeArc(a->getTargetNode());
 	                    first_arc_on_path = false;
 	                    
 	                }
@@ -195,21 +209,22 @@ public:
 	                {
 	                    if(first_arc_on_path)
 	                    {
-	                    	flowPath.push_back(std::make_pair(builder.getAppearanceArc(graphNodeToIdMap_[a->getSourceNode()->getSharedPtr()]), 1));
-	                        flowPath.push_back(std::make_pair(builder.getNodeArc(graphNodeToIdMap_[a->getSourceNode()->getSharedPtr()]), 1));
+	                    	flowPath.push_back(std::make_pair(builder.getAppearanceArc(graphNodeToIdMap_[a->getSourceNode()]), 1));
+	                        addNodeArc(a->getSourceNode());
 	                    }
 	                    first_arc_on_path = false;
-	                    flowPath.push_back(std::make_pair(builder.getDisappearanceArc(graphNodeToIdMap_[a->getSourceNode()->getSharedPtr()]), 1));
+	                    flowPath.push_back(std::make_pair(builder.getDisappearanceArc(graphNodeToIdMap_[a->getSourceNode()]), 1));
 	                }
 	                break;
 	                case Arc::Division:
 	                {
 	                	assert(a->getObservedNode() != nullptr);
-	                	auto flowArcs = builder.getDivisionArcs(graphNodeToIdMap_[a->getObservedNode()->getSharedPtr()], graphNodeToIdMap_[a->getTargetNode()->getSharedPtr()]);
+	                	auto flowArcs = builder.getDivisionArcs(graphNodeToIdMap_[a->getObservedNode()], graphNodeToIdMap_[a->getTargetNode()]);
 	                	flowPath.push_back(std::make_pair(flowArcs.first, 1));
-	                	flowPath.push_back(std::make_pair(flowArcs.second, 1));
+	                	// the duplicate leaves along the parent's arc, with a step of its own
+	                	flowPath.push_back(std::make_pair(flowArcs.second, ResidualGraph::SharedStep));
 
-	                    flowPath.push_back(std::make_pair(builder.getNodeArc(graphNodeToIdMap_[a->getTargetNode()->getSharedPtr()]), 1));
+	                    addNodeArc(a->getTargetNode());
 	                    first_arc_on_path = false;
 	                }
 	                break;
@@ -371,7 +386,7 @@ private:
 
 	/// mapping from id to nodes
 	std::map<size_t, Graph::NodePtr> idToGraphNodeMap_;
-	std::map<Graph::NodePtr, size_t> graphNodeToIdMap_;
+	std::map<const Node*, size_t> graphNodeToIdMap_;
 
 	/// mapping from id to division arc
 	std::map<size_t, Graph::NodePtr> idToGraphDivisionMap_;
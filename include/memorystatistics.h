@@ -0,0 +1,139 @@
+#ifndef DPCT_MEMORY_STATISTICS_H
+#define DPCT_MEMORY_STATISTICS_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Number of nodes and arcs of one graph structure, e.g. the flow graph or its residual graph
+ */
+struct StructureSize
+{
+	std::string structure;
+	size_t numNodes = 0;
+	size_t numArcs = 0;
+};
+
+/**
+ * @brief Number of elements and approximate bytes held by one container of a graph structure
+ */
+struct ContainerMemory
+{
+	std::string structure;
+	std::string container;
+	size_t numElements = 0;
+	size_t bytes = 0;
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Collects the sizes and memory footprints of the containers of the graphs and solvers,
+ * see FlowGraph::collectMemoryStatistics, Graph::collectMemoryStatistics and Magnusson::collectMemoryStatistics.
+ *
+ * The bytes are derived from sizes and capacities, with a fixed overhead per node of a tree or hash map,
+ * so they approximate what the allocator really hands out. The containers never shrink while tracking,
+ * so collecting them after tracking also gives their peak.
+ */
+class MemoryStatistics
+{
+public:
+	/// bookkeeping of one element of a std::map (color and three pointers) or std::unordered_map (next pointer and hash)
+	static const size_t TreeNodeOverheadBytes = 32;
+	static const size_t HashNodeOverheadBytes = 16;
+
+	MemoryStatistics():
+		peakResidentBytes_(0)
+	{}
+
+	void clear() { structures_.clear(); containers_.clear(); peakResidentBytes_ = 0; }
+
+	void addStructure(const std::string& structure, size_t numNodes, size_t numArcs);
+	void addContainer(const std::string& structure, const std::string& container, size_t numElements, size_t bytes);
+
+	template<class T>
+	void addVector(const std::string& structure, const std::string& container, const std::vector<T>& v)
+	{
+		addContainer(structure, container, v.size(), v.capacity() * sizeof(T));
+	}
+
+	void addVector(const std::string& structure, const std::string& container, const std::vector<bool>& v)
+	{
+		addContainer(structure, container, v.size(), v.capacity() / 8);
+	}
+
+	template<class K, class V>
+	void addMap(const std::string& structure, const std::string& container, const std::map<K, V>& m)
+	{
+		addContainer(structure, container, m.size(), m.size() * (sizeof(typename std::map<K, V>::value_type) + TreeNodeOverheadBytes));
+	}
+
+	template<class K, class V>
+	void addMap(const std::string& structure, const std::string& container, const std::unordered_map<K, V>& m)
+	{
+		addContainer(structure, container, m.size(),
+			m.size() * (sizeof(typename std::unordered_map<K, V>::value_type) + HashNodeOverheadBytes) + m.bucket_count() * sizeof(void*));
+	}
+
+	/// a lemon node or arc map of a digraph, which holds one value per id up to the maximal id
+	template<class V>
+	void addItemMap(const std::string& structure, const std::string& container, int maxId)
+	{
+		addContainer(structure, container, size_t(maxId + 1), size_t(maxId + 1) * sizeof(V));
+	}
+
+	/// the node and arc lists of a lemon::ListDigraph, which stores four ints per node id and six per arc id
+	template<class GR>
+	void addListDigraph(const std::string& structure, const GR& g)
+	{
+		addContainer(structure, "nodes", size_t(g.maxNodeId() + 1), size_t(g.maxNodeId() + 1) * 4 * sizeof(int));
+		addContainer(structure, "arcs", size_t(g.maxArcId() + 1), size_t(g.maxArcId() + 1) * 6 * sizeof(int));
+	}
+
+	const std::vector<StructureSize>& getStructures() const { return structures_; }
+	const std::vector<ContainerMemory>& getContainers() const { return containers_; }
+
+	/// @return the bytes of all containers, or of the containers of one structure
+	size_t getTotalBytes() const;
+	size_t getStructureBytes(const std::string& structure) const;
+
+	/// remember the peak resident memory of the process so far, e.g. right after tracking
+	void updatePeakResidentBytes();
+	size_t getPeakResidentBytes() const { return peakResidentBytes_; }
+
+	/// the peak resident memory of this process so far, 0 if it is not known on this platform
+	static size_t readPeakResidentBytes();
+
+	/**
+	 * @brief Approximate peak memory of tracking a model with the given numbers of hypotheses
+	 * by one of the methods of the track tool, before anything is built
+	 */
+	static size_t estimateTrackingBytes(size_t numSegmentations, size_t numLinks, size_t numDivisions, const std::string& method);
+
+	/// a table of the structures and containers with their sizes in MB
+	void writeSummary(std::ostream& out) const;
+
+	/// one line per container, with a header line naming the columns
+	void writeCsv(std::ostream& out) const;
+
+	/// an object with the totals, the structures and all containers
+	void writeJson(std::ostream& out) const;
+
+	/// write JSON if the filename ends with ".json", CSV otherwise
+	void save(const std::string& filename) const;
+
+private:
+	std::vector<StructureSize> structures_;
+	std::vector<ContainerMemory> containers_;
+	size_t peakResidentBytes_;
+};
+
+} // end namespace dpct
+
+#endif // DPCT_MEMORY_STATISTICS_H
@@ -8,6 +8,7 @@
 
 #include "userdata.h"
 #include "iarcnotifier.h"
+#include "arena.h"
 
 namespace dpct
 {
@@ -15,7 +16,7 @@ namespace dpct
 class Arc;
 
 // Nodes notify observers when the cellcount increases
-class Node : public IUserDataHolder, public IArcNotifier, public std::enable_shared_from_this<Node>
+class Node : public IUserDataHolder, public IArcNotifier
 {
 public:
 	typedef std::vector<Arc*>::iterator ArcIt;
@@ -27,8 +28,10 @@ public:
     Node() = delete;
     Node(const Node&) = delete;
 
+    // if a score pool is given, the score table is stored there instead of in its own heap block
     explicit Node(const std::vector<double>& cellCountScore = {},
-         UserDataPtr data = UserDataPtr());
+         UserDataPtr data = UserDataPtr(),
+         ScorePool* scorePool = nullptr);
     // this dedicated copy constructor does NOT copy connected arcs, but only node internals
     Node(const Node& n,
          UserDataPtr data = UserDataPtr());
@@ -40,6 +43,8 @@ public:
 	void registerOutArc(Arc* arc);
     bool removeInArc(Arc* arc);
     bool removeOutArc(Arc* arc);
+    // remove all in and out arcs matching the predicate in one pass
+    void removeArcsIf(const ArcPredicate& pred);
 
 	void reset();
 	void updateBestInArcAndScore();
@@ -68,6 +73,13 @@ public:
     size_t getNumInArcs() const  { return inArcs_.size(); }
     size_t getNumOutArcs() const { return outArcs_.size(); }
 
+    // bytes of the node and its arc lists and score table, without user data
+    size_t memoryBytes() const
+    {
+        return sizeof(Node) + (inArcs_.capacity() + outArcs_.capacity()) * sizeof(Arc*)
+            + cellCountScore_.capacity() * sizeof(double);
+    }
+
     size_t getNumActiveDivisions() const { return numActiveDivisions_; }
     void increaseNumActiveDivisions(int count = 1) { numActiveDivisions_ += count; }
 
@@ -79,7 +91,14 @@ public:
     friend std::ostream& operator<<(std::ostream& lhs, const Node& rhs);
 
     double getScoreDeltaForCurrentCellCount();
-    std::shared_ptr<Node> getSharedPtr(){ return shared_from_this(); }
+
+    // timestep this node was inserted at by the graph
+    size_t getTimestep() const { return timestep_; }
+    void setTimestep(size_t timestep) { timestep_ = timestep; }
+
+    // unique index below Graph::getNumNodeIndices() given by the graph, to store per node data in flat arrays
+    size_t getIndex() const { return index_; }
+    void setIndex(size_t index) { index_ = index; }
 
 protected:
 	// things every node needs
@@ -89,8 +108,10 @@ protected:
     Arc* disappearanceArc_;
 	size_t cellCount_; // do we also need to store how many cells are already dividing?
 	Arc* bestInArc_;
-    std::vector<double> cellCountScore_;
+    ScoreDeltaVector cellCountScore_;
 	double currentScore_;
+    size_t timestep_;
+    size_t index_;
 
     // cache states
     size_t numActiveDivisions_;
@@ -0,0 +1,158 @@
+#ifndef PRUNING_GRAPH_BUILDER
+#define PRUNING_GRAPH_BUILDER
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "graphbuilder.h"
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief What a PruningGraphBuilder removed from a model before it was built
+ */
+struct PruningReport
+{
+	/// hypotheses of the model as read
+	size_t numDetections = 0;
+	size_t numLinks = 0;
+	size_t numDivisions = 0;
+
+	/// links that are never better than letting the source disappear and the target appear
+	size_t numDominatedLinks = 0;
+	/// links, detections and divisions that cannot carry any flow once all dominated links are gone
+	size_t numUnreachableLinks = 0;
+	size_t numUnreachableDetections = 0;
+	size_t numUnreachableDivisions = 0;
+	/// states of detections, links, appearances and disappearances beyond the number of objects that can reach them
+	size_t numRemovedStates = 0;
+
+	/// the removed hypotheses, by id
+	std::vector<std::pair<size_t, size_t> > removedLinks;
+	std::vector<size_t> removedDetections;
+	std::vector<size_t> removedDivisions;
+
+	void clear() { *this = PruningReport(); }
+
+	/// one line with the numbers of removed hypotheses
+	void writeSummary(std::ostream& out) const;
+
+	/// an object with all counts and the ids of all removed hypotheses
+	void writeJson(std::ostream& out) const;
+
+	/// write the report as JSON
+	void save(const std::string& filename) const;
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Graph builder that sits between a graph reader and the builder of the actual graph,
+ * and only hands over the hypotheses that can be part of an optimal solution.
+ *
+ * All hypotheses are buffered until prune() is called, which
+ * - removes links i->j whose every state costs at least as much as the most expensive disappearance
+ *   state of i plus the most expensive appearance state of j. Any flow along such a link can be replaced
+ *   by a disappearance and an appearance without increasing the energy, as long as i can disappear
+ *   and j can appear as often as they can be used. Dividing sources additionally need the link's
+ *   division duplicate to be no better than the appearance of j.
+ * - limits the states of every detection to the number of objects its in- and out-going arcs can carry,
+ *   and those of its links, appearance and disappearance to the states of the detections they connect.
+ *   Detections that cannot carry any object are removed with all their links and their division.
+ * Both steps are repeated until nothing changes. The optimal energy of the model stays the same.
+ *
+ * Afterwards, all results are read from the wrapped builder. Removed hypotheses are missing in the value maps,
+ * which means they have value zero. The costs depend on the weights, so a builder that keeps the cost terms
+ * to recompute them for other weights cannot be wrapped.
+ */
+class PruningGraphBuilder : public GraphBuilder {
+public:
+	PruningGraphBuilder(GraphBuilder* graphBuilder);
+
+	void reserve(size_t numDetections, size_t numLinks, size_t numDivisions);
+
+	void addNode(
+		size_t id,
+		const CostDeltaVector& detectionCosts,
+		const CostDeltaVector& detectionCostDeltas,
+		const CostDeltaVector& appearanceCostDeltas,
+		const CostDeltaVector& disappearanceCostDeltas,
+		size_t targetIdx=0);
+
+	void addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas);
+
+	void allowMitosis(size_t id, ValueType divisionCostDelta);
+
+	/**
+	 * @brief remove dominated and unreachable hypotheses and add the remaining ones to the wrapped builder,
+	 * in the order they were added. Must be called once, after the graph reader is done.
+	 */
+	void prune();
+
+	const PruningReport& getReport() const { return report_; }
+
+	NodeValueMap getNodeValues() { return graphBuilder_->getNodeValues(); }
+	ArcValueMap getArcValues() { return graphBuilder_->getArcValues(); }
+	DivisionValueMap getDivisionValues() { return graphBuilder_->getDivisionValues(); }
+	void visitNodeValues(const NodeValueVisitor& visitor) { graphBuilder_->visitNodeValues(visitor); }
+	void visitArcValues(const ArcValueVisitor& visitor) { graphBuilder_->visitArcValues(visitor); }
+	void visitDivisions(const DivisionVisitor& visitor) { graphBuilder_->visitDivisions(visitor); }
+
+private:
+	struct NodeHypothesis
+	{
+		size_t id;
+		CostDeltaVector detectionCosts;
+		CostDeltaVector detectionCostDeltas;
+		CostDeltaVector appearanceCostDeltas;
+		CostDeltaVector disappearanceCostDeltas;
+		size_t targetIdx;
+		bool hasDivision;
+		ValueType divisionCostDelta;
+		/// indices of the links ending and starting here
+		std::vector<size_t> inLinks;
+		std::vector<size_t> outLinks;
+		/// number of objects that can pass the detection, 0 once it is removed
+		size_t maxValue;
+	};
+
+	struct LinkHypothesis
+	{
+		size_t srcIndex;
+		size_t destIndex;
+		CostDeltaVector costDeltas;
+		bool removed;
+	};
+
+	size_t getNodeIndex(size_t id, const std::string& hypothesis) const;
+
+	/// number of objects that can use the link
+	size_t getLinkMaxValue(const LinkHypothesis& link) const;
+
+	/// lower the maxValue of all detections to what their arcs can carry and remove unreachable hypotheses
+	/// @return whether anything changed
+	bool removeUnreachableHypotheses();
+
+	/// @return whether any link was removed
+	bool removeDominatedLinks();
+
+private:
+	GraphBuilder* graphBuilder_;
+	bool pruned_;
+
+	/// buffered hypotheses
+	std::vector<NodeHypothesis> nodes_;
+	std::vector<LinkHypothesis> links_;
+	/// ids of the dividing detections, in the order allowMitosis was called
+	std::vector<size_t> divisionIds_;
+	std::unordered_map<size_t, size_t> idToNodeIndexMap_;
+
+	PruningReport report_;
+};
+
+} // end namespace dpct
+
+#endif // PRUNING_GRAPH_BUILDER
@@ -4,12 +4,20 @@
 #include <lemon/list_graph.h>
 #include <lemon/maps.h>
 #include "early_stopping_bellman_ford.h"
+#include "csrdigraph.h"
 #include "log.h"
+#include "memorystatistics.h"
+#include "workerpool.h"
+#include <limits>
 #include <map>
 #include <memory>
+#include <stdexcept>
 #include <assert.h>
 #include <unordered_set>
 #include <set>
+#include <vector>
+#include <thread>
+#include <algorithm>
 
 namespace dpct
 {
@@ -17,6 +25,14 @@ namespace dpct
 /**
  * A residual graph has one forward an one backward arc for an original graph, 
  * with different costs, and only enabling them when the flow of the original graph allows them to be used.
+ * An original arc can also be shared with another node, which then gets a forward and backward residual arc
+ * to and from the arc's target with their own costs, capacities and enabled states. Paths report them as the original arc
+ * with the flow delta +-SharedStep, such that the flow of the sharing node can be kept apart from the arc's own flow.
+ * Division duplicates use this to leave along the out arcs of their parent without copies of them.
+ * A detection node of the original graph can carry costs and a capacity itself: it gets an in-side, which its in arcs enter,
+ * and an out-side, which its out arcs leave. The shortest path search crosses between the two sides along a forward and
+ * a backward transit with their own costs, capacities and tokens, without residual arcs. Paths do not report the transits,
+ * the flow through a detection node follows from the flow along its arcs.
  * This is a replacement for Lemon's ResidualGraph, as using several graph adapters on top of each other
  * slows down the shortest path search incredibly.
  */
@@ -32,41 +48,106 @@ public: // typedefs
     typedef Graph::NodeMap<double> BfDistMap;
     typedef std::vector<Node> BfProcess;
     typedef lemon::IterableValueMap<Graph, Node, size_t> NodeUpdateOrderMap;
-    typedef std::map<Node, Node> OriginMap;
-    typedef std::map<Node, Node> ResidualNodeMap;
-    typedef size_t Token;
-    typedef std::set<Token> TokenSet;
+    typedef std::vector<OriginalNode> OriginMap; // indexed by residual node id
+    typedef std::vector<Node> ResidualNodeMap; // indexed by original node id
+    typedef size_t Token; // the id of the original node whose division the token guards
     typedef lemon::EarlyStoppingBellmanFord<Graph, DistMap> BellmanFord;
-    typedef std::vector< std::pair<OriginalArc, int> > Path; // combines arc with flow delta (direction)
+    typedef std::vector< std::pair<OriginalArc, int> > Path; // combines arc with flow delta (direction), +-SharedStep for shared arcs
     typedef std::pair<Path, double> ShortestPathResult;
-    typedef std::pair<Node, Node> ResidualArcCandidate;
+    typedef std::pair<OriginalArc, bool> ArcOrigin; // original arc and whether the residual arc points forward
+    typedef std::vector< std::pair<OriginalArc, OriginalNode> > SharedArcs; // original arcs and the node sharing each
+    typedef std::vector<OriginalNode> DetectionNodes; // original nodes that carry costs and capacities themselves
+    typedef BellmanFord::TransitPartnerMap TransitPartnerMap;
+    typedef BellmanFord::TransitLengthMap TransitLengthMap;
 
     struct ResidualArcProperties 
 	{
 		double cost;
 		bool enabled;
 		bool present;
+		bool active; // whether the arc can currently be relaxed by the shortest path search
 		Arc arc;
 
 		ResidualArcProperties(double c=std::numeric_limits<double>::infinity(), 
 								bool e=true, 
 								bool p=true, 
 								Arc a=lemon::INVALID):
-			cost(c), enabled(e), present(p), arc(a)
+			cost(c), enabled(e), present(p), active(false), arc(a)
 		{}
 	};
-    typedef std::map<ResidualArcCandidate, ResidualArcProperties> ResidualArcMap;
+    typedef std::vector<ResidualArcProperties> ResidualArcMap; // indexed by residualArcIndex()
+    typedef std::vector<ArcOrigin> ResidualArcOriginMap; // indexed by residual arc id
+
+    typedef CsrDigraph CsrGraph;
+    typedef CsrGraph::ArcMap<double> CsrDistMap;
+    typedef lemon::EarlyStoppingBellmanFord<CsrGraph, CsrDistMap> CsrBellmanFord;
+
+    /**
+     * @brief Compressed sparse row copy of the (static) residual graph, ordered by timestep,
+     * together with the Bellman-Ford instance and all maps it needs.
+     */
+    struct CsrBackend
+    {
+    	CsrGraph graph;
+    	CsrDistMap lengthMap;
+    	CsrGraph::NodeMap<double> distMap;
+    	CsrGraph::NodeMap<CsrGraph::Arc> predMap;
+    	CsrGraph::NodeMap<double> potentialMap;
+    	CsrGraph::NodeOrderMap nodeOrderMap;
+    	CsrBellmanFord::TransitPartnerMap transitPartnerMap;
+    	CsrBellmanFord::TransitLengthMap transitLengthMap;
+    	std::vector<CsrGraph::Node> process;
+    	std::vector<CsrGraph::Node> nextProcess;
+    	std::vector<CsrGraph::Node> dirtyNodes;
+    	CsrBellmanFord bf;
+
+    	/// copies the transits as well if the graph has any
+    	CsrBackend(
+    		const Graph& g, 
+    		const DistMap& lengths, 
+    		const NodeUpdateOrderMap& nodeUpdateOrderMap,
+    		const TransitPartnerMap& transitPartners,
+    		const TransitLengthMap& transitLengths,
+    		bool hasTransits);
+
+    	CsrGraph::Node toCsr(const Node& n) const { return graph.nodeFromInputId(Graph::id(n)); }
+    	CsrGraph::Arc toCsr(const Arc& a) const { return graph.arcFromInputId(Graph::id(a)); }
+    	Node toResidual(const CsrGraph::Node& n) const { return Graph::nodeFromId(graph.inputNodeId(n)); }
+    	Arc toResidual(const CsrGraph::Arc& a) const 
+    	{
+    		return a == lemon::INVALID ? Arc(lemon::INVALID) : Graph::arcFromId(graph.inputArcId(a));
+    	}
+    };
 
 	static const bool Forward = true;
 	static const bool Backward = false;
 
+	/// work done by one findShortestPath call, including its retries after token violations
+	struct SearchStats
+	{
+		size_t bfRounds = 0;
+		size_t relaxations = 0;
+		/// nodes whose distances were invalidated by arcs that changed since the previous search
+		size_t dirtyNodes = 0;
+		size_t tokenRetries = 0;
+		bool negativeCycle = false;
+		/// whether the Bellman-Ford result was repaired around the negative cycle of the previous search
+		/// instead of being computed from scratch
+		bool cycleRepair = false;
+	};
+
 public: // API
 	ResidualGraph(
 		const Graph& original,
 		const OriginalNode& origSource, 
-		const std::map<OriginalNode, size_t>& nodeTimestepMap, 
+		const std::vector<size_t>& nodeTimestepMap, // indexed by original node id
+		const SharedArcs& sharedArcs, // every original arc can be shared with at most one node
 		bool useBackArcs=true,
-		bool useOrderedNodeListInBF=false);
+		bool useOrderedNodeListInBF=false,
+		bool useStaticArcs=false,
+		bool useCsrBackend=false,
+		bool useDijkstra=false,
+		const DetectionNodes& detectionNodes=DetectionNodes()); // their in-sides get the timestep of the node, their out-sides the next one
 	
 	/// set arc cost for the residual forward/backward arc corresponding to a in the original graph
 	/// if capacity = 0, the arc will be disabled and the cost ignored
@@ -76,6 +157,30 @@ public: // API
 	void enableArc(const OriginalArc& a, bool state);
 	bool getArcEnabledState(const OriginalArc& a);
 
+	/// whether another node uses the original arc through residual arcs of its own
+	bool isSharedArc(const OriginalArc& a) const
+	{
+		size_t index = originalGraph_.id(a);
+		return index < sharedArcSlots_.size() && sharedArcSlots_[index] != NoSharedArc;
+	}
+
+	/// like updateArc, for the residual arcs of the node sharing a. Does nothing if a is not shared
+	void updateSharedArc(const OriginalArc& a, bool forward, double cost, int capacity);
+
+	/// enable / disable both residual arcs of the node sharing a. Does nothing if a is not shared
+	void enableSharedArc(const OriginalArc& a, bool state);
+
+	/// whether the original node carries costs and a capacity itself, see DetectionNodes
+	bool isDetectionNode(const OriginalNode& n) const
+	{
+		size_t index = originalGraph_.id(n);
+		return index < detectionSlots_.size() && detectionSlots_[index] != NoDetection;
+	}
+
+	/// set the cost of the forward (from the in- to the out-side) / backward transit of a detection node,
+	/// if capacity = 0, the transit will be disabled and the cost ignored
+	void updateNode(const OriginalNode& n, bool forward, double cost, int capacity);
+
 	/// save graph to dot file
 	void fullGraphToDot(const std::string& filename, const Path& p) const;
 	void toDot(const std::string& filename, const Path& p, Node& s, Node& t) const;
@@ -85,101 +190,216 @@ public: // API
 		const std::vector<OriginalNode>& origTargets,
 		bool partialBFUpdates=true);
 
-	/// configure forbidden tokens of arcs
+	/**
+	 * @brief complement the path returned by the last successful findShortestPath() call by further negative
+	 *        cost paths of the same shortest path tree: one for every active residual in-arc of a target, traced
+	 *        back to the source in the order of increasing cost. A path is skipped as soon as its trace reaches
+	 *        a node whose conflict key a selected path uses already, passes through a target or violates
+	 *        the token specs. Must be called before the residual graph is modified again.
+	 * @param conflictKeys a key per original node id, the id of a node it conflicts with or its own.
+	 *        Nodes with a negative key never conflict
+	 * @param minCostRatio only take paths that cost at least this fraction of the shortest path
+	 * @return the shortest path followed by at most maxNumPaths-1 others, only the shortest path after a negative cycle
+	 */
+	std::vector<ShortestPathResult> collectDisjointTreePaths(
+		const ShortestPathResult& shortestPath,
+		const std::vector<OriginalNode>& origTargets,
+		const std::vector<int>& conflictKeys,
+		size_t maxNumPaths,
+		double minCostRatio=0.0) const;
+
+	/// marks residual arcs without a token
+	static const Token NoToken = std::numeric_limits<Token>::max();
+
+	/// the flow delta of a path step along the residual arcs of the node sharing an original arc is +-SharedStep,
+	/// the unit of flow it moves belongs to the sharing node
+	static const int SharedStep = 2;
+
+	/// configure forbidden tokens of arcs, every residual arc can forbid at most one token
 	void addForbiddenToken(const OriginalArc& a, bool forward, Token token);
 	void removeForbiddenToken(const OriginalArc& a, bool forward, Token token);
 
-	/// configure provided tokens of arcs
+	/// let the forward/backward transit of a detection node forbid a token, like a residual arc
+	void addForbiddenToken(const OriginalNode& n, bool forward, Token token);
+
+	/// configure provided tokens of arcs, every residual arc can provide at most one token
 	void addProvidedToken(const OriginalArc& a, bool forward, Token token);
 	void removeProvidedToken(const OriginalArc& a, bool forward, Token token);
 
+	/// set the number of threads relaxing the nodes of each Bellman-Ford round, 0 = all cores
+	void setNumThreads(size_t numThreads);
+
+	/**
+	 * @brief after a negative cycle, only invalidate the shortest path subtrees hanging off the cycles of
+	 *        the predecessor map and continue the interrupted Bellman-Ford from there, instead of
+	 *        initializing it again from scratch. Only used with partial BF updates and without Dijkstra.
+	 */
+	void setLocalCycleRepair(bool localCycleRepair) { localCycleRepair_ = localCycleRepair; }
+
+	/// counters of the last findShortestPath call
+	const SearchStats& getLastSearchStats() const { return lastSearchStats_; }
+
+	/// number of residual arcs that were switched on or off since the residual graph was created
+	size_t getNumToggledArcs() const { return numToggledArcs_; }
+
+	/// add the node and arc counts and the containers of this residual graph and its shortest path search
+	void collectMemoryStatistics(MemoryStatistics& stats) const;
+
 private:
-	/// include/exclude an arc in this residual graph
-	void includeArc(const ResidualArcCandidate& a, ResidualArcProperties& arcProps);
+	/// include/exclude the forward/backward residual arc of an original arc in this residual graph
+	void includeArc(const OriginalArc& a, bool forward);
+
+	/// include/exclude the forward/backward residual arc of the node sharing an original arc
+	void includeSharedArc(const OriginalArc& a, bool forward);
+
+	/// include/exclude the residual arc at the given index that runs from s to t
+	void includeResidualArc(size_t index, const OriginalArc& a, bool forward, const Node& s, const Node& t);
 
-	/// set arc cost for the residual arc
-	void updateResidualArc(const ResidualArcCandidate& a, double cost, int capacity);
+	/// include/exclude the forward/backward transit of a detection node in the shortest path search
+	void includeTransit(const OriginalNode& n, bool forward);
+
+	/// allocate the residual arc at the given index once, for static arcs
+	void addStaticArc(size_t index, const OriginalArc& a, bool forward, const Node& s, const Node& t);
+
+	/// store whether a residual arc or transit is active and keep track of the number of active backward ones
+	void setArcActive(ResidualArcProperties& arcProps, bool forward, bool active);
+
+	/// reset the shortest path search and add the source
+	void initShortestPathSearch();
+
+	/// copy the work counters of the Bellman-Ford in use to the stats of the last search
+	void collectSearchCounters();
 
 	/**
-	 * @brief Check whether the path collected tokens which were forbidden on one of the later arcs
-	 * 
-	 * @param p path
-	 * @return true if no violations were found, otherwise (false, forbiddenToken)
+	 * @brief after the last search stopped at a negative cycle, add the source and all reached nodes whose
+	 *        distance is not backed by their path in the shortest path tree to the dirty nodes.
+	 *        These are the nodes on or behind cycles of the predecessor map, and those whose distance
+	 *        was derived from a negative distance of the source. All other distances remain valid upper bounds,
+	 *        such that the next update only has to invalidate the subtrees of the dirty nodes.
 	 */
-	std::pair<bool, Token> pathSatisfiesTokenSpecs(const Path& p) const;
+	void markUnsoundDistances();
+
+	/// store the token of an arc, which can only have one
+	void setArcToken(Token& arcToken, Token token);
+
+	/// start collecting the tokens of a new path, forgetting those of the previous one in O(1)
+	void beginTokenCheck() const;
+
+	/**
+	 * @brief collect the provided and forbidden token of a residual arc of the current path
+	 * @return false if a token of this arc is both provided and forbidden along the path so far, 
+	 *         then the smallest such token is stored in violatedToken
+	 */
+	bool checkArcTokens(size_t residualArcIndex, Token& violatedToken) const;
 
 	/**
-	 * @brief Transform original graph arc to ordered residual graph node pair, using the specified direction
+	 * @brief Index of the forward/backward residual arc of an original arc in the dense per-arc vectors
 	 * @param a original graph arc
 	 * @param forward true if we want the forward residual arc along this edge
 	 * 
-	 * @return residual graph node pair 
+	 * @return position in residualArcs_, residualArcProvidesToken_ and residualArcForbidsToken_
 	 */
-	ResidualArcCandidate undirectedArcToPair(const OriginalArc& a, bool forward) const
+	size_t residualArcIndex(const OriginalArc& a, bool forward) const
 	{
-		return forward ? arcToPair(a) : arcToInversePair(a);
+		return 2 * originalGraph_.id(a) + (forward ? 0 : 1);
 	}
 
-	/**
-	 * @brief Transform an arc of the original graph into an forward oriented node pair (the ResidualArcCandidate) of the residual graph
-	 * @param a original graph arc
-	 * 
-	 * @return forward arc in residual graph encoded as pair of nodes
-	 */
-	ResidualArcCandidate arcToPair(const OriginalArc& a) const
+	/// index of the forward/backward residual arc of the node sharing a, behind those of all original arcs
+	size_t sharedArcIndex(const OriginalArc& a, bool forward) const
 	{
-		return std::make_pair(residualNodeMap_.at(originalGraph_.source(a)), 
-				residualNodeMap_.at(originalGraph_.target(a)));
+		return sharedArcOffset_ + 2 * sharedArcSlots_[originalGraph_.id(a)] + (forward ? 0 : 1);
 	}
 
-	/**
-	 * @brief Transform an arc of the original graph into an backward oriented node pair (the ResidualArcCandidate) of the residual graph
-	 * @param a original graph arc
-	 * 
-	 * @return backward arc in residual graph encoded as pair of nodes
-	 */
-	ResidualArcCandidate arcToInversePair(const OriginalArc& a) const
+	/// index of the forward/backward transit of a detection node, behind those of all shared arcs
+	size_t transitIndex(const OriginalNode& n, bool forward) const
 	{
-		return std::make_pair(residualNodeMap_.at(originalGraph_.target(a)), 
-				residualNodeMap_.at(originalGraph_.source(a)));
+		return transitOffset_ + 2 * detectionSlots_[originalGraph_.id(n)] + (forward ? 0 : 1);
 	}
 
-	/**
-	 * @brief Transform an arc of the residual graph into an ordered node pair (the ResidualArcCandidate) of the residual graph
-	 * @param a residual graph arc
-	 * 
-	 * @return arc in residual graph encoded as pair of nodes
-	 */
-	ResidualArcCandidate residualArcToPair(const Arc& a) const
+	/// index of the transit that ends at a side of a detection node, the forward one ends at the out-side
+	size_t transitIndexInto(const Node& n) const
 	{
-		return std::make_pair(source(a), target(a));
+		OriginalNode origin = originNode(n);
+		return transitIndex(origin, residualOutNode(origin) == n);
 	}
 
-	/**
-	 * @brief Transform a node pair of the residual graph into an residual arc
-	 * @param a residual graph node pair
-	 * 
-	 * @return arc in residual graph
-	 */
-	Arc pairToResidualArc(const ResidualArcCandidate& ac) const
+	/// index of a present residual arc, telling the arcs of a shared original arc apart
+	size_t indexOfResidualArc(const Arc& a) const
 	{
-		return lemon::findArc(*this, ac.first, ac.second);
+		const ArcOrigin& origin = residualArcToOriginalArc(a);
+		size_t index = residualArcIndex(origin.first, origin.second);
+		if(residualArcs_[index].arc != a)
+			index = sharedArcIndex(origin.first, origin.second);
+		return index;
 	}
 
-	// return the original arc and a boolean whether the residual arc was forward or backward
-	std::pair<OriginalArc, bool> pairToOriginalArc(const ResidualArcCandidate& ac) const
+	/// the original arc of a present residual arc and the flow delta of a path step along it
+	std::pair<OriginalArc, int> pathStep(const Arc& a) const
 	{
-		OriginalArc a = lemon::findArc(originalGraph_, originMap_.at(ac.first), originMap_.at(ac.second));
-		if(a != lemon::INVALID)
-			return std::make_pair(a, true);
-		else
-		{
-			a = lemon::findArc(originalGraph_, originMap_.at(ac.second), originMap_.at(ac.first));
-			assert(a != lemon::INVALID);
-			return std::make_pair(a, false);
-		}
+		const ArcOrigin& origin = residualArcToOriginalArc(a);
+		int step = indexOfResidualArc(a) >= sharedArcOffset_ ? SharedStep : 1;
+		return std::make_pair(origin.first, origin.second ? step : -step);
+	}
+
+	/// residual node corresponding to a node of the original graph, the in-side of a detection node
+	Node residualNode(const OriginalNode& n) const
+	{
+		return residualNodeMap_[originalGraph_.id(n)];
+	}
+
+	/// residual node that the residual arcs of the out arcs of an original node start from, the out-side of a detection node
+	Node residualOutNode(const OriginalNode& n) const
+	{
+		return isDetectionNode(n) ? detectionOutNodes_[detectionSlots_[originalGraph_.id(n)]] : residualNode(n);
+	}
+
+	/// original node corresponding to a node of the residual graph
+	OriginalNode originNode(const Node& n) const
+	{
+		return originMap_[id(n)];
 	}
 
+	/// return the original arc and a boolean whether the residual arc was forward or backward
+	const ArcOrigin& residualArcToOriginalArc(const Arc& a) const
+	{
+		assert((size_t)id(a) < residualArcOriginMap_.size());
+		return residualArcOriginMap_[id(a)];
+	}
+
+	/// query the results of the last shortest path search of whichever backend is in use
+	double shortestPathDist(const Node& n) const
+	{
+		return csr_ ? csr_->bf.dist(csr_->toCsr(n)) : bf.dist(n);
+	}
+
+	bool shortestPathReached(const Node& n) const
+	{
+		return csr_ ? csr_->bf.reached(csr_->toCsr(n)) : bf.reached(n);
+	}
+
+	Arc shortestPathPredArc(const Node& n) const
+	{
+		return csr_ ? csr_->toResidual(csr_->bf.predArc(csr_->toCsr(n))) : bf.predArc(n);
+	}
+
+	bool shortestPathPredTransit(const Node& n) const
+	{
+		return csr_ ? csr_->bf.predTransit(csr_->toCsr(n)) : bf.predTransit(n);
+	}
+
+	/// if the last search reached a side of a detection node over its transit, check the tokens of the transit
+	/// like checkArcTokens and return the other side, where the tree path continues. Otherwise return n
+	Node crossTransit(const Node& n, Token& violatedToken) const
+	{
+		if(!shortestPathPredTransit(n))
+			return n;
+		checkArcTokens(transitIndexInto(n), violatedToken);
+		return transitPartnerMap_[n];
+	}
+
+	/// nodes of the negative cycle found in the last search in the order of the cycle, each is entered from the one before
+	std::vector<Node> negativeCycleNodes() const;
+
 private:
 	/// Original graph
 	const Graph& originalGraph_;
@@ -191,6 +411,18 @@ private:
 	/// ordered by timesteps as in magnusson
 	bool useOrderedNodeListInBF_;
 
+	/// whether all residual arcs are allocated once in the constructor and disabled by an infinite cost
+	/// and in the CSR view instead of being erased from and re-added to the underlying graph on every toggle
+	bool useStaticArcs_;
+
+	/// with static arcs, shortest paths are searched on this CSR copy of the residual graph instead of the
+	/// ListDigraph, whose adjacency skips the disabled arcs
+	std::unique_ptr<CsrBackend> csr_;
+
+	/// whether every search runs Dijkstra on costs reduced by the distances of the previous search,
+	/// instead of updating the previous Bellman-Ford result
+	bool useDijkstra_;
+
 	/// the distance(=cost) map of this residual graph used for shortest path computation
 	DistMap residualDistMap_;
 
@@ -200,12 +432,49 @@ private:
 	/// a mapping from original nodes to residual nodes
 	ResidualNodeMap residualNodeMap_;
 
-	/// a mapping from original arcs to residual arcs
-	ResidualArcMap residualArcMap_;
-
-	/// the required and provided tokens per residual arc - persistent even if arcs are disabled (and hence removed)
-	std::map<ResidualArcCandidate, TokenSet> residualArcProvidesTokens_;
-	std::map<ResidualArcCandidate, TokenSet> residualArcForbidsTokens_;
+	/// the properties of the forward and backward residual arc of every original arc, followed by those of every shared arc
+	ResidualArcMap residualArcs_;
+
+	/// marks original arcs that are not shared, and original nodes that are no detection nodes
+	static const size_t NoSharedArc = std::numeric_limits<size_t>::max();
+	static const size_t NoDetection = std::numeric_limits<size_t>::max();
+
+	/// per original arc id the number of its shared arc pair or NoSharedArc, and per pair the residual node sharing it.
+	/// The residual arcs of pair i are stored at sharedArcOffset_ + 2 * i (+ 1 for the backward one)
+	std::vector<size_t> sharedArcSlots_;
+	std::vector<Node> sharedArcSources_;
+	size_t sharedArcOffset_;
+
+	/// per original node id the number of its detection or NoDetection, and per detection the residual node of its out-side.
+	/// The transits of detection i are stored at transitOffset_ + 2 * i (+ 1 for the backward one)
+	std::vector<size_t> detectionSlots_;
+	std::vector<Node> detectionOutNodes_;
+	size_t transitOffset_;
+
+	/// per residual node the other side of its detection node, INVALID for all other nodes,
+	/// and the length of the transit towards it, infinite if the transit is inactive
+	TransitPartnerMap transitPartnerMap_;
+	TransitLengthMap transitLengthMap_;
+
+	/// back reference from each residual arc that is currently present to its original arc and direction
+	ResidualArcOriginMap residualArcOriginMap_;
+
+	/// the forbidden and provided token per residual arc, NoToken if it has none.
+	/// Persistent even if arcs are disabled (and hence removed)
+	std::vector<Token> residualArcProvidesToken_;
+	std::vector<Token> residualArcForbidsToken_;
+
+	/// per token the number of the path check that collected it as provided or forbidden, 
+	/// such that checking a path needs neither allocations nor clearing
+	mutable std::vector<size_t> providedTokenStamps_;
+	mutable std::vector<size_t> forbiddenTokenStamps_;
+	mutable size_t tokenCheckStamp_;
+
+	/// per conflict key the number of the collectDisjointTreePaths call whose selected paths use it,
+	/// and the candidate arcs of the current call, kept to reuse the memory
+	mutable std::vector<size_t> conflictKeyStamps_;
+	mutable size_t conflictKeyStamp_;
+	mutable std::vector< std::pair<double, Arc> > treePathCandidates_;
 
 	/// store an index for each node depending on when it should be updated
 	NodeUpdateOrderMap nodeUpdateOrderMap_;
@@ -213,14 +482,32 @@ private:
 	/// create the node distance and predecessor maps etc. only once and pass them to BF in each iteration
 	BfDistMap bfDistMap_;
 	BfPredMap bfPredMap_;
+	BfDistMap potentialMap_;
 	BfProcess bfProcess_;
 	BfProcess bfNextProcess_;
+	/// threads of the parallel Bellman-Ford rounds, shared by the ListDigraph and CSR searches
+	std::unique_ptr<WorkerPool> workerPool_;
 	BellmanFord bf;
 
+	/// number of backward residual arcs and transits that are currently active. As long as there are none,
+	/// all arcs point forward in time and shortest paths can be found by a sweep over the timesteps
+	size_t numActiveBackwardArcs_;
+
 	/// set of nodes that have invalidated during this iteration
 	std::vector<Node> dirtyNodes_;
 	bool firstPath_;
+
+	/// whether negative cycles are repaired locally, and whether the next search has to repair one
+	bool localCycleRepair_;
+	bool cycleRepairPending_;
+
+	/// per node id whether its distance is backed by its tree path, and the walk over the tree, reused by markUnsoundDistances
+	std::vector<char> soundDistance_;
+	std::vector<Node> treeWalk_;
 	Node source_;
+
+	SearchStats lastSearchStats_;
+	size_t numToggledArcs_;
 };
 
 
@@ -228,16 +515,11 @@ inline void ResidualGraph::updateArc(const OriginalArc& a, bool forward, double
 {
 	if(!useBackArcs_ && !forward)
 		return;
-	ResidualArcCandidate ac = undirectedArcToPair(a, forward);
-	updateResidualArc(ac, cost, capacity);
-}
 
-inline void ResidualGraph::updateResidualArc(const ResidualArcCandidate& ac, double cost, int capacity)
-{
-	DEBUG_MSG("Updating residual arc (" << id(ac.first) << ", " << id(ac.second) << ") with cost " 
-			<< cost << " and capacity " << capacity);
+	DEBUG_MSG("Updating " << (forward ? "forward" : "backward") << " residual arc of " << originalGraph_.id(a) 
+			<< " with cost " << cost << " and capacity " << capacity);
 
-	ResidualArcProperties& arcProps = residualArcMap_[ac];
+	ResidualArcProperties& arcProps = residualArcs_[residualArcIndex(a, forward)];
 	if(capacity > 0)
 	{
 		arcProps.cost = cost;
@@ -247,14 +529,77 @@ inline void ResidualGraph::updateResidualArc(const ResidualArcCandidate& ac, dou
 	{
 		arcProps.present = false;
 	}
-	includeArc(ac, arcProps);
+	includeArc(a, forward);
+}
+
+inline void ResidualGraph::updateSharedArc(const OriginalArc& a, bool forward, double cost, int capacity)
+{
+	if((!useBackArcs_ && !forward) || !isSharedArc(a))
+		return;
+
+	DEBUG_MSG("Updating shared " << (forward ? "forward" : "backward") << " residual arc of " << originalGraph_.id(a) 
+			<< " with cost " << cost << " and capacity " << capacity);
+
+	ResidualArcProperties& arcProps = residualArcs_[sharedArcIndex(a, forward)];
+	arcProps.present = capacity > 0;
+	if(arcProps.present)
+		arcProps.cost = cost;
+	includeSharedArc(a, forward);
+}
+
+inline void ResidualGraph::updateNode(const OriginalNode& n, bool forward, double cost, int capacity)
+{
+	if(!useBackArcs_ && !forward)
+		return;
+
+	DEBUG_MSG("Updating " << (forward ? "forward" : "backward") << " transit of " << originalGraph_.id(n) 
+			<< " with cost " << cost << " and capacity " << capacity);
+
+	ResidualArcProperties& transitProps = residualArcs_[transitIndex(n, forward)];
+	transitProps.present = capacity > 0;
+	if(transitProps.present)
+		transitProps.cost = cost;
+	includeTransit(n, forward);
 }
 
-inline void ResidualGraph::includeArc(const ResidualArcCandidate& ac, ResidualArcProperties& arcProps)
+inline void ResidualGraph::includeArc(const OriginalArc& a, bool forward)
 {
+	Node s = forward ? residualOutNode(originalGraph_.source(a)) : residualNode(originalGraph_.target(a));
+	Node t = forward ? residualNode(originalGraph_.target(a)) : residualOutNode(originalGraph_.source(a));
+	includeResidualArc(residualArcIndex(a, forward), a, forward, s, t);
+}
+
+inline void ResidualGraph::includeSharedArc(const OriginalArc& a, bool forward)
+{
+	Node sharing = sharedArcSources_[sharedArcSlots_[originalGraph_.id(a)]];
+	Node t = residualNode(originalGraph_.target(a));
+	includeResidualArc(sharedArcIndex(a, forward), a, forward, forward ? sharing : t, forward ? t : sharing);
+}
+
+inline void ResidualGraph::includeResidualArc(size_t index, const OriginalArc& a, bool forward, const Node& s, const Node& t)
+{
+	ResidualArcProperties& arcProps = residualArcs_[index];
+	if(useStaticArcs_)
+	{
+		// arcs never change, inactive ones just can never be relaxed
+		if(arcProps.arc == lemon::INVALID)
+			return;
+		bool active = arcProps.present && arcProps.enabled;
+		setArcActive(arcProps, forward, active);
+		DEBUG_MSG((active ? "enabling" : "disabling") << " static residual arc: " 
+			<< id(source(arcProps.arc)) << ", " << id(target(arcProps.arc)));
+		double cost = active ? arcProps.cost : std::numeric_limits<double>::infinity();
+		residualDistMap_[arcProps.arc] = cost;
+		csr_->lengthMap.set(csr_->toCsr(arcProps.arc), cost);
+		csr_->graph.setArcEnabled(csr_->toCsr(arcProps.arc), active);
+		dirtyNodes_.push_back(t);
+		return;
+	}
+
+	setArcActive(arcProps, forward, arcProps.present && arcProps.enabled);
 	if(!arcProps.present || !arcProps.enabled)
 	{
-		DEBUG_MSG("disabling residual arc: " << id(ac.first) << ", " << id(ac.second));
+		DEBUG_MSG("disabling residual arc: " << id(s) << ", " << id(t));
 		if(arcProps.arc != lemon::INVALID)
 		{
 			erase(arcProps.arc);
@@ -263,71 +608,191 @@ inline void ResidualGraph::includeArc(const ResidualArcCandidate& ac, ResidualAr
 	}
 	else
 	{
-		DEBUG_MSG("enabling residual arc: " << id(ac.first) << ", " << id(ac.second));
+		DEBUG_MSG("enabling residual arc: " << id(s) << ", " << id(t));
 		if(arcProps.arc == lemon::INVALID)
 		{
-			Arc a = addArc(ac.first, ac.second);
-			arcProps.arc = a;
-			residualDistMap_[a] = arcProps.cost;
+			Arc ra = addArc(s, t);
+			arcProps.arc = ra;
+			if((size_t)id(ra) >= residualArcOriginMap_.size())
+				residualArcOriginMap_.resize(id(ra) + 1);
+			residualArcOriginMap_[id(ra)] = std::make_pair(a, forward);
 		}
-		else
-			residualDistMap_[arcProps.arc] = arcProps.cost;
+		residualDistMap_[arcProps.arc] = arcProps.cost;
 	}
 
-	dirtyNodes_.push_back(ac.second);
+	dirtyNodes_.push_back(t);
+}
+
+inline void ResidualGraph::includeTransit(const OriginalNode& n, bool forward)
+{
+	ResidualArcProperties& transitProps = residualArcs_[transitIndex(n, forward)];
+	bool active = transitProps.present && transitProps.enabled;
+	setArcActive(transitProps, forward, active);
+
+	// the transit leaves the side that the arcs of its direction enter
+	Node in = residualNode(n);
+	Node out = residualOutNode(n);
+	Node s = forward ? in : out;
+	double length = active ? transitProps.cost : std::numeric_limits<double>::infinity();
+	DEBUG_MSG((active ? "enabling" : "disabling") << " transit: " << id(s) << ", " << id(forward ? out : in));
+	transitLengthMap_[s] = length;
+	if(csr_)
+		csr_->transitLengthMap.set(csr_->toCsr(s), length);
+	dirtyNodes_.push_back(forward ? out : in);
+}
+
+inline void ResidualGraph::setArcActive(ResidualArcProperties& arcProps, bool forward, bool active)
+{
+	if(arcProps.active != active)
+		numToggledArcs_++;
+	if(!forward && arcProps.active != active)
+	{
+		if(active)
+			numActiveBackwardArcs_++;
+		else
+			numActiveBackwardArcs_--;
+	}
+	arcProps.active = active;
 }
 
 inline bool ResidualGraph::getArcEnabledState(const OriginalArc& a)
 {
 	// use the latest cost and flow states
-	ResidualArcCandidate ac = arcToPair(a);
-	ResidualArcProperties& arcProps = residualArcMap_[ac];
-	return arcProps.enabled;
+	return residualArcs_[residualArcIndex(a, Forward)].enabled;
 }
 
 inline void ResidualGraph::enableArc(const OriginalArc& a, bool state)
 {
 	// use the latest cost and flow states
-	ResidualArcCandidate ac = arcToPair(a);
-	ResidualArcProperties& arcProps = residualArcMap_[ac];
-	arcProps.enabled = state;
-	includeArc(ac, arcProps);
+	residualArcs_[residualArcIndex(a, Forward)].enabled = state;
+	includeArc(a, Forward);
 	
 	if(useBackArcs_)
 	{
-		ac = arcToInversePair(a);
-		ResidualArcProperties& arcProps = residualArcMap_[ac];
-		arcProps.enabled = state;
-		includeArc(ac, arcProps);
+		residualArcs_[residualArcIndex(a, Backward)].enabled = state;
+		includeArc(a, Backward);
+	}
+}
+
+inline void ResidualGraph::enableSharedArc(const OriginalArc& a, bool state)
+{
+	if(!isSharedArc(a))
+		return;
+
+	residualArcs_[sharedArcIndex(a, Forward)].enabled = state;
+	includeSharedArc(a, Forward);
+
+	if(useBackArcs_)
+	{
+		residualArcs_[sharedArcIndex(a, Backward)].enabled = state;
+		includeSharedArc(a, Backward);
 	}
 }
 
 
 /// configure required tokens of arcs
+inline void ResidualGraph::setNumThreads(size_t numThreads)
+{
+	if(numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	if(numThreads == 1)
+	{
+		bf.numThreads(1);
+		if(csr_)
+			csr_->bf.numThreads(1);
+		workerPool_.reset();
+		return;
+	}
+
+	if(!workerPool_ || workerPool_->getNumThreads() != numThreads)
+		workerPool_.reset(new WorkerPool(numThreads));
+	bf.workerPool(*workerPool_);
+	if(csr_)
+		csr_->bf.workerPool(*workerPool_);
+}
+
 inline void ResidualGraph::addForbiddenToken(const OriginalArc& a, bool forward, Token token)
 {
-	ResidualArcCandidate ac = undirectedArcToPair(a, forward);
-	residualArcForbidsTokens_[ac].insert(token);
+	setArcToken(residualArcForbidsToken_[residualArcIndex(a, forward)], token);
 }
 
 inline void ResidualGraph::removeForbiddenToken(const OriginalArc& a, bool forward, Token token)
 {
-	ResidualArcCandidate ac = undirectedArcToPair(a, forward);
-	residualArcForbidsTokens_[ac].erase(token);
+	Token& arcToken = residualArcForbidsToken_[residualArcIndex(a, forward)];
+	if(arcToken == token)
+		arcToken = NoToken;
+}
+
+inline void ResidualGraph::addForbiddenToken(const OriginalNode& n, bool forward, Token token)
+{
+	setArcToken(residualArcForbidsToken_[transitIndex(n, forward)], token);
 }
 
 
 /// configure provided tokens of arcs
 inline void ResidualGraph::addProvidedToken(const OriginalArc& a, bool forward, Token token)
 {
-	ResidualArcCandidate ac = undirectedArcToPair(a, forward);
-	residualArcProvidesTokens_[ac].insert(token);
+	setArcToken(residualArcProvidesToken_[residualArcIndex(a, forward)], token);
 }
 
 inline void ResidualGraph::removeProvidedToken(const OriginalArc& a, bool forward, Token token)
 {
-	ResidualArcCandidate ac = undirectedArcToPair(a, forward);
-	residualArcProvidesTokens_[ac].erase(token);
+	Token& arcToken = residualArcProvidesToken_[residualArcIndex(a, forward)];
+	if(arcToken == token)
+		arcToken = NoToken;
+}
+
+inline void ResidualGraph::setArcToken(Token& arcToken, Token token)
+{
+	if(token == NoToken)
+		throw std::runtime_error("Invalid token");
+	if(arcToken != NoToken && arcToken != token)
+		throw std::runtime_error("A residual arc can provide and forbid at most one token each");
+	arcToken = token;
+	if(token >= providedTokenStamps_.size())
+	{
+		providedTokenStamps_.resize(token + 1, 0);
+		forbiddenTokenStamps_.resize(token + 1, 0);
+	}
+}
+
+inline void ResidualGraph::beginTokenCheck() const
+{
+	if(++tokenCheckStamp_ == 0)
+	{
+		// after an overflow old stamps could be mistaken for current ones
+		std::fill(providedTokenStamps_.begin(), providedTokenStamps_.end(), 0);
+		std::fill(forbiddenTokenStamps_.begin(), forbiddenTokenStamps_.end(), 0);
+		tokenCheckStamp_ = 1;
+	}
+}
+
+inline bool ResidualGraph::checkArcTokens(size_t residualArcIndex, Token& violatedToken) const
+{
+	bool valid = true;
+	Token provided = residualArcProvidesToken_[residualArcIndex];
+	if(provided != NoToken)
+	{
+		providedTokenStamps_[provided] = tokenCheckStamp_;
+		if(forbiddenTokenStamps_[provided] == tokenCheckStamp_)
+		{
+			violatedToken = std::min(violatedToken, provided);
+			valid = false;
+		}
+	}
+
+	Token forbidden = residualArcForbidsToken_[residualArcIndex];
+	if(forbidden != NoToken)
+	{
+		forbiddenTokenStamps_[forbidden] = tokenCheckStamp_;
+		if(providedTokenStamps_[forbidden] == tokenCheckStamp_)
+		{
+			violatedToken = std::min(violatedToken, forbidden);
+			valid = false;
+		}
+	}
+	return valid;
 }
 
 
@@ -0,0 +1,102 @@
+#ifndef DPCT_SOLVER_TELEMETRY_H
+#define DPCT_SOLVER_TELEMETRY_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Counters and timers of one solver iteration, which augments one batch of paths (flow solver)
+ * or adds one path (Magnusson). Counters that a solver does not have stay zero.
+ */
+struct IterationTelemetry
+{
+	size_t iteration = 0;
+	/// wall time of the whole iteration
+	double seconds = 0.0;
+	/// time spent searching the shortest path (flow solver), or updating the scores (Magnusson)
+	double searchSeconds = 0.0;
+	/// time spent augmenting the flow and updating the constraints, or inserting swap arcs
+	double augmentSeconds = 0.0;
+	/// Bellman-Ford rounds and improving relaxations of the search
+	size_t bfRounds = 0;
+	size_t relaxations = 0;
+	/// nodes whose distance (or score) had to be updated, because arcs around them changed
+	size_t dirtyNodes = 0;
+	/// arcs whose residual capacity or availability was toggled after augmentation
+	size_t arcsToggled = 0;
+	/// searches that were repeated because the path violated the division constraints
+	size_t tokenRetries = 0;
+	/// number of negative cycles found instead of a path
+	size_t negativeCycles = 0;
+	/// number of searches that repaired the distances around the previous negative cycle instead of
+	/// starting from scratch, compare their seconds with those of other iterations after a cycle
+	size_t cycleRepairs = 0;
+	/// number of paths or cycles augmented in this iteration, and the length and cost of the first one
+	size_t numPaths = 0;
+	size_t pathLength = 0;
+	double pathCost = 0.0;
+	/// energy after the iteration
+	double energy = 0.0;
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Collects the iteration telemetry of tracking runs, and exports it as CSV or JSON trace.
+ *
+ * Solvers only record telemetry if one is attached to them, otherwise they keep just a few counters,
+ * so this works in release builds without the overhead of the debug log.
+ */
+class SolverTelemetry
+{
+public:
+	/// @param solver name of the solver, stored with the trace
+	SolverTelemetry(const std::string& solver=""):
+		solver_(solver),
+		setupSeconds_(0.0)
+	{}
+
+	void clear() { iterations_.clear(); setupSeconds_ = 0.0; }
+
+	void setSolver(const std::string& solver) { solver_ = solver; }
+	const std::string& getSolver() const { return solver_; }
+
+	/// time spent before the first iteration, e.g. building the residual graph
+	void addSetupSeconds(double seconds) { setupSeconds_ += seconds; }
+	double getSetupSeconds() const { return setupSeconds_; }
+
+	void addIteration(const IterationTelemetry& iteration) { iterations_.push_back(iteration); }
+	const std::vector<IterationTelemetry>& getIterations() const { return iterations_; }
+
+	/// @return the sums of all counters and timers (path lengths and costs only of augmented paths),
+	///         with the energy and iteration number of the last iteration
+	IterationTelemetry getTotals() const;
+
+	/// names of the counters and timers of an iteration, in the order of the CSV columns
+	static const std::vector<std::string>& getColumnNames();
+
+	/// the counters and timers of an iteration in the order of getColumnNames()
+	static std::vector<double> getColumnValues(const IterationTelemetry& iteration);
+
+	/// one line per iteration, with a header line naming the columns
+	void writeCsv(std::ostream& out) const;
+
+	/// an object with the solver, the setup time, the totals and the list of all iterations
+	void writeJson(std::ostream& out) const;
+
+	/// write JSON if the filename ends with ".json", CSV otherwise
+	void save(const std::string& filename) const;
+
+private:
+	std::string solver_;
+	double setupSeconds_;
+	std::vector<IterationTelemetry> iterations_;
+};
+
+} // end namespace dpct
+
+#endif // DPCT_SOLVER_TELEMETRY_H
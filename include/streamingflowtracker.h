@@ -0,0 +1,107 @@
+#ifndef STREAMING_FLOW_TRACKER
+#define STREAMING_FLOW_TRACKER
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "graphbuilder.h"
+#include "flowgraph.h"
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Flow based tracking of an unbounded sequence of timesteps,
+ * keeping only a sliding window of the last timesteps in the flow graph.
+ *
+ * Hypotheses are added through the GraphBuilder interface, timestep after timestep,
+ * and the node timesteps must be set before adding a node. Once all hypotheses of a timestep are in,
+ * finishTimestep() re-tracks the window starting from the previous solution.
+ * Timesteps that drop out of the window are committed: their results are handed to the result callback,
+ * and they are removed from the flow graph. Tracks leaving them become fixed inflow into the window,
+ * so committed decisions are never revised. Links can only start at detections inside the window.
+ */
+class StreamingFlowTracker : public GraphBuilder {
+public:
+	/// the solution of one committed timestep, links and divisions are reported at their source / parent
+	struct TimestepResult
+	{
+		size_t timestep;
+		NodeValueMap nodeValues;
+		ArcValueMap arcValues;
+		DivisionValueMap divisionValues;
+	};
+	typedef std::function<void(const TimestepResult&)> ResultCallback;
+
+	/**
+	 * @param windowSize number of timesteps that are kept in the flow graph and can still change
+	 * @param resultCallback called with the result of every committed timestep, in order
+	 */
+	StreamingFlowTracker(size_t windowSize, ResultCallback resultCallback);
+
+	void addNode(
+		size_t id,
+		const CostDeltaVector& detectionCosts,
+		const CostDeltaVector& detectionCostDeltas,
+		const CostDeltaVector& appearanceCostDeltas,
+		const CostDeltaVector& disappearanceCostDeltas,
+		size_t targetIdx=0);
+
+	void addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas);
+
+	void allowMitosis(size_t id, ValueType divisionCostDelta);
+
+	/**
+	 * @brief re-track the window after all hypotheses up to the given timestep were added,
+	 *        and commit the timesteps that do not fit into the window any more.
+	 * @return the energy of all committed timesteps and the current solution of the window
+	 */
+	double finishTimestep(size_t timestep);
+
+	/// commit all remaining timesteps at the end of the stream
+	void flush();
+
+	/// the energy of all committed timesteps and the current solution of the window
+	double getEnergy() const { return committedEnergy_ + graph_.getFlowEnergy(); }
+
+	/// number of uncommitted timesteps and detections in the flow graph
+	size_t getNumWindowTimesteps() const { return idsPerTimestep_.size(); }
+	size_t getNumWindowNodes() const { return idToFlowGraphNodeMap_.size(); }
+
+	/// set the number of threads relaxing each Bellman-Ford round, 0 = all cores
+	void setNumThreads(size_t numThreads) { numThreads_ = numThreads; }
+
+	/// the values of the uncommitted window, these can still change
+	NodeValueMap getNodeValues();
+	ArcValueMap getArcValues();
+	DivisionValueMap getDivisionValues();
+
+private:
+	/// report the oldest timestep of the window and freeze it into the flow graph
+	void commitOldestTimestep();
+
+	/// flow graph with the window
+	FlowGraph graph_;
+
+	size_t windowSize_;
+	ResultCallback resultCallback_;
+	size_t numThreads_;
+
+	/// energy of the flow along all arcs of committed timesteps
+	double committedEnergy_;
+
+	/// ids of the detections per uncommitted timestep
+	std::map<size_t, std::vector<size_t>> idsPerTimestep_;
+
+	/// mapping from id to flow graph nodes, division arcs and outgoing links of all uncommitted detections
+	std::unordered_map<size_t, FlowGraph::FullNode> idToFlowGraphNodeMap_;
+	std::unordered_map<size_t, FlowGraph::Arc> idToFlowGraphDivisionArcMap_;
+	std::unordered_map<size_t, std::vector<std::pair<size_t, FlowGraph::Arc>>> idToOutLinksMap_;
+};
+
+} // end namespace dpct
+
+#endif // STREAMING_FLOW_TRACKER
@@ -0,0 +1,239 @@
+#ifndef TEMPORAL_BLOCK_FLOW_GRAPH_BUILDER
+#define TEMPORAL_BLOCK_FLOW_GRAPH_BUILDER
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "graphbuilder.h"
+#include "flowgraph.h"
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief The solution of one time block, as found by TemporalBlockFlowGraphBuilder::solveBlock,
+ * possibly by a worker process on another host, or of consecutive blocks tracked together
+ */
+struct BlockResult
+{
+	size_t block = 0;
+	/// the last of the blocks tracked together, the same as block for a single one
+	size_t lastBlock = 0;
+	/// energy of the hypotheses whose values are taken from this block, without the initial state energy
+	double energy = 0.0;
+	/// the used hypotheses of the block
+	GraphBuilder::NodeValueMap nodeValues;
+	GraphBuilder::ArcValueMap arcValues;
+	GraphBuilder::DivisionValueMap divisionValues;
+
+	/// write the block and its energy, and the used hypotheses in the format of the tracking result
+	void save(const std::string& filename) const;
+
+	/// read a block result written by save()
+	static BlockResult load(const std::string& filename);
+};
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief Graph builder that splits the model into overlapping blocks of consecutive timesteps,
+ * tracks each of them in its own flow graph, and stitches the block solutions together.
+ *
+ * Block b covers the timesteps [b * (blockLength - overlap), b * (blockLength - overlap) + blockLength - 1],
+ * such that consecutive blocks share overlap timesteps. Detections belong to the blocks containing their last timestep,
+ * and a block contains the links between its detections. A link whose detections are in no common block, because it skips
+ * a whole overlap, makes the blocks from the one of its source to the one of its target a span that is tracked in one flow graph,
+ * and the overlaps inside a span are not stitched. Every process reads all links, so all of them find the same spans.
+ *
+ * The solution before an overlap is taken from the stitched blocks before it, the solution after it from the next block.
+ * The overlap is tracked again in a small flow graph, together with up to overlap timesteps before and behind it,
+ * as far as this window stays clear of the neighbouring overlaps. Only the borders of the window are fixed:
+ * - the detections right before it hand the window the objects they do not send elsewhere, which may also disappear there,
+ * - the detections right behind it take as many objects as they do not get from elsewhere, which may also appear there.
+ * So a track on which the blocks disagree ends or starts at the border instead of being forced through the window.
+ * Like everywhere in the model, all objects of such a detection disappear or appear there, or none of them.
+ * The flows of links from detections further away, and of dividing detections, into and out of the window are kept
+ * with costs that outweigh all others, like frozen arcs of a FlowGraph. If the window cannot keep them, the blocks on both sides
+ * of the overlap join one span, and the spans are tracked and stitched again. At worst the whole model becomes one span.
+ *
+ * The window starts from zero flow instead of being warm-started with augmentUnitFlow and updateEnabledArcs like magnusson-flow:
+ * the blocks disagree inside the overlap, so their flows do not add up to a flow of the window that keeps its borders,
+ * and splicing one together would need appearances and disappearances the model need not allow. The window is small,
+ * so tracking it from scratch costs little next to the blocks.
+ *
+ * In the simplest case solve() tracks all spans in one process, with as many flow graphs at once as threads.
+ * To spread the blocks over several hosts, every worker reads the model restricted to its block, calls solveBlock()
+ * and saves the BlockResult, then one process reads the model restricted to the overlaps and calls stitch() with
+ * all loaded results, and a function that tracks the spans, e.g. by reading the model again restricted to them.
+ * Every process only keeps the hypotheses it needs, and the timesteps of all detections.
+ * The value maps contain the stitched solution.
+ */
+class TemporalBlockFlowGraphBuilder : public GraphBuilder {
+public:
+	/// tracks one flow graph and returns its energy, without the initial state energy
+	typedef std::function<double(FlowGraph&)> SolverFunction;
+
+	/// tracks the blocks firstBlock to lastBlock in one flow graph, like solveBlocks()
+	typedef std::function<BlockResult(size_t firstBlock, size_t lastBlock)> SpanSolverFunction;
+
+	/// which hypotheses are kept while the model is read: all, those of one block, or those of the stitching windows and their borders
+	enum class Restriction { None, Block, Overlaps };
+
+	/**
+	 * @param blockLength number of timesteps per block
+	 * @param overlap number of timesteps shared by consecutive blocks, at least one and at most half the block length
+	 * @param splitDetections whether the detections of the block and stitching flow graphs are split into two nodes, see FlowGraph
+	 */
+	TemporalBlockFlowGraphBuilder(size_t blockLength, size_t overlap, bool splitDetections = true);
+
+	/// only keep the hypotheses needed to solve one block, or to stitch the blocks. Must be set before reading the model
+	void setRestriction(Restriction restriction, size_t block = 0) { setRestriction(restriction, block, block); }
+
+	/// only keep the hypotheses needed to solve the blocks firstBlock to lastBlock together, with Restriction::Block
+	void setRestriction(Restriction restriction, size_t firstBlock, size_t lastBlock);
+
+	void reserve(size_t numDetections, size_t numLinks, size_t numDivisions);
+
+	void addNode(
+		size_t id,
+		const CostDeltaVector& detectionCosts,
+		const CostDeltaVector& detectionCostDeltas,
+		const CostDeltaVector& appearanceCostDeltas,
+		const CostDeltaVector& disappearanceCostDeltas,
+		size_t targetIdx=0);
+
+	void addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas);
+
+	void allowMitosis(size_t id, ValueType divisionCostDelta);
+
+	/// number of blocks covering all timesteps of the model
+	size_t getNumBlocks() const;
+	size_t getBlockFirstTimestep(size_t block) const { return block * (blockLength_ - overlap_); }
+	size_t getBlockLastTimestep(size_t block) const { return getBlockFirstTimestep(block) + blockLength_ - 1; }
+
+	/// number of links that skip a whole overlap, such that the blocks between their detections are tracked together
+	size_t getNumSkippedLinks() const { return numSkippedLinks_; }
+
+	/// number of overlaps that are not stitched, because skipping links or a failed stitching joined the blocks on both sides
+	size_t getNumMergedOverlaps() const { return std::count(mergedOverlaps_.begin(), mergedOverlaps_.end(), true); }
+
+	/// the first and last blocks of the spans of blocks that are tracked together, in temporal order
+	std::vector<std::pair<size_t, size_t> > getSpans() const;
+
+	/// track one block in its own flow graph, needs the hypotheses of the block
+	BlockResult solveBlock(size_t block, SolverFunction solver) const { return solveBlocks(block, block, solver); }
+
+	/// track the blocks firstBlock to lastBlock together in one flow graph, needs the hypotheses of these blocks
+	BlockResult solveBlocks(size_t firstBlock, size_t lastBlock, SolverFunction solver) const;
+
+	/**
+	 * @brief stitch the results of all blocks by tracking the window around every overlap again, needs the hypotheses of the windows.
+	 *        Afterwards, the value maps contain the stitched solution.
+	 * @param blocks one result of every block, or of every span of blocks tracked together
+	 * @param solveSpan tracks the spans of blocks that are not stitched, defaults to solveBlocks() if all hypotheses were kept
+	 * @return the energy of the stitched solution, without the initial state energy
+	 */
+	double stitch(std::vector<BlockResult> blocks, SolverFunction solver, SpanSolverFunction solveSpan = SpanSolverFunction());
+
+	/**
+	 * @brief solve all spans of blocks on numThreads threads (0 = all cores) and stitch them, needs all hypotheses
+	 * @return the energy of the stitched solution, without the initial state energy
+	 */
+	double solve(SolverFunction solver, size_t numThreads = 0);
+
+	NodeValueMap getNodeValues() { return nodeValues_; }
+	ArcValueMap getArcValues() { return arcValues_; }
+	DivisionValueMap getDivisionValues() { return divisionValues_; }
+
+private:
+	struct NodeHypothesis
+	{
+		size_t id;
+		CostDeltaVector detectionCosts;
+		CostDeltaVector detectionCostDeltas;
+		CostDeltaVector appearanceCostDeltas;
+		CostDeltaVector disappearanceCostDeltas;
+		size_t targetIdx;
+		std::pair<size_t, size_t> timesteps;
+		bool hasDivision;
+		ValueType divisionCostDelta;
+	};
+
+	/// the target of a link that leaves an overlap need not be buffered
+	struct LinkHypothesis
+	{
+		size_t srcId;
+		size_t destId;
+		CostDeltaVector costDeltas;
+	};
+
+	/// the timestep deciding the blocks of a detection
+	size_t getTimestep(const NodeHypothesis& node) const { return node.timesteps.second; }
+	bool isInBlocks(size_t timestep, size_t firstBlock, size_t lastBlock) const;
+
+	/// whether the blocks on both sides of overlap k are tracked together
+	bool isMergedOverlap(size_t overlap) const { return overlap < mergedOverlaps_.size() && mergedOverlaps_[overlap]; }
+
+	/// track the blocks containing both timesteps of a link together if no single block contains both
+	void mergeBlocksOfLink(size_t srcTimestep, size_t destTimestep);
+
+	/// the overlap of blocks k-1 and k containing the timestep, or 0 if the timestep is only in one block.
+	/// Behind the last block this can be an overlap with a block that does not exist
+	size_t getOverlap(size_t timestep) const;
+
+	/// whether the timestep is in the window of an overlap that is tracked again when stitching, or right before or behind one
+	bool isAroundStitchWindow(size_t timestep) const;
+
+	/// whether the blocks firstBlock to lastBlock, and not the stitching of an overlap, decide the hypotheses starting at the timestep
+	bool isDecidedByBlocks(size_t timestep, size_t firstBlock, size_t lastBlock, size_t numBlocks) const;
+
+	/**
+	 * @brief energy of the values of the selected detections, their appearances, disappearances and divisions,
+	 *        and their outgoing links. The links must contain all used links into and out of the selected detections.
+	 */
+	double computeEnergy(const std::function<bool(const NodeHypothesis&)>& selected,
+		const NodeValueMap& nodeValues, const ArcValueMap& arcValues, const DivisionValueMap& divisionValues) const;
+
+	/**
+	 * @brief track the window around overlap k between the stitched solution so far and the next block, and replace their values in it.
+	 *        Adds by how much the energy of the window and its borders differs from that of the blocks to stitchedEnergy.
+	 * @return false, and changes nothing, if the window cannot keep the flows across its borders
+	 */
+	bool stitchOverlap(size_t overlap, const BlockResult& next, SolverFunction solver, double& stitchedEnergy);
+
+private:
+	size_t blockLength_;
+	size_t overlap_;
+	bool splitDetections_;
+	/// timesteps before and behind every overlap that are tracked again together with it
+	size_t stitchMargin_;
+	Restriction restriction_;
+	size_t restrictionBlock_;
+	size_t restrictionLastBlock_;
+
+	/// the last timestep of all detections that were read, kept or not
+	size_t maxTimestep_;
+	size_t numSkippedLinks_;
+	/// whether overlap k is inside a span of blocks tracked together, indexed by k
+	std::vector<bool> mergedOverlaps_;
+
+	/// buffered hypotheses
+	std::vector<NodeHypothesis> nodes_;
+	std::vector<LinkHypothesis> links_;
+	/// ids of the dividing detections, in the order allowMitosis was called
+	std::vector<size_t> divisionIds_;
+	std::unordered_map<size_t, size_t> idToNodeIndexMap_;
+
+	/// the stitched solution
+	NodeValueMap nodeValues_;
+	ArcValueMap arcValues_;
+	DivisionValueMap divisionValues_;
+};
+
+} // end namespace dpct
+
+#endif // TEMPORAL_BLOCK_FLOW_GRAPH_BUILDER
@@ -27,7 +27,9 @@ public:
     virtual double track(Solution& paths) = 0;
 	double getElapsedSeconds();
 
-    void findNonintersectingBackwardPaths(Node* begin, Node* end, Solution& paths);
+    // collect the paths that follow the best in arcs back from the in arcs of end to begin, skipping every path
+    // that shares an arc with a path found before. Paths are extracted on numThreads threads if there are many.
+    void findNonintersectingBackwardPaths(Node* begin, Node* end, Solution& paths, size_t numThreads = 1);
 
     void printPath(TrackingAlgorithm::Path &p);
 protected:
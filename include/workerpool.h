@@ -0,0 +1,63 @@
+#ifndef DPCT_WORKER_POOL_H
+#define DPCT_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief A fixed set of threads that stay alive for the whole solver run and execute the chunks
+ * of one parallel loop at a time. Starting threads costs more than updating the nodes of a timestep
+ * or relaxing a Bellman-Ford round, so solvers create one pool and hand it every parallel loop.
+ */
+class WorkerPool {
+public:
+	typedef std::function<void(size_t)> Task;
+
+	/// @param numThreads threads executing a loop, including the calling one. 0 = all cores
+	explicit WorkerPool(size_t numThreads);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	size_t getNumThreads() const { return workers_.size() + 1; }
+
+	/**
+	 * @brief call task(i) for all i < numTasks, distributed over the pool and the calling thread,
+	 *        and return when all of them finished. Rethrows the first exception of a task.
+	 *        Must not be called from within a task.
+	 */
+	void run(size_t numTasks, const Task& task);
+
+private:
+	void work();
+	/// execute tasks of the current loop until none is left, needs the locked mutex
+	void executeTasks(std::unique_lock<std::mutex>& lock);
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable startCondition_;
+	std::condition_variable doneCondition_;
+
+	/// the current loop, increasing generation numbers tell the workers that a new one started
+	const Task* task_;
+	size_t numTasks_;
+	size_t nextTask_;
+	size_t numRunning_;
+	size_t generation_;
+	bool stopping_;
+	std::exception_ptr error_;
+};
+
+} // namespace dpct
+
+#endif // DPCT_WORKER_POOL_H
@@ -0,0 +1,138 @@
+#include "arraygraphreader.h"
+
+#include <sstream>
+#include <stdexcept>
+
+namespace dpct
+{
+
+ArrayGraphReader::ArrayGraphReader(const Model& model, const FeatureVector& weights, GraphBuilder* graphBuilder):
+	GraphReader(graphBuilder),
+	model_(model)
+{
+	weights_ = weights;
+}
+
+size_t ArrayGraphReader::getNumWeights(const FeatureArray& features)
+{
+	if(features.empty())
+		return 0;
+	if(model_.statesShareWeights)
+		return features.numFeatures;
+	return features.numStates * features.numFeatures;
+}
+
+void ArrayGraphReader::getFeatures(const FeatureArray& features, size_t index, StateFeatureVector& stateFeatures)
+{
+	stateFeatures.resize(features.numStates);
+	const double* values = features.data + index * features.numStates * features.numFeatures;
+	for(FeatureVector& featVec : stateFeatures)
+	{
+		featVec.assign(values, values + features.numFeatures);
+		values += features.numFeatures;
+	}
+}
+
+void ArrayGraphReader::createGraph()
+{
+	if(model_.detectionFeatures.empty() || model_.detectionFeatures.numStates == 0 || model_.detectionFeatures.numFeatures == 0)
+		throw std::runtime_error("Features may not be empty for detections");
+	if(model_.numLinks > 0 && model_.linkFeatures.empty())
+		throw std::runtime_error("Features may not be empty for links");
+	if(model_.numDivisions > 0 && (model_.divisionFeatures.empty() || model_.divisionFeatures.numStates != 2))
+		throw std::runtime_error("Division features must have exactly two states");
+
+	// ------------------------------------------------------------------------------
+	// get number of weights needed for each different variable type
+	size_t numDetWeights = getNumWeights(model_.detectionFeatures);
+	size_t numDivWeights = model_.numDivisions > 0 ? getNumWeights(model_.divisionFeatures) : 0;
+	size_t numAppWeights = getNumWeights(model_.appearanceFeatures);
+	size_t numDisWeights = getNumWeights(model_.disappearanceFeatures);
+	size_t numLinkWeights = model_.numLinks > 0 ? getNumWeights(model_.linkFeatures) : 0;
+
+	if(weights_.size() != numDetWeights + numDivWeights + numAppWeights + numDisWeights + numLinkWeights)
+	{
+		std::stringstream s;
+		s << "Loaded weights do not meet model requirements! Got " << weights_.size() << ", need "
+			<< numDetWeights + numDivWeights + numAppWeights + numDisWeights + numLinkWeights;
+		throw std::runtime_error(s.str());
+	}
+
+	size_t linkWeightOffset = 0;
+	size_t detWeightOffset = linkWeightOffset + numLinkWeights;
+	size_t divWeightOffset = detWeightOffset + numDetWeights;
+	size_t appWeightOffset = divWeightOffset + numDivWeights;
+	size_t disWeightOffset = appWeightOffset + numAppWeights;
+
+	graphBuilder_->reserve(model_.numNodes, model_.numLinks, model_.numDivisions);
+	StateFeatureVector stateFeatures;
+
+	// ------------------------------------------------------------------------------
+	// add segmentation hypotheses
+	for(size_t i = 0; i < model_.numNodes; i++)
+	{
+		size_t id = model_.nodeIds[i];
+		if(model_.nodeTimesteps != nullptr)
+			graphBuilder_->setNodeTimesteps(id, std::make_pair(model_.nodeTimesteps[2 * i], model_.nodeTimesteps[2 * i + 1]));
+
+		getFeatures(model_.detectionFeatures, i, stateFeatures);
+		FeatureVector detCosts = weightedSumOfFeatures(stateFeatures, weights_, detWeightOffset, model_.statesShareWeights);
+		FeatureVector detCostDeltas = costsToScoreDeltas(detCosts);
+		FeatureVector appearanceCostDeltas;
+		FeatureVector disappearanceCostDeltas;
+		if(!model_.appearanceFeatures.empty())
+		{
+			getFeatures(model_.appearanceFeatures, i, stateFeatures);
+			appearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(stateFeatures, weights_, appWeightOffset, model_.statesShareWeights));
+		}
+		if(!model_.disappearanceFeatures.empty())
+		{
+			getFeatures(model_.disappearanceFeatures, i, stateFeatures);
+			disappearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(stateFeatures, weights_, disWeightOffset, model_.statesShareWeights));
+		}
+
+		graphBuilder_->addNode(id, detCosts, detCostDeltas, appearanceCostDeltas, disappearanceCostDeltas, 0);
+	}
+
+	// add linking hypotheses
+	for(size_t i = 0; i < model_.numLinks; i++)
+	{
+		getFeatures(model_.linkFeatures, i, stateFeatures);
+		graphBuilder_->addArc(model_.linkSrcIds[i], model_.linkDestIds[i],
+			costsToScoreDeltas(weightedSumOfFeatures(stateFeatures, weights_, linkWeightOffset, model_.statesShareWeights)));
+	}
+
+	// add divisions
+	for(size_t i = 0; i < model_.numDivisions; i++)
+	{
+		getFeatures(model_.divisionFeatures, i, stateFeatures);
+		graphBuilder_->allowMitosis(model_.divisionIds[i],
+			costsToScoreDelta(weightedSumOfFeatures(stateFeatures, weights_, divWeightOffset, model_.statesShareWeights)));
+	}
+}
+
+void ArrayGraphReader::saveResult(uint64_t* nodeValues, uint64_t* linkValues, uint8_t* divisionValues)
+{
+	GraphBuilder::NodeValueMap nodeValueMap = graphBuilder_->getNodeValues();
+	for(size_t i = 0; i < model_.numNodes; i++)
+	{
+		auto it = nodeValueMap.find(model_.nodeIds[i]);
+		nodeValues[i] = (it == nodeValueMap.end()) ? 0 : it->second;
+	}
+
+	GraphBuilder::ArcValueMap arcValueMap = graphBuilder_->getArcValues();
+	for(size_t i = 0; i < model_.numLinks; i++)
+	{
+		auto it = arcValueMap.find(std::make_pair(size_t(model_.linkSrcIds[i]), size_t(model_.linkDestIds[i])));
+		linkValues[i] = (it == arcValueMap.end()) ? 0 : it->second;
+	}
+
+	GraphBuilder::DivisionValueMap divisionValueMap = graphBuilder_->getDivisionValues();
+	for(size_t i = 0; i < model_.numDivisions; i++)
+	{
+		auto it = divisionValueMap.find(model_.divisionIds[i]);
+		divisionValues[i] = (it != divisionValueMap.end() && it->second) ? 1 : 0;
+	}
+}
+
+} // end namespace dpct
@@ -0,0 +1,84 @@
+#ifndef ARRAY_GRAPH_READER
+#define ARRAY_GRAPH_READER
+
+#include <cstdint>
+
+#include "graphreader.h"
+#include "graphbuilder.h"
+
+namespace dpct
+{
+
+// ----------------------------------------------------------------------------------------
+/**
+ * @brief A graph reader that takes the hypotheses from contiguous arrays instead of dicts,
+ * such that NumPy arrays can be tracked without converting them element by element.
+ *
+ * All hypotheses of one type have the same number of states and features per state.
+ * The weights are laid out as in the JSON format: link, detection, division, appearance and disappearance weights.
+ * The reader does not touch any Python objects, so it can run without holding the GIL.
+ */
+class ArrayGraphReader : public GraphReader
+{
+public:
+	/// row-major array of shape (number of hypotheses, numStates, numFeatures)
+	struct FeatureArray
+	{
+		const double* data = nullptr;
+		size_t numStates = 0;
+		size_t numFeatures = 0;
+
+		bool empty() const { return data == nullptr; }
+	};
+
+	/// views of all arrays of a model, the arrays must stay alive while the reader is used
+	struct Model
+	{
+		size_t numNodes = 0;
+		const int64_t* nodeIds = nullptr;
+		/// optional array of shape (numNodes, 2)
+		const int64_t* nodeTimesteps = nullptr;
+		FeatureArray detectionFeatures;
+		/// optional, if empty no node can appear or disappear
+		FeatureArray appearanceFeatures;
+		FeatureArray disappearanceFeatures;
+
+		size_t numLinks = 0;
+		const int64_t* linkSrcIds = nullptr;
+		const int64_t* linkDestIds = nullptr;
+		FeatureArray linkFeatures;
+
+		size_t numDivisions = 0;
+		const int64_t* divisionIds = nullptr;
+		FeatureArray divisionFeatures;
+
+		bool statesShareWeights = true;
+	};
+
+	ArrayGraphReader(const Model& model, const FeatureVector& weights, GraphBuilder* graphBuilder);
+
+	/**
+	 * @brief Add nodes, links and divisions to the graph builder.
+	 * Costs are computed from features times weights
+	 */
+	void createGraph();
+
+	/**
+	 * @brief Write the solution of the graph builder to the given arrays,
+	 * in the order of the nodes, links and divisions of the model
+	 */
+	void saveResult(uint64_t* nodeValues, uint64_t* linkValues, uint8_t* divisionValues);
+
+private:
+	size_t getNumWeights(const FeatureArray& features);
+
+	/// copy the features of one hypothesis into the reusable state feature vector
+	void getFeatures(const FeatureArray& features, size_t index, StateFeatureVector& stateFeatures);
+
+private:
+	const Model& model_;
+};
+
+} // end namespace dpct
+
+#endif // ARRAY_GRAPH_READER
@@ -1,13 +1,19 @@
 #include <boost/python/suite/indexing/map_indexing_suite.hpp>
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 #include <boost/python.hpp>
+#include <thread>
+#include <mutex>
+#include <chrono>
 
 #include "pythongraphreader.h"
+#include "arraygraphreader.h"
 #include "flowgraph.h"
 #include "flowgraphbuilder.h"
+#include "compiledmodel.h"
 #include "graph.h"
 #include "magnussongraphbuilder.h"
 #include "magnusson.h"
+#include "pruninggraphbuilder.h"
 
 using namespace dpct;
 using namespace boost::python;
@@ -27,24 +33,470 @@ private:
     PyThreadState* threadState_;
 };
 
-object flowBasedTracking(object& graphDict, object& weightsDict)
+/**
+ * @brief Locked view of a C-contiguous Python buffer, e.g. a NumPy array, that checks the element type and shape. 
+ * None gives an empty view.
+ */
+class BufferView {
+public:
+    enum ElementType {Float64, Int64, Bool};
+
+    BufferView(object& obj, const std::string& name, ElementType type, int ndim, bool writable = false)
+    {
+        buffer_.obj = NULL;
+        if(obj.is_none())
+            return;
+
+        int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+        if(PyObject_GetBuffer(obj.ptr(), &buffer_, flags) != 0)
+        {
+            PyErr_Clear();
+            buffer_.obj = NULL;
+            throw std::runtime_error(name + " must be a C-contiguous array");
+        }
+
+        // skip native and little endian byte order markers
+        std::string format(buffer_.format != NULL ? buffer_.format : "B");
+        if(format.size() > 1 && (format[0] == '@' || format[0] == '=' || format[0] == '<'))
+            format = format.substr(1);
+
+        bool validType = false;
+        switch(type)
+        {
+            case Float64: validType = format == "d"; break;
+            case Int64: validType = buffer_.itemsize == 8 && (format == "q" || format == "Q" || format == "l" || format == "L"); break;
+            case Bool: validType = buffer_.itemsize == 1 && format == "?"; break;
+        }
+        if(!validType)
+        {
+            PyBuffer_Release(&buffer_);
+            buffer_.obj = NULL;
+            throw std::runtime_error(name + (type == Float64 ? " must contain float64 values" : type == Int64 ? " must contain 64 bit integers" : " must contain bools"));
+        }
+        if(buffer_.ndim != ndim)
+        {
+            PyBuffer_Release(&buffer_);
+            buffer_.obj = NULL;
+            std::stringstream s;
+            s << name << " must have " << ndim << " dimensions";
+            throw std::runtime_error(s.str());
+        }
+    }
+
+    ~BufferView()
+    {
+        if(buffer_.obj != NULL)
+            PyBuffer_Release(&buffer_);
+    }
+
+    bool empty() const { return buffer_.obj == NULL; }
+    size_t shape(int dim) const { return empty() ? 0 : buffer_.shape[dim]; }
+
+    template<typename T>
+    T* data() const { return empty() ? NULL : static_cast<T*>(buffer_.buf); }
+
+    /// check that the first dimension matches the number of hypotheses
+    void requireLength(size_t length, const std::string& name) const
+    {
+        if(!empty() && shape(0) != length)
+            throw std::runtime_error(name + " must have one entry per hypothesis");
+    }
+
+    ArrayGraphReader::FeatureArray getFeatureArray() const
+    {
+        ArrayGraphReader::FeatureArray features;
+        features.data = data<double>();
+        features.numStates = shape(1);
+        features.numFeatures = shape(2);
+        return features;
+    }
+
+private:
+    BufferView(const BufferView&);
+    BufferView& operator=(const BufferView&);
+
+    Py_buffer buffer_;
+};
+
+object flowBasedTrackingArrays(
+    object nodeIdsObj, 
+    object detectionFeaturesObj,
+    object linkSrcIdsObj, 
+    object linkDestIdsObj, 
+    object linkFeaturesObj, 
+    object weightsObj,
+    object nodeTimestepsObj, 
+    object appearanceFeaturesObj, 
+    object disappearanceFeaturesObj, 
+    object divisionIdsObj, 
+    object divisionFeaturesObj, 
+    bool statesShareWeights,
+    size_t numThreads)
+{
+    BufferView nodeIds(nodeIdsObj, "nodeIds", BufferView::Int64, 1);
+    BufferView nodeTimesteps(nodeTimestepsObj, "nodeTimesteps", BufferView::Int64, 2);
+    BufferView detectionFeatures(detectionFeaturesObj, "detectionFeatures", BufferView::Float64, 3);
+    BufferView appearanceFeatures(appearanceFeaturesObj, "appearanceFeatures", BufferView::Float64, 3);
+    BufferView disappearanceFeatures(disappearanceFeaturesObj, "disappearanceFeatures", BufferView::Float64, 3);
+    BufferView linkSrcIds(linkSrcIdsObj, "linkSrcIds", BufferView::Int64, 1);
+    BufferView linkDestIds(linkDestIdsObj, "linkDestIds", BufferView::Int64, 1);
+    BufferView linkFeatures(linkFeaturesObj, "linkFeatures", BufferView::Float64, 3);
+    BufferView divisionIds(divisionIdsObj, "divisionIds", BufferView::Int64, 1);
+    BufferView divisionFeatures(divisionFeaturesObj, "divisionFeatures", BufferView::Float64, 3);
+    BufferView weights(weightsObj, "weights", BufferView::Float64, 1);
+
+    ArrayGraphReader::Model model;
+    model.numNodes = nodeIds.shape(0);
+    model.nodeIds = nodeIds.data<int64_t>();
+    nodeTimesteps.requireLength(model.numNodes, "nodeTimesteps");
+    if(!nodeTimesteps.empty() && nodeTimesteps.shape(1) != 2)
+        throw std::runtime_error("nodeTimesteps must contain the first and last timestep of each node");
+    model.nodeTimesteps = nodeTimesteps.data<int64_t>();
+    detectionFeatures.requireLength(model.numNodes, "detectionFeatures");
+    appearanceFeatures.requireLength(model.numNodes, "appearanceFeatures");
+    disappearanceFeatures.requireLength(model.numNodes, "disappearanceFeatures");
+    model.detectionFeatures = detectionFeatures.getFeatureArray();
+    model.appearanceFeatures = appearanceFeatures.getFeatureArray();
+    model.disappearanceFeatures = disappearanceFeatures.getFeatureArray();
+
+    model.numLinks = linkSrcIds.shape(0);
+    linkDestIds.requireLength(model.numLinks, "linkDestIds");
+    linkFeatures.requireLength(model.numLinks, "linkFeatures");
+    model.linkSrcIds = linkSrcIds.data<int64_t>();
+    model.linkDestIds = linkDestIds.data<int64_t>();
+    model.linkFeatures = linkFeatures.getFeatureArray();
+
+    model.numDivisions = divisionIds.shape(0);
+    divisionFeatures.requireLength(model.numDivisions, "divisionFeatures");
+    model.divisionIds = divisionIds.data<int64_t>();
+    model.divisionFeatures = divisionFeatures.getFeatureArray();
+    model.statesShareWeights = statesShareWeights;
+
+    // the results are returned as NumPy arrays aligned with the inputs
+    object numpy = import("numpy");
+    object nodeValuesObj = numpy.attr("zeros")(model.numNodes, "uint64");
+    object linkValuesObj = numpy.attr("zeros")(model.numLinks, "uint64");
+    object divisionValuesObj = numpy.attr("zeros")(model.numDivisions, "bool");
+    BufferView nodeValues(nodeValuesObj, "nodeValues", BufferView::Int64, 1, true);
+    BufferView linkValues(linkValuesObj, "linkValues", BufferView::Int64, 1, true);
+    BufferView divisionValues(divisionValuesObj, "divisionValues", BufferView::Bool, 1, true);
+
+    GraphReader::FeatureVector weightVector(weights.data<double>(), weights.data<double>() + weights.shape(0));
+    FlowGraph flowGraph;
+    FlowGraphBuilder graphBuilder(&flowGraph);
+    ArrayGraphReader arrayGraphReader(model, weightVector, &graphBuilder);
+    double energy;
+
+    {
+        // no Python object is touched while building, tracking and storing the result
+        ScopedGILRelease gilLock;
+        arrayGraphReader.createGraph();
+        energy = flowGraph.maxFlowMinCostTracking(arrayGraphReader.getInitialStateEnergy(), true, 0, true, true, false, false, numThreads);
+        arrayGraphReader.saveResult(nodeValues.data<uint64_t>(), linkValues.data<uint64_t>(), divisionValues.data<uint8_t>());
+    }
+
+    dict result;
+    result["nodeValues"] = nodeValuesObj;
+    result["linkValues"] = linkValuesObj;
+    result["divisionValues"] = divisionValuesObj;
+    result["energy"] = energy;
+    return result;
+}
+
+/// the solver telemetry held by a dpct.Telemetry object, or NULL for None
+SolverTelemetry* getTelemetry(object& telemetryObj)
+{
+    if(telemetryObj.is_none())
+        return NULL;
+    return &extract<SolverTelemetry&>(telemetryObj)();
+}
+
+dict iterationTelemetryToDict(const IterationTelemetry& iteration)
+{
+    dict result;
+    const std::vector<std::string>& names = SolverTelemetry::getColumnNames();
+    std::vector<double> values = SolverTelemetry::getColumnValues(iteration);
+    for(size_t i = 0; i < names.size(); i++)
+        result[names[i]] = values[i];
+    return result;
+}
+
+list getTelemetryIterations(const SolverTelemetry& telemetry)
+{
+    list iterations;
+    for(const IterationTelemetry& iteration : telemetry.getIterations())
+        iterations.append(iterationTelemetryToDict(iteration));
+    return iterations;
+}
+
+dict getTelemetryTotals(const SolverTelemetry& telemetry)
+{
+    return iterationTelemetryToDict(telemetry.getTotals());
+}
+
+/// the memory statistics held by a dpct.MemoryStatistics object, or NULL for None
+MemoryStatistics* getMemoryStatistics(object& memoryObj)
+{
+    if(memoryObj.is_none())
+        return NULL;
+    return &extract<MemoryStatistics&>(memoryObj)();
+}
+
+list getMemoryStructures(const MemoryStatistics& memory)
+{
+    list structures;
+    for(const StructureSize& s : memory.getStructures())
+    {
+        dict structure;
+        structure["structure"] = s.structure;
+        structure["numNodes"] = s.numNodes;
+        structure["numArcs"] = s.numArcs;
+        structure["bytes"] = memory.getStructureBytes(s.structure);
+        structures.append(structure);
+    }
+    return structures;
+}
+
+list getMemoryContainers(const MemoryStatistics& memory)
+{
+    list containers;
+    for(const ContainerMemory& c : memory.getContainers())
+    {
+        dict container;
+        container["structure"] = c.structure;
+        container["container"] = c.container;
+        container["numElements"] = c.numElements;
+        container["bytes"] = c.bytes;
+        containers.append(container);
+    }
+    return containers;
+}
+
+/// the pruning report held by a dpct.PruningReport object, or NULL for None
+PruningReport* getPruningReport(object& pruningObj)
+{
+    if(pruningObj.is_none())
+        return NULL;
+    return &extract<PruningReport&>(pruningObj)();
+}
+
+list getRemovedLinks(const PruningReport& report)
+{
+    list links;
+    for(const std::pair<size_t, size_t>& link : report.removedLinks)
+        links.append(make_tuple(link.first, link.second));
+    return links;
+}
+
+list getRemovedDetections(const PruningReport& report)
+{
+    list ids;
+    for(size_t id : report.removedDetections)
+        ids.append(id);
+    return ids;
+}
+
+list getRemovedDivisions(const PruningReport& report)
+{
+    list ids;
+    for(size_t id : report.removedDivisions)
+        ids.append(id);
+    return ids;
+}
+
+/// hand the hypotheses buffered by the pruning builder to the graph, without the pruned ones, and keep its report
+void prune(PruningGraphBuilder& pruningBuilder, PruningReport* pruning)
+{
+    if(pruning == NULL)
+        return;
+    pruningBuilder.prune();
+    *pruning = pruningBuilder.getReport();
+}
+
+/// estimate the memory of tracking a graph dict from its numbers of hypotheses, without building anything
+size_t estimateMemory(object& graphDict, const std::string& method)
+{
+    dict graph = extract<dict>(graphDict);
+    dict weights;
+    PythonGraphReader pyGraphReader(graph, weights, NULL);
+    GraphReader::HypothesisCounts counts = pyGraphReader.countHypotheses();
+    return MemoryStatistics::estimateTrackingBytes(counts.numSegmentations, counts.numLinks, counts.numDivisions, method);
+}
+
+/**
+ * @brief The state of a flow based tracking run handed to the Python progress callback.
+ * The intermediate result can only be read while the callback runs.
+ */
+class PyTrackingProgress {
+public:
+    PyTrackingProgress(const FlowGraph::Progress& progress, PythonGraphReader* reader):
+        progress_(progress),
+        reader_(reader)
+    {}
+
+    size_t getIteration() const { return progress_.iteration; }
+    size_t getNumPaths() const { return progress_.numPaths; }
+    double getEnergy() const { return progress_.energy; }
+    double getElapsedSeconds() const { return progress_.elapsedSeconds; }
+
+    object getResult()
+    {
+        if(reader_ == NULL)
+            throw std::runtime_error("The intermediate result can only be read during the progress callback");
+        return reader_->saveResult();
+    }
+
+    void invalidate() { reader_ = NULL; }
+
+private:
+    FlowGraph::Progress progress_;
+    PythonGraphReader* reader_;
+};
+
+/**
+ * @brief Wrap a Python callable as progress callback, which takes the GIL while it runs.
+ * The callable gets a dpct.TrackingProgress, and stops tracking if it returns False or raises, 
+ * the exception is then raised once tracking returned, see checkProgressCallbackError.
+ * A callback running on a worker thread stores the message of the exception in errorMessage instead,
+ * because the Python error does not outlive the thread state of the worker.
+ */
+FlowGraph::ProgressCallback makeProgressCallback(object callbackObj, PythonGraphReader* reader, std::string* errorMessage = NULL)
+{
+    if(callbackObj.is_none())
+        return FlowGraph::ProgressCallback();
+
+    return [callbackObj, reader, errorMessage](const FlowGraph::Progress& progress)
+    {
+        PyGILState_STATE gilState = PyGILState_Ensure();
+        bool proceed = false;
+        try
+        {
+            object progressObj(PyTrackingProgress(progress, reader));
+            object proceedObj = callbackObj(progressObj);
+            extract<PyTrackingProgress&> pyProgress(progressObj);
+            pyProgress().invalidate();
+            proceed = proceedObj.is_none() || extract<bool>(proceedObj)();
+        }
+        catch(error_already_set&)
+        {
+            // keep the Python error, it is raised after tracking
+            if(errorMessage != NULL)
+            {
+                PyObject *type, *value, *traceback;
+                PyErr_Fetch(&type, &value, &traceback);
+                PyErr_NormalizeException(&type, &value, &traceback);
+                *errorMessage = extract<std::string>(str(handle<>(value)))();
+                Py_XDECREF(type);
+                Py_XDECREF(traceback);
+            }
+        }
+        PyGILState_Release(gilState);
+        return proceed;
+    };
+}
+
+/// raise the error of the progress callback, if it failed. Needs the GIL
+void checkProgressCallbackError()
+{
+    if(PyErr_Occurred())
+        throw_error_already_set();
+}
+
+object flowBasedTracking(
+    object& graphDict, 
+    object& weightsDict, 
+    object numThreadsObj, 
+    object telemetryObj, 
+    double timeBudget, 
+    double energyGap, 
+    object progressObj,
+    object memoryObj,
+    object pruningObj)
 {
 	dict graph = extract<dict>(graphDict);
 	dict weights = extract<dict>(weightsDict);
 
 	FlowGraph flowGraph;
     FlowGraphBuilder graphBuilder(&flowGraph);
-	PythonGraphReader pyGraphReader(graph, weights, &graphBuilder);
+    PruningReport* pruning = getPruningReport(pruningObj);
+    PruningGraphBuilder pruningBuilder(&graphBuilder);
+	PythonGraphReader pyGraphReader(graph, weights, pruning != NULL ? static_cast<GraphBuilder*>(&pruningBuilder) : &graphBuilder);
 	pyGraphReader.createGraphFromPython();
+    prune(pruningBuilder, pruning);
+
+	// an explicitly given number of threads overrides the one from the model settings
+	size_t numThreads = pyGraphReader.getNumThreads();
+	if(!numThreadsObj.is_none())
+		numThreads = extract<size_t>(numThreadsObj);
+    flowGraph.setTelemetry(getTelemetry(telemetryObj));
+    flowGraph.setAnytimeLimits(timeBudget, energyGap);
+    flowGraph.setProgressCallback(makeProgressCallback(progressObj, &pyGraphReader));
 
     {
         ScopedGILRelease gilLock;
-        flowGraph.maxFlowMinCostTracking();
+        flowGraph.maxFlowMinCostTracking(pyGraphReader.getInitialStateEnergy(), true, 0, true, true, false, false, numThreads);
+    }
+    checkProgressCallbackError();
+
+    MemoryStatistics* memory = getMemoryStatistics(memoryObj);
+    if(memory != NULL)
+    {
+        flowGraph.collectMemoryStatistics(*memory);
+        memory->updatePeakResidentBytes();
     }
 
 	return pyGraphReader.saveResult();
 }
 
+/**
+ * @brief A flow graph built once from a graph dict, which can then be tracked for many different weights
+ */
+class PyCompiledModel {
+public:
+    PyCompiledModel(dict graph, dict weights):
+        graph_(graph),
+        weights_(weights),
+        compiledModel_(&flowGraph_),
+        pyGraphReader_(graph_, weights_, &compiledModel_)
+    {
+        pyGraphReader_.createGraphFromPython();
+    }
+
+    object track(object& weightsDict, object numThreadsObj, object telemetryObj, double timeBudget, double energyGap, object progressObj)
+    {
+        dict weights = extract<dict>(weightsDict);
+        GraphReader::FeatureVector weightVector = pyGraphReader_.readWeightsFromPython(weights);
+
+        size_t numThreads = pyGraphReader_.getNumThreads();
+        if(!numThreadsObj.is_none())
+            numThreads = extract<size_t>(numThreadsObj);
+        flowGraph_.setTelemetry(getTelemetry(telemetryObj));
+        flowGraph_.setAnytimeLimits(timeBudget, energyGap);
+        flowGraph_.setProgressCallback(makeProgressCallback(progressObj, &pyGraphReader_));
+
+        {
+            ScopedGILRelease gilLock;
+            compiledModel_.setWeights(weightVector);
+            flowGraph_.maxFlowMinCostTracking(compiledModel_.getInitialStateEnergy(), true, 0, true, true, false, false, numThreads);
+        }
+        // the callback holds a reference to the Python callable, release it while holding the GIL
+        flowGraph_.setProgressCallback(FlowGraph::ProgressCallback());
+        checkProgressCallbackError();
+
+        return pyGraphReader_.saveResult();
+    }
+
+    size_t getNumWeights() const { return compiledModel_.getNumWeights(); }
+
+private:
+    /// the reader refers to the dicts when saving results
+    dict graph_;
+    dict weights_;
+    FlowGraph flowGraph_;
+    CompiledModel compiledModel_;
+    PythonGraphReader pyGraphReader_;
+};
+
 object maxFlowTracking(object& graphDict, object& weightsDict)
 {
 	dict graph = extract<dict>(graphDict);
@@ -63,7 +515,7 @@ object maxFlowTracking(object& graphDict, object& weightsDict)
 	return pyGraphReader.saveResult();
 }
 
-object magnussonTracking(object& graphDict, object& weightsDict)
+object magnussonTracking(object& graphDict, object& weightsDict, object numThreadsObj, object telemetryObj, object memoryObj, object pruningObj, size_t pathsPerSweep)
 {
 	dict graph = extract<dict>(graphDict);
 	dict weights = extract<dict>(weightsDict);
@@ -71,43 +523,468 @@ object magnussonTracking(object& graphDict, object& weightsDict)
 	Graph::Configuration config(true, true, true);
 	Graph magnussonGraph(config);
     MagnussonGraphBuilder graphBuilder(&magnussonGraph);
-    PythonGraphReader pyGraphReader(graph, weights, &graphBuilder);
+    PruningReport* pruning = getPruningReport(pruningObj);
+    PruningGraphBuilder pruningBuilder(&graphBuilder);
+    PythonGraphReader pyGraphReader(graph, weights, pruning != NULL ? static_cast<GraphBuilder*>(&pruningBuilder) : &graphBuilder);
 	pyGraphReader.createGraphFromPython();
+    prune(pruningBuilder, pruning);
     std::vector<TrackingAlgorithm::Path> paths;
 
+	// an explicitly given number of threads overrides the one from the model settings
+	size_t numThreads = pyGraphReader.getNumThreads();
+	if(!numThreadsObj.is_none())
+		numThreads = extract<size_t>(numThreadsObj);
+
+    SolverTelemetry* telemetry = getTelemetry(telemetryObj);
+    MemoryStatistics* memory = getMemoryStatistics(memoryObj);
     {
         ScopedGILRelease gilLock;
         Magnusson tracker(&magnussonGraph, true, true, false);
+        tracker.setNumThreads(numThreads);
+        tracker.setTelemetry(telemetry);
+        tracker.setPathsPerSweep(pathsPerSweep);
         double score = tracker.track(paths);
         std::cout << "\nTracking finished in " << tracker.getElapsedSeconds() 
         		  << " secs with energy " << -score << std::endl;
+        if(memory != NULL)
+        {
+            tracker.collectMemoryStatistics(*memory);
+            memory->updatePeakResidentBytes();
+        }
     }
 
     graphBuilder.getSolutionFromPaths(paths);
 	return pyGraphReader.saveResult();
 }
 
+/**
+ * @brief A tracking run on a C++ worker thread, returned by the track*Async functions.
+ * The graph is built from the dicts by the calling thread, the worker runs the solver without the GIL,
+ * it publishes its progress here and checks for cancellation after every iteration.
+ * Only a Python progress callable makes the worker take the GIL, for as long as the callable runs after each iteration,
+ * so the worker then waits for and blocks the other Python threads during that time.
+ */
+class PyTrackingJob {
+public:
+    typedef std::chrono::time_point<std::chrono::high_resolution_clock> TimePoint;
+
+    PyTrackingJob():
+        cancelled_(false),
+        done_(false),
+        iteration_(0),
+        numPaths_(0),
+        energy_(0.0),
+        startTime_(std::chrono::high_resolution_clock::now()),
+        endTime_(startTime_)
+    {}
+
+    /// derived classes must call stop() before their solver members are destroyed
+    virtual ~PyTrackingJob() { stop(); }
+
+    dict progress()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TimePoint endTime = done_ ? endTime_ : std::chrono::high_resolution_clock::now();
+        dict result;
+        result["iteration"] = iteration_;
+        result["numPaths"] = numPaths_;
+        result["energy"] = energy_;
+        result["elapsedSeconds"] = std::chrono::duration<double>(endTime - startTime_).count();
+        result["done"] = done_;
+        result["cancelled"] = cancelled_;
+        return result;
+    }
+
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+
+    bool isDone()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return done_;
+    }
+
+    /// wait for the worker without holding the GIL, then raise its error or return the result dict
+    object result()
+    {
+        if(worker_.joinable())
+        {
+            ScopedGILRelease gilLock;
+            worker_.join();
+        }
+        if(!error_.empty())
+            throw std::runtime_error(error_);
+        return saveResult();
+    }
+
+protected:
+    /// start the worker, once the derived class is fully set up
+    void start()
+    {
+        worker_ = std::thread([this]()
+        {
+            try
+            {
+                if(!isCancelled())
+                    run();
+            }
+            catch(std::exception& e)
+            {
+                error_ = e.what();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+            endTime_ = std::chrono::high_resolution_clock::now();
+        });
+    }
+
+    /// cancel and wait for the worker. Needs the GIL, which is released while waiting
+    void stop()
+    {
+        if(!worker_.joinable())
+            return;
+        cancel();
+        ScopedGILRelease gilLock;
+        worker_.join();
+    }
+
+    /// store the progress of the worker, returns false if the job was cancelled
+    bool reportProgress(size_t iteration, size_t numPaths, double energy)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        iteration_ = iteration;
+        numPaths_ = numPaths;
+        energy_ = energy;
+        return !cancelled_;
+    }
+
+    bool isCancelled()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cancelled_;
+    }
+
+    /// runs on the worker thread without the GIL
+    virtual void run() = 0;
+    /// runs on the calling thread with the GIL, after the worker finished
+    virtual object saveResult() = 0;
+
+private:
+    std::thread worker_;
+    std::mutex mutex_;
+    bool cancelled_;
+    bool done_;
+    size_t iteration_;
+    size_t numPaths_;
+    double energy_;
+    TimePoint startTime_;
+    TimePoint endTime_;
+    /// only written by the worker, read after it was joined
+    std::string error_;
+};
+
+/**
+ * @brief Flow based or min-cost max-flow tracking on a worker thread, see trackFlowBasedAsync and trackMaxFlowAsync
+ */
+class PyFlowTrackingJob : public PyTrackingJob {
+public:
+    PyFlowTrackingJob(dict graph, dict weights, object numThreadsObj, object telemetryObj, double timeBudget, double energyGap, object progressObj, bool maxFlow):
+        graph_(graph),
+        weights_(weights),
+        telemetryObj_(telemetryObj),
+        progressCallback_(makeProgressCallback(progressObj, &pyGraphReader_, &progressError_)),
+        graphBuilder_(&flowGraph_),
+        pyGraphReader_(graph_, weights_, &graphBuilder_),
+        maxFlow_(maxFlow)
+    {
+        pyGraphReader_.createGraphFromPython();
+
+        numThreads_ = pyGraphReader_.getNumThreads();
+        if(!numThreadsObj.is_none())
+            numThreads_ = extract<size_t>(numThreadsObj);
+        flowGraph_.setTelemetry(getTelemetry(telemetryObj_));
+        flowGraph_.setAnytimeLimits(timeBudget, energyGap);
+        flowGraph_.setProgressCallback([this](const FlowGraph::Progress& progress)
+        {
+            if(!reportProgress(progress.iteration, progress.numPaths, progress.energy))
+                return false;
+            // the callable cancels the job like cancel() would, ending at the same solution
+            if(progressCallback_ && !progressCallback_(progress))
+            {
+                cancel();
+                return false;
+            }
+            return true;
+        });
+        start();
+    }
+
+    virtual ~PyFlowTrackingJob() { stop(); }
+
+protected:
+    virtual void run()
+    {
+        // max flow has no iterations, it can only be cancelled before it started
+        if(maxFlow_)
+        {
+            double energy = flowGraph_.maxFlow();
+            reportProgress(1, 0, energy);
+        }
+        else
+            flowGraph_.maxFlowMinCostTracking(pyGraphReader_.getInitialStateEnergy(), true, 0, true, true, false, false, numThreads_);
+    }
+
+    virtual object saveResult()
+    {
+        // the callback holds a reference to the Python callable, release it while holding the GIL
+        progressCallback_ = FlowGraph::ProgressCallback();
+        if(!progressError_.empty())
+            throw std::runtime_error(progressError_);
+        return pyGraphReader_.saveResult();
+    }
+
+private:
+    /// the reader refers to the dicts when saving results, the telemetry is written by the worker
+    dict graph_;
+    dict weights_;
+    object telemetryObj_;
+    FlowGraph::ProgressCallback progressCallback_;
+    /// only written by the worker, read after it was joined
+    std::string progressError_;
+    FlowGraph flowGraph_;
+    FlowGraphBuilder graphBuilder_;
+    PythonGraphReader pyGraphReader_;
+    bool maxFlow_;
+    size_t numThreads_;
+};
+
+/**
+ * @brief Magnusson's tracking on a worker thread, see trackMagnussonAsync
+ */
+class PyMagnussonTrackingJob : public PyTrackingJob {
+public:
+    PyMagnussonTrackingJob(dict graph, dict weights, object numThreadsObj, object telemetryObj):
+        graph_(graph),
+        weights_(weights),
+        telemetryObj_(telemetryObj),
+        magnussonGraph_(Graph::Configuration(true, true, true)),
+        graphBuilder_(&magnussonGraph_),
+        pyGraphReader_(graph_, weights_, &graphBuilder_)
+    {
+        pyGraphReader_.createGraphFromPython();
+
+        numThreads_ = pyGraphReader_.getNumThreads();
+        if(!numThreadsObj.is_none())
+            numThreads_ = extract<size_t>(numThreadsObj);
+        start();
+    }
+
+    virtual ~PyMagnussonTrackingJob() { stop(); }
+
+protected:
+    virtual void run()
+    {
+        std::vector<TrackingAlgorithm::Path> paths;
+        Magnusson tracker(&magnussonGraph_, true, true, false);
+        tracker.setNumThreads(numThreads_);
+        tracker.setTelemetry(getTelemetry(telemetryObj_));
+        tracker.setProgressCallback([this](const Magnusson::Progress& progress)
+        {
+            return reportProgress(progress.iteration, progress.numPaths, progress.energy);
+        });
+        tracker.track(paths);
+        graphBuilder_.getSolutionFromPaths(paths);
+    }
+
+    virtual object saveResult() { return pyGraphReader_.saveResult(); }
+
+private:
+    /// the reader refers to the dicts when saving results, the telemetry is written by the worker
+    dict graph_;
+    dict weights_;
+    object telemetryObj_;
+    Graph magnussonGraph_;
+    MagnussonGraphBuilder graphBuilder_;
+    PythonGraphReader pyGraphReader_;
+    size_t numThreads_;
+};
+
+PyTrackingJob* flowBasedTrackingAsync(
+    object& graphDict, 
+    object& weightsDict, 
+    object numThreadsObj, 
+    object telemetryObj, 
+    double timeBudget, 
+    double energyGap,
+    object progressObj)
+{
+    return new PyFlowTrackingJob(extract<dict>(graphDict), extract<dict>(weightsDict), numThreadsObj, telemetryObj, timeBudget, energyGap, progressObj, false);
+}
+
+PyTrackingJob* maxFlowTrackingAsync(object& graphDict, object& weightsDict)
+{
+    return new PyFlowTrackingJob(extract<dict>(graphDict), extract<dict>(weightsDict), object(), object(), 0.0, 0.0, object(), true);
+}
+
+PyTrackingJob* magnussonTrackingAsync(object& graphDict, object& weightsDict, object numThreadsObj, object telemetryObj)
+{
+    return new PyMagnussonTrackingJob(extract<dict>(graphDict), extract<dict>(weightsDict), numThreadsObj, telemetryObj);
+}
+
 /**
  * @brief Python interface of 'dpct' module
  */
 BOOST_PYTHON_MODULE( dpct )
 {
-	def("trackFlowBased", flowBasedTracking, args("graph", "weights"),
+	class_<SolverTelemetry>("Telemetry",
+		"Collects the counters and timers of every iteration of the tracking runs it is passed to as 'telemetry'. "
+		"Works in release builds, without the debug log.",
+		init<optional<std::string> >(arg("solver")))
+		.add_property("iterations", getTelemetryIterations, 
+			"list of dicts with the counters and timers of every iteration, as in the CSV trace")
+		.add_property("totals", getTelemetryTotals, "dict of the sums of all iterations, with the final energy")
+		.add_property("setupSeconds", &SolverTelemetry::getSetupSeconds, "time spent before the first iterations, e.g. building the residual graph")
+		.add_property("solver", make_function(&SolverTelemetry::getSolver, return_value_policy<copy_const_reference>()), 
+			&SolverTelemetry::setSolver)
+		.def("clear", &SolverTelemetry::clear, "remove all recorded iterations")
+		.def("save", &SolverTelemetry::save, arg("filename"), "write the trace as JSON if the filename ends with '.json', as CSV otherwise");
+	class_<MemoryStatistics>("MemoryStatistics",
+		"Collects the node and arc counts and the approximate bytes of all containers of the graphs "
+		"of the tracking runs it is passed to as 'memory', after tracking.")
+		.add_property("structures", getMemoryStructures, 
+			"list of dicts with the numNodes, numArcs and bytes of every graph structure")
+		.add_property("containers", getMemoryContainers, 
+			"list of dicts with the numElements and bytes of every container of a structure")
+		.add_property("totalBytes", &MemoryStatistics::getTotalBytes, "bytes of all containers")
+		.add_property("peakResidentBytes", &MemoryStatistics::getPeakResidentBytes, 
+			"peak resident memory of the process right after the last tracking run, 0 if unknown")
+		.def("clear", &MemoryStatistics::clear, "remove all structures and containers")
+		.def("save", &MemoryStatistics::save, arg("filename"), "write the statistics as JSON if the filename ends with '.json', as CSV otherwise");
+	class_<PruningReport>("PruningReport",
+		"Passed as 'pruning' to a tracking function, it enables the removal of dominated and unreachable hypotheses "
+		"before the graph is built, and tells which ones were removed.")
+		.def_readonly("numDetections", &PruningReport::numDetections)
+		.def_readonly("numLinks", &PruningReport::numLinks)
+		.def_readonly("numDivisions", &PruningReport::numDivisions)
+		.def_readonly("numDominatedLinks", &PruningReport::numDominatedLinks, 
+			"links that are never better than a disappearance of the source and an appearance of the target")
+		.def_readonly("numUnreachableLinks", &PruningReport::numUnreachableLinks)
+		.def_readonly("numUnreachableDetections", &PruningReport::numUnreachableDetections)
+		.def_readonly("numUnreachableDivisions", &PruningReport::numUnreachableDivisions)
+		.def_readonly("numRemovedStates", &PruningReport::numRemovedStates, 
+			"states beyond the number of objects that can pass the remaining hypotheses")
+		.add_property("removedLinks", getRemovedLinks, "list of (src, dest) tuples of the removed links")
+		.add_property("removedDetections", getRemovedDetections, "list of the ids of the removed detections")
+		.add_property("removedDivisions", getRemovedDivisions, "list of the ids of the detections whose division was removed")
+		.def("clear", &PruningReport::clear)
+		.def("save", &PruningReport::save, arg("filename"), "write the report as JSON");
+	def("estimateMemory", estimateMemory, (arg("graph"), arg("method")="flow"),
+		"Estimate the peak bytes of tracking the graph dict with 'flow', 'magnusson' or 'magnusson-flow' "
+		"from its numbers of hypotheses, without building it. This is the estimate of the --dryRun of the track tool.");
+	class_<PyTrackingProgress>("TrackingProgress",
+		"The state of a flow based tracking run after an iteration, handed to the progress callback.", no_init)
+		.add_property("iteration", &PyTrackingProgress::getIteration)
+		.add_property("numPaths", &PyTrackingProgress::getNumPaths, "number of paths augmented so far")
+		.add_property("energy", &PyTrackingProgress::getEnergy, "energy of the current feasible solution")
+		.add_property("elapsedSeconds", &PyTrackingProgress::getElapsedSeconds, "time since tracking was started")
+		.def("getResult", &PyTrackingProgress::getResult, 
+			"the current solution as result dictionary like the one returned by trackFlowBased, only during the callback");
+	def("trackFlowBased", flowBasedTracking, 
+		(arg("graph"), arg("weights"), arg("numThreads")=object(), arg("telemetry")=object(), 
+		 arg("timeBudget")=0.0, arg("energyGap")=0.0, arg("progress")=object(), arg("memory")=object(), arg("pruning")=object()),
 		"Use the flow-based tracker on a graph specified as a dictionary,"
 		"in the same structure as the supported JSON format. Similarly, the weights are also given as dict.\n\n"
+		"numThreads sets how many threads relax the Bellman-Ford rounds (0 = all cores). If it is None, "
+		"the 'optimizerNumThreads' entry of the graph's settings is used, falling back to a single thread.\n\n"
+		"If a dpct.Telemetry is given, the counters and timers of all iterations are added to it.\n\n"
+		"Tracking stops early with the best solution found so far once timeBudget seconds are used up (checked after "
+		"every iteration), or once the next path would decrease the energy by less than energyGap. 0 disables both. "
+		"progress is called with a dpct.TrackingProgress after every iteration that changed the solution, "
+		"and tracking stops if it returns False.\n\n"
+		"If a dpct.MemoryStatistics is given, the sizes and memory of all containers are added to it after tracking.\n\n"
+		"If a dpct.PruningReport is given, dominated and unreachable hypotheses are removed before the graph is built, "
+		"which keeps the optimal energy, and the report tells which ones. They have value zero in the result.\n\n"
 		"Returns a python dictionary similar to the result.json file, but also stores 'value' or 'divisionValue'"
 		"for each detection and link.");
+	def("trackFlowBasedArrays", flowBasedTrackingArrays, 
+		(arg("nodeIds"), arg("detectionFeatures"), arg("linkSrcIds"), arg("linkDestIds"), arg("linkFeatures"), arg("weights"),
+		 arg("nodeTimesteps")=object(), arg("appearanceFeatures")=object(), arg("disappearanceFeatures")=object(),
+		 arg("divisionIds")=object(), arg("divisionFeatures")=object(), arg("statesShareWeights")=true, arg("numThreads")=1),
+		"Use the flow-based tracker on a graph given as contiguous NumPy arrays, which are read without copying. "
+		"Ids and timesteps are int64 arrays of shape (n,) and (n, 2), features are float64 arrays of shape "
+		"(number of hypotheses, number of states, number of features), divisions have two states. "
+		"Appearance, disappearance and division arrays are optional. The weights are a float64 array "
+		"ordered as for the dict interface: link, detection, division, appearance and disappearance weights.\n\n"
+		"The GIL is released while the graph is built and tracked.\n\n"
+		"Returns a dictionary with the uint64 arrays 'nodeValues' and 'linkValues', the bool array 'divisionValues', "
+		"all in the order of the inputs, and the final 'energy'.");
+	class_<PyCompiledModel, boost::noncopyable>("CompiledModel", 
+		"A flow graph built once from a graph dict in the format of trackFlowBased, which keeps the features "
+		"such that it can be tracked for many weight vectors without reading the graph again, e.g. for parameter sweeps.",
+		init<dict, dict>((arg("graph"), arg("weights")),
+			"Build the flow graph. The weights define the weight layout that all later weights must follow."))
+		.def("trackFlowBased", &PyCompiledModel::track, 
+			(arg("weights"), arg("numThreads")=object(), arg("telemetry")=object(), 
+			 arg("timeBudget")=0.0, arg("energyGap")=0.0, arg("progress")=object()),
+			"Recompute all costs for the given weights dict and track from scratch, see dpct.trackFlowBased.\n\n"
+			"Returns the same python dictionary as dpct.trackFlowBased.")
+		.add_property("numWeights", &PyCompiledModel::getNumWeights, "number of weights the model needs");
 	def("trackMaxFlow", maxFlowTracking, args("graph", "weights"),
 		"Run min-cost max-flow tracking on a graph specified as a dictionary,"
 		"in the same structure as the supported JSON format. Similarly, the weights are also given as dict.\n\n"
 		"The max-flow disregards division constraints and simply pushes as much flow through the net as possible.\n\n"
 		"Returns a python dictionary similar to the result.json file, but also stores 'value' or 'divisionValue'"
 		"for each detection and link.");
-	def("trackMagnusson", magnussonTracking, args("graph", "weights"),
+	def("trackMagnusson", magnussonTracking, 
+		(arg("graph"), arg("weights"), arg("numThreads")=object(), arg("telemetry")=object(), arg("memory")=object(), arg("pruning")=object(), arg("pathsPerSweep")=1),
 		"Use Magnusson's tracker on a graph specified as a dictionary,"
 		"in the same structure as the supported JSON format. Similarly, the weights are also given as dict.\n\n"
+		"numThreads sets how many threads update the nodes of each timestep (0 = all cores). If it is None, "
+		"the 'optimizerNumThreads' entry of the graph's settings is used, falling back to a single thread.\n\n"
+		"If a dpct.Telemetry is given, the counters and timers of all found paths are added to it.\n\n"
+		"If a dpct.MemoryStatistics is given, the sizes and memory of the graph and the swap arcs are added to it after tracking.\n\n"
+		"If a dpct.PruningReport is given, hypotheses are pruned before the graph is built, see dpct.trackFlowBased.\n\n"
+		"pathsPerSweep > 1 augments up to that many paths that share no nodes after every sweep, "
+		"which needs fewer sweeps but may find a worse solution.\n\n"
 		"Magnusson only approximates the residual graph and is thus much faster but not as close to the optimum, "
 		"but still always feasible.\n\n"
 		"Returns a python dictionary similar to the result.json file, but also stores 'value' or 'divisionValue'"
 		"for each detection and link.");
+	class_<PyTrackingJob, boost::noncopyable>("TrackingJob",
+		"A tracking run on a C++ worker thread, started by trackFlowBasedAsync, trackMaxFlowAsync or trackMagnussonAsync. "
+		"The graph is built before the function returns, such that the next graph can be built while this one is tracked. "
+		"Deleting the job cancels it and waits for the worker.", no_init)
+		.def("progress", &PyTrackingJob::progress, 
+			"dict with the 'iteration', 'numPaths' and 'energy' of the latest solution, the 'elapsedSeconds' since the job was started, "
+			"and whether it is 'done' or 'cancelled'")
+		.def("cancel", &PyTrackingJob::cancel, 
+			"stop tracking after the current iteration with the solution found so far")
+		.def("done", &PyTrackingJob::isDone, "whether the worker finished")
+		.def("result", &PyTrackingJob::result, 
+			"wait for the worker without holding the GIL and return the result dictionary like the synchronous function, "
+			"or raise the error of the worker");
+	def("trackFlowBasedAsync", flowBasedTrackingAsync, 
+		(arg("graph"), arg("weights"), arg("numThreads")=object(), arg("telemetry")=object(), 
+		 arg("timeBudget")=0.0, arg("energyGap")=0.0, arg("progress")=object()),
+		return_value_policy<manage_new_object>(),
+		"Build the graph like dpct.trackFlowBased, then track it on a worker thread. "
+		"A given dpct.Telemetry must not be read before the job is done. "
+		"progress is called on the worker thread like the one of dpct.trackFlowBased, returning False cancels the job, "
+		"and an exception it raises is raised by result(). "
+		"The worker holds the GIL while progress runs, so it serializes with the other Python threads after every iteration.\n\n"
+		"Returns a dpct.TrackingJob.");
+	def("trackMaxFlowAsync", maxFlowTrackingAsync, args("graph", "weights"),
+		return_value_policy<manage_new_object>(),
+		"Build the graph like dpct.trackMaxFlow, then run min-cost max-flow on a worker thread. "
+		"It has no iterations, so cancel only has an effect before the worker started.\n\n"
+		"Returns a dpct.TrackingJob.");
+	def("trackMagnussonAsync", magnussonTrackingAsync, 
+		(arg("graph"), arg("weights"), arg("numThreads")=object(), arg("telemetry")=object()),
+		return_value_policy<manage_new_object>(),
+		"Build the graph like dpct.trackMagnusson, then track it on a worker thread. "
+		"A given dpct.Telemetry must not be read before the job is done.\n\n"
+		"Returns a dpct.TrackingJob.");
 }
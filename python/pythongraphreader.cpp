@@ -40,6 +40,8 @@ void PythonGraphReader::createGraphFromPython()
 		dict settings = extract<dict>(graphDict_[GraphReader::JsonTypeNames[GraphReader::JsonTypes::Settings]]);
 		if(settings.has_key(GraphReader::JsonTypeNames[GraphReader::JsonTypes::StatesShareWeights]))
 			statesShareWeights = extract<bool>(settings[GraphReader::JsonTypeNames[GraphReader::JsonTypes::StatesShareWeights]]);
+		if(settings.has_key(GraphReader::JsonTypeNames[GraphReader::JsonTypes::OptimizerNumThreads]))
+			numThreads_ = extract<size_t>(settings[GraphReader::JsonTypeNames[GraphReader::JsonTypes::OptimizerNumThreads]]);
 	}
 
 	// ------------------------------------------------------------------------------
@@ -50,6 +52,7 @@ void PythonGraphReader::createGraphFromPython()
 	size_t numAppWeights = 0;
 	size_t numDisWeights = 0;
 	size_t numLinkWeights = 0;
+	size_t numDivisions = 0;
 
 	list segmentationHypotheses = extract<list>(graphDict_[GraphReader::JsonTypeNames[GraphReader::JsonTypes::Segmentations]]);
 	for(size_t i = 0; (int)i < len(segmentationHypotheses); i++)
@@ -58,7 +61,10 @@ void PythonGraphReader::createGraphFromPython()
 		numDetWeights = getNumWeights(jsonHyp, GraphReader::JsonTypes::Features, statesShareWeights);
 
 		if(jsonHyp.has_key(GraphReader::JsonTypeNames[GraphReader::JsonTypes::DivisionFeatures]))
+		{
 			numDivWeights = getNumWeights(jsonHyp, GraphReader::JsonTypes::DivisionFeatures, statesShareWeights);
+			numDivisions++;
+		}
 
 		if(jsonHyp.has_key(GraphReader::JsonTypeNames[GraphReader::JsonTypes::AppearanceFeatures]))
 			numAppWeights = getNumWeights(jsonHyp, GraphReader::JsonTypes::AppearanceFeatures, statesShareWeights);
@@ -92,6 +98,7 @@ void PythonGraphReader::createGraphFromPython()
 	// ------------------------------------------------------------------------------
 	// read segmentation hypotheses and add to flowgraph
 	std::cout << "\tcontains " << len(segmentationHypotheses) << " segmentation hypotheses" << std::endl;
+	graphBuilder_->reserve(len(segmentationHypotheses), len(linkingHypotheses), numDivisions);
 	
 	for(size_t i = 0; (int)i < len(segmentationHypotheses); i++)
 	{
@@ -264,6 +271,22 @@ PythonGraphReader::StateFeatureVector PythonGraphReader::extractFeatures(boost::
 	return stateFeatVec;
 }
 
+GraphReader::HypothesisCounts PythonGraphReader::countHypotheses()
+{
+	HypothesisCounts counts;
+	list segmentationHypotheses = extract<list>(graphDict_[GraphReader::JsonTypeNames[GraphReader::JsonTypes::Segmentations]]);
+	list linkingHypotheses = extract<list>(graphDict_[GraphReader::JsonTypeNames[GraphReader::JsonTypes::Links]]);
+	counts.numSegmentations = len(segmentationHypotheses);
+	counts.numLinks = len(linkingHypotheses);
+	for(size_t i = 0; (int)i < len(segmentationHypotheses); i++)
+	{
+		dict jsonHyp = extract<dict>(segmentationHypotheses[i]);
+		if(jsonHyp.has_key(GraphReader::JsonTypeNames[GraphReader::JsonTypes::DivisionFeatures]))
+			counts.numDivisions++;
+	}
+	return counts;
+}
+
 PythonGraphReader::FeatureVector PythonGraphReader::readWeightsFromPython(boost::python::dict& weightsDict)
 {
 	list weightsList = extract<list>(weightsDict[GraphReader::GraphReader::JsonTypeNames[GraphReader::GraphReader::JsonTypes::Weights]]);
@@ -42,9 +42,14 @@ public:
 	 */
 	boost::python::object saveResult();
 
+	/// count the hypotheses of the graph dict without building anything, e.g. to estimate the memory of tracking it
+	HypothesisCounts countHypotheses();
+
+	/// read the weight vector from a weights dict as used for createGraphFromPython
+	FeatureVector readWeightsFromPython(boost::python::dict& weightsDict);
+
 private:
 	StateFeatureVector extractFeatures(boost::python::dict& entry, GraphReader::JsonTypes type);
-	FeatureVector readWeightsFromPython(boost::python::dict& weightsDict);
 	size_t getNumWeights(boost::python::dict& hypothesis, GraphReader::JsonTypes type, bool statesShareWeights);
 
 private:
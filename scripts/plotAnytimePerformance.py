@@ -9,7 +9,30 @@ import matplotlib.pyplot as plt
 # python plotAnytimePerformance.py --logs /Users/chaubold/hci/data/hufnagel2012-08-03/2016-01-29-flow-result-comparison/flow.log /Users/chaubold/hci/data/hufnagel2012-08-03/2016-01-29-flow-result-comparison/magnusson.log /Users/chaubold/hci/data/hufnagel2012-08-03/2016-01-29-flow-result-comparison/flow-ordered.log /Users/chaubold/hci/data/hufnagel2012-08-03/2016-01-29-flow-result-comparison/gurobi.log --labels flow magnusson flow-orderedNodes gurobi --out /Users/chaubold/Dropbox/VerbTeX/eccv16-divisibleCellFlow2/fig/anytime-drosophila.pdf
 # python plotAnytimePerformance.py --logs /Users/chaubold/hci/data/rapoport_sub/flow.log /Users/chaubold/hci/data/rapoport_sub/magnusson.log /Users/chaubold/hci/data/rapoport_sub/flow-orderedNodes.log /Users/chaubold/hci/data/rapoport_sub/gurobi.log --labels flow magnusson flowOrdered gurobi --out /Users/chaubold/Dropbox/VerbTeX/eccv16-divisibleCellFlow2/fig/anytime-rapoport.pdf
 
+def parseTelemetry(filename):
+    ''' read the energy over time from a trace written by track --telemetry (CSV or JSON) '''
+    if filename.endswith('.json'):
+        import json
+        with open(filename, 'r') as f:
+            trace = json.load(f)
+        time = trace['setupSeconds']
+        iterations = trace['iterations']
+    else:
+        import csv
+        time = 0.0
+        with open(filename, 'r') as f:
+            iterations = [dict((k, float(v)) for k, v in row.items()) for row in csv.DictReader(f)]
+
+    points = []
+    for it in iterations:
+        time += it['seconds']
+        points.append([time, it['energy']])
+    return np.array(points)
+
 def parseFile(filename):
+    if filename.endswith('.csv') or filename.endswith('.json'):
+        return parseTelemetry(filename)
+
     time = 0.0
     points = []
     zeroEnergy = 0.0
@@ -50,7 +73,7 @@ if __name__ == '__main__':
     parser = argparse.ArgumentParser(description="""
         Plot anytime performance from logs.
         """, formatter_class=argparse.ArgumentDefaultsHelpFormatter)
-    parser.add_argument('--logs', dest='logs', type=str, nargs='+', required=True, help='list of files containing logs')
+    parser.add_argument('--logs', dest='logs', type=str, nargs='+', required=True, help='list of files containing logs, or telemetry traces (.csv or .json) written by track --telemetry')
     parser.add_argument('--labels', dest='labels', type=str, nargs='+', required=True, help='list of labels to use for each line')
     parser.add_argument('--out', dest='outFile', type=str, required=True, help='output filename')
     args = parser.parse_args()
@@ -6,7 +6,22 @@ matplotlib.use('Agg')
 
 import matplotlib.pyplot as plt
 
+def parseTelemetry(filename):
+    ''' read the times per iteration from a CSV trace written by track --telemetry '''
+    import csv
+    with open(filename, 'r') as f:
+        rows = [dict((k, float(v)) for k, v in row.items()) for row in csv.DictReader(f)]
+    searchTimes = np.array([r['searchSeconds'] for r in rows])
+    augmentTimes = np.array([r['augmentSeconds'] for r in rows])
+    iterationTimes = np.array([r['seconds'] for r in rows])
+    # the telemetry does not split the search into BF init, BF and path extraction, nor augmentation and constraint update
+    empty = np.zeros(len(rows))
+    return empty, searchTimes, empty, augmentTimes, empty, iterationTimes
+
 def parseFile(filename):
+    if filename.endswith('.csv'):
+        return parseTelemetry(filename)
+
     iterationTimes = []
     initBfTimes = []
     bfTimes = []
@@ -45,7 +60,7 @@ if __name__ == '__main__':
     parser = argparse.ArgumentParser(description="""
         Plot how the iteration runtime is made up
         """, formatter_class=argparse.ArgumentDefaultsHelpFormatter)
-    parser.add_argument('--log', dest='log', type=str, required=True, help='file containing log')
+    parser.add_argument('--log', dest='log', type=str, required=True, help='file containing log, or CSV telemetry trace written by track --telemetry')
     parser.add_argument('--out', dest='outFile', type=str, required=True, help='output filename')
     parser.add_argument('--pieout', dest='pieOutFile', type=str, required=False, default=None, help='output filename')
     args = parser.parse_args()
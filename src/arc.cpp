@@ -14,12 +14,13 @@ Arc::Arc(Node* source,
          Type type,
          const std::vector<double>& scoreDeltas,
          Node* dependsOnCellInNode,
-         UserDataPtr data):
+         UserDataPtr data,
+         ScorePool* scorePool):
     IUserDataHolder(data),
 	sourceNode_(source),
 	targetNode_(target),
 	type_(type),
-	scoreDeltas_(scoreDeltas),
+	scoreDeltas_(scoreDeltas.begin(), scoreDeltas.end(), PoolAllocator<double>(scorePool)),
 	currentScore_(scoreDeltas[0]),
     enabled_(true),
     used_(0),
@@ -52,7 +53,7 @@ Arc::Arc(const Arc& a,
     Arc(map_node(a.sourceNode_),
         map_node(a.targetNode_),
         a.type_,
-        a.scoreDeltas_,
+        std::vector<double>(a.scoreDeltas_.begin(), a.scoreDeltas_.end()),
         map_node(a.dependsOnCellInNode_),
         data)
 {}
@@ -0,0 +1,79 @@
+#include "binarymodel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+namespace dpct
+{
+
+static_assert(sizeof(BinaryModelHeader) % sizeof(double) == 0, "Binary model sections must stay aligned");
+static_assert(sizeof(BinaryModelNode) % sizeof(double) == 0, "Binary model sections must stay aligned");
+static_assert(sizeof(BinaryModelLink) % sizeof(double) == 0, "Binary model sections must stay aligned");
+
+MappedFile::MappedFile(const std::string& filename):
+	fileDescriptor_(-1),
+	data_(nullptr),
+	size_(0)
+{
+	fileDescriptor_ = open(filename.c_str(), O_RDONLY);
+	if(fileDescriptor_ < 0)
+		throw std::runtime_error("Could not open file for mapping: " + filename);
+
+	struct stat fileStatus;
+	if(fstat(fileDescriptor_, &fileStatus) != 0)
+	{
+		close(fileDescriptor_);
+		throw std::runtime_error("Could not determine size of file: " + filename);
+	}
+	size_ = fileStatus.st_size;
+	map(filename, false);
+}
+
+MappedFile::MappedFile(const std::string& filename, size_t size):
+	fileDescriptor_(-1),
+	data_(nullptr),
+	size_(size)
+{
+	fileDescriptor_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fileDescriptor_ < 0)
+		throw std::runtime_error("Could not create file for mapping: " + filename);
+
+	if(ftruncate(fileDescriptor_, size_) != 0)
+	{
+		close(fileDescriptor_);
+		throw std::runtime_error("Could not resize file: " + filename);
+	}
+	map(filename, true);
+}
+
+void MappedFile::map(const std::string& filename, bool writable)
+{
+	if(size_ == 0)
+		return;
+
+	void* data = mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fileDescriptor_, 0);
+	if(data == MAP_FAILED)
+	{
+		close(fileDescriptor_);
+		throw std::runtime_error("Could not map file into memory: " + filename);
+	}
+	data_ = static_cast<char*>(data);
+
+	// models are read front to back
+	if(!writable)
+		madvise(data_, size_, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile()
+{
+	if(data_ != nullptr)
+		munmap(data_, size_);
+	if(fileDescriptor_ >= 0)
+		close(fileDescriptor_);
+}
+
+} // end namespace dpct
@@ -0,0 +1,142 @@
+#include "compiledmodel.h"
+
+#include <sstream>
+#include <stdexcept>
+
+namespace dpct
+{
+
+CompiledModel::CompiledModel(FlowGraph* graph):
+	FlowGraphBuilder(graph),
+	numWeights_(0),
+	initialStateEnergy_(0.0),
+	costVectorOffsets_(1, 0),
+	numAssignedCostVectors_(0)
+{}
+
+void CompiledModel::addCostTerms(const std::vector<CostTerm>& termPerState, size_t numWeights)
+{
+	if(costVectorOffsets_.size() == 1)
+		numWeights_ = numWeights;
+	else if(numWeights != numWeights_)
+		throw std::runtime_error("All costs of a compiled model must be computed from the same weights");
+
+	for(const CostTerm& term : termPerState)
+	{
+		features_.push_back(term.first);
+		weightIndices_.push_back(term.second);
+	}
+	costVectorOffsets_.push_back(features_.size());
+}
+
+size_t CompiledModel::assignCostVectors(size_t minNumVectors, size_t maxNumVectors)
+{
+	size_t first = numAssignedCostVectors_;
+	size_t numVectors = costVectorOffsets_.size() - 1 - first;
+	if(numVectors < minNumVectors || numVectors > maxNumVectors)
+	{
+		std::stringstream s;
+		s << "Compiled model got " << numVectors << " cost vectors for a hypothesis, expected " 
+		  << minNumVectors << " to " << maxNumVectors << ". It must be built by a graph reader.";
+		throw std::runtime_error(s.str());
+	}
+	numAssignedCostVectors_ += numVectors;
+	return first;
+}
+
+void CompiledModel::addCostTarget(const FlowGraph::Arc& arc, size_t costVector, size_t numCostDeltas, const FlowGraph::Node& node)
+{
+	size_t numStates = costVectorOffsets_[costVector + 1] - costVectorOffsets_[costVector];
+	if(numStates != numCostDeltas + 1)
+		throw std::runtime_error("Compiled model got cost deltas that do not match the cost vector of the hypothesis");
+
+	// arcs without costs can never carry flow
+	if(numCostDeltas > 0)
+		costTargets_.push_back({arc, node, costVector});
+}
+
+void CompiledModel::addNode(
+	size_t id,
+	const CostDeltaVector& detectionCosts,
+	const CostDeltaVector& detectionCostDeltas,
+	const CostDeltaVector& appearanceCostDeltas,
+	const CostDeltaVector& disappearanceCostDeltas,
+	size_t targetIdx)
+{
+	size_t first = assignCostVectors(1, 3);
+	size_t numVectors = numAssignedCostVectors_ - first;
+	FlowGraphBuilder::addNode(id, detectionCosts, detectionCostDeltas, appearanceCostDeltas, disappearanceCostDeltas, targetIdx);
+
+	const FlowGraph::FullNode& node = idToFlowGraphNodeMap_[id];
+	addCostTarget(node.a, first, detectionCostDeltas.size(), node.u);
+
+	// readers compute the appearance costs before the disappearance costs, but either can be missing
+	size_t appearanceVector = first + 1;
+	size_t disappearanceVector = first + 2;
+	if(numVectors == 2 && appearanceCostDeltas.empty())
+		disappearanceVector = first + 1;
+
+	if(!appearanceCostDeltas.empty())
+		addCostTarget(getAppearanceArc(id), appearanceVector, appearanceCostDeltas.size());
+	if(!disappearanceCostDeltas.empty())
+		addCostTarget(getDisappearanceArc(id), disappearanceVector, disappearanceCostDeltas.size());
+}
+
+void CompiledModel::addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas)
+{
+	size_t costVector = assignCostVectors(1, 1);
+	FlowGraphBuilder::addArc(srcId, destId, costDeltas);
+	addCostTarget(getMoveArc(std::make_pair(srcId, destId)), costVector, costDeltas.size());
+}
+
+void CompiledModel::allowMitosis(size_t id, ValueType divisionCostDelta)
+{
+	size_t costVector = assignCostVectors(1, 1);
+	FlowGraphBuilder::allowMitosis(id, divisionCostDelta);
+	addCostTarget(idToFlowGraphDivisionArcMap_[id], costVector, 1);
+}
+
+void CompiledModel::setWeights(const std::vector<ValueType>& weights)
+{
+	if(weights.size() != numWeights_)
+	{
+		std::stringstream s;
+		s << "Compiled model needs " << numWeights_ << " weights, got " << weights.size();
+		throw std::runtime_error(s.str());
+	}
+
+	// the extra weight is the zero weight of states without features
+	weights_.assign(weights.begin(), weights.end());
+	weights_.push_back(0.0);
+
+	// one pass over all states of all hypotheses, independent iterations that the compiler can vectorize
+	size_t numStates = features_.size();
+	costs_.resize(numStates);
+	const ValueType* features = features_.data();
+	const size_t* weightIndices = weightIndices_.data();
+	const ValueType* weightValues = weights_.data();
+	ValueType* costs = costs_.data();
+	for(size_t i = 0; i < numStates; i++)
+		costs[i] = features[i] * weightValues[weightIndices[i]];
+
+	initialStateEnergy_ = 0.0;
+	for(size_t v = 0; v + 1 < costVectorOffsets_.size(); v++)
+		initialStateEnergy_ += costs[costVectorOffsets_[v]];
+
+	// without flow, changing the arc costs does not need to remove any tracks
+	graph_->resetFlow();
+	for(const CostTarget& target : costTargets_)
+	{
+		size_t begin = costVectorOffsets_[target.costVector];
+		size_t end = costVectorOffsets_[target.costVector + 1];
+		costDeltas_.resize(end - begin - 1);
+		for(size_t i = begin + 1; i < end; i++)
+			costDeltas_[i - begin - 1] = costs[i] - costs[i - 1];
+		if(target.arc != lemon::INVALID)
+			graph_->setArcCosts(target.arc, costDeltas_);
+		else
+			graph_->setNodeCosts({target.node, target.node, target.arc}, costDeltas_);
+	}
+}
+
+} // end namespace dpct
@@ -6,17 +6,45 @@
 
 #include <assert.h>
 #include <limits>
+#include <algorithm>
+#include <cmath>
 
 namespace dpct
 {
-FlowGraph::FlowGraph():
+FlowGraph::FlowGraph(bool splitDetections):
 	flowMap_(baseGraph_),
-	capacityMap_(baseGraph_)
+	sharedFlowMap_(baseGraph_),
+	capacityMap_(baseGraph_),
+	splitDetections_(splitDetections),
+	frozenArcCost_(0.0),
+	telemetry_(nullptr),
+	timeBudgetSeconds_(0.0),
+	energyGapTolerance_(0.0),
+	pathBatchCostRatio_(0.95),
+	stopReason_(StopReason::Converged),
+	localCycleRepair_(false),
+	tracked_(false)
 {
 	source_ = baseGraph_.addNode();
-	nodeTimestepMap_[source_] = 0;
+	setNodeTimestep(source_, 0);
 	targets_.push_back(baseGraph_.addNode());
-	nodeTimestepMap_[targets_.front()] = 1;
+	setNodeTimestep(targets_.front(), 1);
+}
+
+void FlowGraph::reserve(size_t numDetections, size_t numLinks, size_t numDivisions, size_t numCostsPerArc)
+{
+	size_t nodesPerDetection = splitDetections_ ? 2 : 1;
+	size_t numNodes = 2 + targets_.size() + nodesPerDetection * numDetections + numDivisions;
+	size_t numArcs = (nodesPerDetection + 1) * numDetections + numLinks + numDivisions;
+
+	baseGraph_.reserveNode(numNodes);
+	baseGraph_.reserveArc(numArcs);
+	nodeTimestepMap_.reserve(numNodes);
+	intermediateArcs_.reserve(numArcs);
+	arcCostRanges_.reserve(numArcs);
+	if(!splitDetections_)
+		nodeCostRanges_.reserve(numNodes);
+	arcCostPool_.reserve((numArcs + (splitDetections_ ? 0 : numDetections)) * numCostsPerArc);
 }
 
 FlowGraph::FullNode FlowGraph::addNode(const CostVector& costs, size_t timestep)
@@ -24,35 +52,75 @@ FlowGraph::FullNode FlowGraph::addNode(const CostVector& costs, size_t timestep)
 	assert(costs.size() > 0);
 	
 	FullNode f;
-	f.u = baseGraph_.addNode();
-	f.v = baseGraph_.addNode();
-	f.a = addArc(f.u, f.v, costs);
-	intermediateArcs_.insert(f.a);
-	nodeTimestepMap_[f.u] = timestep * 2 + 1;
-	nodeTimestepMap_[f.v] = timestep * 2 + 2;
+	if(splitDetections_)
+	{
+		f.u = baseGraph_.addNode();
+		f.v = baseGraph_.addNode();
+		f.a = addArc(f.u, f.v, costs);
+		intermediateArcs_[baseGraph_.id(f.a)] = true;
+		setNodeTimestep(f.v, timestep * 2 + 2);
+	}
+	else
+	{
+		// the node carries the costs itself, its out-side in the residual graph gets the timestep of an out-node
+		f.u = f.v = baseGraph_.addNode();
+		f.a = lemon::INVALID;
+		size_t index = baseGraph_.id(f.u);
+		if(index >= nodeCostRanges_.size())
+			nodeCostRanges_.resize(index + 1, CostRange(0, 0));
+		assignCosts(nodeCostRanges_[index], costs);
+	}
+	if(tracked_)
+		invalidateResidualGraph();
+	setNodeTimestep(f.u, timestep * 2 + 1);
 
 	// update target timestep such that it is higher than any node timestep
-	if(timestep * 2 + 2 >= nodeTimestepMap_[targets_.front()])
+	if(timestep * 2 + 2 >= nodeTimestepMap_[baseGraph_.id(targets_.front())])
 	{
 		for(auto t : targets_)
-			nodeTimestepMap_[t] = timestep * 2 + 3;
+			setNodeTimestep(t, timestep * 2 + 3);
 	}
 
 	return f;
 }
 
-FlowGraph::Arc FlowGraph::addArc(FlowGraph::Node source,
-	FlowGraph::Node target,
-	const CostVector& costs)
+FlowGraph::Arc FlowGraph::createArc(const Node& source, const Node& target, const CostVector& costs)
 {
 	assert(costs.size() > 0);
 	Arc a = baseGraph_.addArc(source, target);
-	arcCosts_[a] = costs;
+	size_t index = baseGraph_.id(a);
+	if(index >= arcCostRanges_.size())
+	{
+		arcCostRanges_.resize(index + 1);
+		intermediateArcs_.resize(index + 1, false);
+		frozenArcs_.resize(index + 1, false);
+	}
+	arcCostRanges_[index] = CostRange(arcCostPool_.size(), costs.size());
+	arcCostPool_.insert(arcCostPool_.end(), costs.begin(), costs.end());
+	intermediateArcs_[index] = false;
+	frozenArcs_[index] = false;
 	flowMap_[a] = 0;
+	sharedFlowMap_[a] = 0;
 	capacityMap_[a] = costs.size();
 	return a;
 }
 
+FlowGraph::Arc FlowGraph::addArc(FlowGraph::Node source,
+	FlowGraph::Node target,
+	const CostVector& costs)
+{
+	Arc a = createArc(source, target, costs);
+
+	// when adding arcs to a tracked graph, let the adjacent tracks choose again
+	if(tracked_)
+	{
+		releaseTracksAt(source);
+		releaseTracksAt(target);
+		invalidateResidualGraph();
+	}
+	return a;
+}
+
 FlowGraph::Arc FlowGraph::addArc(FlowGraph::FullNode source,
 	FlowGraph::FullNode target,
 	const CostVector& costs)
@@ -64,26 +132,383 @@ FlowGraph::Arc FlowGraph::addArc(FlowGraph::FullNode source,
 FlowGraph::Arc FlowGraph::allowMitosis(FlowGraph::FullNode parent,
 	double divisionCost)
 {
+	if(tracked_)
+		releaseTracksAt(parent.v);
+
 	// set up duplicate with disabled in arc
+	// the duplicate leaves at the same time as the parent's out-node, or the out-side of an unsplit parent
 	Node duplicate = baseGraph_.addNode();
-	nodeTimestepMap_[duplicate] = nodeTimestepMap_[parent.v];
+	setNodeTimestep(duplicate, nodeTimestepMap_[baseGraph_.id(parent.v)] + (parent.a == lemon::INVALID ? 1 : 0));
 	Arc a = addArc(source_, duplicate, {divisionCost});
+	parentToDuplicateMap_[parent.v] = duplicate;
+	duplicateToParentMap_[duplicate] = parent.v;
+
+	return a;
+}
 
-	// copy all out arcs, but with capacity=1 only, and don't add disappearance arc
-	for(Graph::OutArcIt oa(baseGraph_, parent.v); oa != lemon::INVALID; ++oa)
+void FlowGraph::setArcCosts(Arc a, const CostVector& costs)
+{
+	assert(costs.size() > 0);
+	bool removedFlow = removeFlowThrough(a);
+	removedFlow = releaseTracksAt(baseGraph_.source(a)) || removedFlow;
+	removedFlow = releaseTracksAt(baseGraph_.target(a)) || removedFlow;
+
+	assignCosts(arcCostRanges_[baseGraph_.id(a)], costs);
+	capacityMap_[a] = costs.size();
+	if(removedFlow)
+		invalidateResidualGraph();
+	else if(residualGraph_)
+		updateArc(a);
+}
+
+void FlowGraph::setNodeCosts(const FullNode& n, const CostVector& costs)
+{
+	if(n.a != lemon::INVALID)
 	{
-		if(!isTarget(baseGraph_.target(oa)))
-			addArc(duplicate, baseGraph_.target(oa), {arcCosts_[oa][0]});
+		setArcCosts(n.a, costs);
+		return;
 	}
 
-	parentToDuplicateMap_[parent.v] = duplicate;
-	duplicateToParentMap_[duplicate] = parent.v;
+	assert(costs.size() > 0);
+	bool removedFlow = releaseTracksAt(n.u);
+	assignCosts(nodeCostRanges_[baseGraph_.id(n.u)], costs);
+	if(removedFlow)
+		invalidateResidualGraph();
+	else if(residualGraph_)
+		updateNode(n.u);
+}
 
-	return a;
+void FlowGraph::assignCosts(CostRange& range, const CostVector& costs)
+{
+	// reuse the pool entries if the length stays the same, otherwise append (the old ones are left unused)
+	if(range.second != costs.size())
+	{
+		range = CostRange(arcCostPool_.size(), costs.size());
+		arcCostPool_.resize(arcCostPool_.size() + costs.size());
+	}
+	std::copy(costs.begin(), costs.end(), arcCostPool_.begin() + range.first);
+}
+
+void FlowGraph::removeArc(Arc a)
+{
+	if(isIntermediateArc(a))
+		throw std::runtime_error("Cannot remove the arc of a detection, remove the node instead");
+
+	removeFlowThrough(a);
+	baseGraph_.erase(a);
+	invalidateResidualGraph();
+}
+
+void FlowGraph::removeNode(FullNode n)
+{
+	if(n.a == lemon::INVALID)
+		releaseTracksAt(n.u);
+	else
+		removeFlowThrough(n.a);
+
+	std::map<Node, Node>::iterator duplicateIt = parentToDuplicateMap_.find(n.v);
+	if(duplicateIt != parentToDuplicateMap_.end())
+	{
+		// erasing a node erases all its arcs
+		eraseNode(duplicateIt->second);
+		duplicateToParentMap_.erase(duplicateIt->second);
+		parentToDuplicateMap_.erase(duplicateIt);
+	}
+	eraseNode(n.u);
+	if(n.v != n.u)
+		eraseNode(n.v);
+	invalidateResidualGraph();
+}
+
+void FlowGraph::eraseNode(const Node& n)
+{
+	if(isDetectionNode(n))
+		nodeCostRanges_[baseGraph_.id(n)] = CostRange(0, 0);
+	baseGraph_.erase(n);
+}
+
+bool FlowGraph::releaseTracksAt(const Node& n)
+{
+	std::map<Node, Node>::const_iterator parentIt = duplicateToParentMap_.find(n);
+	Node node = parentIt == duplicateToParentMap_.end() ? n : parentIt->second;
+	if(node == source_ || isTarget(node))
+		return false;
+
+	if(isDetectionNode(node))
+	{
+		bool removedFlow = false;
+		for(Graph::InArcIt ia(baseGraph_, node); ia != lemon::INVALID; ++ia)
+			removedFlow = removeFlowThrough(ia) || removedFlow;
+		return removedFlow;
+	}
+
+	// the arc of the detection is the only out arc of its in-node (odd internal timestep), 
+	// and the only in arc of its out-node (even internal timestep)
+	if(nodeTimestepMap_[baseGraph_.id(node)] % 2 == 1)
+	{
+		for(Graph::OutArcIt oa(baseGraph_, node); oa != lemon::INVALID; ++oa)
+		{
+			if(isIntermediateArc(oa))
+				return removeFlowThrough(oa);
+		}
+	}
+	else
+	{
+		for(Graph::InArcIt ia(baseGraph_, node); ia != lemon::INVALID; ++ia)
+		{
+			if(isIntermediateArc(ia))
+				return removeFlowThrough(ia);
+		}
+	}
+	return false;
+}
+
+bool FlowGraph::removeFlowThrough(const Arc& a)
+{
+	if(getLinkFlow(a) == 0)
+		return false;
+
+	// a track step is an arc and whether it carries the flow of the division duplicate sharing it,
+	// which then leaves from the duplicate instead of the arc's source
+	typedef std::pair<Arc, bool> TrackStep;
+	auto stepSource = [&](const TrackStep& step) -> Node
+	{
+		Node n = baseGraph_.source(step.first);
+		return step.second ? parentToDuplicateMap_.find(n)->second : n;
+	};
+
+	std::set<Node> parents;
+	while(getLinkFlow(a) > 0)
+	{
+		std::vector<TrackStep> track(1, TrackStep(a, flowMap_[a] == 0));
+
+		// walk back to the source
+		for(Node n = stepSource(track.front()); n != source_; )
+		{
+			TrackStep next(lemon::INVALID, false);
+			for(Graph::InArcIt ia(baseGraph_, n); ia != lemon::INVALID && next.first == lemon::INVALID; ++ia)
+			{
+				if(flowMap_[ia] > 0)
+					next = TrackStep(ia, false);
+			}
+			for(Graph::InArcIt ia(baseGraph_, n); ia != lemon::INVALID && next.first == lemon::INVALID; ++ia)
+			{
+				if(sharedFlowMap_[ia] > 0)
+					next = TrackStep(ia, true);
+			}
+
+			if(next.first == lemon::INVALID)
+				throw std::runtime_error("Flow is not conserved, could not find the start of a track");
+			track.push_back(next);
+			n = stepSource(next);
+		}
+
+		// walk forward to a target, a duplicate leaves along the arcs of its parent
+		for(Node n = baseGraph_.target(a); !isTarget(n); )
+		{
+			std::map<Node, Node>::const_iterator parentIt = duplicateToParentMap_.find(n);
+			bool shared = parentIt != duplicateToParentMap_.end();
+			const FlowMap& flowMap = shared ? sharedFlowMap_ : flowMap_;
+			TrackStep next(lemon::INVALID, shared);
+			for(Graph::OutArcIt oa(baseGraph_, shared ? parentIt->second : n); oa != lemon::INVALID && next.first == lemon::INVALID; ++oa)
+			{
+				if(flowMap[oa] > 0)
+					next.first = oa;
+			}
+
+			if(next.first == lemon::INVALID)
+				throw std::runtime_error("Flow is not conserved, could not find the end of a track");
+			track.push_back(next);
+			n = baseGraph_.target(next.first);
+		}
+
+		DEBUG_MSG("Removing track of length " << track.size() << " through arc " << baseGraph_.id(a));
+		for(const TrackStep& step : track)
+		{
+			(step.second ? sharedFlowMap_ : flowMap_)[step.first] -= 1;
+			Node n = baseGraph_.target(step.first);
+			if(parentToDuplicateMap_.find(n) != parentToDuplicateMap_.end())
+				parents.insert(n);
+		}
+	}
+
+	// a division needs the single unit of its parent, so the track of the duplicate is removed along with it
+	for(const Node& parent : parents)
+	{
+		for(Graph::InArcIt ia(baseGraph_, parentToDuplicateMap_[parent]); ia != lemon::INVALID; ++ia)
+			removeFlowThrough(ia);
+	}
+	return true;
+}
+
+double FlowGraph::getArcFlowEnergy(const Arc& a) const
+{
+	// frozen inflow has no costs of its own
+	if(isFrozenArc(a))
+		return 0.0;
+
+	double energy = 0.0;
+	const CostRange& range = arcCostRanges_[baseGraph_.id(a)];
+	for(int f = 0; f < getLinkFlow(a); ++f)
+		energy += arcCostPool_[range.first + f];
+	return energy;
+}
+
+void FlowGraph::resetFlow()
+{
+	if(std::find(frozenArcs_.begin(), frozenArcs_.end(), true) != frozenArcs_.end())
+		throw std::runtime_error("Cannot reset the flow of a graph with frozen nodes");
+
+	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
+	{
+		flowMap_[a] = 0;
+		sharedFlowMap_[a] = 0;
+	}
+	invalidateResidualGraph();
+	tracked_ = false;
+}
+
+double FlowGraph::getFlowEnergy(double initialStateEnergy) const
+{
+	double energy = initialStateEnergy;
+	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
+		energy += getArcFlowEnergy(a);
+	for(size_t i = 0; i < nodeCostRanges_.size(); ++i)
+	{
+		if(nodeCostRanges_[i].second > 0)
+			energy += getNodeFlowEnergy(baseGraph_.nodeFromId(i));
+	}
+	return energy;
+}
+
+double FlowGraph::getNodeFlowEnergy(const Node& n) const
+{
+	double energy = 0.0;
+	const CostRange& range = nodeCostRanges_[baseGraph_.id(n)];
+	int flow = sumInFlow(n);
+	for(int f = 0; f < flow; ++f)
+		energy += arcCostPool_[range.first + f];
+	return energy;
+}
+
+double FlowGraph::freezeNodes(const std::vector<FullNode>& nodes)
+{
+	std::set<Node> frozenNodes;
+	for(const FullNode& n : nodes)
+	{
+		frozenNodes.insert(n.u);
+		frozenNodes.insert(n.v);
+		std::map<Node, Node>::const_iterator duplicateIt = parentToDuplicateMap_.find(n.v);
+		if(duplicateIt != parentToDuplicateMap_.end())
+			frozenNodes.insert(duplicateIt->second);
+	}
+
+	// sum up the energy of all arcs that disappear, and the flow that continues into remaining nodes
+	double energy = 0.0;
+	std::map<Node, int> inflow;
+	for(const Node& n : frozenNodes)
+	{
+		if(isDetectionNode(n))
+			energy += getNodeFlowEnergy(n);
+		for(Graph::InArcIt ia(baseGraph_, n); ia != lemon::INVALID; ++ia)
+		{
+			Node s = baseGraph_.source(ia);
+			if(s != source_ && frozenNodes.count(s) == 0 && getLinkFlow(ia) > 0)
+				throw std::runtime_error("Cannot freeze nodes whose tracks start at remaining nodes");
+			if(s == source_ || frozenNodes.count(s) == 0)
+				energy += getArcFlowEnergy(ia);
+		}
+
+		for(Graph::OutArcIt oa(baseGraph_, n); oa != lemon::INVALID; ++oa)
+		{
+			energy += getArcFlowEnergy(oa);
+			Node t = baseGraph_.target(oa);
+			if(!isTarget(t) && frozenNodes.count(t) == 0 && getLinkFlow(oa) > 0)
+				inflow[t] += getLinkFlow(oa);
+		}
+	}
+
+	for(const FullNode& n : nodes)
+	{
+		std::map<Node, Node>::iterator duplicateIt = parentToDuplicateMap_.find(n.v);
+		if(duplicateIt != parentToDuplicateMap_.end())
+		{
+			duplicateToParentMap_.erase(duplicateIt->second);
+			parentToDuplicateMap_.erase(duplicateIt);
+		}
+	}
+	for(const Node& n : frozenNodes)
+		eraseNode(n);
+
+	// the continuing tracks now enter from the source. Their arc costs outweigh all other costs in the graph,
+	// such that they are always used again, even after their tracks were released by a modification.
+	double sumOfCosts = 1.0;
+	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
+	{
+		if(isFrozenArc(a))
+			continue;
+		const CostRange& range = arcCostRanges_[baseGraph_.id(a)];
+		for(size_t i = 0; i < range.second; ++i)
+			sumOfCosts += std::abs(arcCostPool_[range.first + i]);
+	}
+	for(const CostRange& range : nodeCostRanges_)
+	{
+		for(size_t i = 0; i < range.second; ++i)
+			sumOfCosts += std::abs(arcCostPool_[range.first + i]);
+	}
+	frozenArcCost_ = std::min(frozenArcCost_, -2.0 * sumOfCosts);
+
+	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
+	{
+		if(isFrozenArc(a))
+		{
+			const CostRange& range = arcCostRanges_[baseGraph_.id(a)];
+			std::fill(arcCostPool_.begin() + range.first, arcCostPool_.begin() + range.first + range.second, frozenArcCost_);
+		}
+	}
+
+	for(auto& nodeInflow : inflow)
+	{
+		Arc a = createArc(source_, nodeInflow.first, CostVector(nodeInflow.second, frozenArcCost_));
+		frozenArcs_[baseGraph_.id(a)] = true;
+		flowMap_[a] = nodeInflow.second;
+		tracked_ = true;
+	}
+
+	compactArcCostPool();
+	invalidateResidualGraph();
+	return energy;
+}
+
+void FlowGraph::compactArcCostPool()
+{
+	size_t numUsedCosts = 0;
+	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
+		numUsedCosts += numArcCosts(a);
+	for(const CostRange& range : nodeCostRanges_)
+		numUsedCosts += range.second;
+	if(2 * numUsedCosts >= arcCostPool_.size())
+		return;
+
+	std::vector<double> pool;
+	pool.reserve(2 * numUsedCosts);
+	auto moveRange = [&](CostRange& range)
+	{
+		pool.insert(pool.end(), arcCostPool_.begin() + range.first, arcCostPool_.begin() + range.first + range.second);
+		range.first = pool.size() - range.second;
+	};
+	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
+		moveRange(arcCostRanges_[baseGraph_.id(a)]);
+	for(CostRange& range : nodeCostRanges_)
+		moveRange(range);
+	arcCostPool_.swap(pool);
 }
 
 double FlowGraph::maxFlow()
 {
+	if(!splitDetections_)
+		throw std::runtime_error("Min cost max flow needs split detections, it cannot handle costs on nodes");
+
  	TimePoint startTime = std::chrono::high_resolution_clock::now();
 
  	LOG_MSG("Running min cost max flow on a graph with " << lemon::countNodes(baseGraph_)
@@ -101,8 +526,8 @@ double FlowGraph::maxFlow()
 	DistMap distMap(baseGraph_);
 	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
 	{
-		assert(arcCosts_[a].size() == 1);
-		distMap[a] = arcCosts_[a][0];
+		assert(numArcCosts(a) == 1);
+		distMap[a] = getArcCost(a, 0);
 	}
 	minCostFlow.costMap(distMap);
 
@@ -114,7 +539,9 @@ double FlowGraph::maxFlow()
 	for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
 	{
 		flowMap_[a] = minCostFlow.flow(a);
+		sharedFlowMap_[a] = 0;
 	}
+	tracked_ = true;
 
 	TimePoint endTime = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<double> elapsed_seconds = endTime - startTime;
@@ -129,17 +556,37 @@ double FlowGraph::maxFlowMinCostTracking(
 	bool useBackArcs, 
 	size_t maxNumPaths, 
 	bool useOrderedNodeListInBF,
-	bool partialBFUpdates)
+	bool partialBFUpdates,
+	bool useStaticResidualArcs,
+	bool useCsrBackend,
+	size_t numThreads,
+	bool useDijkstra,
+	size_t maxPathsPerIteration)
 {
 
+	TimePoint setupStartTime = std::chrono::high_resolution_clock::now();
 	if(!residualGraph_)
-		initializeResidualGraph(useBackArcs, useOrderedNodeListInBF);
+		initializeResidualGraph(useBackArcs, useOrderedNodeListInBF, useStaticResidualArcs, useCsrBackend, useDijkstra);
+	residualGraph_->setNumThreads(numThreads);
+	residualGraph_->setLocalCycleRepair(localCycleRepair_);
 
 	TimePoint startTime = std::chrono::high_resolution_clock::now();
+	if(telemetry_ != nullptr)
+		telemetry_->addSetupSeconds(std::chrono::duration<double>(startTime - setupStartTime).count());
 
 	ResidualGraph::ShortestPathResult result;
 	size_t iter=0;
+	size_t numPaths=0;
 	double currentEnergy = initialStateEnergy;
+	// paths that improve the energy by less than the tolerance are not worth augmenting
+	double minImprovement = std::max(0.00000001, energyGapTolerance_);
+	stopReason_ = StopReason::Converged;
+	// batches stop once a shortest path tree offers no second disjoint path
+	bool batching = maxPathsPerIteration > 1;
+	size_t numBatchedIterations = 0;
+	std::vector<int> conflictKeys;
+	if(batching)
+		conflictKeys = this->conflictKeys();
 	LOG_MSG("Beginning tracking ...");
 	do
 	{
@@ -148,17 +595,23 @@ double FlowGraph::maxFlowMinCostTracking(
 		DEBUG_MSG("Current Flow:");
 		printAllFlows();
 
+		size_t numToggledArcs = residualGraph_->getNumToggledArcs();
 		result = residualGraph_->findShortestPath(targets_, partialBFUpdates);
+		TimePoint searchEndTime = std::chrono::high_resolution_clock::now();
+		size_t numAugmentedPaths = 0;
 
 		DEBUG_MSG("\tFound path or cycle"
 				<< " of length " << result.first.size() 
 				<< " of distance " << result.second);
 
-		if(result.second > -0.00000001)
+		if(result.second > -minImprovement)
 		{
 #ifdef DEBUG_LOG
 			printPath(result.first); std::cout << std::endl;
 #endif
+			if(result.second <= -0.00000001)
+				stopReason_ = StopReason::EnergyGap;
+			recordIteration(iter, iterationStartTime, searchEndTime, result, 0, numToggledArcs, currentEnergy);
 			break;
 		}
 
@@ -171,36 +624,223 @@ double FlowGraph::maxFlowMinCostTracking(
 			// outName << "/Users/chaubold/Desktop/residualGraph_iter" << iter << ".dot";
 			// residualGraph_->toDot(outName.str(), result.first);
 #endif
-			augmentUnitFlow(result.first);
+			std::vector<ResidualGraph::ShortestPathResult> batch(1, result);
+			if(batching && !residualGraph_->getLastSearchStats().negativeCycle)
+			{
+				size_t batchSize = maxPathsPerIteration;
+				if(maxNumPaths > 0)
+					batchSize = std::min(batchSize, maxNumPaths - numPaths);
+				batch = residualGraph_->collectDisjointTreePaths(result, targets_, conflictKeys, batchSize, 
+																	   pathBatchCostRatio_);
+				DEBUG_MSG("Augmenting " << batch.size() << " disjoint paths at once");
+				batching = batch.size() > 1;
+				++numBatchedIterations;
+			}
+
+			// the paths are disjoint, so augmenting one does not change the residual arcs of the others
+			for(const ResidualGraph::ShortestPathResult& path : batch)
+				augmentUnitFlow(path.first);
 			TimePoint afterAugmentationTime = std::chrono::high_resolution_clock::now();
 			std::chrono::duration<double> elapsed_seconds1 = afterAugmentationTime - iterationBetweenTime;
-			updateEnabledArcs(result.first);
-			currentEnergy += result.second; // decrease energy
+			for(const ResidualGraph::ShortestPathResult& path : batch)
+			{
+				updateEnabledArcs(path.first);
+				currentEnergy += path.second; // decrease energy
+			}
+			numPaths += batch.size();
+			numAugmentedPaths = batch.size();
 			TimePoint afterArcEnablingTime = std::chrono::high_resolution_clock::now();
 			std::chrono::duration<double> elapsed_seconds = afterArcEnablingTime - iterationBetweenTime;
 			DEBUG_MSG("augmenting flow took " << elapsed_seconds1.count() 
 				<< " and updating constraints took " << elapsed_seconds.count() << " secs");
 		}
+		recordIteration(iter, iterationStartTime, searchEndTime, result, numAugmentedPaths, numToggledArcs, currentEnergy);
 		TimePoint iterationEndTime = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> elapsed_seconds = iterationEndTime - iterationStartTime;
 		DEBUG_MSG("\t<<<Iteration " << iter << " done in " << elapsed_seconds.count() 
 				<< " secs, system Energy=" << currentEnergy);
 		iter++;
+
+		if(numAugmentedPaths > 0 && stopAnytime(iter - 1, numPaths, currentEnergy, setupStartTime))
+			break;
 	}
-	while(result.first.size() > 0 && result.second < 0.0 && (maxNumPaths < 1 || iter < maxNumPaths));
+	while(result.first.size() > 0 && result.second < 0.0 && (maxNumPaths < 1 || numPaths < maxNumPaths));
+
+	if(stopReason_ == StopReason::Converged && maxNumPaths > 0 && numPaths >= maxNumPaths)
+		stopReason_ = StopReason::MaxNumPaths;
 
 	TimePoint endTime = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<double> elapsed_seconds = endTime - startTime;
 	LOG_MSG("Tracking took " << elapsed_seconds.count() << " secs and " << iter << " iterations");
+	if(maxPathsPerIteration > 1)
+		LOG_MSG("Augmented " << numPaths << " paths in batches of up to " << maxPathsPerIteration
+			<< ", batching stopped after " << numBatchedIterations << " iterations");
 	LOG_MSG("Final energy: " << currentEnergy);
 	return currentEnergy;
 }
 
-void FlowGraph::initializeResidualGraph(bool useBackArcs, bool useOrderedNodeListInBF)
+void FlowGraph::setAnytimeLimits(double timeBudgetSeconds, double energyGapTolerance)
+{
+	if(timeBudgetSeconds < 0.0 || energyGapTolerance < 0.0)
+		throw std::runtime_error("Time budget and energy gap tolerance must not be negative");
+	timeBudgetSeconds_ = timeBudgetSeconds;
+	energyGapTolerance_ = energyGapTolerance;
+}
+
+bool FlowGraph::stopAnytime(size_t iteration, size_t numPaths, double energy, const TimePoint& startTime)
+{
+	double elapsedSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	if(progressCallback_)
+	{
+		Progress progress;
+		progress.iteration = iteration;
+		progress.numPaths = numPaths;
+		progress.energy = energy;
+		progress.elapsedSeconds = elapsedSeconds;
+		if(!progressCallback_(progress))
+		{
+			LOG_MSG("Tracking stopped by the progress callback after " << numPaths << " paths");
+			stopReason_ = StopReason::Callback;
+			return true;
+		}
+	}
+
+	if(timeBudgetSeconds_ > 0.0 && elapsedSeconds >= timeBudgetSeconds_)
+	{
+		LOG_MSG("Tracking stopped after " << numPaths << " paths, time budget of " << timeBudgetSeconds_ << " secs is used up");
+		stopReason_ = StopReason::TimeBudget;
+		return true;
+	}
+	return false;
+}
+
+void FlowGraph::collectMemoryStatistics(MemoryStatistics& stats) const
+{
+	const std::string structure("FlowGraph");
+	stats.addStructure(structure, lemon::countNodes(baseGraph_), lemon::countArcs(baseGraph_));
+	stats.addListDigraph(structure, baseGraph_);
+	stats.addVector(structure, "targets", targets_);
+	stats.addItemMap<int>(structure, "flowMap", baseGraph_.maxArcId());
+	stats.addItemMap<int>(structure, "sharedFlowMap", baseGraph_.maxArcId());
+	stats.addItemMap<int>(structure, "capacityMap", baseGraph_.maxArcId());
+	stats.addVector(structure, "arcCostPool", arcCostPool_);
+	stats.addVector(structure, "arcCostRanges", arcCostRanges_);
+	stats.addVector(structure, "nodeCostRanges", nodeCostRanges_);
+	stats.addMap(structure, "parentToDuplicateMap", parentToDuplicateMap_);
+	stats.addMap(structure, "duplicateToParentMap", duplicateToParentMap_);
+	stats.addVector(structure, "intermediateArcs", intermediateArcs_);
+	stats.addVector(structure, "frozenArcs", frozenArcs_);
+	stats.addVector(structure, "nodeTimestepMap", nodeTimestepMap_);
+
+	if(residualGraph_)
+		residualGraph_->collectMemoryStatistics(stats);
+}
+
+void FlowGraph::recordIteration(
+	size_t iteration,
+	const TimePoint& startTime,
+	const TimePoint& searchEndTime,
+	const ResidualGraph::ShortestPathResult& result,
+	size_t numAugmentedPaths,
+	size_t numToggledArcsBefore,
+	double energy)
+{
+	if(telemetry_ == nullptr)
+		return;
+
+	TimePoint endTime = std::chrono::high_resolution_clock::now();
+	const ResidualGraph::SearchStats& stats = residualGraph_->getLastSearchStats();
+	IterationTelemetry it;
+	it.iteration = iteration;
+	it.seconds = std::chrono::duration<double>(endTime - startTime).count();
+	it.searchSeconds = std::chrono::duration<double>(searchEndTime - startTime).count();
+	it.augmentSeconds = std::chrono::duration<double>(endTime - searchEndTime).count();
+	it.bfRounds = stats.bfRounds;
+	it.relaxations = stats.relaxations;
+	it.dirtyNodes = stats.dirtyNodes;
+	it.arcsToggled = residualGraph_->getNumToggledArcs() - numToggledArcsBefore;
+	it.tokenRetries = stats.tokenRetries;
+	it.negativeCycles = stats.negativeCycle ? 1 : 0;
+	it.cycleRepairs = stats.cycleRepair ? 1 : 0;
+	it.numPaths = numAugmentedPaths;
+	it.pathLength = result.first.size();
+	it.pathCost = result.second;
+	it.energy = energy;
+	telemetry_->addIteration(it);
+}
+
+double FlowGraph::maxFlowMinCostRetracking(
+	double initialStateEnergy, 
+	bool useBackArcs, 
+	size_t maxNumPaths, 
+	bool useOrderedNodeListInBF,
+	bool partialBFUpdates,
+	bool useStaticResidualArcs,
+	bool useCsrBackend,
+	size_t numThreads,
+	bool useDijkstra,
+	size_t maxPathsPerIteration)
+{
+	double flowEnergy = getFlowEnergy(initialStateEnergy);
+	LOG_MSG("Retracking graph starting from a flow with energy " << flowEnergy 
+			<< (residualGraph_ ? "" : ", rebuilding the residual graph"));
+	return maxFlowMinCostTracking(flowEnergy, useBackArcs, maxNumPaths, useOrderedNodeListInBF, partialBFUpdates,
+								  useStaticResidualArcs, useCsrBackend, numThreads, useDijkstra, maxPathsPerIteration);
+}
+
+std::vector<int> FlowGraph::conflictKeys() const
+{
+	std::vector<int> keys(baseGraph_.maxNodeId() + 1, -1);
+	for(Graph::NodeIt n(baseGraph_); n != lemon::INVALID; ++n)
+	{
+		if(n == source_ || isTarget(n))
+			continue;
+		keys[baseGraph_.id(n)] = baseGraph_.id(n);
+		for(Graph::OutArcIt oa(baseGraph_, n); oa != lemon::INVALID; ++oa)
+		{
+			if(isIntermediateArc(oa))
+				keys[baseGraph_.id(n)] = baseGraph_.id(baseGraph_.target(oa));
+		}
+	}
+
+	for(const auto& duplicateAndParent : duplicateToParentMap_)
+		keys[baseGraph_.id(duplicateAndParent.first)] = keys[baseGraph_.id(duplicateAndParent.second)];
+	return keys;
+}
+
+void FlowGraph::initializeResidualGraph(
+	bool useBackArcs, 
+	bool useOrderedNodeListInBF, 
+	bool useStaticResidualArcs,
+	bool useCsrBackend,
+	bool useDijkstra)
 {
 	LOG_MSG("Initializing Residual Graph ...");
+	tracked_ = true;
 	TimePoint initStartTime = std::chrono::high_resolution_clock::now();
-	residualGraph_ = std::make_shared<ResidualGraph>(baseGraph_, source_, nodeTimestepMap_, useBackArcs, useOrderedNodeListInBF);
+
+	// division duplicates leave along the out arcs of their parents, each of which they can use once
+	ResidualGraph::SharedArcs sharedArcs;
+	for(const auto& parentAndDuplicate : parentToDuplicateMap_)
+	{
+		for(Graph::OutArcIt oa(baseGraph_, parentAndDuplicate.first); oa != lemon::INVALID; ++oa)
+		{
+			if(!isTarget(baseGraph_.target(oa)))
+				sharedArcs.push_back(std::make_pair(Arc(oa), parentAndDuplicate.second));
+		}
+	}
+
+	// unsplit detections are crossed along their transits
+	ResidualGraph::DetectionNodes detectionNodes;
+	for(size_t i = 0; i < nodeCostRanges_.size(); ++i)
+	{
+		if(nodeCostRanges_[i].second > 0)
+			detectionNodes.push_back(baseGraph_.nodeFromId(i));
+	}
+
+	residualGraph_ = std::make_shared<ResidualGraph>(baseGraph_, source_, nodeTimestepMap_, sharedArcs, useBackArcs, 
+													 useOrderedNodeListInBF, useStaticResidualArcs, useCsrBackend,
+													 useDijkstra, detectionNodes);
 	
 	TimePoint initEndTime = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<double> elapsed_seconds = initEndTime - initStartTime;
@@ -218,16 +858,27 @@ void FlowGraph::initializeResidualGraph(bool useBackArcs, bool useOrderedNodeLis
     		residualGraph_->addProvidedToken(a, ResidualGraph::Forward, 
     										 baseGraph_.id(duplicateToParentMap_[baseGraph_.target(a)]));
     	}
-    	else if(parentToDuplicateMap_.find(baseGraph_.target(a)) != parentToDuplicateMap_.end())
+    	else if(parentToDuplicateMap_.find(baseGraph_.target(a)) != parentToDuplicateMap_.end()
+    			&& !isDetectionNode(baseGraph_.target(a)))
     	{
     		residualGraph_->addForbiddenToken(a, ResidualGraph::Backward, baseGraph_.id(baseGraph_.target(a)));
     	}
     }
 
+    // an unsplit mother forbids the token on its backward transit instead of its intermediate arc
+    for(const Node& n : detectionNodes)
+    {
+    	updateNode(n);
+    	if(parentToDuplicateMap_.find(n) != parentToDuplicateMap_.end())
+    		residualGraph_->addForbiddenToken(n, ResidualGraph::Backward, baseGraph_.id(n));
+    }
+
     // enable all arcs depending on their flow
     for(Graph::ArcIt a(baseGraph_); a != lemon::INVALID; ++a)
     {
     	updateEnabledArc(a);
+    	if(sharedFlowMap_[a] > 0)
+    		updateEnabledSharedArc(a);
     }
 
     initEndTime = std::chrono::high_resolution_clock::now();
@@ -244,88 +895,80 @@ void FlowGraph::printPath(const Path& p)
     }
 }
 
-void FlowGraph::synchronizeDivisionDuplicateArcFlows()
-{
-	for(auto coupledNodeIt : parentToDuplicateMap_)
-	{
-		for(Graph::OutArcIt oa(baseGraph_, coupledNodeIt.first); oa != lemon::INVALID; ++oa)
-		{
-			int origFlow = flowMap_[oa];
-
-			for(Graph::OutArcIt duplicateOa(baseGraph_, coupledNodeIt.second); duplicateOa != lemon::INVALID; ++duplicateOa)
-			{
-				if(baseGraph_.target(oa) == baseGraph_.target(duplicateOa))
-				{
-					int duplicateFlow = flowMap_[duplicateOa];
-					int flow = std::max(origFlow, duplicateFlow);
-
-					flowMap_[duplicateOa] = std::min(flow, int(1));
-					flowMap_[oa] = flow;
-					break;
-				}
-			}
-		}
-	}
-}
-
 /// augment flow along a path or cycle, adding one unit of flow forward, and subtracting one backwards
 void FlowGraph::augmentUnitFlow(const FlowGraph::Path& p)
 {
+	// the net change of the in-flow of each unsplit detection along the path. A path that enters a detection
+	// and leaves it again on the same side does so in consecutive steps, which cancel
+	std::vector< std::pair<Node, int> > nodeFlowDeltas;
 	for(const std::pair<Arc, int>& af : p)
 	{
-		flowMap_[af.first] += af.second;
+		if(std::abs(af.second) == ResidualGraph::SharedStep)
+			sharedFlowMap_[af.first] += af.second / ResidualGraph::SharedStep;
+		else
+			flowMap_[af.first] += af.second;
 		updateArc(af.first);
 
-		// see if this is a division duplicate pair, if yes, keep arc flows synchronized
-		std::map<Node, Node>::const_iterator coupledNodeIt = duplicateToParentMap_.find(baseGraph_.source(af.first));
-		if(coupledNodeIt != duplicateToParentMap_.end())
-		{
-			for(Graph::OutArcIt oa(baseGraph_, coupledNodeIt->second); oa != lemon::INVALID; ++oa)
-			{
-				if(baseGraph_.target(oa) == baseGraph_.target(af.first))
-				{
-					flowMap_[oa] += af.second;
-					updateArc(oa);
-					break;
-				}
-			}
+		Node target = baseGraph_.target(af.first);
+		if(!isDetectionNode(target))
 			continue;
-		}
+		if(nodeFlowDeltas.empty() || nodeFlowDeltas.back().first != target)
+			nodeFlowDeltas.push_back(std::make_pair(target, 0));
+		nodeFlowDeltas.back().second += af.second > 0 ? 1 : -1;
+	}
 
-		coupledNodeIt = parentToDuplicateMap_.find(baseGraph_.source(af.first));
-		if(coupledNodeIt != parentToDuplicateMap_.end())
-		{
-			for(Graph::OutArcIt oa(baseGraph_, coupledNodeIt->second); oa != lemon::INVALID; ++oa)
-			{
-				if(baseGraph_.target(oa) == baseGraph_.target(af.first))
-				{
-					// set the duplicated arcs, but don't exceed their capacity!
-					flowMap_[oa] = std::min(flowMap_[af.first], 1);
-					updateArc(oa);
-					break;
-				}
-			}
-		}
+	// a cycle can enter and leave a detection in its last and first step
+	if(nodeFlowDeltas.size() > 1 && nodeFlowDeltas.front().first == nodeFlowDeltas.back().first)
+	{
+		nodeFlowDeltas.front().second += nodeFlowDeltas.back().second;
+		nodeFlowDeltas.pop_back();
+	}
+	for(const std::pair<Node, int>& nodeDelta : nodeFlowDeltas)
+	{
+		if(nodeDelta.second != 0)
+			updateNode(nodeDelta.first);
 	}
 }
 
 void FlowGraph::updateArc(const Arc& a)
 {
-	int flow = flowMap_[a];
+	// the costs depend on the number of objects along the arc, whether they belong to its source or its duplicate
+	int flow = getLinkFlow(a);
 	DEBUG_MSG("Found " << flow << " flow along arc " << baseGraph_.id(baseGraph_.source(a)) << "->" << baseGraph_.id(baseGraph_.target(a)));
 	int capacity = capacityMap_[a];
-	if(flow < 0)
+	if(flowMap_[a] < 0 || sharedFlowMap_[a] < 0)
 		throw std::runtime_error("Found Arc with negative flow!");
-	if(flow > capacity)
+	if(flow > capacity || sharedFlowMap_[a] > 1)
 		throw std::runtime_error("Found Arc with more flow than capacity!");
 
 	// forward arc:
 	double forwardCost = getArcCost(a, flow);
     residualGraph_->updateArc(a, ResidualGraph::Forward, forwardCost, capacity - flow);
 
-    // backward arc:
+    // backward arc, only the source's own flow can be sent back to it:
     double backwardCost = -1.0 * getArcCost(a, flow-1);
-    residualGraph_->updateArc(a, ResidualGraph::Backward, backwardCost, flow);
+    residualGraph_->updateArc(a, ResidualGraph::Backward, backwardCost, flowMap_[a]);
+
+    // a division duplicate can use its parent's arc once if nothing else moves along it,
+    // and only send back its own unit
+    if(residualGraph_->isSharedArc(a))
+    {
+    	residualGraph_->updateSharedArc(a, ResidualGraph::Forward, forwardCost, flow == 0 ? 1 : 0);
+    	residualGraph_->updateSharedArc(a, ResidualGraph::Backward, backwardCost, sharedFlowMap_[a]);
+    }
+}
+
+void FlowGraph::updateNode(const Node& n)
+{
+	// the costs depend on the number of objects entering the detection, the transits play the role of the intermediate arc
+	int flow = sumInFlow(n);
+	DEBUG_MSG("Found " << flow << " flow through node " << baseGraph_.id(n));
+	int capacity = numNodeCosts(n);
+	if(flow > capacity)
+		throw std::runtime_error("Found Node with more flow than capacity!");
+
+	residualGraph_->updateNode(n, ResidualGraph::Forward, getNodeCost(n, flow), capacity - flow);
+	residualGraph_->updateNode(n, ResidualGraph::Backward, -1.0 * getNodeCost(n, flow - 1), flow);
 }
 
 /// updates the enabled arcs in the residual graph by checking 
@@ -342,10 +985,22 @@ void FlowGraph::updateEnabledArcs(const FlowGraph::Path& p)
 			<< baseGraph_.id(source) << " to " << baseGraph_.id(target));
 #endif
 
-		updateEnabledArc(af.first);
+		if(std::abs(af.second) == ResidualGraph::SharedStep)
+			updateEnabledSharedArc(af.first);
+		else
+			updateEnabledArc(af.first);
 	}
 }
 
+void FlowGraph::updateEnabledSharedArc(const FlowGraph::Arc& a)
+{
+	// the duplicate has neither appearance nor disappearance, but enters the arc's target like any other track
+	Node target = baseGraph_.target(a);
+	DEBUG_MSG("Updating stuff for the duplicate's edge from " 
+		<< baseGraph_.id(baseGraph_.source(a)) << " to " << baseGraph_.id(target));
+	toggleAppearanceArc(target, sumInFlow(target) == 0);
+}
+
 void FlowGraph::updateEnabledArc(const FlowGraph::Arc& a)
 {
 	Node source = baseGraph_.source(a);
@@ -399,7 +1054,7 @@ void FlowGraph::updateEnabledArc(const FlowGraph::Arc& a)
 		toggleOutArcsBut(source, target, flowMap_[a] == 0);
 	}
 	
-	if(source != source_ && !isTarget(target) && intermediateArcs_.count(a) == 0)
+	if(source != source_ && !isTarget(target) && !isIntermediateArc(a))
 	{
 		// we did not use an appearance or disappearance arc! 
 		// enable those if no other in-/out- flow at that arc yet
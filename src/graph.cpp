@@ -12,84 +12,137 @@ namespace dpct
 
 Graph::Configuration::Configuration(bool enableAppearance, 
 									bool enableDisappearance, 
-                                    bool enableDivision):
+                                    bool enableDivision,
+                                    bool useArenaStorage):
 	withAppearance(enableAppearance),
 	withDisappearance(enableDisappearance),
-    withDivision(enableDivision)
+    withDivision(enableDivision),
+    withArenaStorage(useArenaStorage)
 {}
 
 Graph::Graph(const Graph::Configuration& config):
 	config_(config),
+    arenaOwner_(config.withArenaStorage ? std::make_shared<char>(0) : std::shared_ptr<char>()),
     sourceNode_(std::vector<double>(), std::make_shared<NameData>("Source")),
     sinkNode_(std::vector<double>(), std::make_shared<NameData>("Sink")),
-    numNodes_(0)
+    numNodes_(0),
+    numNodeIndices_(2)
 {
+    sourceNode_.setIndex(0);
+    sinkNode_.setIndex(1);
 }
 
-Graph::NodePtr Graph::addNode(size_t timestep,
+Graph::NodePtr Graph::createNode(size_t timestep,
 					const std::vector<double>& cellCountScoreDelta,
-					const std::vector<double>& appearanceScoreDelta,
-					const std::vector<double>& disappearanceScoreDelta,
-		 			bool connectToSource,
-		 			bool connectToSink,
-                    UserDataPtr data)
+					UserDataPtr data)
 {
-	NodePtr node(new Node(cellCountScoreDelta, data));
 	while(nodesPerTimestep_.size() <= timestep)
 	{
 		nodesPerTimestep_.push_back(std::vector<NodePtr>());
 	}
+
+	NodePtr node;
+	if(config_.withArenaStorage)
+	{
+		while(nodeArenas_.size() <= timestep)
+			nodeArenas_.push_back(std::unique_ptr<Arena<Node>>(new Arena<Node>()));
+		Node* n = nodeArenas_[timestep]->emplace(cellCountScoreDelta, data, &scorePool_);
+		node = NodePtr(arenaOwner_, n);
+	}
+	else
+		node = NodePtr(new Node(cellCountScoreDelta, data));
+
+	node->setTimestep(timestep);
+	node->setIndex(numNodeIndices_++);
 	nodesPerTimestep_[timestep].push_back(node);
 	numNodes_++;
+	return node;
+}
+
+Graph::ArcPtr Graph::createArc(Node* source,
+					Node* target,
+					Arc::Type type,
+					const std::vector<double>& scoreDeltas,
+					Node* dependsOnCellInNode,
+					UserDataPtr data)
+{
+	ArcPtr arc;
+	if(config_.withArenaStorage)
+	{
+		size_t timestep = (target == &sinkNode_) ? source->getTimestep() : target->getTimestep();
+		while(arcArenas_.size() <= timestep)
+			arcArenas_.push_back(std::unique_ptr<Arena<Arc>>(new Arena<Arc>()));
+		Arc* a = arcArenas_[timestep]->emplace(source, target, type, scoreDeltas, dependsOnCellInNode, data, &scorePool_);
+		arc = ArcPtr(arenaOwner_, a);
+	}
+	else
+		arc = ArcPtr(new Arc(source, target, type, scoreDeltas, dependsOnCellInNode, data));
+
+	arcs_.push_back(arc);
+	return arc;
+}
+
+void Graph::reserve(size_t numArcs, size_t numScoreDeltas)
+{
+	arcs_.reserve(numArcs);
+	if(config_.withArenaStorage && numScoreDeltas > 0)
+		scorePool_.reserve(numScoreDeltas);
+}
+
+Graph::NodePtr Graph::addNode(size_t timestep,
+					const std::vector<double>& cellCountScoreDelta,
+					const std::vector<double>& appearanceScoreDelta,
+					const std::vector<double>& disappearanceScoreDelta,
+		 			bool connectToSource,
+		 			bool connectToSink,
+                    UserDataPtr data)
+{
+	NodePtr node = createNode(timestep, cellCountScoreDelta, data);
 
     std::vector<double> zeroCost(cellCountScoreDelta.size(), 0);
 
 	// create appearance and division arcs if enabled and not in first time frame
 	if(config_.withAppearance && !connectToSource)
 	{
-		ArcPtr arc(new Arc(&sourceNode_,
+		createArc(&sourceNode_,
 			node.get(),
 			Arc::Appearance,
 			appearanceScoreDelta,
 			nullptr,
-			nullptr));
-		arcs_.push_back(arc);
+			nullptr);
 	}
 
 	// create arc to disappearance if this is not the very last frame
 	if(config_.withDisappearance && !connectToSink)
 	{
-		ArcPtr arc(new Arc(node.get(),
+		createArc(node.get(),
 			&sinkNode_,
 			Arc::Disappearance,
 			disappearanceScoreDelta,
 			nullptr,
-			nullptr));
-		arcs_.push_back(arc);
+			nullptr);
 	}
 
     // create arc from source if requested
     if(connectToSource)
     {
-        ArcPtr arc(new Arc(&sourceNode_,
+        createArc(&sourceNode_,
             node.get(),
             Arc::Dummy,
             {0.0},
             nullptr,
-            nullptr));
-        arcs_.push_back(arc);
+            nullptr);
     }
 
     // create arc to sink if requested
     if(connectToSink)
     {
-        ArcPtr arc(new Arc(node.get(),
+        createArc(node.get(),
             &sinkNode_,
             Arc::Dummy,
             {0.0},
             nullptr,
-            nullptr));
-        arcs_.push_back(arc);
+            nullptr);
     }
 
 	return node;
@@ -103,14 +156,13 @@ Graph::ArcPtr Graph::addMoveArc(NodePtr source,
 	// assert(source in nodes_)
 	// assert(target in nodes_)
 
-	ArcPtr arc(new Arc(source.get(), 
+	ArcPtr arc = createArc(source.get(), 
 		target.get(),
 		Arc::Move,
 		scoreDeltas,
 		nullptr,
-		data));
+		data);
 
-	arcs_.push_back(arc);
 	return arc;
 }
 
@@ -134,13 +186,12 @@ Graph::ArcPtr Graph::allowMitosis(Node* parent,
     	throw std::runtime_error("Adding mitosis where no move could have appeared.");
 
 	// add division arc
-    ArcPtr arc(new Arc(&sourceNode_, 
+    ArcPtr arc = createArc(&sourceNode_, 
         child,
         Arc::Division,
         {divisionScoreDelta},
-        parent));
+        parent);
 
-    arcs_.push_back(arc);
     return arc;
 }
 
@@ -175,12 +226,15 @@ void Graph::reset()
 
 void Graph::visitNodesInTimestep(size_t timestep, Graph::VisitorFunction func)
 {
-	assert(timestep < nodesPerTimestep_.size());
+	forEachNodeInTimestep(timestep, func);
+}
 
-	for(NodeVector::iterator it = nodesPerTimestep_[timestep].begin(); it != nodesPerTimestep_[timestep].end(); ++it)
-	{
-		func(it->get());
-    }
+void Graph::visitNodesInTimestep(size_t timestep,
+                                 Graph::VisitorFunction func,
+                                 WorkerPool* pool,
+                                 size_t minNodesPerThread)
+{
+	forEachNodeInTimestep(timestep, func, pool, minNodesPerThread);
 }
 
 void Graph::visitSpecialNodes(Graph::VisitorFunction func)
@@ -204,16 +258,18 @@ bool Graph::removeNode(Node* n)
     assert(n->getNumInArcs() == 0);
     assert(n->getNumOutArcs() == 0);
 
-    for(NodeVectorVector::iterator v = nodesPerTimestep_.begin(); v != nodesPerTimestep_.end(); ++v)
+    if(n->getTimestep() >= nodesPerTimestep_.size())
+        return false;
+
+    // only the timestep the node was inserted at needs to be searched
+    NodeVector& v = nodesPerTimestep_[n->getTimestep()];
+    for(NodeVector::iterator it = v.begin(); it != v.end(); ++it)
     {
-        for(NodeVector::iterator it = v->begin(); it != v->end(); ++it)
+        if(it->get() == n)
         {
-            if(it->get() == n)
-            {
-                v->erase(it);
-                numNodes_--;
-                return true;
-            }
+            v.erase(it);
+            numNodes_--;
+            return true;
         }
     }
     return false;
@@ -235,6 +291,28 @@ bool Graph::removeArc(Arc* a)
     return false;
 }
 
+void Graph::collectMemoryStatistics(MemoryStatistics& stats) const
+{
+    const std::string structure("Graph");
+    stats.addStructure(structure, numNodes_, arcs_.size());
+
+    // the objects live in the arenas or in their own heap blocks, with the control block of their shared pointer
+    size_t pointerOverhead = config_.withArenaStorage ? 0 : 2 * sizeof(long);
+    size_t nodeBytes = sourceNode_.memoryBytes() + sinkNode_.memoryBytes();
+    for(const NodeVector& nv : nodesPerTimestep_)
+    {
+        nodeBytes += nv.capacity() * sizeof(NodePtr);
+        for(const NodePtr& n : nv)
+            nodeBytes += n->memoryBytes() + pointerOverhead;
+    }
+    stats.addContainer(structure, "nodes", numNodes_, nodeBytes);
+
+    size_t arcBytes = arcs_.capacity() * sizeof(ArcPtr);
+    for(const ArcPtr& a : arcs_)
+        arcBytes += a->memoryBytes() + pointerOverhead;
+    stats.addContainer(structure, "arcs", arcs_.size(), arcBytes);
+}
+
 void Graph::print() const
 {
 	LOG_MSG("Source Node: " << &sourceNode_);
@@ -1,4 +1,5 @@
 #include "graphreader.h"
+#include "graphbuilder.h"
 #include <assert.h>
 #include <fstream>
 #include <iostream>
@@ -42,12 +43,18 @@ GraphReader::FeatureVector GraphReader::weightedSumOfFeatures(
 	bool statesShareWeights)
 {
 	FeatureVector costPerState(stateFeatures.size(), 0.0);
+	bool keepTerms = graphBuilder_ != nullptr && graphBuilder_->keepsCostTerms();
+	if(keepTerms)
+		costTerms_.assign(stateFeatures.size(), GraphBuilder::CostTerm(0.0, weights.size()));
 
 	size_t weightIdx = offset;
 	for(size_t state = 0; state < stateFeatures.size(); state++)
 	{
 		for(auto f : stateFeatures[state])
 		{
+			// only the last feature of a state determines its cost
+			if(keepTerms)
+				costTerms_[state] = GraphBuilder::CostTerm(f, weightIdx);
 			costPerState[state] = f * weights[(weightIdx++)];
 		}
 
@@ -56,6 +63,8 @@ GraphReader::FeatureVector GraphReader::weightedSumOfFeatures(
 	}
 
 	initialStateEnergy_ += costPerState[0];
+	if(keepTerms)
+		graphBuilder_->addCostTerms(costTerms_, weights.size());
 
 	return costPerState;
 }
@@ -1,6 +1,8 @@
 #include "iarcnotifier.h"
 #include "arc.h"
 
+#include <algorithm>
+
 namespace dpct
 {
 
@@ -9,6 +11,20 @@ void IArcNotifier::registerObserverArc(Arc* arc)
     observerArcs_.push_back(arc);
 }
 
+bool IArcNotifier::unregisterObserverArc(Arc* arc)
+{
+    std::vector<Arc*>::iterator it = std::find(observerArcs_.begin(), observerArcs_.end(), arc);
+    if(it == observerArcs_.end())
+        return false;
+    observerArcs_.erase(it);
+    return true;
+}
+
+void IArcNotifier::unregisterObserverArcsIf(const ArcPredicate& pred)
+{
+    observerArcs_.erase(std::remove_if(observerArcs_.begin(), observerArcs_.end(), pred), observerArcs_.end());
+}
+
 void IArcNotifier::visitObserverArcs(NotificationFunction notificationFunc)
 {
     for(std::vector<Arc*>::iterator it = observerArcs_.begin(); it != observerArcs_.end(); ++it)
@@ -1,6 +1,12 @@
 #include "jsongraphreader.h"
 #include <assert.h>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <numeric>
+#include <sstream>
+
+#include "binarymodel.h"
 
 namespace dpct
 {
@@ -12,265 +18,816 @@ JsonGraphReader::JsonGraphReader(const std::string& modelFilename, const std::st
 {
 }
 
-size_t JsonGraphReader::getNumWeights(const Json::Value& jsonHyp, JsonTypes type, bool statesShareWeights)
+JsonGraphReader::JsonGraphReader(const std::string& modelFilename, const FeatureVector& weights, GraphBuilder* graphBuilder):
+	GraphReader(graphBuilder),
+	modelFilename_(modelFilename)
 {
-	size_t numWeights;
-	StateFeatureVector stateFeatVec = extractFeatures(jsonHyp, type);
-	
-	if(statesShareWeights)
-		numWeights = stateFeatVec[0].size();
-	else
-	{
-		numWeights = 0;
-		for(auto stateFeats : stateFeatVec)
-			numWeights += stateFeats.size();
-	}
-	return numWeights;
+	weights_ = weights;
 }
 
-void JsonGraphReader::createGraphFromJson()
+namespace
 {
-	std::ifstream input(modelFilename_.c_str());
-	if(!input.good())
-		throw std::runtime_error("Could not open JSON model file for reading: " + modelFilename_);
+	typedef JsonStreamParser::Token Token;
 
-	Json::Value root;
-	input >> root;
+	/// read the number value after the current key, converting booleans and null like jsoncpp does
+	double readNumberValue(JsonStreamParser& parser)
+	{
+		switch(parser.next())
+		{
+			case Token::Number: return parser.getNumber();
+			case Token::True: return 1.0;
+			case Token::False:
+			case Token::Null: return 0.0;
+			default: parser.error("expected a number");
+		}
+		return 0.0;
+	}
 
-	// get flag whether states should share weights or not
-	bool statesShareWeights = false;
-	if(root.isMember(JsonTypeNames[JsonTypes::Settings]))
+	bool readBoolValue(JsonStreamParser& parser)
 	{
-		Json::Value& settings = root[JsonTypeNames[JsonTypes::Settings]];
-		if(settings.isMember(JsonTypeNames[JsonTypes::StatesShareWeights]))
-			statesShareWeights = settings[JsonTypeNames[JsonTypes::StatesShareWeights]].asBool();
+		return readNumberValue(parser) != 0.0;
 	}
 
-	// ------------------------------------------------------------------------------
-	// get weight vector and number of weights needed for each different variable type
-	FeatureVector weights = readWeightsFromJson(weightsFilename_);
-	size_t numDetWeights = 0;
-	size_t numDivWeights = 0;
-	size_t numAppWeights = 0;
-	size_t numDisWeights = 0;
-	size_t numLinkWeights = 0;
-
-	const Json::Value segmentationHypotheses = root[JsonTypeNames[JsonTypes::Segmentations]];
-	for(int i = 0; i < (int)segmentationHypotheses.size(); i++)
+	/**
+	 * @brief Writes an array of flat result objects with unsigned values in the style of jsoncpp's default writer,
+	 * such that results are streamed without building a Json::Value, but the files stay the same
+	 */
+	class ResultArrayWriter
 	{
-		const Json::Value jsonHyp = segmentationHypotheses[i];
-		numDetWeights = getNumWeights(jsonHyp, JsonTypes::Features, statesShareWeights);
+	public:
+		ResultArrayWriter(std::ostream& output):
+			output_(output),
+			numEntries_(0)
+		{}
+
+		/// the keys of every entry, they are written sorted by name like jsoncpp does
+		void setKeys(const std::vector<std::string>& keys)
+		{
+			keys_ = keys;
+			values_.resize(keys.size());
+			order_.resize(keys.size());
+			std::iota(order_.begin(), order_.end(), 0);
+			std::sort(order_.begin(), order_.end(), [&](size_t a, size_t b){ return keys_[a] < keys_[b]; });
+		}
 
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::DivisionFeatures]))
-			numDivWeights = getNumWeights(jsonHyp, JsonTypes::DivisionFeatures, statesShareWeights);
+		void setValue(size_t key, unsigned int value) { values_[key] = std::to_string(value); }
+		void setValue(size_t key, const std::string& value) { values_[key] = value; }
 
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::AppearanceFeatures]))
-			numAppWeights = getNumWeights(jsonHyp, JsonTypes::AppearanceFeatures, statesShareWeights);
+		/// write an entry with the current values
+		void writeEntry()
+		{
+			output_ << (numEntries_ == 0 ? "\n\t[\n" : ",\n") << "\t\t{\n";
+			for(size_t i = 0; i < order_.size(); i++)
+				output_ << "\t\t\t\"" << keys_[order_[i]] << "\" : " << values_[order_[i]] << (i + 1 < order_.size() ? ",\n" : "\n");
+			output_ << "\t\t}";
+			numEntries_++;
+		}
 
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::DisappearanceFeatures]))
-			numDisWeights = getNumWeights(jsonHyp, JsonTypes::DisappearanceFeatures, statesShareWeights);
-	}
+		/// close the array, an array without entries is null as it was never appended to
+		void finish()
+		{
+			output_ << (numEntries_ == 0 ? "null" : "\n\t]");
+		}
+
+	private:
+		std::ostream& output_;
+		std::vector<std::string> keys_;
+		std::vector<std::string> values_;
+		std::vector<size_t> order_;
+		size_t numEntries_;
+	};
 
-	const Json::Value linkingHypotheses = root[JsonTypeNames[JsonTypes::Links]];
-	for(int i = 0; i < (int)linkingHypotheses.size(); i++)
+	/// skip the value after the current key
+	void skipMemberValue(JsonStreamParser& parser)
 	{
-		const Json::Value jsonHyp = linkingHypotheses[i];
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::Features]))
-				numLinkWeights = getNumWeights(jsonHyp, JsonTypes::Features, statesShareWeights);
+		parser.next();
+		parser.skipValue();
 	}
 
-	if(weights.size() != numDetWeights + numDivWeights + numAppWeights + numDisWeights + numLinkWeights)
+	/// move to the first element of the array after the current key, return false if the value is null instead
+	bool beginArrayValue(JsonStreamParser& parser, const std::string& name)
 	{
-		std::stringstream s;
-		s << "Loaded weights do not meet model requirements! Got " << weights.size() << ", need " 
-			<< numDetWeights + numDivWeights + numAppWeights + numDisWeights + numLinkWeights;
-		throw std::runtime_error(s.str());
+		Token token = parser.next();
+		if(token == Token::Null)
+			return false;
+		if(token != Token::BeginArray)
+			parser.error(name + " must be an array");
+		return true;
 	}
+}
 
-	size_t linkWeightOffset = 0;
-	size_t detWeightOffset = linkWeightOffset + numLinkWeights;
-	size_t divWeightOffset = detWeightOffset + numDetWeights;
-	size_t appWeightOffset = divWeightOffset + numDivWeights;
-	size_t disWeightOffset = appWeightOffset + numAppWeights;
+size_t JsonGraphReader::getNumWeights(const FeatureShape& shape, bool statesShareWeights)
+{
+	if(statesShareWeights)
+		return shape.firstState;
+	else
+		return shape.total;
+}
 
-	// ------------------------------------------------------------------------------
-	// read segmentation hypotheses and add to flowgraph
-	std::cout << "\tcontains " << segmentationHypotheses.size() << " segmentation hypotheses" << std::endl;
-	
-	for(int i = 0; i < (int)segmentationHypotheses.size(); i++)
+JsonGraphReader::FeatureShape JsonGraphReader::readFeatures(JsonStreamParser& parser, JsonTypes type, StateFeatureVector* stateFeatures)
+{
+	const std::string& name = JsonTypeNames[type];
+	if(parser.next() != Token::BeginArray)
+		throw std::runtime_error(name + " must be an array");
+
+	// get the features per state, reusing the vectors of the previous hypothesis
+	FeatureShape shape;
+	size_t numStates = 0;
+	while(parser.next() != Token::EndArray)
 	{
-		const Json::Value jsonHyp = segmentationHypotheses[i];
-		
-		if(!jsonHyp.isMember(JsonTypeNames[JsonTypes::Id]))
-			throw std::runtime_error("Cannot read detection hypothesis without Id!");
-		size_t id = jsonHyp[JsonTypeNames[JsonTypes::Id]].asInt();
+		if(parser.getToken() != Token::BeginArray)
+			throw std::runtime_error("Expected to find a list of features for each state");
 
-		if(!jsonHyp.isMember(JsonTypeNames[JsonTypes::Features]))
-			throw std::runtime_error("Cannot read detection hypothesis without features!");
+		FeatureVector* featVec = nullptr;
+		if(stateFeatures != nullptr)
+		{
+			if(stateFeatures->size() <= numStates)
+				stateFeatures->resize(numStates + 1);
+			featVec = &(*stateFeatures)[numStates];
+			featVec->clear();
+		}
 
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::Timestep]))
+		size_t numFeatures = 0;
+		while(parser.next() != Token::EndArray)
 		{
-			const Json::Value& timeJson = jsonHyp[JsonTypeNames[JsonTypes::Timestep]];
-			if(!timeJson.isArray() || timeJson.size() != 2)
-				throw std::runtime_error("Node's Timestep is supposed to be a 2-element array");
-			std::pair<int, int> timeRange = std::make_pair(timeJson[0].asInt(), timeJson[1].asInt());
-			graphBuilder_->setNodeTimesteps(id, timeRange);
+			if(parser.getToken() != Token::Number)
+				parser.error("features must be numbers for " + name);
+			if(featVec != nullptr)
+				featVec->push_back(parser.getNumber());
+			numFeatures++;
 		}
 
-		FeatureVector detCosts = weightedSumOfFeatures(extractFeatures(jsonHyp, JsonTypes::Features), weights, detWeightOffset, statesShareWeights);
-		FeatureVector detCostDeltas = costsToScoreDeltas(detCosts);
-		FeatureVector appearanceCostDeltas;
-		FeatureVector disappearanceCostDeltas;
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::AppearanceFeatures]))
-			appearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(extractFeatures(jsonHyp, JsonTypes::AppearanceFeatures), weights, appWeightOffset, statesShareWeights));
+		if(numFeatures == 0)
+			throw std::runtime_error("Features for state may not be empty for " + name);
 
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::DisappearanceFeatures]))
-			disappearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(extractFeatures(jsonHyp, JsonTypes::DisappearanceFeatures), weights, disWeightOffset, statesShareWeights));
+		if(numStates == 0)
+			shape.firstState = numFeatures;
+		shape.total += numFeatures;
+		numStates++;
+	}
+
+	if(numStates == 0)
+		throw std::runtime_error("Features may not be empty for " + name);
+
+	if(stateFeatures != nullptr)
+		stateFeatures->resize(numStates);
+	shape.numStates = numStates;
+	return shape;
+}
 
-		size_t targetIdx = 0;
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::DisappearanceTarget]))
+JsonGraphReader::ModelSummary JsonGraphReader::scanModel()
+{
+	std::ifstream input(modelFilename_.c_str(), std::ios::binary);
+	if(!input.good())
+		throw std::runtime_error("Could not open JSON model file for reading: " + modelFilename_);
+	JsonStreamParser parser(input);
+
+	const std::string& segmentationsName = JsonTypeNames[JsonTypes::Segmentations];
+	const std::string& linksName = JsonTypeNames[JsonTypes::Links];
+	const std::string& exclusionsName = JsonTypeNames[JsonTypes::Exclusions];
+	const std::string& settingsName = JsonTypeNames[JsonTypes::Settings];
+	const std::string& featuresName = JsonTypeNames[JsonTypes::Features];
+	const std::string& divisionFeaturesName = JsonTypeNames[JsonTypes::DivisionFeatures];
+	const std::string& appearanceFeaturesName = JsonTypeNames[JsonTypes::AppearanceFeatures];
+	const std::string& disappearanceFeaturesName = JsonTypeNames[JsonTypes::DisappearanceFeatures];
+
+	ModelSummary summary;
+	bool foundSegmentations = false;
+	auto countFeatureValues = [&](const FeatureShape& shape){
+		summary.numFeatureValues += 1 + shape.numStates + shape.total;
+		return shape;
+	};
+	if(parser.next() != Token::BeginObject)
+		parser.error("the model must be a JSON object");
+
+	while(parser.next() == Token::Key)
+	{
+		if(parser.getString() == settingsName)
 		{
-			targetIdx = jsonHyp[JsonTypeNames[JsonTypes::DisappearanceTarget]].asUInt();
+			if(parser.next() != Token::BeginObject)
+			{
+				parser.skipValue();
+				continue;
+			}
+			while(parser.next() == Token::Key)
+			{
+				if(parser.getString() == JsonTypeNames[JsonTypes::StatesShareWeights])
+					summary.statesShareWeights = readBoolValue(parser);
+				else if(parser.getString() == JsonTypeNames[JsonTypes::OptimizerNumThreads])
+					numThreads_ = (size_t)readNumberValue(parser);
+				else
+					skipMemberValue(parser);
+			}
 		}
-
-		graphBuilder_->addNode(id, detCosts, detCostDeltas, appearanceCostDeltas, disappearanceCostDeltas, targetIdx);
+		else if(parser.getString() == segmentationsName)
+		{
+			foundSegmentations = true;
+			if(!beginArrayValue(parser, segmentationsName))
+				continue;
+			while(parser.next() == Token::BeginObject)
+			{
+				bool hasFeatures = false;
+				while(parser.next() == Token::Key)
+				{
+					const std::string& key = parser.getString();
+					if(key == featuresName)
+					{
+						summary.detShape = countFeatureValues(readFeatures(parser, JsonTypes::Features, nullptr));
+						hasFeatures = true;
+					}
+					else if(key == divisionFeaturesName)
+					{
+						summary.divShape = countFeatureValues(readFeatures(parser, JsonTypes::DivisionFeatures, nullptr));
+						summary.numDivisions++;
+					}
+					else if(key == appearanceFeaturesName)
+						summary.appShape = countFeatureValues(readFeatures(parser, JsonTypes::AppearanceFeatures, nullptr));
+					else if(key == disappearanceFeaturesName)
+						summary.disShape = countFeatureValues(readFeatures(parser, JsonTypes::DisappearanceFeatures, nullptr));
+					else
+						skipMemberValue(parser);
+				}
+				if(!hasFeatures)
+					throw std::runtime_error("Could not find Json tags for " + featuresName);
+				summary.numSegmentations++;
+			}
+			if(parser.getToken() != Token::EndArray)
+				parser.error("expected a detection hypothesis object");
+		}
+		else if(parser.getString() == linksName)
+		{
+			if(!foundSegmentations)
+				summary.linksBeforeSegmentations = true;
+			if(!beginArrayValue(parser, linksName))
+				continue;
+			while(parser.next() == Token::BeginObject)
+			{
+				while(parser.next() == Token::Key)
+				{
+					if(parser.getString() == featuresName)
+						summary.linkShape = countFeatureValues(readFeatures(parser, JsonTypes::Features, nullptr));
+					else
+						skipMemberValue(parser);
+				}
+				summary.numLinks++;
+			}
+			if(parser.getToken() != Token::EndArray)
+				parser.error("expected a linking hypothesis object");
+		}
+		else if(parser.getString() == exclusionsName)
+		{
+			if(!beginArrayValue(parser, exclusionsName))
+				continue;
+			while(parser.next() != Token::EndArray)
+			{
+				parser.skipValue();
+				summary.numExclusions++;
+			}
+		}
+		else
+			skipMemberValue(parser);
 	}
 
-	// read linking hypotheses
-	std::cout << "\tcontains " << linkingHypotheses.size() << " linking hypotheses" << std::endl;
-	for(int i = 0; i < (int)linkingHypotheses.size(); i++)
-	{
-		const Json::Value jsonHyp = linkingHypotheses[i];
+	if(parser.getToken() != Token::EndObject)
+		parser.error("expected the end of the model object");
 
-		size_t srcId = jsonHyp[JsonTypeNames[JsonTypes::SrcId]].asInt();
-		size_t destId = jsonHyp[JsonTypeNames[JsonTypes::DestId]].asInt();
-		graphBuilder_->addArc(srcId, destId, costsToScoreDeltas(weightedSumOfFeatures(extractFeatures(jsonHyp, JsonTypes::Features), weights, linkWeightOffset, statesShareWeights)));
-	}
+	// the links can only be added in the same pass if all detections are known already
+	if(!foundSegmentations)
+		summary.linksBeforeSegmentations = false;
+	return summary;
+}
 
-	// read divisions
-	for(int i = 0; i < (int)segmentationHypotheses.size(); i++)
+void JsonGraphReader::streamHypotheses(bool readSegmentations, bool readLinks, const SegmentationCallback& onSegmentation, const LinkCallback& onLink)
+{
+	std::ifstream input(modelFilename_.c_str(), std::ios::binary);
+	if(!input.good())
+		throw std::runtime_error("Could not open JSON model file for reading: " + modelFilename_);
+	JsonStreamParser parser(input);
+
+	const std::string& segmentationsName = JsonTypeNames[JsonTypes::Segmentations];
+	const std::string& linksName = JsonTypeNames[JsonTypes::Links];
+	const std::string& idName = JsonTypeNames[JsonTypes::Id];
+	const std::string& timestepName = JsonTypeNames[JsonTypes::Timestep];
+	const std::string& srcIdName = JsonTypeNames[JsonTypes::SrcId];
+	const std::string& destIdName = JsonTypeNames[JsonTypes::DestId];
+	const std::string& featuresName = JsonTypeNames[JsonTypes::Features];
+	const std::string& divisionFeaturesName = JsonTypeNames[JsonTypes::DivisionFeatures];
+	const std::string& appearanceFeaturesName = JsonTypeNames[JsonTypes::AppearanceFeatures];
+	const std::string& disappearanceFeaturesName = JsonTypeNames[JsonTypes::DisappearanceFeatures];
+	const std::string& disappearanceTargetName = JsonTypeNames[JsonTypes::DisappearanceTarget];
+
+	SegmentationHypothesis segmentation;
+	LinkHypothesis link;
+
+	if(parser.next() != Token::BeginObject)
+		parser.error("the model must be a JSON object");
+
+	while(parser.next() == Token::Key)
 	{
-		const Json::Value jsonHyp = segmentationHypotheses[i];
-		size_t id = jsonHyp[JsonTypeNames[JsonTypes::Id]].asInt();
-
-		if(jsonHyp.isMember(JsonTypeNames[JsonTypes::DivisionFeatures]))
+		if(readSegmentations && parser.getString() == segmentationsName)
+		{
+			if(!beginArrayValue(parser, segmentationsName))
+				continue;
+			while(parser.next() == Token::BeginObject)
+			{
+				SegmentationHypothesis& hyp = segmentation;
+				hyp.id = 0;
+				hyp.targetIdx = 0;
+				hyp.hasTimestep = false;
+				hyp.hasDivision = false;
+				hyp.hasAppearance = false;
+				hyp.hasDisappearance = false;
+				bool hasId = false;
+				bool hasFeatures = false;
+
+				while(parser.next() == Token::Key)
+				{
+					const std::string& key = parser.getString();
+					if(key == idName)
+					{
+						hyp.id = (int)readNumberValue(parser);
+						hasId = true;
+					}
+					else if(key == featuresName)
+					{
+						readFeatures(parser, JsonTypes::Features, &hyp.features);
+						hasFeatures = true;
+					}
+					else if(key == timestepName)
+					{
+						const std::string timestepError("Node's Timestep is supposed to be a 2-element array");
+						if(parser.next() != Token::BeginArray || parser.next() != Token::Number)
+							throw std::runtime_error(timestepError);
+						hyp.timeRange.first = (int)parser.getNumber();
+						if(parser.next() != Token::Number)
+							throw std::runtime_error(timestepError);
+						hyp.timeRange.second = (int)parser.getNumber();
+						if(parser.next() != Token::EndArray)
+							throw std::runtime_error(timestepError);
+						hyp.hasTimestep = true;
+					}
+					else if(key == divisionFeaturesName)
+					{
+						readFeatures(parser, JsonTypes::DivisionFeatures, &hyp.divFeatures);
+						hyp.hasDivision = true;
+					}
+					else if(key == appearanceFeaturesName)
+					{
+						readFeatures(parser, JsonTypes::AppearanceFeatures, &hyp.appFeatures);
+						hyp.hasAppearance = true;
+					}
+					else if(key == disappearanceFeaturesName)
+					{
+						readFeatures(parser, JsonTypes::DisappearanceFeatures, &hyp.disFeatures);
+						hyp.hasDisappearance = true;
+					}
+					else if(key == disappearanceTargetName)
+						hyp.targetIdx = (unsigned int)readNumberValue(parser);
+					else
+						skipMemberValue(parser);
+				}
+
+				if(!hasId)
+					throw std::runtime_error("Cannot read detection hypothesis without Id!");
+				if(!hasFeatures)
+					throw std::runtime_error("Cannot read detection hypothesis without features!");
+				onSegmentation(hyp);
+			}
+			if(parser.getToken() != Token::EndArray)
+				parser.error("expected a detection hypothesis object");
+		}
+		else if(readLinks && parser.getString() == linksName)
 		{
-			graphBuilder_->allowMitosis(id, costsToScoreDelta(weightedSumOfFeatures(extractFeatures(jsonHyp, JsonTypes::DivisionFeatures), weights, divWeightOffset, statesShareWeights)));
+			if(!beginArrayValue(parser, linksName))
+				continue;
+			while(parser.next() == Token::BeginObject)
+			{
+				LinkHypothesis& hyp = link;
+				hyp.srcId = 0;
+				hyp.destId = 0;
+				bool hasFeatures = false;
+				while(parser.next() == Token::Key)
+				{
+					const std::string& key = parser.getString();
+					if(key == srcIdName)
+						hyp.srcId = (int)readNumberValue(parser);
+					else if(key == destIdName)
+						hyp.destId = (int)readNumberValue(parser);
+					else if(key == featuresName)
+					{
+						readFeatures(parser, JsonTypes::Features, &hyp.features);
+						hasFeatures = true;
+					}
+					else
+						skipMemberValue(parser);
+				}
+
+				if(!hasFeatures)
+					throw std::runtime_error("Could not find Json tags for " + featuresName);
+				onLink(hyp);
+			}
+			if(parser.getToken() != Token::EndArray)
+				parser.error("expected a linking hypothesis object");
 		}
+		else
+			skipMemberValue(parser);
 	}
+}
 
-	// read exclusion constraints between detections
-	// const Json::Value exclusions = root[JsonTypeNames[JsonTypes::Exclusions]];
-	// std::cout << "\tcontains " << exclusions.size() << " exclusions" << std::endl;
-	// for(int i = 0; i < (int)exclusions.size(); i++)
-	// {
-	// 	const Json::Value jsonExc = exclusions[i];
-	// 	// TODO: implement some API for those?!
-	// }
-	if(root.isMember(JsonTypeNames[JsonTypes::Exclusions]) && root[JsonTypeNames[JsonTypes::Exclusions]].size() > 0)
-		throw std::runtime_error("FlowSolver cannot deal with exclusion constraints yet!");
+void JsonGraphReader::streamAllHypotheses(const ModelSummary& summary, const SegmentationCallback& onSegmentation, const LinkCallback& onLink)
+{
+	// links that are stored before the detections need a second pass
+	streamHypotheses(true, !summary.linksBeforeSegmentations, onSegmentation, onLink);
+	if(summary.linksBeforeSegmentations)
+		streamHypotheses(false, true, onSegmentation, onLink);
 }
 
-void JsonGraphReader::saveResultJson(const std::string& filename)
+JsonGraphReader::WeightOffsets JsonGraphReader::getWeightOffsets(const ModelSummary& summary, const FeatureVector& weights)
 {
-	std::ofstream output(filename.c_str());
-	if(!output.good())
-		throw std::runtime_error("Could not open JSON result file for saving: " + filename);
+	size_t numDetWeights = getNumWeights(summary.detShape, summary.statesShareWeights);
+	size_t numDivWeights = getNumWeights(summary.divShape, summary.statesShareWeights);
+	size_t numAppWeights = getNumWeights(summary.appShape, summary.statesShareWeights);
+	size_t numDisWeights = getNumWeights(summary.disShape, summary.statesShareWeights);
+	size_t numLinkWeights = getNumWeights(summary.linkShape, summary.statesShareWeights);
 
-	Json::Value root;
+	if(weights.size() != numDetWeights + numDivWeights + numAppWeights + numDisWeights + numLinkWeights)
+	{
+		std::stringstream s;
+		s << "Loaded weights do not meet model requirements! Got " << weights.size() << ", need " 
+			<< numDetWeights + numDivWeights + numAppWeights + numDisWeights + numLinkWeights;
+		throw std::runtime_error(s.str());
+	}
+
+	WeightOffsets offsets;
+	offsets.link = 0;
+	offsets.det = offsets.link + numLinkWeights;
+	offsets.div = offsets.det + numDetWeights;
+	offsets.app = offsets.div + numDivWeights;
+	offsets.dis = offsets.app + numAppWeights;
+	return offsets;
+}
+
+void JsonGraphReader::addSegmentation(const SegmentationHypothesis& hyp, const FeatureVector& weights, const WeightOffsets& offsets, bool statesShareWeights)
+{
+	if(hyp.hasTimestep)
+		graphBuilder_->setNodeTimesteps(hyp.id, hyp.timeRange);
+
+	FeatureVector detCosts = weightedSumOfFeatures(hyp.features, weights, offsets.det, statesShareWeights);
+	FeatureVector detCostDeltas = costsToScoreDeltas(detCosts);
+	FeatureVector appearanceCostDeltas;
+	FeatureVector disappearanceCostDeltas;
+	if(hyp.hasAppearance)
+		appearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(hyp.appFeatures, weights, offsets.app, statesShareWeights));
+	if(hyp.hasDisappearance)
+		disappearanceCostDeltas = costsToScoreDeltas(weightedSumOfFeatures(hyp.disFeatures, weights, offsets.dis, statesShareWeights));
+
+	graphBuilder_->addNode(hyp.id, detCosts, detCostDeltas, appearanceCostDeltas, disappearanceCostDeltas, hyp.targetIdx);
+}
+
+void JsonGraphReader::addLink(const LinkHypothesis& hyp, const FeatureVector& weights, const WeightOffsets& offsets, bool statesShareWeights)
+{
+	graphBuilder_->addArc(hyp.srcId, hyp.destId, costsToScoreDeltas(weightedSumOfFeatures(hyp.features, weights, offsets.link, statesShareWeights)));
+}
 
-	// save links
-	Json::Value& linksJson = root[JsonTypeNames[JsonTypes::LinkResults]];
-	GraphBuilder::ArcValueMap arcValues = graphBuilder_->getArcValues();
-	for(auto iter : arcValues)
+bool JsonGraphReader::isBinaryModel()
+{
+	std::ifstream input(modelFilename_.c_str(), std::ios::binary);
+	char magicBytes[sizeof(BinaryModelHeader::magicBytes)];
+	input.read(magicBytes, sizeof(magicBytes));
+	return input.gcount() == sizeof(magicBytes) && std::memcmp(magicBytes, BinaryModelHeader::magic(), sizeof(magicBytes)) == 0;
+}
+
+void JsonGraphReader::createGraphFromJson()
+{
+	if(isBinaryModel())
 	{
-		int value = iter.second;
+		createGraphFromBinary();
+		return;
+	}
 
-		if(value > 0)
-		{
-			Json::Value val;
-			val[JsonTypeNames[JsonTypes::SrcId]] = Json::Value((unsigned int)iter.first.first);
-			val[JsonTypeNames[JsonTypes::DestId]] = Json::Value((unsigned int)iter.first.second);
-			val[JsonTypeNames[JsonTypes::Value]] = Json::Value((unsigned int)value);
-			linksJson.append(val);
-		}
+	// ------------------------------------------------------------------------------
+	// get settings, weight vector and number of weights needed for each different variable type
+	ModelSummary summary = scanModel();
+	if(summary.numExclusions > 0)
+		throw std::runtime_error("FlowSolver cannot deal with exclusion constraints yet!");
+
+	FeatureVector weights = loadWeights();
+	WeightOffsets offsets = getWeightOffsets(summary, weights);
+
+	// ------------------------------------------------------------------------------
+	// stream segmentation and linking hypotheses into the graph builder
+	std::cout << "\tcontains " << summary.numSegmentations << " segmentation hypotheses" << std::endl;
+	std::cout << "\tcontains " << summary.numLinks << " linking hypotheses" << std::endl;
+	graphBuilder_->reserve(summary.numSegmentations, summary.numLinks, summary.numDivisions);
+
+	std::vector<std::pair<size_t, StateFeatureVector>> divisionFeatures;
+	divisionFeatures.reserve(summary.numDivisions);
+	streamAllHypotheses(summary,
+		[&](const SegmentationHypothesis& hyp){
+			addSegmentation(hyp, weights, offsets, summary.statesShareWeights);
+			// divisions are added once all links are in place
+			if(hyp.hasDivision)
+				divisionFeatures.push_back(std::make_pair(hyp.id, hyp.divFeatures));
+		},
+		[&](const LinkHypothesis& hyp){
+			addLink(hyp, weights, offsets, summary.statesShareWeights);
+		});
+
+	// read divisions
+	for(const std::pair<size_t, StateFeatureVector>& division : divisionFeatures)
+	{
+		graphBuilder_->allowMitosis(division.first, costsToScoreDelta(weightedSumOfFeatures(division.second, weights, offsets.div, summary.statesShareWeights)));
 	}
+}
 
-	// save divisions
-	Json::Value& divisionsJson = root[JsonTypeNames[JsonTypes::DivisionResults]];
-	GraphBuilder::DivisionValueMap divisionValues = graphBuilder_->getDivisionValues();
-	for(auto iter : divisionValues)
+namespace
+{
+	/// append features to the feature pool of a binary model and return their offset
+	uint64_t packFeatures(const GraphReader::StateFeatureVector& stateFeatures, double* pool, uint64_t& poolSize)
 	{
-		bool value = iter.second;
-		
-		if(value > 0)
+		uint64_t offset = poolSize;
+		pool[poolSize++] = stateFeatures.size();
+		for(const GraphReader::FeatureVector& features : stateFeatures)
 		{
-			Json::Value val;
-			val[JsonTypeNames[JsonTypes::Id]] = Json::Value((unsigned int)iter.first);
-			val[JsonTypeNames[JsonTypes::Value]] = Json::Value(true);
-			divisionsJson.append(val);
+			pool[poolSize++] = features.size();
+			for(double f : features)
+				pool[poolSize++] = f;
 		}
+		return offset;
 	}
 
-	// save detections
-	Json::Value& detectionsJson = root[JsonTypeNames[JsonTypes::DetectionResults]];
-	GraphBuilder::NodeValueMap nodeValues = graphBuilder_->getNodeValues();
-	for(auto iter : nodeValues)
+	/// read the features at the given offset of the feature pool into reusable vectors
+	void unpackFeatures(const double* pool, uint64_t numValues, uint64_t offset, GraphReader::StateFeatureVector& stateFeatures)
 	{
-		size_t value = iter.second;
-		
-		if(value > 0)
+		if(offset >= numValues)
+			throw std::runtime_error("Feature offset of binary model is out of range");
+		const double* values = pool + offset;
+		const double* end = pool + numValues;
+		size_t numStates = (size_t)*values++;
+		if(numStates > (size_t)(end - values))
+			throw std::runtime_error("Features of binary model are truncated");
+		stateFeatures.resize(numStates);
+		for(GraphReader::FeatureVector& features : stateFeatures)
 		{
-			Json::Value val;
-			val[JsonTypeNames[JsonTypes::Id]] = Json::Value((unsigned int)iter.first);
-			val[JsonTypeNames[JsonTypes::Value]] = Json::Value((unsigned int)value);
-			detectionsJson.append(val);
+			if(values >= end || values + 1 + (size_t)*values > end)
+				throw std::runtime_error("Features of binary model are truncated");
+			size_t numFeatures = (size_t)*values++;
+			features.assign(values, values + numFeatures);
+			values += numFeatures;
 		}
 	}
+}
 
-	output << root << std::endl;
+void JsonGraphReader::convertToBinary(const std::string& filename)
+{
+	ModelSummary summary = scanModel();
+	if(summary.numExclusions > 0)
+		throw std::runtime_error("FlowSolver cannot deal with exclusion constraints yet!");
+
+	BinaryModelHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magicBytes, BinaryModelHeader::magic(), sizeof(header.magicBytes));
+	header.version = BinaryModelHeader::CurrentVersion;
+	header.statesShareWeights = summary.statesShareWeights;
+	header.numThreads = numThreads_;
+	header.numSegmentations = summary.numSegmentations;
+	header.numLinks = summary.numLinks;
+	header.numDivisions = summary.numDivisions;
+	const FeatureShape* shapes[BinaryModelHeader::NumFeatureTypes] = {
+		&summary.linkShape, &summary.detShape, &summary.divShape, &summary.appShape, &summary.disShape};
+	for(size_t type = 0; type < BinaryModelHeader::NumFeatureTypes; ++type)
+	{
+		header.featureShapes[type][0] = shapes[type]->firstState;
+		header.featureShapes[type][1] = shapes[type]->total;
+	}
+	header.numFeatureValues = summary.numFeatureValues;
+
+	MappedFile file(filename, header.getFileSize());
+	std::memcpy(file.getData(), &header, sizeof(header));
+	BinaryModelNode* nodes = reinterpret_cast<BinaryModelNode*>(file.getData() + sizeof(BinaryModelHeader));
+	BinaryModelLink* links = reinterpret_cast<BinaryModelLink*>(nodes + header.numSegmentations);
+	double* pool = reinterpret_cast<double*>(links + header.numLinks);
+
+	uint64_t numNodes = 0;
+	uint64_t numLinks = 0;
+	uint64_t poolSize = 0;
+	streamAllHypotheses(summary,
+		[&](const SegmentationHypothesis& hyp){
+			BinaryModelNode& node = nodes[numNodes++];
+			node.id = hyp.id;
+			node.timesteps[0] = hyp.timeRange.first;
+			node.timesteps[1] = hyp.timeRange.second;
+			node.targetIdx = hyp.targetIdx;
+			node.flags = (hyp.hasTimestep ? BinaryModelNode::HasTimestep : 0)
+				| (hyp.hasDivision ? BinaryModelNode::HasDivision : 0)
+				| (hyp.hasAppearance ? BinaryModelNode::HasAppearance : 0)
+				| (hyp.hasDisappearance ? BinaryModelNode::HasDisappearance : 0);
+			node.features[0] = packFeatures(hyp.features, pool, poolSize);
+			node.features[1] = hyp.hasDivision ? packFeatures(hyp.divFeatures, pool, poolSize) : BinaryModelNode::NoFeatures;
+			node.features[2] = hyp.hasAppearance ? packFeatures(hyp.appFeatures, pool, poolSize) : BinaryModelNode::NoFeatures;
+			node.features[3] = hyp.hasDisappearance ? packFeatures(hyp.disFeatures, pool, poolSize) : BinaryModelNode::NoFeatures;
+		},
+		[&](const LinkHypothesis& hyp){
+			BinaryModelLink& link = links[numLinks++];
+			link.srcId = hyp.srcId;
+			link.destId = hyp.destId;
+			link.features = packFeatures(hyp.features, pool, poolSize);
+		});
+
+	assert(numNodes == header.numSegmentations && numLinks == header.numLinks && poolSize == header.numFeatureValues);
+	std::cout << "\tstored " << numNodes << " segmentation and " << numLinks << " linking hypotheses in " << filename << std::endl;
 }
 
-JsonGraphReader::StateFeatureVector JsonGraphReader::extractFeatures(const Json::Value& entry, JsonTypes type)
+void JsonGraphReader::createGraphFromBinary()
 {
-	StateFeatureVector stateFeatVec;
-	if(!entry.isMember(JsonTypeNames[type]))
-		throw std::runtime_error("Could not find Json tags for " + JsonTypeNames[type]);
+	MappedFile file(modelFilename_);
+	if(file.getSize() < sizeof(BinaryModelHeader))
+		throw std::runtime_error("Binary model file is truncated: " + modelFilename_);
+
+	BinaryModelHeader header;
+	std::memcpy(&header, file.getData(), sizeof(header));
+	if(header.version != BinaryModelHeader::CurrentVersion)
+		throw std::runtime_error("Unsupported version of binary model file: " + modelFilename_);
+	if(header.getFileSize() != file.getSize())
+		throw std::runtime_error("Size of binary model file does not match its header: " + modelFilename_);
+
+	// the weight layout is restored from the stored shapes
+	ModelSummary summary;
+	summary.statesShareWeights = header.statesShareWeights != 0;
+	summary.numSegmentations = header.numSegmentations;
+	summary.numLinks = header.numLinks;
+	summary.numDivisions = header.numDivisions;
+	FeatureShape* shapes[BinaryModelHeader::NumFeatureTypes] = {
+		&summary.linkShape, &summary.detShape, &summary.divShape, &summary.appShape, &summary.disShape};
+	for(size_t type = 0; type < BinaryModelHeader::NumFeatureTypes; ++type)
+	{
+		shapes[type]->firstState = header.featureShapes[type][0];
+		shapes[type]->total = header.featureShapes[type][1];
+	}
+	numThreads_ = header.numThreads;
 
-	const Json::Value featuresPerState = entry[JsonTypeNames[type]];
+	FeatureVector weights = loadWeights();
+	WeightOffsets offsets = getWeightOffsets(summary, weights);
 
-	if(!featuresPerState.isArray())
-		throw std::runtime_error(JsonTypeNames[type] + " must be an array");
+	const BinaryModelNode* nodes = reinterpret_cast<const BinaryModelNode*>(file.getData() + sizeof(BinaryModelHeader));
+	const BinaryModelLink* links = reinterpret_cast<const BinaryModelLink*>(nodes + header.numSegmentations);
+	const double* pool = reinterpret_cast<const double*>(links + header.numLinks);
 
-	if(!featuresPerState.size() > 0)
-		throw std::runtime_error("Features may not be empty for " + JsonTypeNames[type]);
+	std::cout << "\tcontains " << summary.numSegmentations << " segmentation hypotheses" << std::endl;
+	std::cout << "\tcontains " << summary.numLinks << " linking hypotheses" << std::endl;
+	graphBuilder_->reserve(summary.numSegmentations, summary.numLinks, summary.numDivisions);
 
-	// std::cout << "\tReading features for: " << JsonTypeNames[type] << std::endl;
+	SegmentationHypothesis segmentation;
+	for(uint64_t n = 0; n < header.numSegmentations; ++n)
+	{
+		const BinaryModelNode& node = nodes[n];
+		segmentation.id = node.id;
+		segmentation.targetIdx = node.targetIdx;
+		segmentation.timeRange = std::make_pair(node.timesteps[0], node.timesteps[1]);
+		segmentation.hasTimestep = (node.flags & BinaryModelNode::HasTimestep) != 0;
+		segmentation.hasDivision = false;
+		segmentation.hasAppearance = (node.flags & BinaryModelNode::HasAppearance) != 0;
+		segmentation.hasDisappearance = (node.flags & BinaryModelNode::HasDisappearance) != 0;
+		unpackFeatures(pool, header.numFeatureValues, node.features[0], segmentation.features);
+		if(segmentation.hasAppearance)
+			unpackFeatures(pool, header.numFeatureValues, node.features[2], segmentation.appFeatures);
+		if(segmentation.hasDisappearance)
+			unpackFeatures(pool, header.numFeatureValues, node.features[3], segmentation.disFeatures);
+		addSegmentation(segmentation, weights, offsets, summary.statesShareWeights);
+	}
 
-	// get the features per state
-	for(int i = 0; i < (int)featuresPerState.size(); i++)
+	LinkHypothesis link;
+	for(uint64_t l = 0; l < header.numLinks; ++l)
 	{
-		// get features for the specific state
-		FeatureVector featVec;
-		const Json::Value& featuresForState = featuresPerState[i];
+		link.srcId = links[l].srcId;
+		link.destId = links[l].destId;
+		unpackFeatures(pool, header.numFeatureValues, links[l].features, link.features);
+		addLink(link, weights, offsets, summary.statesShareWeights);
+	}
 
-		if(!featuresForState.isArray())
-			throw std::runtime_error("Expected to find a list of features for each state");
+	// read divisions
+	StateFeatureVector divFeatures;
+	for(uint64_t n = 0; n < header.numSegmentations; ++n)
+	{
+		if((nodes[n].flags & BinaryModelNode::HasDivision) == 0)
+			continue;
+		unpackFeatures(pool, header.numFeatureValues, nodes[n].features[1], divFeatures);
+		graphBuilder_->allowMitosis(nodes[n].id, costsToScoreDelta(weightedSumOfFeatures(divFeatures, weights, offsets.div, summary.statesShareWeights)));
+	}
+}
 
-		if(!featuresForState.size() > 0)
-		throw std::runtime_error("Features for state may not be empty for " + JsonTypeNames[type]);
+void JsonGraphReader::saveResultJson(const std::string& filename)
+{
+	std::ofstream output(filename.c_str());
+	if(!output.good())
+		throw std::runtime_error("Could not open JSON result file for saving: " + filename);
 
-		for(int j = 0; j < (int)featuresForState.size(); j++)
-		{
-			featVec.push_back(featuresForState[j].asDouble());
-		}
+	// jsoncpp writes the members of an object sorted by name, so the result arrays are written in that order too
+	typedef std::pair<std::string, std::function<void(ResultArrayWriter&)> > ResultArray;
+	std::vector<ResultArray> resultArrays;
+	resultArrays.push_back(ResultArray(JsonTypeNames[JsonTypes::LinkResults], [&](ResultArrayWriter& writer){
+		writer.setKeys({JsonTypeNames[JsonTypes::SrcId], JsonTypeNames[JsonTypes::DestId], JsonTypeNames[JsonTypes::Value]});
+		graphBuilder_->visitArcValues([&](size_t srcId, size_t destId, size_t value){
+			writer.setValue(0, (unsigned int)srcId);
+			writer.setValue(1, (unsigned int)destId);
+			writer.setValue(2, (unsigned int)value);
+			writer.writeEntry();
+		});
+	}));
+	resultArrays.push_back(ResultArray(JsonTypeNames[JsonTypes::DivisionResults], [&](ResultArrayWriter& writer){
+		writer.setKeys({JsonTypeNames[JsonTypes::Id], JsonTypeNames[JsonTypes::Value]});
+		writer.setValue(1, "true");
+		graphBuilder_->visitDivisions([&](size_t id){
+			writer.setValue(0, (unsigned int)id);
+			writer.writeEntry();
+		});
+	}));
+	resultArrays.push_back(ResultArray(JsonTypeNames[JsonTypes::DetectionResults], [&](ResultArrayWriter& writer){
+		writer.setKeys({JsonTypeNames[JsonTypes::Id], JsonTypeNames[JsonTypes::Value]});
+		graphBuilder_->visitNodeValues([&](size_t id, size_t value){
+			writer.setValue(0, (unsigned int)id);
+			writer.setValue(1, (unsigned int)value);
+			writer.writeEntry();
+		});
+	}));
+	std::sort(resultArrays.begin(), resultArrays.end(), [](const ResultArray& a, const ResultArray& b){ return a.first < b.first; });
+
+	output << "{\n";
+	for(size_t i = 0; i < resultArrays.size(); i++)
+	{
+		output << "\t\"" << resultArrays[i].first << "\" : ";
+		ResultArrayWriter writer(output);
+		resultArrays[i].second(writer);
+		writer.finish();
+		output << (i + 1 < resultArrays.size() ? ",\n" : "\n");
+	}
+	output << "}" << std::endl;
+}
 
-		// std::cout << "\t\tfound " << featVec.size() << " features for state " << i << std::endl;
+void JsonGraphReader::saveResultBinary(const std::string& filename)
+{
+	std::ofstream output(filename.c_str(), std::ios::binary);
+	if(!output.good())
+		throw std::runtime_error("Could not open binary result file for saving: " + filename);
+
+	// only the used hypotheses are collected, column by column
+	std::vector<uint64_t> nodeIds, nodeValues, linkSrcIds, linkDestIds, linkValues, divisionIds;
+	graphBuilder_->visitNodeValues([&](size_t id, size_t value){
+		nodeIds.push_back(id);
+		nodeValues.push_back(value);
+	});
+	graphBuilder_->visitArcValues([&](size_t srcId, size_t destId, size_t value){
+		linkSrcIds.push_back(srcId);
+		linkDestIds.push_back(destId);
+		linkValues.push_back(value);
+	});
+	graphBuilder_->visitDivisions([&](size_t id){
+		divisionIds.push_back(id);
+	});
+
+	BinaryResultHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magicBytes, BinaryResultHeader::magic(), sizeof(header.magicBytes));
+	header.version = BinaryResultHeader::CurrentVersion;
+	header.numDetections = nodeIds.size();
+	header.numLinks = linkSrcIds.size();
+	header.numDivisions = divisionIds.size();
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for(const std::vector<uint64_t>* column : {&nodeIds, &nodeValues, &linkSrcIds, &linkDestIds, &linkValues, &divisionIds})
+		output.write(reinterpret_cast<const char*>(column->data()), column->size() * sizeof(uint64_t));
+	if(!output.good())
+		throw std::runtime_error("Could not write binary result file: " + filename);
+}
 
-		stateFeatVec.push_back(featVec);
+JsonGraphReader::HypothesisCounts JsonGraphReader::countHypotheses()
+{
+	HypothesisCounts counts;
+	if(isBinaryModel())
+	{
+		std::ifstream input(modelFilename_.c_str(), std::ios::binary);
+		BinaryModelHeader header;
+		input.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if(input.gcount() != sizeof(header))
+			throw std::runtime_error("Binary model file is truncated: " + modelFilename_);
+		counts.numSegmentations = header.numSegmentations;
+		counts.numLinks = header.numLinks;
+		counts.numDivisions = header.numDivisions;
+		return counts;
 	}
 
-	return stateFeatVec;
+	ModelSummary summary = scanModel();
+	counts.numSegmentations = summary.numSegmentations;
+	counts.numLinks = summary.numLinks;
+	counts.numDivisions = summary.numDivisions;
+	return counts;
+}
+
+JsonGraphReader::FeatureVector JsonGraphReader::loadWeights()
+{
+	if(weightsFilename_.empty())
+		return weights_;
+	return readWeightsFromJson(weightsFilename_);
 }
 
 JsonGraphReader::FeatureVector JsonGraphReader::readWeightsFromJson(const std::string& filename)
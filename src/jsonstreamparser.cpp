@@ -0,0 +1,230 @@
+#include "jsonstreamparser.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace dpct
+{
+
+JsonStreamParser::JsonStreamParser(std::istream& input, size_t bufferSize):
+	input_(input),
+	buffer_(std::max(bufferSize, size_t(1))),
+	pos_(0),
+	end_(0),
+	line_(1),
+	token_(Token::EndOfInput),
+	number_(0.0)
+{}
+
+bool JsonStreamParser::fillBuffer()
+{
+	input_.read(buffer_.data(), buffer_.size());
+	pos_ = 0;
+	end_ = input_.gcount();
+	return end_ > 0;
+}
+
+void JsonStreamParser::error(const std::string& message) const
+{
+	std::stringstream s;
+	s << "JSON parse error in line " << line_ << ": " << message;
+	throw std::runtime_error(s.str());
+}
+
+void JsonStreamParser::skipWhitespace(bool separators)
+{
+	while(true)
+	{
+		int c = peekChar();
+		if(c == '\n')
+			line_++;
+
+		if(c == ' ' || c == '\t' || c == '\n' || c == '\r' || (separators && (c == ',' || c == ':')))
+		{
+			pos_++;
+		}
+		else if(c == '/')
+		{
+			pos_++;
+			c = getChar();
+			if(c == '/')
+			{
+				while(c != '\n' && c != -1)
+					c = getChar();
+				line_++;
+			}
+			else if(c == '*')
+			{
+				int previous = 0;
+				c = getChar();
+				while(c != -1 && !(previous == '*' && c == '/'))
+				{
+					if(c == '\n')
+						line_++;
+					previous = c;
+					c = getChar();
+				}
+				if(c == -1)
+					error("unterminated comment");
+			}
+			else
+				error("unexpected '/'");
+		}
+		else
+			return;
+	}
+}
+
+JsonStreamParser::Token JsonStreamParser::next()
+{
+	skipWhitespace(true);
+	int c = peekChar();
+	switch(c)
+	{
+		case -1: token_ = Token::EndOfInput; break;
+		case '{': pos_++; token_ = Token::BeginObject; break;
+		case '}': pos_++; token_ = Token::EndObject; break;
+		case '[': pos_++; token_ = Token::BeginArray; break;
+		case ']': pos_++; token_ = Token::EndArray; break;
+		case '"':
+			pos_++;
+			readString();
+			// a string followed by a colon is the key of an object member
+			skipWhitespace(false);
+			if(peekChar() == ':')
+			{
+				pos_++;
+				token_ = Token::Key;
+			}
+			else
+				token_ = Token::String;
+			break;
+		case 't': readLiteral("true", Token::True); break;
+		case 'f': readLiteral("false", Token::False); break;
+		case 'n': readLiteral("null", Token::Null); break;
+		default:
+			if(c == '-' || (c >= '0' && c <= '9'))
+				readNumber();
+			else
+				error(std::string("unexpected character '") + char(c) + "'");
+	}
+	return token_;
+}
+
+void JsonStreamParser::skipValue()
+{
+	if(token_ != Token::BeginObject && token_ != Token::BeginArray)
+		return;
+
+	size_t depth = 1;
+	while(depth > 0)
+	{
+		switch(next())
+		{
+			case Token::BeginObject:
+			case Token::BeginArray: depth++; break;
+			case Token::EndObject:
+			case Token::EndArray: depth--; break;
+			case Token::EndOfInput: error("unexpected end of input"); break;
+			default: break;
+		}
+	}
+}
+
+void JsonStreamParser::readString()
+{
+	string_.clear();
+	while(true)
+	{
+		int c = getChar();
+		if(c == -1)
+			error("unterminated string");
+		if(c == '"')
+			return;
+		if(c == '\n')
+			line_++;
+		if(c != '\\')
+		{
+			string_.push_back(char(c));
+			continue;
+		}
+
+		c = getChar();
+		switch(c)
+		{
+			case '"': string_.push_back('"'); break;
+			case '\\': string_.push_back('\\'); break;
+			case '/': string_.push_back('/'); break;
+			case 'b': string_.push_back('\b'); break;
+			case 'f': string_.push_back('\f'); break;
+			case 'n': string_.push_back('\n'); break;
+			case 'r': string_.push_back('\r'); break;
+			case 't': string_.push_back('\t'); break;
+			case 'u':
+			{
+				unsigned int codePoint = 0;
+				for(int i = 0; i < 4; ++i)
+				{
+					c = getChar();
+					codePoint <<= 4;
+					if(c >= '0' && c <= '9') codePoint += c - '0';
+					else if(c >= 'a' && c <= 'f') codePoint += c - 'a' + 10;
+					else if(c >= 'A' && c <= 'F') codePoint += c - 'A' + 10;
+					else error("invalid unicode escape sequence");
+				}
+				// encode as UTF-8, surrogate pairs are not combined
+				if(codePoint < 0x80)
+					string_.push_back(char(codePoint));
+				else if(codePoint < 0x800)
+				{
+					string_.push_back(char(0xC0 | (codePoint >> 6)));
+					string_.push_back(char(0x80 | (codePoint & 0x3F)));
+				}
+				else
+				{
+					string_.push_back(char(0xE0 | (codePoint >> 12)));
+					string_.push_back(char(0x80 | ((codePoint >> 6) & 0x3F)));
+					string_.push_back(char(0x80 | (codePoint & 0x3F)));
+				}
+				break;
+			}
+			default: error("invalid escape sequence in string");
+		}
+	}
+}
+
+void JsonStreamParser::readNumber()
+{
+	char text[64];
+	size_t length = 0;
+	int c = peekChar();
+	while(c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E' || (c >= '0' && c <= '9'))
+	{
+		if(length + 1 == sizeof(text))
+			error("number is too long");
+		text[length++] = char(c);
+		pos_++;
+		c = peekChar();
+	}
+	text[length] = '\0';
+
+	char* numberEnd;
+	number_ = std::strtod(text, &numberEnd);
+	if(numberEnd != text + length)
+		error(std::string("invalid number '") + text + "'");
+	token_ = Token::Number;
+}
+
+void JsonStreamParser::readLiteral(const char* literal, Token token)
+{
+	for(const char* l = literal; *l != '\0'; ++l)
+	{
+		if(getChar() != *l)
+			error(std::string("invalid literal, expected '") + literal + "'");
+	}
+	token_ = token;
+}
+
+} // end namespace dpct
@@ -2,14 +2,15 @@
 #include <algorithm>
 #include <assert.h>
 #include <sstream>
+#include <random>
+#include <thread>
+#include <unordered_set>
 
 #include "magnusson.h"
 #include "trackingalgorithm.h"
 #include "graph.h"
 #include "log.h"
 
-using std::placeholders::_1;
-
 namespace dpct
 {
 
@@ -19,178 +20,259 @@ Magnusson::Magnusson(Graph* graph, bool withSwap, bool usedArcsScoreZero, bool u
     usedArcsScoreZero_(usedArcsScoreZero),
     selectorFunction_( selectBestInArc ), // globally defined function
     maxNumPaths_(std::numeric_limits<size_t>::max()),
-    useFastFirstIter_(useFastFirstIter)
+    pathsPerSweep_(1),
+    minPathScoreRatio_(0.8),
+    motionModelThreadSafe_(false),
+    numThreads_(1),
+    minNodesPerThread_(256),
+    useFastFirstIter_(useFastFirstIter),
+    recycleStaleSwapArcs_(false),
+    incrementalUpdates_(false),
+    telemetry_(nullptr),
+    progressCallback_()
 {
     assert(usedArcsScoreZero == true);
 }
 
+Magnusson::~Magnusson()
+{
+    removeSwapArcs();
+}
+
 void Magnusson::setPathStartSelectorFunction(SelectorFunction func)
 {
     selectorFunction_ = func;
 }
 
-void Magnusson::setMotionModelScoreFunction(MotionModelScoreFunction func)
+void Magnusson::setMotionModelScoreFunction(MotionModelScoreFunction func, bool threadSafe)
 {
     motionModelScoreFunction_ = func;
+    motionModelThreadSafe_ = threadSafe;
 }
 
-void Magnusson::batchFirstIteration(double& score, Solution& paths)
+void Magnusson::setBatchMotionModelScoreFunction(BatchMotionModelScoreFunction func, bool threadSafe)
 {
-    DEBUG_MSG("Finding all good tracks from sink for first iteration");
-    Solution availablePaths;
-    double scoreDelta;
-    
-    findNonintersectingBackwardPaths(&graph_->getSourceNode(), &graph_->getSinkNode(), availablePaths);
-
-    // insert all paths at once
-    for(Path& p : availablePaths)
-    {
-        // only add path if they increase the overall score
-        scoreDelta = p.back()->getCurrentScore();
-        if(scoreDelta < 0)
-            continue;
-
-        // update cell counts and score
-        increaseCellCount(p.front()->getSourceNode());
-        for(Arc* a : p)
-            increaseCellCount(a->getTargetNode());
+    batchMotionModelScoreFunction_ = func;
+    motionModelThreadSafe_ = threadSafe;
+}
 
-        score += scoreDelta;
+double Magnusson::track(Solution& paths)
+{
+    if(batchMotionModelScoreFunction_)
+        return trackWithSelectorFunction(paths, BatchFunctionMotionModel(batchMotionModelScoreFunction_, motionModelThreadSafe_));
+    else if(motionModelScoreFunction_)
+        return trackWithSelectorFunction(paths, FunctionMotionModel(motionModelScoreFunction_, motionModelThreadSafe_));
+    else
+        return trackWithSelectorFunction(paths, NoMotionModel());
+}
 
-        if(withSwap_)
-        {
-            // insert swap arcs
-            insertSwapArcsForNewUsedPath(p);
-        }
+template<class MotionModel>
+double Magnusson::trackWithSelectorFunction(Solution& paths, const MotionModel& motionModel)
+{
+    // the default selector is inlined, all others are called through the std::function
+    typedef Arc* (*SelectorPointer)(Node*);
+    const SelectorPointer* selector = selectorFunction_.target<SelectorPointer>();
+    if(selector != nullptr && *selector == &selectBestInArc)
+        return track(paths, motionModel, BestInArcSelector());
+    else
+        return track(paths, motionModel, FunctionSelector(selectorFunction_));
+}
 
-        // add to solution
-        paths.push_back(p);
-        DEBUG_MSG("Adding path of length " << p.size() << " has score: " << p.back()->getCurrentScore());
-        DEBUG_MSG("\rFound " << paths.size() << " paths...");
-    }
+void Magnusson::setNumThreads(size_t numThreads, size_t minNodesPerThread)
+{
+    if(numThreads == 0)
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    numThreads_ = numThreads;
+    minNodesPerThread_ = std::max(minNodesPerThread, size_t(1));
+}
 
-    // update only once
-    updateNodesByTimestep();
+void Magnusson::recordIteration(size_t iteration, const TimePoint& startTime, const TimePoint& augmentEndTime,
+    size_t dirtyNodes, size_t numPaths, const Path& p, double pathScore, double score)
+{
+    if(telemetry_ == nullptr)
+        return;
+
+    // the scores are updated for the next path after the current one was augmented
+    TimePoint endTime = std::chrono::high_resolution_clock::now();
+    IterationTelemetry it;
+    it.iteration = iteration;
+    it.seconds = std::chrono::duration<double>(endTime - startTime).count();
+    it.augmentSeconds = std::chrono::duration<double>(augmentEndTime - startTime).count();
+    it.searchSeconds = std::chrono::duration<double>(endTime - augmentEndTime).count();
+    it.dirtyNodes = dirtyNodes;
+    it.arcsToggled = numPaths > 0 ? p.size() : 0;
+    it.numPaths = numPaths;
+    it.pathLength = p.size();
+    it.pathCost = -pathScore;
+    it.energy = -score;
+    telemetry_->addIteration(it);
 }
 
-void Magnusson::updateNodesByTimestep()
+void Magnusson::collectMemoryStatistics(MemoryStatistics& stats) const
 {
-    updateNode(&graph_->getSourceNode());
+    graph_->collectMemoryStatistics(stats);
+
+    const std::string structure("Magnusson");
+    stats.addStructure(structure, 0, swapArcs_.size());
+
+    // every swap arc has its own score table and user data, which is stored together with its shared pointer
+    size_t swapArcBytes = swapArcStore_.getNumSlots() * sizeof(Arc) + swapArcs_.capacity() * sizeof(Arc*);
+    for(const Arc* a : swapArcs_)
+        swapArcBytes += a->memoryBytes() - sizeof(Arc) + sizeof(MagnussonSwapArcUserData) + 2 * sizeof(long);
+    stats.addContainer(structure, "swapArcs", swapArcs_.size(), swapArcBytes);
 
-    for(size_t t = 0; t < graph_->getNumTimesteps(); ++t)
+    size_t numDirtyNodes = 0;
+    size_t dirtyNodesBytes = dirtyNodesPerTimestep_.capacity() * sizeof(std::vector<Node*>);
+    for(const std::vector<Node*>& nodes : dirtyNodesPerTimestep_)
     {
-        graph_->visitNodesInTimestep(t, std::bind(&Magnusson::updateNode, this, _1));
+        numDirtyNodes += nodes.size();
+        dirtyNodesBytes += nodes.capacity() * sizeof(Node*);
     }
-    updateNode(&graph_->getSourceNode());
-    updateNode(&graph_->getSinkNode());
+    stats.addContainer(structure, "dirtyNodesPerTimestep", numDirtyNodes, dirtyNodesBytes);
+    stats.addMap(structure, "dirtyNodes", dirtyNodes_);
+    stats.addVector(structure, "previousArcScores", previousArcScores_);
 }
 
-double Magnusson::track(Solution& paths)
+bool Magnusson::reportProgress(size_t iteration, size_t numPaths, double score)
 {
-    tic();
-	paths.clear();
-	double score = 0;
-    double scoreDelta = 0.0;
+    if(!progressCallback_)
+        return true;
+
+    Progress progress;
+    progress.iteration = iteration;
+    progress.numPaths = numPaths;
+    progress.energy = -score;
+    progress.elapsedSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime_).count();
+    return progressCallback_(progress);
+}
 
-	// update scores from timestep 0 to the end
-	updateNodesByTimestep();
+void Magnusson::markNodeDirty(Node* n, bool forceOutArcs)
+{
+    // source and sink are handled separately
+    if(graph_->isSpecialNode(n))
+        return;
 
-    if(useFastFirstIter_)
+    std::unordered_map<Node*, bool>::iterator it = dirtyNodes_.find(n);
+    if(it != dirtyNodes_.end())
     {
-        batchFirstIteration(score, paths);
+        it->second |= forceOutArcs;
+        return;
     }
 
-    while(paths.size() < maxNumPaths_)
-    {
-        // backtrack best path, increase cell counts -> invalidates scores!
-        Path p;
-        backtrack(&(graph_->getSinkNode()), p, std::bind(&Magnusson::increaseCellCount, this, _1));
+    dirtyNodes_[n] = forceOutArcs;
+    assert(n->getTimestep() < dirtyNodesPerTimestep_.size());
+    dirtyNodesPerTimestep_[n->getTimestep()].push_back(n);
+}
 
-        DEBUG_MSG("Current best path of length " << p.size() << " has score: " << p.back()->getCurrentScore());
-        printPath(p);
-        scoreDelta = p.back()->getCurrentScore();
+void Magnusson::markArcUseChanged(Arc* a)
+{
+    // the score delta of the arc changed, and marking it used toggled the enabled state
+    // of the arcs around its source, its target and the node it depends on (see Arc::markUsed)
+    Node* source = a->getSourceNode();
+    if(source == &graph_->getSourceNode())
+        a->update(); // the source node is never updated itself, its score does not change
+    else
+        markNodeDirty(source, true);
 
-        // only continue if this path adds to the overall score
-        if(scoreDelta < 0)
+    markNodeDirty(a->getTargetNode(), false);
+    if(a->getObservedNode() != nullptr)
+        markNodeDirty(a->getObservedNode(), true);
+
+    // swap arcs observing this one might have been toggled
+    a->visitObserverArcs([&](Arc* o){ markNodeDirty(o->getTargetNode(), false); });
+}
+
+double Magnusson::augmentIndependentPaths(const Path& first, size_t maxNumPaths, Solution& newPaths)
+{
+    Node* source = &graph_->getSourceNode();
+    Node* sink = &graph_->getSinkNode();
+    double score = 0.0;
+    if(maxNumPaths == 0)
+        return score;
+
+    // using an arc changes the scores and enabled states of the arcs around its source, its target
+    // and the mother cell it observes, so a path is only taken if it avoids all these nodes of the taken paths
+    std::unordered_set<const Node*> touchedNodes;
+    auto touchNodes = [&](const Path& p)
+    {
+        for(Arc* a : p)
         {
-            DEBUG_MSG("Path has negative reward, stopping here with a total number of " << paths.size() << " cells added");
-            break;
+            touchedNodes.insert(a->getTargetNode());
+            if(a->getObservedNode() != nullptr)
+                touchedNodes.insert(a->getObservedNode());
         }
-
-        // insert swap arcs
-        if(withSwap_)
+    };
+    auto findUntouchedPath = [&](Arc* lastArc, Path& p)
+    {
+        p.clear();
+        for(Arc* a = lastArc; ; a = a->getSourceNode()->getBestInArc())
         {
-            cleanUpUsedSwapArcs(p, paths);
-
-            // make sure no swap arcs are left in the paths, otherwise we'll access free'd memory lateron
-            for(Path& path : paths)
-            { 
-                for(Node::ArcIt p_it = path.begin(); p_it != path.end(); ++p_it)
-                {
-                    assert((*p_it)->getType() != Arc::Swap);
-                }
-            }
-
-            insertSwapArcsForNewUsedPath(p);
+            if(a == nullptr || !a->isEnabled() || a->getType() == Arc::Swap)
+                return false;
+            if(a->getObservedNode() != nullptr && touchedNodes.count(a->getObservedNode()) > 0)
+                return false;
+            p.push_back(a);
+            if(a->getSourceNode() == source)
+                break;
+            if(touchedNodes.count(a->getSourceNode()) > 0)
+                return false;
         }
-
-        // update scores from timestep 0 to the end
-        updateNodesByTimestep();
-
-        // add path to solution
-        paths.push_back(p);
-        score += scoreDelta;
-        // std::chrono::time_point<std::chrono::high_resolution_clock> td = std::chrono::high_resolution_clock::now();
-        DEBUG_MSG("Found " << paths.size() << " paths... overall score=" << score << " after " << toc() << " secs");
+        std::reverse(p.begin(), p.end());
+        return true;
+    };
+    touchNodes(first);
+
+    // the sweep found the best path through every in arc of the sink, take the best ones first
+    double minScore = std::max(0.0, minPathScoreRatio_ * first.back()->getCurrentScore());
+    std::vector<Arc*> lastArcs;
+    for(Node::ArcIt a = sink->getInArcsBegin(); a != sink->getInArcsEnd(); ++a)
+    {
+        if(*a != first.back() && (*a)->isEnabled() && (*a)->getCurrentScore() >= minScore)
+            lastArcs.push_back(*a);
     }
-    LOG_MSG("Found " << paths.size() << " paths... overall score=" << score << " after " << toc() << " secs");
+    std::stable_sort(lastArcs.begin(), lastArcs.end(), [](Arc* a, Arc* b){ return a->getCurrentScore() > b->getCurrentScore(); });
 
-    // done
-    // removeSwapArcs(); // TODO: try leaving this out, looks like this takes 100 seconds for rapoport?!
-    toc();
-
-    return score;
-}
+    Path p;
+    for(Arc* lastArc : lastArcs)
+    {
+        if(newPaths.size() >= maxNumPaths)
+            break;
+        if(!findUntouchedPath(lastArc, p))
+            continue;
 
-void Magnusson::updateNode(Node* n)
-{
-    // do not try to find best in arc of source as there is none (yields -inf score otherwise)
-    if(n != &graph_->getSourceNode())
-	   n->updateBestInArcAndScore();
+        // augment like backtrack() does
+        for(Path::reverse_iterator it = p.rbegin(); it != p.rend(); ++it)
+        {
+            increaseCellCount((*it)->getTargetNode());
+            if((*it)->getType() != Arc::Dummy)
+                (*it)->markUsed();
+        }
+        increaseCellCount(source);
 
-    if(motionModelScoreFunction_)
-    {
-        Node* predecessor = nullptr;
-        double motionModelScoreDelta = 0.0;
-        Arc* a = n->getBestInArc();
-        if(a)
+        if(incrementalUpdates_)
         {
-            predecessor = a->getSourceNode();
+            for(Arc* a : p)
+                markArcUseChanged(a);
         }
 
-        for(Node::ArcIt outArc = n->getOutArcsBegin(); outArc != n->getOutArcsEnd(); ++outArc)
+        if(withSwap_)
         {
-            if((*outArc)->getType() == Arc::Move)
-            {
-                Node *predecessorParam = graph_->isSpecialNode(predecessor) ? nullptr : predecessor;
-                Node *nParam = graph_->isSpecialNode(n) ? nullptr : n;
-                Node *targetParam = graph_->isSpecialNode((*outArc)->getTargetNode()) ? nullptr : (*outArc)->getTargetNode();
-                motionModelScoreDelta = motionModelScoreFunction_(predecessorParam, nParam, targetParam);
-                (*outArc)->update(motionModelScoreDelta);
-            }
-            else
+            size_t numSwapArcs = swapArcs_.size();
+            insertSwapArcsForNewUsedPath(p);
+
+            if(incrementalUpdates_)
             {
-                (*outArc)->update();
+                for(size_t i = numSwapArcs; i < swapArcs_.size(); ++i)
+                    markNodeDirty(swapArcs_[i]->getTargetNode(), false);
             }
         }
+
+        DEBUG_MSG("Adding independent path of length " << p.size() << " with score: " << lastArc->getCurrentScore());
+        score += lastArc->getCurrentScore();
+        touchNodes(p);
+        newPaths.push_back(p);
     }
-    else
-    {
-        for(Node::ArcIt outArc = n->getOutArcsBegin(); outArc != n->getOutArcsEnd(); ++outArc)
-        {
-            (*outArc)->update();
-        }
-    }
+    return score;
 }
 
 void Magnusson::increaseCellCount(Node* n)
@@ -209,33 +291,6 @@ void Magnusson::increaseCellCount(Node* n)
 	n->increaseCellCount();
 }
 
-void Magnusson::backtrack(Node* start, TrackingAlgorithm::Path& p, TrackingAlgorithm::VisitorFunction nodeVisitor)
-{
-	p.clear();
-	Node* current = start;
-
-    while(current != &(graph_->getSourceNode()))
-	{
-        nodeVisitor(current);
-        Arc* bestArc = nullptr;
-        if(current == start)
-            bestArc = selectorFunction_(current);
-        else
-            bestArc = current->getBestInArc();
-
-		assert(bestArc != nullptr);
-        assert(bestArc->isEnabled());
-
-        if(bestArc->getType() != Arc::Dummy)
-            bestArc->markUsed();
-		p.push_back(bestArc);
-		current = bestArc->getSourceNode();
-	}
-
-    nodeVisitor(current);
-	std::reverse(p.begin(), p.end());
-}
-
 std::ostream& operator<<(std::ostream& s, Arc* arc)
 {
     s << "(";
@@ -285,6 +340,16 @@ void Magnusson::insertSwapArcsForNewUsedPath(TrackingAlgorithm::Path &p)
     }
 }
 
+void Magnusson::addSwapArc(Node* source, Node* target, double score, Arc* cutArc, Arc* replacementA, Arc* replacementB)
+{
+    std::shared_ptr<MagnussonSwapArcUserData> data = std::make_shared<MagnussonSwapArcUserData>(cutArc, replacementA, replacementB);
+    data->setStoreIndex(swapArcs_.size());
+
+    Arc* arc = swapArcStore_.emplace(source, target, Arc::Swap, std::vector<double>({score}), nullptr, data);
+    cutArc->registerObserverArc(arc);
+    swapArcs_.push_back(arc);
+}
+
 void Magnusson::insertMoveSwapArcs(Arc* a)
 {
     Node *source = a->getSourceNode();
@@ -308,14 +373,7 @@ void Magnusson::insertMoveSwapArcs(Arc* a)
             // the swap arc does not depend on other nodes being part of a path,
             // as this algorithm never removes cells and thus the previously populated nodes can be used in swaps.
             // BUT: it needs to store a reference to the arc that it would cut, and the cleanup action is performed in cleanUpUsedSwapArcs()
-            Arc* arc = new Arc(alternativeSource,
-                                      alternativeTarget,
-                                      Arc::Swap,
-                                      {score},
-                                      nullptr,
-                                      std::make_shared<MagnussonSwapArcUserData>(a, *inIt, *outIt)
-                                      );
-            a->registerObserverArc(arc);
+            addSwapArc(alternativeSource, alternativeTarget, score, a, *inIt, *outIt);
 
 #ifdef DEBUG_LOG
             std::stringstream debugString;
@@ -336,8 +394,6 @@ void Magnusson::insertMoveSwapArcs(Arc* a)
             DEBUG_MSG("\twith replacement arcs: in=" << *inIt << " and out=" << *outIt);
             DEBUG_MSG("\tdeletes arc: " << a);
 #endif
-
-            swapArcs_.push_back(arc);
         }
     }
 }
@@ -414,15 +470,7 @@ void Magnusson::insertAppearanceSwapArcs(Arc* a)
             double score;
             std::tie(alternativeTarget, originalInArc, alternativeAppearanceArc, score) = *swapIt;
 
-            Arc* arc = new Arc(alternativeSource,
-                                      alternativeTarget,
-                                      Arc::Swap,
-                                      {score},
-                                      nullptr,
-                                      std::make_shared<MagnussonSwapArcUserData>(a, originalInArc, alternativeAppearanceArc)
-                                      );
-            a->registerObserverArc(arc);
-            swapArcs_.push_back(arc);
+            addSwapArc(alternativeSource, alternativeTarget, score, a, originalInArc, alternativeAppearanceArc);
         }
     }
 }
@@ -505,15 +553,7 @@ void Magnusson::insertDisappearanceSwapArcs(Arc* a)
             double score;
             std::tie(alternativeSource, originalInArc, alternativeDisappearanceArc, score) = *swapIt;
 
-            Arc* arc = new Arc(alternativeSource,
-                                      alternativeTarget,
-                                      Arc::Swap,
-                                      {score},
-                                      nullptr,
-                                      std::make_shared<MagnussonSwapArcUserData>(a, originalInArc, alternativeDisappearanceArc)
-                                      );
-            a->registerObserverArc(arc);
-            swapArcs_.push_back(arc);
+            addSwapArc(alternativeSource, alternativeTarget, score, a, originalInArc, alternativeDisappearanceArc);
         }
     }
 }
@@ -521,6 +561,7 @@ void Magnusson::insertDisappearanceSwapArcs(Arc* a)
 void Magnusson::cleanUpUsedSwapArcs(TrackingAlgorithm::Path &p, std::vector<Path>& paths)
 {
     std::vector<Arc*> usedSwapArcs;
+    std::vector<Arc*> unusedCutArcs;
 
     // if a swap arc was used, we can find the path that was affected by this and create the two paths after swapping
     bool foundSwapArc = true;
@@ -575,6 +616,16 @@ void Magnusson::cleanUpUsedSwapArcs(TrackingAlgorithm::Path &p, std::vector<Path
                                 replacementP->markUsed();
                                 // "unuse" the arc that was previously used
                                 arcToRemove->markUsed(false);
+
+                                if(incrementalUpdates_)
+                                {
+                                    markArcUseChanged(replacementPath);
+                                    markArcUseChanged(replacementP);
+                                    markArcUseChanged(arcToRemove);
+                                }
+
+                                if(recycleStaleSwapArcs_)
+                                    unusedCutArcs.push_back(arcToRemove);
                             }
 
                             // remove all this swap arc
@@ -605,6 +656,12 @@ void Magnusson::cleanUpUsedSwapArcs(TrackingAlgorithm::Path &p, std::vector<Path
         removeSwapArc(a);
     }
 
+    // only once the paths are fixed, as stale swap arcs cannot occur in any of them
+    for(Arc* a: unusedCutArcs)
+    {
+        removeStaleSwapArcs(a);
+    }
+
 #ifdef DEBUG_LOG
     DEBUG_MSG("Paths after removing swaps:");
     printPath(p);
@@ -621,13 +678,35 @@ void Magnusson::cleanUpUsedSwapArcs(TrackingAlgorithm::Path &p, std::vector<Path
 void Magnusson::removeSwapArc(Arc* arc)
 {
     assert(arc->getType() == Arc::Swap);
+    std::shared_ptr<MagnussonSwapArcUserData> data = std::static_pointer_cast<MagnussonSwapArcUserData>(arc->getUserData());
 
-    removeArc(arc);
-    std::vector<Arc*>::iterator it = std::find(swapArcs_.begin(), swapArcs_.end(), arc);
-    if(it != swapArcs_.end())
-        swapArcs_.erase(it);
-    else
+    // O(1) removal from the list of swap arcs by moving the last one into this position
+    size_t index = data->getStoreIndex();
+    if(index >= swapArcs_.size() || swapArcs_[index] != arc)
         throw std::runtime_error("Did not find arc to remove!");
+    Arc* last = swapArcs_.back();
+    std::static_pointer_cast<MagnussonSwapArcUserData>(last->getUserData())->setStoreIndex(index);
+    swapArcs_[index] = last;
+    swapArcs_.pop_back();
+
+    if(incrementalUpdates_)
+        markNodeDirty(arc->getTargetNode(), false);
+
+    removeArc(arc);
+    data->getCutArc()->unregisterObserverArc(arc);
+    swapArcStore_.release(arc);
+}
+
+void Magnusson::removeStaleSwapArcs(Arc* cutArc)
+{
+    std::vector<Arc*> staleSwapArcs;
+    cutArc->visitObserverArcs([&](Arc* a){
+        if(a->getType() == Arc::Swap && std::static_pointer_cast<MagnussonSwapArcUserData>(a->getUserData())->isStale())
+            staleSwapArcs.push_back(a);
+    });
+
+    for(Arc* a : staleSwapArcs)
+        removeSwapArc(a);
 }
 
 void Magnusson::removeArc(Arc* a)
@@ -641,12 +720,29 @@ void Magnusson::removeArc(Arc* a)
 
 void Magnusson::removeSwapArcs()
 {
+    if(swapArcs_.empty())
+        return;
+
+    // unregister all swap arcs in one pass over every affected node and cut arc,
+    // instead of searching each swap arc in the arc lists of its nodes
+    std::unordered_set<const Arc*> swapArcSet(swapArcs_.begin(), swapArcs_.end());
+    std::unordered_set<Node*> nodes;
+    std::unordered_set<Arc*> cutArcs;
     for(Arc* a : swapArcs_)
     {
-        removeArc(a);
-        delete a;
+        nodes.insert(a->getSourceNode());
+        nodes.insert(a->getTargetNode());
+        cutArcs.insert(std::static_pointer_cast<MagnussonSwapArcUserData>(a->getUserData())->getCutArc());
     }
+
+    IArcNotifier::ArcPredicate isOwnSwapArc = [&](const Arc* a){ return swapArcSet.count(a) > 0; };
+    for(Node* n : nodes)
+        n->removeArcsIf(isOwnSwapArc);
+    for(Arc* a : cutArcs)
+        a->unregisterObserverArcsIf(isOwnSwapArc);
+
     swapArcs_.clear();
+    swapArcStore_.clear();
 }
 
 // -------------------------------------------------------------------------
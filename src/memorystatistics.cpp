@@ -0,0 +1,152 @@
+#include "memorystatistics.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <sys/resource.h>
+
+namespace dpct
+{
+
+namespace
+{
+/// approximate bytes per hypothesis of a flow graph with its residual graph and of a magnusson graph with its
+/// swap arcs, at the end of tracking, fitted to collectMemoryStatistics of models with 2000 to 4000 segmentations.
+/// Magnusson's swap arcs depend on the solution, they are budgeted with up to three and a half per link.
+const size_t FlowBytesPerSegmentation = 524;
+const size_t FlowBytesPerLink = 369;
+const size_t FlowBytesPerDivision = 1115;
+const size_t MagnussonBytesPerSegmentation = 269;
+const size_t MagnussonBytesPerLink = 1100;
+const size_t MagnussonBytesPerDivision = 833;
+
+double toMB(size_t bytes)
+{
+	return double(bytes) / (1024.0 * 1024.0);
+}
+} // end anonymous namespace
+
+void MemoryStatistics::addStructure(const std::string& structure, size_t numNodes, size_t numArcs)
+{
+	StructureSize size;
+	size.structure = structure;
+	size.numNodes = numNodes;
+	size.numArcs = numArcs;
+	structures_.push_back(size);
+}
+
+void MemoryStatistics::addContainer(const std::string& structure, const std::string& container, size_t numElements, size_t bytes)
+{
+	ContainerMemory memory;
+	memory.structure = structure;
+	memory.container = container;
+	memory.numElements = numElements;
+	memory.bytes = bytes;
+	containers_.push_back(memory);
+}
+
+size_t MemoryStatistics::getTotalBytes() const
+{
+	size_t bytes = 0;
+	for(const ContainerMemory& c : containers_)
+		bytes += c.bytes;
+	return bytes;
+}
+
+size_t MemoryStatistics::getStructureBytes(const std::string& structure) const
+{
+	size_t bytes = 0;
+	for(const ContainerMemory& c : containers_)
+		if(c.structure == structure)
+			bytes += c.bytes;
+	return bytes;
+}
+
+void MemoryStatistics::updatePeakResidentBytes()
+{
+	peakResidentBytes_ = std::max(peakResidentBytes_, readPeakResidentBytes());
+}
+
+size_t MemoryStatistics::readPeakResidentBytes()
+{
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return size_t(usage.ru_maxrss);
+#else
+	// in kilobytes
+	return size_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
+size_t MemoryStatistics::estimateTrackingBytes(size_t numSegmentations, size_t numLinks, size_t numDivisions, const std::string& method)
+{
+	size_t flowBytes = numSegmentations * FlowBytesPerSegmentation
+		+ numLinks * FlowBytesPerLink
+		+ numDivisions * FlowBytesPerDivision;
+	size_t magnussonBytes = numSegmentations * MagnussonBytesPerSegmentation
+		+ numLinks * MagnussonBytesPerLink
+		+ numDivisions * MagnussonBytesPerDivision;
+
+	if(method == "magnusson")
+		return magnussonBytes;
+	// magnusson's graph is still alive while the flow graph is built and tracked
+	if(method == "magnusson-flow")
+		return magnussonBytes + flowBytes;
+	return flowBytes;
+}
+
+void MemoryStatistics::writeSummary(std::ostream& out) const
+{
+	for(const StructureSize& s : structures_)
+		out << s.structure << ": " << s.numNodes << " nodes, " << s.numArcs << " arcs, "
+			<< toMB(getStructureBytes(s.structure)) << " MB" << std::endl;
+	for(const ContainerMemory& c : containers_)
+		out << "\t" << c.structure << "::" << c.container << ": " << c.numElements << " elements, "
+			<< toMB(c.bytes) << " MB" << std::endl;
+	out << "Total: " << toMB(getTotalBytes()) << " MB in containers, peak resident memory "
+		<< toMB(peakResidentBytes_) << " MB" << std::endl;
+}
+
+void MemoryStatistics::writeCsv(std::ostream& out) const
+{
+	out << "structure,container,numElements,bytes\n";
+	for(const ContainerMemory& c : containers_)
+		out << c.structure << "," << c.container << "," << c.numElements << "," << c.bytes << "\n";
+}
+
+void MemoryStatistics::writeJson(std::ostream& out) const
+{
+	out << "{\n\t\"totalBytes\": " << getTotalBytes() << ",\n\t\"peakResidentBytes\": " << peakResidentBytes_ << ",\n\t\"structures\": [";
+	for(size_t i = 0; i < structures_.size(); i++)
+	{
+		const StructureSize& s = structures_[i];
+		out << (i > 0 ? ",\n\t\t" : "\n\t\t") << "{\"structure\": \"" << s.structure << "\", \"numNodes\": " << s.numNodes
+			<< ", \"numArcs\": " << s.numArcs << ", \"bytes\": " << getStructureBytes(s.structure) << "}";
+	}
+	out << "\n\t],\n\t\"containers\": [";
+	for(size_t i = 0; i < containers_.size(); i++)
+	{
+		const ContainerMemory& c = containers_[i];
+		out << (i > 0 ? ",\n\t\t" : "\n\t\t") << "{\"structure\": \"" << c.structure << "\", \"container\": \"" << c.container
+			<< "\", \"numElements\": " << c.numElements << ", \"bytes\": " << c.bytes << "}";
+	}
+	out << "\n\t]\n}\n";
+}
+
+void MemoryStatistics::save(const std::string& filename) const
+{
+	std::ofstream out(filename.c_str());
+	if(!out.good())
+		throw std::runtime_error("Could not open memory statistics file for writing: " + filename);
+
+	const std::string jsonExtension(".json");
+	if(filename.size() >= jsonExtension.size()
+		&& filename.compare(filename.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0)
+		writeJson(out);
+	else
+		writeCsv(out);
+}
+
+} // end namespace dpct
@@ -12,14 +12,17 @@ namespace dpct
 {
 
 Node::Node(const std::vector<double>& cellCountScore,
-           UserDataPtr data):
+           UserDataPtr data,
+           ScorePool* scorePool):
     IUserDataHolder(data),
     appearanceArc_(nullptr),
     disappearanceArc_(nullptr),
     cellCount_(0),
     bestInArc_(nullptr),
-    cellCountScore_(cellCountScore),
+    cellCountScore_(cellCountScore.begin(), cellCountScore.end(), PoolAllocator<double>(scorePool)),
     currentScore_(0.0),
+    timestep_(0),
+    index_(0),
     numActiveDivisions_(0),
     numUsedMoveInArcs_(0),
     numUsedMoveOutArcs_(0)
@@ -35,7 +38,7 @@ Node::Node(const std::vector<double>& cellCountScore,
 }
 
 Node::Node(const Node& n, UserDataPtr data):
-    Node(n.cellCountScore_, data)
+    Node(std::vector<double>(n.cellCountScore_.begin(), n.cellCountScore_.end()), data)
 {}
 
 void Node::registerInArc(Arc* arc)
@@ -88,6 +91,19 @@ bool Node::removeOutArc(Arc *arc)
     }
     return false;
 }
+void Node::removeArcsIf(const ArcPredicate& pred)
+{
+    if(appearanceArc_ != nullptr && pred(appearanceArc_))
+        appearanceArc_ = nullptr;
+    if(disappearanceArc_ != nullptr && pred(disappearanceArc_))
+        disappearanceArc_ = nullptr;
+    if(bestInArc_ != nullptr && pred(bestInArc_))
+        bestInArc_ = nullptr;
+
+    inArcs_.erase(std::remove_if(inArcs_.begin(), inArcs_.end(), pred), inArcs_.end());
+    outArcs_.erase(std::remove_if(outArcs_.begin(), outArcs_.end(), pred), outArcs_.end());
+}
+
 void Node::reset()
 {
     cellCount_ = 0;
@@ -0,0 +1,274 @@
+#include "pruninggraphbuilder.h"
+#include "log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace dpct
+{
+
+void PruningReport::writeSummary(std::ostream& out) const
+{
+	out << "Pruned " << removedLinks.size() << " of " << numLinks << " links (" << numDominatedLinks << " dominated, "
+		<< numUnreachableLinks << " unreachable), " << numUnreachableDetections << " of " << numDetections << " detections, "
+		<< numUnreachableDivisions << " of " << numDivisions << " divisions and " << numRemovedStates << " states" << std::endl;
+}
+
+void PruningReport::writeJson(std::ostream& out) const
+{
+	out << "{\n\t\"numDetections\": " << numDetections << ",\n\t\"numLinks\": " << numLinks << ",\n\t\"numDivisions\": " << numDivisions
+		<< ",\n\t\"numDominatedLinks\": " << numDominatedLinks << ",\n\t\"numUnreachableLinks\": " << numUnreachableLinks
+		<< ",\n\t\"numUnreachableDetections\": " << numUnreachableDetections << ",\n\t\"numUnreachableDivisions\": " << numUnreachableDivisions
+		<< ",\n\t\"numRemovedStates\": " << numRemovedStates << ",\n\t\"removedLinks\": [";
+	for(size_t i = 0; i < removedLinks.size(); i++)
+		out << (i > 0 ? ",\n\t\t" : "\n\t\t") << "{\"src\": " << removedLinks[i].first << ", \"dest\": " << removedLinks[i].second << "}";
+	out << "\n\t],\n\t\"removedDetections\": [";
+	for(size_t i = 0; i < removedDetections.size(); i++)
+		out << (i > 0 ? ", " : "") << removedDetections[i];
+	out << "],\n\t\"removedDivisions\": [";
+	for(size_t i = 0; i < removedDivisions.size(); i++)
+		out << (i > 0 ? ", " : "") << removedDivisions[i];
+	out << "]\n}\n";
+}
+
+void PruningReport::save(const std::string& filename) const
+{
+	std::ofstream out(filename.c_str());
+	if(!out.good())
+		throw std::runtime_error("Could not open pruning report file for writing: " + filename);
+	writeJson(out);
+}
+
+PruningGraphBuilder::PruningGraphBuilder(GraphBuilder* graphBuilder):
+	graphBuilder_(graphBuilder),
+	pruned_(false)
+{
+	if(graphBuilder_->keepsCostTerms())
+		throw std::runtime_error("Cannot prune the hypotheses of a graph builder that recomputes the costs for other weights");
+}
+
+void PruningGraphBuilder::reserve(size_t numDetections, size_t numLinks, size_t numDivisions)
+{
+	GraphBuilder::reserve(numDetections, numLinks, numDivisions);
+	nodes_.reserve(numDetections);
+	links_.reserve(numLinks);
+	divisionIds_.reserve(numDivisions);
+	idToNodeIndexMap_.reserve(numDetections);
+}
+
+void PruningGraphBuilder::addNode(
+	size_t id,
+	const CostDeltaVector& detectionCosts,
+	const CostDeltaVector& detectionCostDeltas,
+	const CostDeltaVector& appearanceCostDeltas,
+	const CostDeltaVector& disappearanceCostDeltas,
+	size_t targetIdx)
+{
+	idToNodeIndexMap_[id] = nodes_.size();
+	nodes_.push_back(NodeHypothesis{id, detectionCosts, detectionCostDeltas, appearanceCostDeltas, disappearanceCostDeltas,
+						targetIdx, false, 0.0, {}, {}, detectionCostDeltas.size()});
+}
+
+size_t PruningGraphBuilder::getNodeIndex(size_t id, const std::string& hypothesis) const
+{
+	std::unordered_map<size_t, size_t>::const_iterator it = idToNodeIndexMap_.find(id);
+	if(it == idToNodeIndexMap_.end())
+		throw std::runtime_error("Trying to add " + hypothesis + " but the node is not present in map");
+	return it->second;
+}
+
+void PruningGraphBuilder::addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas)
+{
+	size_t srcIndex = getNodeIndex(srcId, "link source");
+	size_t destIndex = getNodeIndex(destId, "link destination");
+	nodes_[srcIndex].outLinks.push_back(links_.size());
+	nodes_[destIndex].inLinks.push_back(links_.size());
+	links_.push_back(LinkHypothesis{srcIndex, destIndex, costDeltas, false});
+}
+
+void PruningGraphBuilder::allowMitosis(size_t id, ValueType divisionCostDelta)
+{
+	NodeHypothesis& node = nodes_[getNodeIndex(id, "division")];
+	node.hasDivision = true;
+	node.divisionCostDelta = divisionCostDelta;
+	divisionIds_.push_back(id);
+}
+
+size_t PruningGraphBuilder::getLinkMaxValue(const LinkHypothesis& link) const
+{
+	return std::min(link.costDeltas.size(), std::min(nodes_[link.srcIndex].maxValue, nodes_[link.destIndex].maxValue));
+}
+
+bool PruningGraphBuilder::removeUnreachableHypotheses()
+{
+	bool changed = false;
+	bool nodesChanged = true;
+	while(nodesChanged)
+	{
+		nodesChanged = false;
+		for(LinkHypothesis& link : links_)
+		{
+			if(!link.removed && getLinkMaxValue(link) == 0)
+			{
+				link.removed = true;
+				nodesChanged = true;
+			}
+		}
+
+		for(NodeHypothesis& node : nodes_)
+		{
+			if(node.maxValue == 0)
+				continue;
+
+			// every object has to enter and leave the detection, a division duplicate brings at most one more object
+			size_t inCapacity = std::min(node.appearanceCostDeltas.size(), node.maxValue);
+			for(size_t l : node.inLinks)
+			{
+				const LinkHypothesis& link = links_[l];
+				if(!link.removed)
+					inCapacity += getLinkMaxValue(link) + (nodes_[link.srcIndex].hasDivision ? 1 : 0);
+			}
+			size_t outCapacity = std::min(node.disappearanceCostDeltas.size(), node.maxValue);
+			for(size_t l : node.outLinks)
+			{
+				if(!links_[l].removed)
+					outCapacity += getLinkMaxValue(links_[l]);
+			}
+
+			size_t maxValue = std::min(node.maxValue, std::min(inCapacity, outCapacity));
+			if(maxValue < node.maxValue)
+			{
+				node.maxValue = maxValue;
+				nodesChanged = true;
+			}
+		}
+
+		// a division needs its parent to be used and at least one link to send the second child along
+		for(NodeHypothesis& node : nodes_)
+		{
+			if(!node.hasDivision)
+				continue;
+			bool hasOutLink = std::any_of(node.outLinks.begin(), node.outLinks.end(), [&](size_t l){ return !links_[l].removed; });
+			if(node.maxValue == 0 || !hasOutLink)
+			{
+				node.hasDivision = false;
+				nodesChanged = true;
+			}
+		}
+		changed = changed || nodesChanged;
+	}
+	return changed;
+}
+
+bool PruningGraphBuilder::removeDominatedLinks()
+{
+	bool changed = false;
+	for(LinkHypothesis& link : links_)
+	{
+		if(link.removed)
+			continue;
+		const NodeHypothesis& src = nodes_[link.srcIndex];
+		const NodeHypothesis& dest = nodes_[link.destIndex];
+
+		// the replacement must be possible for every object that can pass the detections
+		if(src.disappearanceCostDeltas.size() < src.maxValue || dest.appearanceCostDeltas.size() < dest.maxValue)
+			continue;
+
+		ValueType cheapestLinkState = *std::min_element(link.costDeltas.begin(), link.costDeltas.begin() + getLinkMaxValue(link));
+		ValueType disappearanceCost = *std::max_element(src.disappearanceCostDeltas.begin(), src.disappearanceCostDeltas.begin() + src.maxValue);
+		ValueType appearanceCost = *std::max_element(dest.appearanceCostDeltas.begin(), dest.appearanceCostDeltas.begin() + dest.maxValue);
+
+		if(cheapestLinkState < disappearanceCost + appearanceCost)
+			continue;
+		// the second child of a division takes the duplicate of the link instead of appearing
+		if(src.hasDivision && cheapestLinkState + src.divisionCostDelta < appearanceCost)
+			continue;
+
+		link.removed = true;
+		report_.numDominatedLinks++;
+		changed = true;
+	}
+	return changed;
+}
+
+void PruningGraphBuilder::prune()
+{
+	if(pruned_)
+		throw std::runtime_error("The hypotheses of a pruning graph builder can only be pruned once");
+	pruned_ = true;
+
+	report_.clear();
+	report_.numDetections = nodes_.size();
+	report_.numLinks = links_.size();
+	report_.numDivisions = divisionIds_.size();
+
+	removeUnreachableHypotheses();
+	while(removeDominatedLinks())
+		removeUnreachableHypotheses();
+
+	// collect what is kept and what was removed
+	size_t numLinks = 0;
+	for(const LinkHypothesis& link : links_)
+	{
+		if(link.removed)
+			report_.removedLinks.push_back(std::make_pair(nodes_[link.srcIndex].id, nodes_[link.destIndex].id));
+		else
+		{
+			report_.numRemovedStates += link.costDeltas.size() - getLinkMaxValue(link);
+			numLinks++;
+		}
+	}
+	report_.numUnreachableLinks = report_.removedLinks.size() - report_.numDominatedLinks;
+
+	for(const NodeHypothesis& node : nodes_)
+	{
+		if(node.maxValue == 0)
+			report_.removedDetections.push_back(node.id);
+		else
+			report_.numRemovedStates += node.detectionCostDeltas.size() - node.maxValue
+				+ node.appearanceCostDeltas.size() - std::min(node.appearanceCostDeltas.size(), node.maxValue)
+				+ node.disappearanceCostDeltas.size() - std::min(node.disappearanceCostDeltas.size(), node.maxValue);
+	}
+	report_.numUnreachableDetections = report_.removedDetections.size();
+
+	for(size_t id : divisionIds_)
+	{
+		if(!nodes_[idToNodeIndexMap_[id]].hasDivision)
+			report_.removedDivisions.push_back(id);
+	}
+	report_.numUnreachableDivisions = report_.removedDivisions.size();
+	DEBUG_MSG("Pruning kept " << nodes_.size() - report_.numUnreachableDetections << " detections and " << numLinks << " links");
+
+	// hand the remaining hypotheses with their reachable states to the wrapped builder
+	graphBuilder_->reserve(nodes_.size() - report_.numUnreachableDetections, numLinks, divisionIds_.size() - report_.numUnreachableDivisions);
+	for(const NodeHypothesis& node : nodes_)
+	{
+		if(node.maxValue == 0)
+			continue;
+		if(idToTimestepsMap_.find(node.id) != idToTimestepsMap_.end())
+			graphBuilder_->setNodeTimesteps(node.id, idToTimestepsMap_[node.id]);
+		size_t numAppearanceStates = std::min(node.appearanceCostDeltas.size(), node.maxValue);
+		size_t numDisappearanceStates = std::min(node.disappearanceCostDeltas.size(), node.maxValue);
+		graphBuilder_->addNode(node.id,
+			CostDeltaVector(node.detectionCosts.begin(), node.detectionCosts.begin() + std::min(node.detectionCosts.size(), node.maxValue + 1)),
+			CostDeltaVector(node.detectionCostDeltas.begin(), node.detectionCostDeltas.begin() + node.maxValue),
+			CostDeltaVector(node.appearanceCostDeltas.begin(), node.appearanceCostDeltas.begin() + numAppearanceStates),
+			CostDeltaVector(node.disappearanceCostDeltas.begin(), node.disappearanceCostDeltas.begin() + numDisappearanceStates),
+			node.targetIdx);
+	}
+	for(const LinkHypothesis& link : links_)
+	{
+		if(!link.removed)
+			graphBuilder_->addArc(nodes_[link.srcIndex].id, nodes_[link.destIndex].id,
+				CostDeltaVector(link.costDeltas.begin(), link.costDeltas.begin() + getLinkMaxValue(link)));
+	}
+	for(size_t id : divisionIds_)
+	{
+		const NodeHypothesis& node = nodes_[idToNodeIndexMap_[id]];
+		if(node.hasDivision)
+			graphBuilder_->allowMitosis(id, node.divisionCostDelta);
+	}
+}
+
+} // end namespace dpct
@@ -8,51 +8,386 @@
 namespace dpct
 {
 
+/// Dijkstra gives up and leaves the search to Bellman-Ford after scanning this many nodes per node in the graph
+const size_t DijkstraScansPerNode = 4;
+
+const ResidualGraph::Token ResidualGraph::NoToken;
+const int ResidualGraph::SharedStep;
+const size_t ResidualGraph::NoSharedArc;
+const size_t ResidualGraph::NoDetection;
+
 ResidualGraph::ResidualGraph(
 		const Graph& original, 
 		const OriginalNode& origSource, 
-		const std::map<OriginalNode, size_t>& nodeTimestepMap, 
+		const std::vector<size_t>& nodeTimestepMap, 
+		const SharedArcs& sharedArcs,
 		bool useBackArcs,
-		bool useOrderedNodeListInBF
+		bool useOrderedNodeListInBF,
+		bool useStaticArcs,
+		bool useCsrBackend,
+		bool useDijkstra,
+		const DetectionNodes& detectionNodes
 ):
 	originalGraph_(original),
 	useBackArcs_(useBackArcs),
 	useOrderedNodeListInBF_(useOrderedNodeListInBF),
+	useStaticArcs_(useStaticArcs || useCsrBackend), // a CSR graph cannot change its topology
+	useDijkstra_(useDijkstra),
 	residualDistMap_(*this),
+	transitPartnerMap_(*this),
+	transitLengthMap_(*this),
+	tokenCheckStamp_(0),
+	conflictKeyStamp_(0),
 	nodeUpdateOrderMap_(*this),
 	bfDistMap_(*this),
 	bfPredMap_(*this),
+	potentialMap_(*this, 0.0),
 	bf(*this, residualDistMap_, bfProcess_, bfNextProcess_),
-	firstPath_(true)
+	numActiveBackwardArcs_(0),
+	firstPath_(true),
+	localCycleRepair_(false),
+	cycleRepairPending_(false),
+	numToggledArcs_(0)
 {
-	reserveNode(lemon::countNodes(original));
-	reserveArc(2 * lemon::countArcs(original));
+	reserveNode(lemon::countNodes(original) + detectionNodes.size());
+	reserveArc(2 * lemon::countArcs(original) + 2 * sharedArcs.size());
 
-	for(Graph::NodeIt origNode(original); origNode != lemon::INVALID; ++origNode)
+	if(!detectionNodes.empty())
+		detectionSlots_.resize(original.maxNodeId() + 1, NoDetection);
+	for(size_t i = 0; i < detectionNodes.size(); i++)
+	{
+		size_t& slot = detectionSlots_[original.id(detectionNodes[i])];
+		if(slot != NoDetection)
+			throw std::runtime_error("A detection node can only be given once");
+		slot = i;
+	}
+	detectionOutNodes_.resize(detectionNodes.size(), lemon::INVALID);
+
+	// all per node and per arc bookkeeping is indexed by lemon id, so size it by the max id (ids can have gaps)
+	originMap_.reserve(original.maxNodeId() + 1 + detectionNodes.size());
+	residualNodeMap_.resize(original.maxNodeId() + 1, lemon::INVALID);
+	auto addResidualNode = [&](const OriginalNode& origNode, size_t timestep)
 	{
 		Node n = addNode();
-		originMap_[n] = origNode;
-		residualNodeMap_[origNode] = n;
-		nodeUpdateOrderMap_.set(n, nodeTimestepMap.at(origNode));
+		if((size_t)id(n) >= originMap_.size())
+			originMap_.resize(id(n) + 1, lemon::INVALID);
+		originMap_[id(n)] = origNode;
+		nodeUpdateOrderMap_.set(n, timestep);
+		transitPartnerMap_[n] = lemon::INVALID;
+		transitLengthMap_[n] = std::numeric_limits<double>::infinity();
+		return n;
+	};
+	for(Graph::NodeIt origNode(original); origNode != lemon::INVALID; ++origNode)
+	{
+		size_t timestep = nodeTimestepMap.at(original.id(origNode));
+		Node n = addResidualNode(origNode, timestep);
+		residualNodeMap_[original.id(origNode)] = n;
+
+		// the out-side of a detection node follows its in-side in time, like in a graph with split detections
+		if(isDetectionNode(origNode))
+		{
+			Node out = addResidualNode(origNode, timestep + 1);
+			detectionOutNodes_[detectionSlots_[original.id(origNode)]] = out;
+			transitPartnerMap_[n] = out;
+			transitPartnerMap_[out] = n;
+		}
 	}
 
-	for(Graph::ArcIt origArc(original); origArc != lemon::INVALID; ++origArc)
+	sharedArcOffset_ = 2 * (original.maxArcId() + 1);
+	if(!sharedArcs.empty())
+		sharedArcSlots_.resize(original.maxArcId() + 1, NoSharedArc);
+	sharedArcSources_.reserve(sharedArcs.size());
+	for(const std::pair<OriginalArc, OriginalNode>& sharedArc : sharedArcs)
+	{
+		size_t& slot = sharedArcSlots_[original.id(sharedArc.first)];
+		if(slot != NoSharedArc)
+			throw std::runtime_error("An arc can only be shared with one node");
+		slot = sharedArcSources_.size();
+		sharedArcSources_.push_back(residualNode(sharedArc.second));
+	}
+
+	transitOffset_ = sharedArcOffset_ + 2 * sharedArcs.size();
+	size_t numResidualArcs = transitOffset_ + 2 * detectionNodes.size();
+	residualArcs_.resize(numResidualArcs);
+	residualArcProvidesToken_.resize(numResidualArcs, NoToken);
+	residualArcForbidsToken_.resize(numResidualArcs, NoToken);
+	residualArcOriginMap_.resize(numResidualArcs, ArcOrigin(lemon::INVALID, true));
+
+	if(useStaticArcs_)
 	{
-		residualArcProvidesTokens_[arcToPair(origArc)] = {};
-		residualArcProvidesTokens_[arcToInversePair(origArc)] = {};
-		residualArcForbidsTokens_[arcToPair(origArc)] = {};
-		residualArcForbidsTokens_[arcToInversePair(origArc)] = {};
-		residualArcMap_[arcToPair(origArc)] = ResidualArcProperties();
-		residualArcMap_[arcToInversePair(origArc)] = ResidualArcProperties();
+		// allocate every residual arc exactly once, they start out inactive with infinite cost
+		for(Graph::ArcIt origArc(original); origArc != lemon::INVALID; ++origArc)
+		{
+			for(bool forward : {true, false})
+			{
+				if(!forward && !useBackArcs_)
+					continue;
+				Node s = forward ? residualOutNode(original.source(origArc)) : residualNode(original.target(origArc));
+				Node t = forward ? residualNode(original.target(origArc)) : residualOutNode(original.source(origArc));
+				addStaticArc(residualArcIndex(origArc, forward), origArc, forward, s, t);
+			}
+		}
+
+		for(const std::pair<OriginalArc, OriginalNode>& sharedArc : sharedArcs)
+		{
+			Node sharing = residualNode(sharedArc.second);
+			Node t = residualNode(original.target(sharedArc.first));
+			addStaticArc(sharedArcIndex(sharedArc.first, Forward), sharedArc.first, Forward, sharing, t);
+			if(useBackArcs_)
+				addStaticArc(sharedArcIndex(sharedArc.first, Backward), sharedArc.first, Backward, t, sharing);
+		}
 	}
 
+	// the ListDigraph only stores the static arcs, searches run on the CSR view that skips the disabled ones
+	if(useStaticArcs_)
+		csr_.reset(new CsrBackend(*this, residualDistMap_, nodeUpdateOrderMap_, 
+			transitPartnerMap_, transitLengthMap_, !detectionNodes.empty()));
+	else if(!detectionNodes.empty())
+		bf.nodeTransits(transitPartnerMap_, transitLengthMap_);
+
 	bfProcess_.reserve(lemon::countNodes(*this));
 	bfNextProcess_.reserve(lemon::countNodes(*this));
 	dirtyNodes_.reserve(lemon::countNodes(*this));
 
     bf.distMap(bfDistMap_);
     bf.predMap(bfPredMap_);
-    source_ = residualNodeMap_.at(origSource);
+    source_ = residualNode(origSource);
+}
+
+void ResidualGraph::addStaticArc(size_t index, const OriginalArc& a, bool forward, const Node& s, const Node& t)
+{
+	Arc ra = addArc(s, t);
+	residualArcs_[index].arc = ra;
+	if((size_t)id(ra) >= residualArcOriginMap_.size())
+		residualArcOriginMap_.resize(id(ra) + 1);
+	residualArcOriginMap_[id(ra)] = ArcOrigin(a, forward);
+	residualDistMap_[ra] = std::numeric_limits<double>::infinity();
+}
+
+ResidualGraph::CsrBackend::CsrBackend(
+	const Graph& g, 
+	const DistMap& lengths, 
+	const NodeUpdateOrderMap& nodeUpdateOrderMap,
+	const TransitPartnerMap& transitPartners,
+	const TransitLengthMap& transitLengths,
+	bool hasTransits
+):
+	graph(g, nodeUpdateOrderMap),
+	lengthMap(graph),
+	distMap(graph),
+	predMap(graph),
+	potentialMap(graph, 0.0),
+	nodeOrderMap(graph),
+	transitPartnerMap(graph, lemon::INVALID),
+	transitLengthMap(graph, std::numeric_limits<double>::infinity()),
+	bf(graph, lengthMap, process, nextProcess)
+{
+	for(CsrGraph::ArcIt a(graph); a != lemon::INVALID; ++a)
+	{
+		lengthMap.set(a, lengths[toResidual(a)]);
+		if(lengths[toResidual(a)] == std::numeric_limits<double>::infinity())
+			graph.setArcEnabled(a, false);
+	}
+
+	if(hasTransits)
+	{
+		for(CsrGraph::NodeIt n(graph); n != lemon::INVALID; ++n)
+		{
+			Node partner = transitPartners[toResidual(n)];
+			if(partner == lemon::INVALID)
+				continue;
+			transitPartnerMap.set(n, toCsr(partner));
+			transitLengthMap.set(n, transitLengths[toResidual(n)]);
+		}
+		bf.nodeTransits(transitPartnerMap, transitLengthMap);
+	}
+
+	process.reserve(graph.nodeNum());
+	nextProcess.reserve(graph.nodeNum());
+	dirtyNodes.reserve(graph.nodeNum());
+	bf.distMap(distMap);
+	bf.predMap(predMap);
+}
+
+std::vector<ResidualGraph::Node> ResidualGraph::negativeCycleNodes() const
+{
+	if(!csr_)
+		return bf.negativeCycleNodes();
+
+	std::vector<Node> cycle;
+	for(const CsrGraph::Node& n : csr_->bf.negativeCycleNodes())
+		cycle.push_back(csr_->toResidual(n));
+	return cycle;
+}
+
+std::vector<ResidualGraph::ShortestPathResult> ResidualGraph::collectDisjointTreePaths(
+	const ShortestPathResult& shortestPath,
+	const std::vector<OriginalNode>& origTargets,
+	const std::vector<int>& conflictKeys,
+	size_t maxNumPaths,
+	double minCostRatio) const
+{
+	std::vector<ShortestPathResult> paths(1, shortestPath);
+
+	// after a negative cycle the tree is not valid
+	if(firstPath_ || cycleRepairPending_ || maxNumPaths < 2)
+		return paths;
+
+	if(conflictKeyStamps_.size() < conflictKeys.size())
+		conflictKeyStamps_.resize(conflictKeys.size(), 0);
+	if(++conflictKeyStamp_ == 0)
+	{
+		// after an overflow old stamps could be mistaken for current ones
+		std::fill(conflictKeyStamps_.begin(), conflictKeyStamps_.end(), 0);
+		conflictKeyStamp_ = 1;
+	}
+
+	// whether a node of the arc has a key used by a selected path, and marking all keys of a selected path
+	auto conflicts = [&](const OriginalArc& a)
+	{
+		int sourceKey = conflictKeys[originalGraph_.id(originalGraph_.source(a))];
+		int targetKey = conflictKeys[originalGraph_.id(originalGraph_.target(a))];
+		return (sourceKey >= 0 && conflictKeyStamps_[sourceKey] == conflictKeyStamp_)
+			|| (targetKey >= 0 && conflictKeyStamps_[targetKey] == conflictKeyStamp_);
+	};
+	auto markKeys = [&](const Path& p)
+	{
+		for(const std::pair<OriginalArc, int>& af : p)
+		{
+			for(const OriginalNode& n : {originalGraph_.source(af.first), originalGraph_.target(af.first)})
+			{
+				int key = conflictKeys[originalGraph_.id(n)];
+				if(key >= 0)
+					conflictKeyStamps_[key] = conflictKeyStamp_;
+			}
+		}
+	};
+	markKeys(shortestPath.first);
+
+	std::vector<Node> targets;
+	for(auto ot : origTargets)
+		targets.push_back(residualNode(ot));
+	auto isTarget = [&](const Node& n){ return std::find(targets.begin(), targets.end(), n) != targets.end(); };
+
+	// the last arcs of all negative paths that are cheap enough, the one of the shortest path is taken already
+	double maxCost = std::min(0.0, minCostRatio * shortestPath.second);
+	treePathCandidates_.clear();
+	for(const Node& target : targets)
+	{
+		for(Graph::InArcIt ia(*this, target); ia != lemon::INVALID; ++ia)
+		{
+			Node u = this->source(ia);
+			double cost = shortestPathDist(u) + residualDistMap_[ia];
+			if(!shortestPathReached(u) || isTarget(u) || !(cost < 0.0 && cost <= maxCost)
+				|| Arc(ia) == shortestPathPredArc(target))
+				continue;
+			treePathCandidates_.push_back(std::make_pair(cost, Arc(ia)));
+		}
+	}
+	std::stable_sort(treePathCandidates_.begin(), treePathCandidates_.end(), 
+		[](const std::pair<double, Arc>& a, const std::pair<double, Arc>& b){ return a.first < b.first; });
+
+	for(const std::pair<double, Arc>& candidate : treePathCandidates_)
+	{
+		if(paths.size() >= maxNumPaths)
+			break;
+
+		Path p;
+		bool valid = true;
+		Token violatedToken = NoToken;
+		beginTokenCheck();
+		Node n = lemon::INVALID;
+		for(Arc a = candidate.second; valid && a != lemon::INVALID; a = shortestPathPredArc(n))
+		{
+			if(a != candidate.second && isTarget(this->target(a)))
+				valid = false;
+			const ArcOrigin& arcForward = residualArcToOriginalArc(a);
+			p.push_back(pathStep(a));
+			// the tree cannot be longer than the number of nodes, anything else is a stale loop
+			valid = valid && checkArcTokens(indexOfResidualArc(a), violatedToken)
+				&& p.size() <= originMap_.size()
+				&& !conflicts(arcForward.first);
+			n = crossTransit(this->source(a), violatedToken);
+			valid = valid && violatedToken == NoToken;
+		}
+
+		if(valid)
+		{
+			markKeys(p);
+			paths.push_back(std::make_pair(p, candidate.first));
+		}
+	}
+	return paths;
+}
+
+void ResidualGraph::initShortestPathSearch()
+{
+	if(csr_)
+	{
+		csr_->bf.init();
+		if(useOrderedNodeListInBF_)
+			csr_->bf.addSource(csr_->toCsr(source_), csr_->nodeOrderMap);
+		else
+			csr_->bf.addSource(csr_->toCsr(source_));
+	}
+	else
+	{
+		bf.init();
+	    if(useOrderedNodeListInBF_)
+	    	bf.addSource(source_, nodeUpdateOrderMap_);
+	   	else
+	   		bf.addSource(source_);
+	}
+}
+
+void ResidualGraph::collectSearchCounters()
+{
+	lastSearchStats_.bfRounds = csr_ ? csr_->bf.numRounds() : bf.numRounds();
+	lastSearchStats_.relaxations = csr_ ? csr_->bf.numRelaxations() : bf.numRelaxations();
+}
+
+void ResidualGraph::markUnsoundDistances()
+{
+	// walk the shortest path tree from the source, treating its distance as zero again. A distance is only
+	// an upper bound of the cost of its tree path if it is at least the distance of the tree parent plus
+	// the arc cost, otherwise it stems from a negative distance of the source and the subtree is dropped.
+	// Nodes on cycles of the predecessor map are never reached from the source.
+	soundDistance_.assign(maxNodeId() + 1, 0);
+	soundDistance_[id(source_)] = 1;
+	treeWalk_.assign(1, source_);
+	while(!treeWalk_.empty())
+	{
+		Node u = treeWalk_.back();
+		treeWalk_.pop_back();
+		double dist = u == source_ ? 0.0 : shortestPathDist(u);
+		for(OutArcIt a(*this, u); a != lemon::INVALID; ++a)
+		{
+			Node v = this->target(a);
+			if(soundDistance_[id(v)] || shortestPathPredArc(v) != a)
+				continue;
+			if(shortestPathDist(v) >= dist + residualDistMap_[a])
+			{
+				soundDistance_[id(v)] = 1;
+				treeWalk_.push_back(v);
+			}
+		}
+
+		// the other side of a detection node is a tree child as well if it was reached over the transit
+		Node partner = transitPartnerMap_[u];
+		if(partner != lemon::INVALID && !soundDistance_[id(partner)] && shortestPathPredTransit(partner)
+			&& shortestPathDist(partner) >= dist + transitLengthMap_[u])
+		{
+			soundDistance_[id(partner)] = 1;
+			treeWalk_.push_back(partner);
+		}
+	}
+
+	dirtyNodes_.push_back(source_);
+	for(NodeIt n(*this); n != lemon::INVALID; ++n)
+	{
+		if(!soundDistance_[id(n)] && (shortestPathPredArc(n) != lemon::INVALID || shortestPathPredTransit(n)))
+			dirtyNodes_.push_back(n);
+	}
 }
 
 /// find a shortest path or a negative cost cycle, and return it with flow direction and cost
@@ -66,26 +401,40 @@ ResidualGraph::ShortestPathResult ResidualGraph::findShortestPath(
 
 	Path p;
 	double pathCost = 0.0;
-	int flow = 0;
 	std::pair<bool, Token> ret = std::make_pair(true, 0);
+	lastSearchStats_ = SearchStats();
+	if(csr_)
+		csr_->bf.resetCounters();
+	else
+		bf.resetCounters();
 
 	do{
 		// if the last path found a token violation, we'll remove the back arc of the mother for this iteration
+		// and search again. The tokens are checked while the path is extracted, without copying them
 		if(!ret.first)
 		{
 			DEBUG_MSG("Retrying to find shortest path..." << ret.second);
+			lastSearchStats_.tokenRetries++;
 			OriginalNode n = originalGraph_.nodeFromId(ret.second);
 			if(n == lemon::INVALID)
 				throw std::runtime_error("Could not find original arc that violated the token specs!");
 
-			// this should only be exactly one
-			for(Graph::InArcIt a(originalGraph_, n); a != lemon::INVALID; ++a)
+			if(isDetectionNode(n))
 			{
-				DEBUG_MSG("Disabling in-arc " << originalGraph_.id(originalGraph_.source(a)) << " -> " << ret.second);
-				ResidualArcCandidate ac = arcToInversePair(a);
-				ResidualArcProperties& arcProps = residualArcMap_[ac];
-				arcProps.enabled = false;
-				includeArc(ac, arcProps);
+				// the token is forbidden by the backward transit of the detection itself
+				DEBUG_MSG("Disabling backward transit of " << ret.second);
+				residualArcs_[transitIndex(n, Backward)].enabled = false;
+				includeTransit(n, Backward);
+			}
+			else
+			{
+				// this should only be exactly one
+				for(Graph::InArcIt a(originalGraph_, n); a != lemon::INVALID; ++a)
+				{
+					DEBUG_MSG("Disabling in-arc " << originalGraph_.id(originalGraph_.source(a)) << " -> " << ret.second);
+					residualArcs_[residualArcIndex(a, Backward)].enabled = false;
+					includeArc(a, Backward);
+				}
 			}
 
 			DEBUG_MSG("Searching shortest path in graph with " << lemon::countNodes(*this)
@@ -93,20 +442,66 @@ ResidualGraph::ShortestPathResult ResidualGraph::findShortestPath(
 		}
 
     	// prepare for new iteration
+    	Token violatedToken = NoToken;
+    	beginTokenCheck();
     	TimePoint iterationInitTime = std::chrono::high_resolution_clock::now();
-		if(firstPath_ or !partialBFUpdates)
+		bool solvedWithoutBF = false;
+		lastSearchStats_.dirtyNodes += dirtyNodes_.size();
+		if(firstPath_ or !partialBFUpdates or useDijkstra_)
 		{
 			firstPath_ = false;
-			bf.init();
-		    if(useOrderedNodeListInBF_)
-		    	bf.addSource(source_, nodeUpdateOrderMap_);
-		   	else
-		   		bf.addSource(source_);
+			cycleRepairPending_ = false;
+			initShortestPathSearch();
+
+			// without backward arcs the residual graph is a DAG ordered by timesteps,
+			// so a single sweep over the timesteps yields the exact distances
+			if(numActiveBackwardArcs_ == 0)
+			{
+				solvedWithoutBF = csr_ ? csr_->bf.layeredStart(csr_->nodeOrderMap) 
+									   : bf.layeredStart(nodeUpdateOrderMap_);
+				if(!solvedWithoutBF)
+				{
+					DEBUG_MSG("Residual graph is not ordered by timesteps, falling back to Bellman-Ford");
+					initShortestPathSearch();
+				}
+			}
+
+			// the distances of the last search are potentials that make most reduced arc costs non-negative,
+			// only nodes behind arcs that were toggled or reversed since then have to be scanned again
+			if(!solvedWithoutBF && useDijkstra_)
+			{
+				solvedWithoutBF = csr_ ? csr_->bf.potentialStart(csr_->potentialMap, DijkstraScansPerNode * csr_->graph.nodeNum())
+									   : bf.potentialStart(potentialMap_, DijkstraScansPerNode * lemon::countNodes(*this));
+				// at the scan limit Bellman-Ford continues from the nodes Dijkstra had to scan again,
+				// only a cycle through the source needs a search from scratch
+				if(!solvedWithoutBF && shortestPathPredArc(source_) != lemon::INVALID)
+				{
+					DEBUG_MSG("Dijkstra found a negative cycle through the source, falling back to Bellman-Ford");
+					initShortestPathSearch();
+				}
+				else if(!solvedWithoutBF)
+				{
+					DEBUG_MSG("Dijkstra exceeded its scan limit, Bellman-Ford continues from its distances");
+				}
+			}
 		}
 		else if(!dirtyNodes_.empty())
 		{
-			DEBUG_MSG("Running BF Update for " << dirtyNodes_.size() << " nodes");
-			bf.update(dirtyNodes_, nodeUpdateOrderMap_);
+			// after a negative cycle the search stopped early, so the nodes it did not process yet
+			// have to be processed as well
+			DEBUG_MSG("Running BF Update for " << dirtyNodes_.size() << " nodes"
+				<< (cycleRepairPending_ ? " after a negative cycle" : ""));
+			lastSearchStats_.cycleRepair = lastSearchStats_.cycleRepair || cycleRepairPending_;
+			if(csr_)
+			{
+				csr_->dirtyNodes.clear();
+				for(const Node& n : dirtyNodes_)
+					csr_->dirtyNodes.push_back(csr_->toCsr(n));
+				csr_->bf.update(csr_->dirtyNodes, csr_->nodeOrderMap, cycleRepairPending_);
+			}
+			else
+				bf.update(dirtyNodes_, nodeUpdateOrderMap_, cycleRepairPending_);
+			cycleRepairPending_ = false;
 		}
 		dirtyNodes_.clear();
 	    
@@ -115,11 +510,12 @@ ResidualGraph::ShortestPathResult ResidualGraph::findShortestPath(
 		// * checking for negative cycles each round brings runtime down to 82 secs
 		// * checking for negative cycles every 100 iterations yields runtime of 53secs!
 		// BUT: the number of paths found changes, which means we are not finding the same things... (different negative cycles?)
+		// Now BF maintains its shortest path tree and stops in the round that closes a cycle, without periodic checks.
 		TimePoint iterationStartTime = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> elapsed_seconds = iterationStartTime - iterationInitTime;
 		DEBUG_MSG("initializing BF took " << elapsed_seconds.count() << " secs");
 		
-		bool foundPath = bf.checkedStart(300, 0);
+		bool foundPath = solvedWithoutBF || (csr_ ? csr_->bf.checkedStart() : bf.checkedStart());
 		TimePoint iterationEndTime = std::chrono::high_resolution_clock::now();
 		elapsed_seconds = iterationEndTime - iterationStartTime;
 		DEBUG_MSG("BF took " << elapsed_seconds.count() << " secs");
@@ -127,38 +523,49 @@ ResidualGraph::ShortestPathResult ResidualGraph::findShortestPath(
 		if(foundPath)
 	    {	
 	    	DEBUG_MSG("Found path");
+	    	if(useDijkstra_)
+	    	{
+	    		if(csr_)
+	    			csr_->bf.updatePotentials(csr_->potentialMap);
+	    		else
+	    			bf.updatePotentials(potentialMap_);
+	    	}
 
 	    	// we are fine if we reach any target, use the one with the lowest cost
 	    	std::vector<double> targetDistances;
 	    	for(auto ot : origTargets)
 	    	{
-		    	Node target = residualNodeMap_.at(ot);
-		    	targetDistances.push_back(bf.dist(target));
+		    	Node target = residualNode(ot);
+		    	targetDistances.push_back(shortestPathDist(target));
 		    }
 
 		    size_t targetIndex = std::distance(targetDistances.begin(), std::min_element(targetDistances.begin(), targetDistances.end()));
-		    Node target = residualNodeMap_.at(origTargets[targetIndex]);
+		    Node target = residualNode(origTargets[targetIndex]);
 
 	    	// found path
-	        if(bf.reached(target))
+	        if(shortestPathReached(target))
 	        {
-	        	pathCost = bf.dist(target);
-	        	for(Arc a = bf.predArc(target); a != lemon::INVALID; a = bf.predArc(this->source(a)))
+	        	pathCost = shortestPathDist(target);
+	        	Node n = crossTransit(target, violatedToken);
+	        	for(Arc a = shortestPathPredArc(n); a != lemon::INVALID; a = shortestPathPredArc(n))
 	            {
 	            	DEBUG_MSG("\t residual arc (" << id(this->source(a)) << ", " << id(this->target(a)) << ")");
-	            	std::pair<Arc, bool> arcForward = pairToOriginalArc(residualArcToPair(a));
-	            	flow = arcForward.second ? 1 : -1;
-	            	if(std::find(p.begin(), p.end(), std::make_pair(arcForward.first, flow)) != p.end())
+	            	const std::pair<OriginalArc, int> step = pathStep(a);
+	            	// keep extracting after a violation, loops are reported first
+	            	checkArcTokens(indexOfResidualArc(a), violatedToken);
+	            	if(std::find(p.begin(), p.end(), step) != p.end())
 	            	{
 	            		// throw std::runtime_error("Found loop in path!");
 	            		DEBUG_MSG("Found loop in path!");
-	            		p.push_back(std::make_pair(arcForward.first, flow));
+	            		p.push_back(step);
+	            		collectSearchCounters();
 	            		return std::make_pair(p, std::numeric_limits<double>::infinity());
 	            		// p.clear();
 	            		// foundPath = false;
 	            		// break;
 	            	}
-	                p.push_back(std::make_pair(arcForward.first, flow));
+	                p.push_back(step);
+	                n = crossTransit(this->source(a), violatedToken);
 	            }
 	        }
 	        else
@@ -168,29 +575,43 @@ ResidualGraph::ShortestPathResult ResidualGraph::findShortestPath(
 	    {
 	    	DEBUG_MSG("Found cycle");
 	    	// found cycle
-	    	lemon::Path<ResidualGraph> path = bf.negativeCycle();
-	    	ResidualArcCandidate ac;
-	    	for(lemon::Path<ResidualGraph>::ArcIt a(path); a != lemon::INVALID; ++a)
+	    	for(const Node& n : negativeCycleNodes())
 	        {
+	        	// the transit into the node has no arc and no path step, only its cost and tokens
+	        	if(shortestPathPredTransit(n))
+	        	{
+	        		Node partner = transitPartnerMap_[n];
+	        		DEBUG_MSG("\t transit (" << id(partner) << ", " << id(n) << ")");
+	        		pathCost += transitLengthMap_[partner];
+	        		checkArcTokens(transitIndexInto(n), violatedToken);
+	        		continue;
+	        	}
+
+	        	Arc a = shortestPathPredArc(n);
 	        	DEBUG_MSG("\t residual arc (" << id(this->source(a)) << ", " << id(this->target(a)) << ")");
-	        	ac = residualArcToPair(a);
-	        	pathCost += residualArcMap_.at(ac).cost;
-	            std::pair<Arc, bool> arcForward = pairToOriginalArc(ac);
-	        	flow = arcForward.second ? 1 : -1;
-	            p.push_back(std::make_pair(arcForward.first, flow));
+	        	pathCost += residualDistMap_[a];
+	            p.push_back(pathStep(a));
+	            checkArcTokens(indexOfResidualArc(a), violatedToken);
 	        }
 
-	        // we need to initialize BF again from scratch, as a neg weight cycle 
-	        // invalidates most of the distance map
-	        firstPath_ = true;
+	        // a neg weight cycle invalidates the distances of all nodes behind it, so either
+	        // invalidate just those or initialize BF again from scratch
+	        if(localCycleRepair_ && partialBFUpdates && !useDijkstra_)
+	        {
+	        	markUnsoundDistances();
+	        	cycleRepairPending_ = true;
+	        }
+	        else
+	        	firstPath_ = true;
 	    }
+	    lastSearchStats_.negativeCycle = !foundPath;
 
 	    TimePoint pathExtractionTime = std::chrono::high_resolution_clock::now();
 		elapsed_seconds = pathExtractionTime - iterationEndTime;
 		DEBUG_MSG("extracting path took " << elapsed_seconds.count() << " secs");
 
 		// analyze the new path
-	    ret = pathSatisfiesTokenSpecs(p);
+	    ret = std::make_pair(violatedToken == NoToken, violatedToken);
 	    if(!ret.first)
 	    {
 	    	DEBUG_MSG("############## Found path that violates the token specs! " << ret.second);
@@ -199,35 +620,54 @@ ResidualGraph::ShortestPathResult ResidualGraph::findShortestPath(
 	    }
 	} while(!ret.first);
 
+	collectSearchCounters();
     return std::make_pair(p, pathCost);
 }
 
-std::pair<bool, ResidualGraph::Token> ResidualGraph::pathSatisfiesTokenSpecs(const Path& p) const
+void ResidualGraph::collectMemoryStatistics(MemoryStatistics& stats) const
 {
-	TokenSet collectedTokens;
-	TokenSet forbiddenTokens;
-	// walk in reverse order as we build the path back to front in findShortestPath()
-	for(auto af = p.rbegin(); af != p.rend(); ++af)
-	{
-		Arc a = af->first;
-		bool forward = af->second > 0;
-		ResidualArcCandidate ac = undirectedArcToPair(a, forward);
-		const TokenSet& arcForbiddenTokens = residualArcForbidsTokens_.at(ac);
-		const TokenSet& providedTokens = residualArcProvidesTokens_.at(ac);
-
-		// update collected tokens
-		collectedTokens.insert(providedTokens.begin(), providedTokens.end());
-		forbiddenTokens.insert(arcForbiddenTokens.begin(), arcForbiddenTokens.end());
-	}
-
-	// no forbidden token is allowed in collected
-	for(Token t : collectedTokens)
+	const std::string structure("ResidualGraph");
+	stats.addStructure(structure, lemon::countNodes(*this), lemon::countArcs(*this));
+	stats.addListDigraph(structure, *this);
+	stats.addItemMap<double>(structure, "residualDistMap", maxArcId());
+	stats.addVector(structure, "originMap", originMap_);
+	stats.addVector(structure, "residualNodeMap", residualNodeMap_);
+	stats.addVector(structure, "residualArcs", residualArcs_);
+	stats.addVector(structure, "residualArcOriginMap", residualArcOriginMap_);
+	stats.addVector(structure, "sharedArcSlots", sharedArcSlots_);
+	stats.addVector(structure, "sharedArcSources", sharedArcSources_);
+	stats.addVector(structure, "detectionSlots", detectionSlots_);
+	stats.addVector(structure, "detectionOutNodes", detectionOutNodes_);
+	stats.addItemMap<Node>(structure, "transitPartnerMap", maxNodeId());
+	stats.addItemMap<double>(structure, "transitLengthMap", maxNodeId());
+	stats.addVector(structure, "residualArcProvidesToken", residualArcProvidesToken_);
+	stats.addVector(structure, "residualArcForbidsToken", residualArcForbidsToken_);
+	stats.addVector(structure, "providedTokenStamps", providedTokenStamps_);
+	stats.addVector(structure, "forbiddenTokenStamps", forbiddenTokenStamps_);
+	// the iterable value map keeps its nodes in a doubly linked list per value
+	stats.addContainer(structure, "nodeUpdateOrderMap", size_t(maxNodeId() + 1), 
+		size_t(maxNodeId() + 1) * (sizeof(size_t) + 2 * sizeof(int)));
+	stats.addItemMap<double>(structure, "bfDistMap", maxNodeId());
+	stats.addItemMap<Arc>(structure, "bfPredMap", maxNodeId());
+	stats.addItemMap<double>(structure, "potentialMap", maxNodeId());
+	stats.addVector(structure, "bfProcess", bfProcess_);
+	stats.addVector(structure, "bfNextProcess", bfNextProcess_);
+	stats.addContainer(structure, "bellmanFordWork", 0, bf.workBytes());
+	stats.addVector(structure, "dirtyNodes", dirtyNodes_);
+	stats.addVector(structure, "soundDistance", soundDistance_);
+	stats.addVector(structure, "treeWalk", treeWalk_);
+
+	if(csr_)
 	{
-		if(forbiddenTokens.count(t) > 0)
-			return std::make_pair(false, t);
+		size_t numNodes = size_t(csr_->graph.nodeNum());
+		size_t numArcs = size_t(csr_->graph.arcNum());
+		stats.addContainer(structure, "csrGraph", numArcs, csr_->graph.memoryBytes());
+		stats.addContainer(structure, "csrMaps", numNodes + numArcs, 
+			numArcs * sizeof(double) + numNodes * (3 * sizeof(double) + sizeof(CsrGraph::Arc) + sizeof(CsrGraph::Node)));
+		stats.addContainer(structure, "csrProcess", csr_->process.size() + csr_->nextProcess.size() + csr_->dirtyNodes.size(),
+			(csr_->process.capacity() + csr_->nextProcess.capacity() + csr_->dirtyNodes.capacity()) * sizeof(CsrGraph::Node));
+		stats.addContainer(structure, "csrBellmanFordWork", 0, csr_->bf.workBytes());
 	}
-
-	return std::make_pair(true, 0);
 }
 
 void ResidualGraph::fullGraphToDot(const std::string& filename, const Path& p) const
@@ -250,14 +690,18 @@ void ResidualGraph::fullGraphToDot(const std::string& filename, const Path& p) c
 	// arcs
 	for(Graph::ArcIt a(*this); a != lemon::INVALID; ++a)
 	{
-		ResidualArcCandidate ac = residualArcToPair(a);
+		// skip inactive static arcs
+		if(residualDistMap_[a] == std::numeric_limits<double>::infinity())
+			continue;
+
+		const ArcOrigin& origin = residualArcToOriginalArc(a);
 		out_file << "\t" << id(source(a)) << " -> " << id(target(a)) << " [ label=\"" 
-			<< "cost=" << residualArcMap_.at(ac).cost << "\" ";
+			<< "cost=" << residualDistMap_[a] << "\" ";
 
 		// highlight arcs on the given path
 		for(const std::pair<OriginalArc, int>& af : p)
 		{
-			if(ac == arcToPair(af.first) || ac == arcToInversePair(af.first))
+			if(af.first == origin.first)
 				out_file << "color=\"red\" fontcolor=\"red\" ";
 		}
 
@@ -282,33 +726,38 @@ void ResidualGraph::toDot(const std::string& filename, const Path& p, Node& s, N
     std::set<Node> nodesOnPath;
     for(const std::pair<OriginalArc, int>& af : p)
 	{
-		ResidualArcCandidate ac = arcToPair(af.first);
-		nodesOnPath.insert(ac.first);
-		nodesOnPath.insert(ac.second);
+		nodesOnPath.insert(residualOutNode(originalGraph_.source(af.first)));
+		nodesOnPath.insert(residualNode(originalGraph_.target(af.first)));
 	}
 
 	// arcs
 	for(Graph::ArcIt a(*this); a != lemon::INVALID; ++a)
 	{
-		ResidualArcCandidate ac = residualArcToPair(a);
+		// skip inactive static arcs
+		if(residualDistMap_[a] == std::numeric_limits<double>::infinity())
+			continue;
+
+		Node as = source(a);
+		Node at = target(a);
 
 		// only draw arcs that are close to the path
-		if(nodesOnPath.count(ac.first) == 0 && nodesOnPath.count(ac.second) == 0)
+		if(nodesOnPath.count(as) == 0 && nodesOnPath.count(at) == 0)
 			continue;
 		// only draw arcs that are not connected to source or sink
-		if(ac.first == s || ac.first == t || ac.first == s || ac.second == t)
+		if(as == s || as == t || at == s || at == t)
 			continue;
 
-		out_file << "\t" << id(ac.first) << " -> " << id(ac.second) << " [ label=\"" 
-			<< "cost=" << residualArcMap_.at(ac).cost
-			<< " originSource=" << originalGraph_.id(originMap_.at(ac.first))
-			<< " originTarget=" << originalGraph_.id(originMap_.at(ac.second))
+		out_file << "\t" << id(as) << " -> " << id(at) << " [ label=\"" 
+			<< "cost=" << residualDistMap_[a]
+			<< " originSource=" << originalGraph_.id(originNode(as))
+			<< " originTarget=" << originalGraph_.id(originNode(at))
 			<< "\" ";
 
 		// highlight arcs on the given path
+		const ArcOrigin& origin = residualArcToOriginalArc(a);
 		for(const std::pair<OriginalArc, int>& af : p)
 		{
-			if(ac == arcToPair(af.first) || ac == arcToInversePair(af.first))
+			if(af.first == origin.first)
 				out_file << "color=\"red\" fontcolor=\"red\" ";
 		}
 
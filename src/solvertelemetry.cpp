@@ -0,0 +1,122 @@
+#include "solvertelemetry.h"
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace dpct
+{
+
+const std::vector<std::string>& SolverTelemetry::getColumnNames()
+{
+	static const std::vector<std::string> columnNames = {"iteration", "seconds", "searchSeconds", "augmentSeconds", 
+		"bfRounds", "relaxations", "dirtyNodes", "arcsToggled", "tokenRetries", "negativeCycles", 
+		"cycleRepairs", "numPaths", "pathLength", "pathCost", "energy"};
+	return columnNames;
+}
+
+std::vector<double> SolverTelemetry::getColumnValues(const IterationTelemetry& it)
+{
+	return {double(it.iteration), it.seconds, it.searchSeconds, it.augmentSeconds, 
+		double(it.bfRounds), double(it.relaxations), double(it.dirtyNodes), double(it.arcsToggled), 
+		double(it.tokenRetries), double(it.negativeCycles), double(it.cycleRepairs), double(it.numPaths), double(it.pathLength), 
+		it.pathCost, it.energy};
+}
+
+IterationTelemetry SolverTelemetry::getTotals() const
+{
+	IterationTelemetry totals;
+	for(const IterationTelemetry& it : iterations_)
+	{
+		totals.seconds += it.seconds;
+		totals.searchSeconds += it.searchSeconds;
+		totals.augmentSeconds += it.augmentSeconds;
+		totals.bfRounds += it.bfRounds;
+		totals.relaxations += it.relaxations;
+		totals.dirtyNodes += it.dirtyNodes;
+		totals.arcsToggled += it.arcsToggled;
+		totals.tokenRetries += it.tokenRetries;
+		totals.negativeCycles += it.negativeCycles;
+		totals.cycleRepairs += it.cycleRepairs;
+		totals.numPaths += it.numPaths;
+		// the final search of a solver finds no improving path, whose cost may be infinite
+		if(it.numPaths > 0)
+		{
+			totals.pathLength += it.pathLength;
+			totals.pathCost += it.pathCost;
+		}
+	}
+	if(!iterations_.empty())
+	{
+		totals.iteration = iterations_.back().iteration;
+		totals.energy = iterations_.back().energy;
+	}
+	return totals;
+}
+
+void SolverTelemetry::writeCsv(std::ostream& out) const
+{
+	std::streamsize precision = out.precision(std::numeric_limits<double>::digits10);
+	const std::vector<std::string>& names = getColumnNames();
+	for(size_t i = 0; i < names.size(); i++)
+		out << (i > 0 ? "," : "") << names[i];
+	out << "\n";
+
+	for(const IterationTelemetry& it : iterations_)
+	{
+		std::vector<double> values = getColumnValues(it);
+		for(size_t i = 0; i < values.size(); i++)
+			out << (i > 0 ? "," : "") << values[i];
+		out << "\n";
+	}
+	out.precision(precision);
+}
+
+void SolverTelemetry::writeJson(std::ostream& out) const
+{
+	auto writeObject = [&](const IterationTelemetry& it)
+	{
+		const std::vector<std::string>& names = getColumnNames();
+		std::vector<double> values = getColumnValues(it);
+		out << "{";
+		for(size_t i = 0; i < values.size(); i++)
+		{
+			// JSON has no infinity
+			out << (i > 0 ? ", " : "") << "\"" << names[i] << "\": ";
+			if(std::isfinite(values[i]))
+				out << values[i];
+			else
+				out << "null";
+		}
+		out << "}";
+	};
+
+	std::streamsize precision = out.precision(std::numeric_limits<double>::digits10);
+	out << "{\n\t\"solver\": \"" << solver_ << "\",\n\t\"setupSeconds\": " << setupSeconds_ << ",\n\t\"totals\": ";
+	writeObject(getTotals());
+	out << ",\n\t\"iterations\": [";
+	for(size_t i = 0; i < iterations_.size(); i++)
+	{
+		out << (i > 0 ? ",\n\t\t" : "\n\t\t");
+		writeObject(iterations_[i]);
+	}
+	out << "\n\t]\n}\n";
+	out.precision(precision);
+}
+
+void SolverTelemetry::save(const std::string& filename) const
+{
+	std::ofstream out(filename.c_str());
+	if(!out.good())
+		throw std::runtime_error("Could not open telemetry file for writing: " + filename);
+
+	const std::string jsonExtension(".json");
+	if(filename.size() >= jsonExtension.size() 
+		&& filename.compare(filename.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0)
+		writeJson(out);
+	else
+		writeCsv(out);
+}
+
+} // end namespace dpct
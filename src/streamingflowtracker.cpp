@@ -0,0 +1,147 @@
+#include "streamingflowtracker.h"
+#include "log.h"
+
+#include <stdexcept>
+
+namespace dpct
+{
+
+StreamingFlowTracker::StreamingFlowTracker(size_t windowSize, ResultCallback resultCallback):
+	windowSize_(windowSize),
+	resultCallback_(resultCallback),
+	numThreads_(1),
+	committedEnergy_(0.0)
+{
+	if(windowSize_ == 0)
+		throw std::runtime_error("The tracking window must contain at least one timestep");
+}
+
+void StreamingFlowTracker::addNode(
+	size_t id,
+	const CostDeltaVector& detectionCosts,
+	const CostDeltaVector& detectionCostDeltas,
+	const CostDeltaVector& appearanceCostDeltas,
+	const CostDeltaVector& disappearanceCostDeltas,
+	size_t targetIdx)
+{
+	if(idToTimestepsMap_.find(id) == idToTimestepsMap_.end())
+		throw std::runtime_error("Node timesteps must be set for streaming tracking");
+
+	size_t timestep = idToTimestepsMap_[id].second;
+	if(!idsPerTimestep_.empty() && timestep < idsPerTimestep_.begin()->first)
+		throw std::runtime_error("Cannot add a node to a timestep that was committed already");
+
+	FlowGraph::FullNode n = graph_.addNode(detectionCostDeltas, timestep);
+	idToFlowGraphNodeMap_[id] = n;
+	idsPerTimestep_[timestep].push_back(id);
+
+	if(appearanceCostDeltas.size() > 0)
+		graph_.addArc(graph_.getSource(), n.u, appearanceCostDeltas);
+
+	if(disappearanceCostDeltas.size() > 0)
+		graph_.addArc(n.v, graph_.getTarget(targetIdx), disappearanceCostDeltas);
+}
+
+void StreamingFlowTracker::addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas)
+{
+	if(idToFlowGraphNodeMap_.find(srcId) == idToFlowGraphNodeMap_.end())
+		throw std::runtime_error("Trying to add link but source node is not present in the window");
+	if(idToFlowGraphNodeMap_.find(destId) == idToFlowGraphNodeMap_.end())
+		throw std::runtime_error("Trying to add link but destination node is not present in the window");
+
+	FlowGraph::Arc a = graph_.addArc(idToFlowGraphNodeMap_[srcId], idToFlowGraphNodeMap_[destId], costDeltas);
+	idToOutLinksMap_[srcId].push_back(std::make_pair(destId, a));
+}
+
+void StreamingFlowTracker::allowMitosis(size_t id, ValueType divisionCostDelta)
+{
+	if(idToFlowGraphNodeMap_.find(id) == idToFlowGraphNodeMap_.end())
+		throw std::runtime_error("Trying to allow division but node is not present in the window");
+
+	idToFlowGraphDivisionArcMap_[id] = graph_.allowMitosis(idToFlowGraphNodeMap_[id], divisionCostDelta);
+}
+
+double StreamingFlowTracker::finishTimestep(size_t timestep)
+{
+	graph_.maxFlowMinCostRetracking(0.0, true, 0, true, true, false, false, numThreads_);
+
+	while(!idsPerTimestep_.empty() && idsPerTimestep_.begin()->first + windowSize_ <= timestep)
+		commitOldestTimestep();
+
+	return getEnergy();
+}
+
+void StreamingFlowTracker::flush()
+{
+	while(!idsPerTimestep_.empty())
+		commitOldestTimestep();
+}
+
+void StreamingFlowTracker::commitOldestTimestep()
+{
+	const FlowGraph::FlowMap& flowMap = graph_.getFlowMap();
+	TimestepResult result;
+	result.timestep = idsPerTimestep_.begin()->first;
+	std::vector<FlowGraph::FullNode> nodes;
+
+	for(size_t id : idsPerTimestep_.begin()->second)
+	{
+		FlowGraph::FullNode n = idToFlowGraphNodeMap_[id];
+		nodes.push_back(n);
+		result.nodeValues[id] = flowMap[n.a];
+
+		auto divisionIt = idToFlowGraphDivisionArcMap_.find(id);
+		if(divisionIt != idToFlowGraphDivisionArcMap_.end())
+		{
+			result.divisionValues[id] = flowMap[divisionIt->second] == 1;
+			idToFlowGraphDivisionArcMap_.erase(divisionIt);
+		}
+
+		auto linksIt = idToOutLinksMap_.find(id);
+		if(linksIt != idToOutLinksMap_.end())
+		{
+			for(const std::pair<size_t, FlowGraph::Arc>& link : linksIt->second)
+				result.arcValues[std::make_pair(id, link.first)] = graph_.getLinkFlow(link.second);
+			idToOutLinksMap_.erase(linksIt);
+		}
+
+		idToFlowGraphNodeMap_.erase(id);
+		idToTimestepsMap_.erase(id);
+	}
+	idsPerTimestep_.erase(idsPerTimestep_.begin());
+
+	committedEnergy_ += graph_.freezeNodes(nodes);
+	DEBUG_MSG("Committed timestep " << result.timestep << ", energy of committed timesteps: " << committedEnergy_);
+
+	if(resultCallback_)
+		resultCallback_(result);
+}
+
+GraphBuilder::NodeValueMap StreamingFlowTracker::getNodeValues()
+{
+	NodeValueMap nodeValueMap;
+	for(auto iter : idToFlowGraphNodeMap_)
+		nodeValueMap[iter.first] = graph_.getFlowMap()[iter.second.a];
+	return nodeValueMap;
+}
+
+GraphBuilder::ArcValueMap StreamingFlowTracker::getArcValues()
+{
+	ArcValueMap arcValueMap;
+	for(auto iter : idToOutLinksMap_)
+	{
+		for(const std::pair<size_t, FlowGraph::Arc>& link : iter.second)
+			arcValueMap[std::make_pair(iter.first, link.first)] = graph_.getLinkFlow(link.second);
+	}
+	return arcValueMap;
+}
+
+GraphBuilder::DivisionValueMap StreamingFlowTracker::getDivisionValues()
+{
+	DivisionValueMap divisionValueMap;
+	for(auto iter : idToFlowGraphDivisionArcMap_)
+		divisionValueMap[iter.first] = graph_.getFlowMap()[iter.second] == 1;
+	return divisionValueMap;
+}
+
+} // end namespace dpct
@@ -0,0 +1,741 @@
+#include "temporalblockflowgraphbuilder.h"
+#include "flowgraphbuilder.h"
+#include "log.h"
+#include "json/json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+namespace dpct
+{
+
+void BlockResult::save(const std::string& filename) const
+{
+	std::ofstream out(filename.c_str());
+	if(!out.good())
+		throw std::runtime_error("Could not open block result file for writing: " + filename);
+
+	out << std::setprecision(17) << "{\n\t\"block\": " << block << ",\n\t\"lastBlock\": " << lastBlock << ",\n\t\"energy\": " << energy
+		<< ",\n\t\"detectionResults\": [";
+	bool first = true;
+	for(const auto& node : nodeValues)
+	{
+		out << (first ? "\n\t\t" : ",\n\t\t") << "{\"id\": " << node.first << ", \"value\": " << node.second << "}";
+		first = false;
+	}
+	out << "\n\t],\n\t\"linkingResults\": [";
+	first = true;
+	for(const auto& link : arcValues)
+	{
+		out << (first ? "\n\t\t" : ",\n\t\t") << "{\"src\": " << link.first.first << ", \"dest\": " << link.first.second
+			<< ", \"value\": " << link.second << "}";
+		first = false;
+	}
+	out << "\n\t],\n\t\"divisionResults\": [";
+	first = true;
+	for(const auto& division : divisionValues)
+	{
+		out << (first ? "\n\t\t" : ",\n\t\t") << "{\"id\": " << division.first << ", \"value\": " << (division.second ? "true" : "false") << "}";
+		first = false;
+	}
+	out << "\n\t]\n}\n";
+}
+
+BlockResult BlockResult::load(const std::string& filename)
+{
+	std::ifstream input(filename.c_str());
+	if(!input.good())
+		throw std::runtime_error("Could not open block result file for reading: " + filename);
+
+	Json::Value root;
+	input >> root;
+	if(!root.isMember("block") || !root.isMember("energy"))
+		throw std::runtime_error("Not a block result: " + filename);
+
+	BlockResult result;
+	result.block = root["block"].asUInt64();
+	result.lastBlock = root.isMember("lastBlock") ? root["lastBlock"].asUInt64() : result.block;
+	result.energy = root["energy"].asDouble();
+	for(const Json::Value& node : root["detectionResults"])
+		result.nodeValues[node["id"].asUInt64()] = node["value"].asUInt64();
+	for(const Json::Value& link : root["linkingResults"])
+		result.arcValues[std::make_pair(link["src"].asUInt64(), link["dest"].asUInt64())] = link["value"].asUInt64();
+	for(const Json::Value& division : root["divisionResults"])
+		result.divisionValues[division["id"].asUInt64()] = division["value"].asBool();
+	return result;
+}
+
+TemporalBlockFlowGraphBuilder::TemporalBlockFlowGraphBuilder(size_t blockLength, size_t overlap, bool splitDetections):
+	blockLength_(blockLength),
+	overlap_(overlap),
+	splitDetections_(splitDetections),
+	stitchMargin_(0),
+	restriction_(Restriction::None),
+	restrictionBlock_(0),
+	restrictionLastBlock_(0),
+	maxTimestep_(0),
+	numSkippedLinks_(0)
+{
+	if(overlap_ == 0)
+		throw std::runtime_error("Consecutive time blocks must overlap by at least one timestep");
+	if(2 * overlap_ > blockLength_)
+		throw std::runtime_error("The overlap of time blocks can be at most half of their length");
+	// the windows must not reach into the neighbouring overlaps
+	stitchMargin_ = std::min(overlap_, blockLength_ - 2 * overlap_);
+}
+
+void TemporalBlockFlowGraphBuilder::setRestriction(Restriction restriction, size_t firstBlock, size_t lastBlock)
+{
+	if(!nodes_.empty())
+		throw std::runtime_error("The hypotheses of time blocks must be restricted before reading the model");
+	if(lastBlock < firstBlock)
+		throw std::runtime_error("The blocks to keep must end at or after block " + std::to_string(firstBlock));
+	restriction_ = restriction;
+	restrictionBlock_ = firstBlock;
+	restrictionLastBlock_ = lastBlock;
+}
+
+void TemporalBlockFlowGraphBuilder::reserve(size_t numDetections, size_t numLinks, size_t numDivisions)
+{
+	GraphBuilder::reserve(numDetections, numLinks, numDivisions);
+	// a restricted builder only keeps a fraction of the model
+	if(restriction_ == Restriction::None)
+	{
+		nodes_.reserve(numDetections);
+		links_.reserve(numLinks);
+		divisionIds_.reserve(numDivisions);
+		idToNodeIndexMap_.reserve(numDetections);
+	}
+}
+
+bool TemporalBlockFlowGraphBuilder::isInBlocks(size_t timestep, size_t firstBlock, size_t lastBlock) const
+{
+	return timestep >= getBlockFirstTimestep(firstBlock) && timestep <= getBlockLastTimestep(lastBlock);
+}
+
+void TemporalBlockFlowGraphBuilder::mergeBlocksOfLink(size_t srcTimestep, size_t destTimestep)
+{
+	// the latest block containing the earlier detection, and the first one containing the later detection
+	size_t stride = blockLength_ - overlap_;
+	size_t block = std::min(srcTimestep, destTimestep) / stride;
+	size_t lastTimestep = std::max(srcTimestep, destTimestep);
+	size_t lastBlock = lastTimestep < blockLength_ ? 0 : (lastTimestep - blockLength_) / stride + 1;
+	if(lastBlock <= block)
+		return;
+
+	numSkippedLinks_++;
+	if(mergedOverlaps_.size() <= lastBlock)
+		mergedOverlaps_.resize(lastBlock + 1, false);
+	std::fill(mergedOverlaps_.begin() + block + 1, mergedOverlaps_.begin() + lastBlock + 1, true);
+}
+
+size_t TemporalBlockFlowGraphBuilder::getOverlap(size_t timestep) const
+{
+	// overlaps are at most as long as the stride, so a timestep is in the overlap of the block starting before it, if any
+	size_t block = timestep / (blockLength_ - overlap_);
+	if(block > 0 && timestep <= getBlockLastTimestep(block - 1))
+		return block;
+	return 0;
+}
+
+bool TemporalBlockFlowGraphBuilder::isAroundStitchWindow(size_t timestep) const
+{
+	// the windows are at most as long as the stride, like the overlaps
+	size_t overlap = (timestep + stitchMargin_ + 1) / (blockLength_ - overlap_);
+	return overlap > 0 && timestep <= getBlockLastTimestep(overlap - 1) + stitchMargin_ + 1;
+}
+
+bool TemporalBlockFlowGraphBuilder::isDecidedByBlocks(size_t timestep, size_t firstBlock, size_t lastBlock, size_t numBlocks) const
+{
+	size_t block = std::min(timestep / (blockLength_ - overlap_), numBlocks - 1);
+	if(block < firstBlock || block > lastBlock)
+		return false;
+	// only the overlap with the blocks before is stitched, those between the blocks are tracked with them
+	return firstBlock == 0 || getOverlap(timestep) != firstBlock;
+}
+
+size_t TemporalBlockFlowGraphBuilder::getNumBlocks() const
+{
+	if(maxTimestep_ < blockLength_)
+		return 1;
+	size_t stride = blockLength_ - overlap_;
+	return 1 + (maxTimestep_ - blockLength_ + stride) / stride;
+}
+
+std::vector<std::pair<size_t, size_t> > TemporalBlockFlowGraphBuilder::getSpans() const
+{
+	std::vector<std::pair<size_t, size_t> > spans;
+	for(size_t b = 0; b < getNumBlocks(); ++b)
+	{
+		if(b > 0 && isMergedOverlap(b))
+			spans.back().second = b;
+		else
+			spans.push_back(std::make_pair(b, b));
+	}
+	return spans;
+}
+
+void TemporalBlockFlowGraphBuilder::addNode(
+	size_t id,
+	const CostDeltaVector& detectionCosts,
+	const CostDeltaVector& detectionCostDeltas,
+	const CostDeltaVector& appearanceCostDeltas,
+	const CostDeltaVector& disappearanceCostDeltas,
+	size_t targetIdx)
+{
+	std::pair<size_t, size_t> timesteps = idToTimestepsMap_[id];
+	maxTimestep_ = std::max(maxTimestep_, timesteps.second);
+
+	// the timesteps of dropped detections still tell which blocks their links join
+	if((restriction_ == Restriction::Block && !isInBlocks(timesteps.second, restrictionBlock_, restrictionLastBlock_))
+		|| (restriction_ == Restriction::Overlaps && !isAroundStitchWindow(timesteps.second)))
+		return;
+
+	idToNodeIndexMap_[id] = nodes_.size();
+	nodes_.push_back(NodeHypothesis{id, detectionCosts, detectionCostDeltas, appearanceCostDeltas, disappearanceCostDeltas,
+						targetIdx, timesteps, false, 0.0});
+}
+
+void TemporalBlockFlowGraphBuilder::addArc(size_t srcId, size_t destId, const CostDeltaVector& costDeltas)
+{
+	std::unordered_map<size_t, size_t>::const_iterator srcIt = idToNodeIndexMap_.find(srcId);
+	std::unordered_map<size_t, size_t>::const_iterator destIt = idToNodeIndexMap_.find(destId);
+	if(restriction_ == Restriction::None)
+	{
+		if(srcIt == idToNodeIndexMap_.end())
+			throw std::runtime_error("Trying to add link but source node is not present in map");
+		if(destIt == idToNodeIndexMap_.end())
+			throw std::runtime_error("Trying to add link but destination node is not present in map");
+	}
+
+	std::unordered_map<size_t, std::pair<size_t, size_t> >::const_iterator srcTimesteps = idToTimestepsMap_.find(srcId);
+	std::unordered_map<size_t, std::pair<size_t, size_t> >::const_iterator destTimesteps = idToTimestepsMap_.find(destId);
+	if(srcTimesteps != idToTimestepsMap_.end() && destTimesteps != idToTimestepsMap_.end())
+		mergeBlocksOfLink(srcTimesteps->second.second, destTimesteps->second.second);
+
+	// the stitching only needs the links into and out of the overlaps, whose targets can be further behind them
+	if(restriction_ != Restriction::None
+		&& (srcIt == idToNodeIndexMap_.end() || (restriction_ == Restriction::Block && destIt == idToNodeIndexMap_.end())))
+		return;
+
+	links_.push_back(LinkHypothesis{srcId, destId, costDeltas});
+}
+
+void TemporalBlockFlowGraphBuilder::allowMitosis(size_t id, ValueType divisionCostDelta)
+{
+	std::unordered_map<size_t, size_t>::const_iterator it = idToNodeIndexMap_.find(id);
+	if(it == idToNodeIndexMap_.end())
+	{
+		if(restriction_ == Restriction::None)
+			throw std::runtime_error("Trying to allow division but node is not present in map");
+		return;
+	}
+	nodes_[it->second].hasDivision = true;
+	nodes_[it->second].divisionCostDelta = divisionCostDelta;
+	divisionIds_.push_back(id);
+}
+
+namespace
+{
+
+/// sum of the cost deltas of the first value states
+double stateCost(const GraphBuilder::CostDeltaVector& costDeltas, long value, const char* hypothesis, size_t id)
+{
+	if(value < 0 || size_t(value) > costDeltas.size())
+		throw std::runtime_error(std::string("Inconsistent block solution: ") + hypothesis + " of detection " + std::to_string(id)
+			+ " has " + std::to_string(value) + " objects but only " + std::to_string(costDeltas.size()) + " states");
+	double energy = 0.0;
+	for(long i = 0; i < value; ++i)
+		energy += costDeltas[i];
+	return energy;
+}
+
+template<class K, class V>
+V findValue(const std::map<K, V>& values, const K& key)
+{
+	typename std::map<K, V>::const_iterator it = values.find(key);
+	return it == values.end() ? V() : it->second;
+}
+
+} // end anonymous namespace
+
+double TemporalBlockFlowGraphBuilder::computeEnergy(const std::function<bool(const NodeHypothesis&)>& selected,
+	const NodeValueMap& nodeValues, const ArcValueMap& arcValues, const DivisionValueMap& divisionValues) const
+{
+	std::unordered_map<size_t, long> inFlow;
+	std::unordered_map<size_t, long> outFlow;
+	for(const auto& arc : arcValues)
+	{
+		outFlow[arc.first.first] += arc.second;
+		inFlow[arc.first.second] += arc.second;
+	}
+
+	double energy = 0.0;
+	for(const NodeHypothesis& node : nodes_)
+	{
+		if(!selected(node))
+			continue;
+		long value = findValue(nodeValues, node.id);
+		bool divides = findValue(divisionValues, node.id);
+		// every object that did not arrive along a link appeared, the second child of a division leaves along a link
+		energy += stateCost(node.detectionCostDeltas, value, "the detection", node.id);
+		if(value > 0)
+		{
+			energy += stateCost(node.appearanceCostDeltas, value - inFlow[node.id], "the appearance", node.id);
+			energy += stateCost(node.disappearanceCostDeltas, value + (divides ? 1 : 0) - outFlow[node.id], "the disappearance", node.id);
+		}
+		if(divides)
+			energy += node.divisionCostDelta;
+	}
+
+	for(const LinkHypothesis& link : links_)
+	{
+		if(selected(nodes_[idToNodeIndexMap_.at(link.srcId)]))
+			energy += stateCost(link.costDeltas, findValue(arcValues, std::make_pair(link.srcId, link.destId)), "the link", link.srcId);
+	}
+	return energy;
+}
+
+BlockResult TemporalBlockFlowGraphBuilder::solveBlocks(size_t firstBlock, size_t lastBlock, SolverFunction solver) const
+{
+	size_t numBlocks = getNumBlocks();
+	if(lastBlock >= numBlocks || lastBlock < firstBlock)
+		throw std::runtime_error("The model only has " + std::to_string(numBlocks) + " time blocks, cannot solve blocks "
+			+ std::to_string(firstBlock) + " to " + std::to_string(lastBlock));
+	if(restriction_ == Restriction::Overlaps
+		|| (restriction_ == Restriction::Block && (firstBlock < restrictionBlock_ || lastBlock > restrictionLastBlock_)))
+		throw std::runtime_error("The hypotheses of time blocks " + std::to_string(firstBlock) + " to " + std::to_string(lastBlock) + " were not kept");
+
+	auto isInSpan = [&](const NodeHypothesis& node){ return isInBlocks(getTimestep(node), firstBlock, lastBlock); };
+	auto inBlock = [&](size_t id){
+		std::unordered_map<size_t, size_t>::const_iterator it = idToNodeIndexMap_.find(id);
+		return it != idToNodeIndexMap_.end() && isInSpan(nodes_[it->second]);
+	};
+
+	FlowGraph graph(splitDetections_);
+	FlowGraphBuilder builder(&graph);
+	size_t numNodes = 0;
+	for(const NodeHypothesis& node : nodes_)
+	{
+		if(!isInSpan(node))
+			continue;
+		builder.setNodeTimesteps(node.id, node.timesteps);
+		builder.addNode(node.id, node.detectionCosts, node.detectionCostDeltas,
+			node.appearanceCostDeltas, node.disappearanceCostDeltas, node.targetIdx);
+		numNodes++;
+	}
+	for(const LinkHypothesis& link : links_)
+	{
+		if(inBlock(link.srcId) && inBlock(link.destId))
+			builder.addArc(link.srcId, link.destId, link.costDeltas);
+	}
+	for(size_t id : divisionIds_)
+	{
+		if(inBlock(id))
+			builder.allowMitosis(id, nodes_[idToNodeIndexMap_.at(id)].divisionCostDelta);
+	}
+	DEBUG_MSG("Tracking time blocks " << firstBlock << " to " << lastBlock << " of " << numBlocks << " with " << numNodes << " detections");
+
+	solver(graph);
+
+	BlockResult result;
+	result.block = firstBlock;
+	result.lastBlock = lastBlock;
+	builder.visitNodeValues([&](size_t id, size_t value){ result.nodeValues[id] = value; });
+	builder.visitArcValues([&](size_t srcId, size_t destId, size_t value){ result.arcValues[std::make_pair(srcId, destId)] = value; });
+	builder.visitDivisions([&](size_t id){ result.divisionValues[id] = true; });
+	result.energy = computeEnergy([&](const NodeHypothesis& node){ return isDecidedByBlocks(getTimestep(node), firstBlock, lastBlock, numBlocks); },
+		result.nodeValues, result.arcValues, result.divisionValues);
+	return result;
+}
+
+bool TemporalBlockFlowGraphBuilder::stitchOverlap(size_t overlap, const BlockResult& next, SolverFunction solver, double& stitchedEnergy)
+{
+	size_t firstTimestep = getBlockFirstTimestep(overlap) - stitchMargin_;
+	size_t lastTimestep = getBlockLastTimestep(overlap - 1) + stitchMargin_;
+	auto isInWindow = [&](const NodeHypothesis& node){
+		return getTimestep(node) >= firstTimestep && getTimestep(node) <= lastTimestep;
+	};
+	auto findNode = [&](size_t id) -> const NodeHypothesis* {
+		std::unordered_map<size_t, size_t>::const_iterator it = idToNodeIndexMap_.find(id);
+		return it == idToNodeIndexMap_.end() ? nullptr : &nodes_[it->second];
+	};
+	auto inWindow = [&](size_t id){
+		const NodeHypothesis* node = findNode(id);
+		return node != nullptr && isInWindow(*node);
+	};
+
+	// the blocks paid for the detections of the window around the overlap, the stitched solution contains those before it
+	double energy = -computeEnergy([&](const NodeHypothesis& node){ return isInWindow(node) && getTimestep(node) < getBlockFirstTimestep(overlap); },
+			nodeValues_, arcValues_, divisionValues_)
+		- computeEnergy([&](const NodeHypothesis& node){ return isInWindow(node) && getTimestep(node) > getBlockLastTimestep(overlap - 1); },
+			next.nodeValues, next.arcValues, next.divisionValues);
+
+	// The detections right before the overlap hand it the objects they do not send elsewhere, which may disappear instead,
+	// and the detections right behind it take the objects they do not get from elsewhere, which may appear instead.
+	// Only the links from detections further away, or from dividing ones, keep their flow into and out of the overlap.
+	std::map<size_t, size_t> objectsBefore;
+	std::map<size_t, size_t> objectsBehind;
+	std::map<size_t, const NodeHypothesis*> openBefore;
+	std::map<size_t, const NodeHypothesis*> openBehind;
+	ArcValueMap fixedLinks;
+	for(const auto& node : nodeValues_)
+	{
+		const NodeHypothesis* hypothesis = findNode(node.first);
+		if(hypothesis != nullptr && getTimestep(*hypothesis) + 1 == firstTimestep && !findValue(divisionValues_, node.first))
+		{
+			openBefore[node.first] = hypothesis;
+			objectsBefore[node.first] = node.second;
+		}
+	}
+	for(const auto& arc : arcValues_)
+	{
+		bool open = openBefore.count(arc.first.first) > 0;
+		if(open && !inWindow(arc.first.second))
+			objectsBefore[arc.first.first] -= arc.second;
+		else if(!open && !inWindow(arc.first.first) && inWindow(arc.first.second))
+		{
+			fixedLinks.insert(arc);
+			objectsBefore[arc.first.first] += arc.second;
+		}
+	}
+	for(const LinkHypothesis& link : links_)
+	{
+		const NodeHypothesis* dest = findNode(link.destId);
+		if(inWindow(link.srcId) && dest != nullptr && getTimestep(*dest) == lastTimestep + 1 && findValue(next.nodeValues, link.destId) > 0)
+			openBehind[link.destId] = dest;
+	}
+	for(const auto& open : openBehind)
+		objectsBehind[open.first] = next.nodeValues.at(open.first);
+	for(const auto& arc : next.arcValues)
+	{
+		bool open = openBehind.count(arc.first.second) > 0;
+		if(open && !inWindow(arc.first.first))
+			objectsBehind[arc.first.second] -= arc.second;
+		else if(!open && inWindow(arc.first.first) && !inWindow(arc.first.second))
+			objectsBehind[arc.first.second] += arc.second;
+	}
+	auto eraseEmpty = [](std::map<size_t, size_t>& objects, std::map<size_t, const NodeHypothesis*>& open){
+		for(std::map<size_t, size_t>::iterator it = objects.begin(); it != objects.end();)
+		{
+			if(it->second > 0)
+				++it;
+			else
+			{
+				open.erase(it->first);
+				it = objects.erase(it);
+			}
+		}
+	};
+	eraseEmpty(objectsBefore, openBefore);
+	eraseEmpty(objectsBehind, openBehind);
+
+	// Appearances and disappearances at the open detections cost what they would in the model. The objects of an open detection
+	// are cheaper than appearing or disappearing there, those of the others than any solution that does not keep them, like frozen arcs.
+	// Every further object costs a bit more, as equal costs would let rounding errors close cycles along the same arc.
+	auto prefix = [](const CostDeltaVector& costDeltas, size_t length){
+		return CostDeltaVector(costDeltas.begin(), costDeltas.begin() + std::min(length, costDeltas.size()));
+	};
+	auto keepCosts = [](size_t numObjects, ValueType cost){
+		CostDeltaVector costDeltas;
+		for(size_t i = 0; i < numObjects; ++i)
+			costDeltas.push_back(cost + ValueType(i) / numObjects);
+		return costDeltas;
+	};
+	auto openKeepCosts = [&](size_t numObjects, const CostDeltaVector& costDeltas){
+		ValueType maxAbsCost = 0.0;
+		for(ValueType c : costDeltas)
+			maxAbsCost = std::max(maxAbsCost, std::abs(c));
+		return keepCosts(numObjects, -1.0 - maxAbsCost);
+	};
+	double sumAbsCosts = 1.0;
+	auto addAbsCosts = [&](const CostDeltaVector& costs){
+		for(ValueType c : costs)
+			sumAbsCosts += std::abs(c);
+	};
+	for(const NodeHypothesis& node : nodes_)
+	{
+		if(!isInWindow(node))
+			continue;
+		addAbsCosts(node.detectionCostDeltas);
+		addAbsCosts(node.appearanceCostDeltas);
+		addAbsCosts(node.disappearanceCostDeltas);
+		sumAbsCosts += std::abs(node.divisionCostDelta);
+	}
+	for(const LinkHypothesis& link : links_)
+	{
+		if(inWindow(link.srcId) || (openBefore.count(link.srcId) > 0 && inWindow(link.destId)))
+			addAbsCosts(link.costDeltas);
+	}
+	for(const auto& open : openBefore)
+		addAbsCosts(prefix(open.second->disappearanceCostDeltas, objectsBefore[open.first]));
+	for(const auto& open : openBehind)
+		addAbsCosts(prefix(open.second->appearanceCostDeltas, objectsBehind[open.first]));
+	ValueType fixedFlowCost = -2.0 * sumAbsCosts;
+
+	// The detections around the overlap are only there to send or take their objects. Like in the model, all objects of an open
+	// detection disappear or none, and none of them can disappear if the detection sends objects elsewhere. The same holds for appearances.
+	FlowGraph graph(splitDetections_);
+	FlowGraphBuilder builder(&graph);
+	for(const auto& before : objectsBefore)
+	{
+		builder.setNodeTimesteps(before.first, std::make_pair(firstTimestep - 1, firstTimestep - 1));
+		if(openBefore.count(before.first) == 0)
+		{
+			builder.addNode(before.first, {}, CostDeltaVector(before.second, 0.0), CostDeltaVector(before.second, 0.0), {});
+			continue;
+		}
+		CostDeltaVector disappearanceCostDeltas = prefix(openBefore[before.first]->disappearanceCostDeltas, before.second);
+		builder.addNode(before.first, {}, openKeepCosts(before.second, disappearanceCostDeltas), CostDeltaVector(before.second, 0.0),
+			before.second < findValue(nodeValues_, before.first) ? CostDeltaVector() : disappearanceCostDeltas);
+	}
+	for(const NodeHypothesis& node : nodes_)
+	{
+		if(!isInWindow(node))
+			continue;
+		builder.setNodeTimesteps(node.id, node.timesteps);
+		builder.addNode(node.id, node.detectionCosts, node.detectionCostDeltas,
+			node.appearanceCostDeltas, node.disappearanceCostDeltas, node.targetIdx);
+	}
+	for(const auto& behind : objectsBehind)
+	{
+		builder.setNodeTimesteps(behind.first, std::make_pair(lastTimestep + 1, lastTimestep + 1));
+		if(openBehind.count(behind.first) == 0)
+		{
+			builder.addNode(behind.first, {}, keepCosts(behind.second, fixedFlowCost), {}, CostDeltaVector(behind.second, 0.0));
+			continue;
+		}
+		CostDeltaVector appearanceCostDeltas = prefix(openBehind[behind.first]->appearanceCostDeltas, behind.second);
+		builder.addNode(behind.first, {}, openKeepCosts(behind.second, appearanceCostDeltas),
+			behind.second < next.nodeValues.at(behind.first) ? CostDeltaVector() : appearanceCostDeltas, CostDeltaVector(behind.second, 0.0));
+	}
+	for(const auto& arc : fixedLinks)
+		builder.addArc(arc.first.first, arc.first.second, keepCosts(arc.second, fixedFlowCost));
+	for(const LinkHypothesis& link : links_)
+	{
+		if((inWindow(link.srcId) && (inWindow(link.destId) || objectsBehind.count(link.destId) > 0))
+			|| (openBefore.count(link.srcId) > 0 && inWindow(link.destId)))
+			builder.addArc(link.srcId, link.destId, link.costDeltas);
+	}
+	for(size_t id : divisionIds_)
+	{
+		if(inWindow(id))
+			builder.allowMitosis(id, nodes_[idToNodeIndexMap_.at(id)].divisionCostDelta);
+	}
+	DEBUG_MSG("Stitching overlap " << overlap << " with " << objectsBefore.size() << " detections before it ("
+		<< openBefore.size() << " open) and " << objectsBehind.size() << " behind it (" << openBehind.size() << " open)");
+
+	solver(graph);
+
+	NodeValueMap nodeValues;
+	ArcValueMap arcValues;
+	DivisionValueMap divisionValues;
+	NodeValueMap boundaryValues;
+	builder.visitNodeValues([&](size_t id, size_t value){ (inWindow(id) ? nodeValues : boundaryValues)[id] = value; });
+	for(const std::map<size_t, size_t>* objects : {&objectsBefore, &objectsBehind})
+	{
+		for(const auto& node : *objects)
+		{
+			if(findValue(boundaryValues, node.first) != node.second)
+			{
+				LOG_MSG("Stitching overlap " << overlap << " could not keep the objects of detection " << node.first << " next to it");
+				return false;
+			}
+		}
+	}
+	// only the links into, inside and out of the overlap
+	builder.visitArcValues([&](size_t srcId, size_t destId, size_t value){
+		if(inWindow(srcId) || inWindow(destId))
+			arcValues[std::make_pair(srcId, destId)] = value;
+	});
+	builder.visitDivisions([&](size_t id){ divisionValues[id] = true; });
+	for(const auto& arc : fixedLinks)
+	{
+		if(findValue(arcValues, arc.first) != arc.second)
+		{
+			LOG_MSG("Stitching overlap " << overlap << " could not keep the link from " << arc.first.first << " to " << arc.first.second);
+			return false;
+		}
+	}
+	energy += computeEnergy(isInWindow, nodeValues, arcValues, divisionValues);
+
+	// the open detections were already paid for by the blocks, with the objects they exchanged there
+	std::map<size_t, size_t> newFlow;
+	std::map<size_t, size_t> oldFlow;
+	for(const auto& arc : arcValues)
+	{
+		if(openBefore.count(arc.first.first) > 0)
+			newFlow[arc.first.first] += arc.second;
+		else if(openBehind.count(arc.first.second) > 0)
+			newFlow[arc.first.second] += arc.second;
+	}
+	for(const auto& arc : arcValues_)
+	{
+		if(openBefore.count(arc.first.first) > 0 && inWindow(arc.first.second))
+			oldFlow[arc.first.first] += arc.second;
+	}
+	for(const auto& arc : next.arcValues)
+	{
+		if(inWindow(arc.first.first) && openBehind.count(arc.first.second) > 0)
+			oldFlow[arc.first.second] += arc.second;
+	}
+	for(const auto& open : openBefore)
+	{
+		const CostDeltaVector& disappearanceCostDeltas = open.second->disappearanceCostDeltas;
+		size_t objects = objectsBefore[open.first];
+		energy += stateCost(disappearanceCostDeltas, objects - newFlow[open.first], "the disappearance", open.first)
+			- stateCost(disappearanceCostDeltas, objects - oldFlow[open.first], "the disappearance", open.first);
+		for(const LinkHypothesis& link : links_)
+		{
+			std::pair<size_t, size_t> key = std::make_pair(link.srcId, link.destId);
+			if(link.srcId == open.first && inWindow(link.destId))
+				energy += stateCost(link.costDeltas, findValue(arcValues, key), "the link", link.srcId)
+					- stateCost(link.costDeltas, findValue(arcValues_, key), "the link", link.srcId);
+		}
+	}
+	size_t numBlocks = getNumBlocks();
+	for(const auto& open : openBehind)
+	{
+		// detections of a later overlap are paid for when it is stitched
+		if(!isDecidedByBlocks(getTimestep(*open.second), next.block, next.lastBlock, numBlocks))
+			continue;
+		const CostDeltaVector& appearanceCostDeltas = open.second->appearanceCostDeltas;
+		size_t objects = objectsBehind[open.first];
+		energy += stateCost(appearanceCostDeltas, objects - newFlow[open.first], "the appearance", open.first)
+			- stateCost(appearanceCostDeltas, objects - oldFlow[open.first], "the appearance", open.first);
+	}
+
+	// replace what the blocks decided inside the overlap and on the open links into it, and append the next block behind it
+	for(NodeValueMap::iterator it = nodeValues_.begin(); it != nodeValues_.end();)
+		it = inWindow(it->first) ? nodeValues_.erase(it) : std::next(it);
+	for(ArcValueMap::iterator it = arcValues_.begin(); it != arcValues_.end();)
+	{
+		bool replaced = inWindow(it->first.first) || (openBefore.count(it->first.first) > 0 && inWindow(it->first.second));
+		it = replaced ? arcValues_.erase(it) : std::next(it);
+	}
+	for(DivisionValueMap::iterator it = divisionValues_.begin(); it != divisionValues_.end();)
+		it = inWindow(it->first) ? divisionValues_.erase(it) : std::next(it);
+
+	nodeValues_.insert(nodeValues.begin(), nodeValues.end());
+	for(const auto& arc : arcValues)
+	{
+		if(inWindow(arc.first.first) || openBefore.count(arc.first.first) > 0)
+			arcValues_.insert(arc);
+	}
+	divisionValues_.insert(divisionValues.begin(), divisionValues.end());
+	for(const auto& node : next.nodeValues)
+	{
+		if(!inWindow(node.first))
+			nodeValues_.insert(node);
+	}
+	for(const auto& arc : next.arcValues)
+	{
+		if(!inWindow(arc.first.first))
+			arcValues_.insert(arc);
+	}
+	for(const auto& division : next.divisionValues)
+	{
+		if(!inWindow(division.first))
+			divisionValues_.insert(division);
+	}
+	stitchedEnergy += energy;
+	return true;
+}
+
+double TemporalBlockFlowGraphBuilder::stitch(std::vector<BlockResult> blocks, SolverFunction solver, SpanSolverFunction solveSpan)
+{
+	if(restriction_ == Restriction::Block)
+		throw std::runtime_error("Stitching time blocks needs the hypotheses of all overlaps");
+	if(!solveSpan && restriction_ == Restriction::None)
+		solveSpan = [&](size_t firstBlock, size_t lastBlock){ return solveBlocks(firstBlock, lastBlock, solver); };
+
+	size_t numBlocks = getNumBlocks();
+	std::sort(blocks.begin(), blocks.end(), [](const BlockResult& a, const BlockResult& b){ return a.block < b.block; });
+	// the results must follow each other without gaps, anything else is out of range afterwards
+	size_t nextBlock = 0;
+	for(const BlockResult& block : blocks)
+		nextBlock = (block.block == nextBlock && block.lastBlock >= block.block) ? block.lastBlock + 1 : numBlocks + 1;
+	if(nextBlock != numBlocks)
+		throw std::runtime_error("Stitching needs exactly one result of each of the " + std::to_string(numBlocks) + " time blocks");
+
+	while(true)
+	{
+		// the blocks around overlaps that are not stitched are tracked together
+		std::vector<BlockResult> spans;
+		for(size_t i = 0; i < blocks.size();)
+		{
+			size_t j = i;
+			while(j + 1 < blocks.size() && isMergedOverlap(blocks[j + 1].block))
+				++j;
+			if(j == i)
+				spans.push_back(std::move(blocks[i]));
+			else
+			{
+				if(!solveSpan)
+					throw std::runtime_error("Time blocks " + std::to_string(blocks[i].block) + " to " + std::to_string(blocks[j].lastBlock)
+						+ " must be tracked together, but there is no function to track them");
+				LOG_MSG("Tracking time blocks " << blocks[i].block << " to " << blocks[j].lastBlock << " together");
+				spans.push_back(solveSpan(blocks[i].block, blocks[j].lastBlock));
+			}
+			i = j + 1;
+		}
+		blocks.swap(spans);
+
+		nodeValues_ = blocks[0].nodeValues;
+		arcValues_ = blocks[0].arcValues;
+		divisionValues_ = blocks[0].divisionValues;
+		double energy = 0.0;
+		for(const BlockResult& block : blocks)
+			energy += block.energy;
+		size_t failedOverlap = 0;
+		for(size_t i = 1; i < blocks.size() && failedOverlap == 0; ++i)
+		{
+			if(!stitchOverlap(blocks[i].block, blocks[i], solver, energy))
+				failedOverlap = blocks[i].block;
+		}
+		if(failedOverlap == 0)
+			return energy;
+
+		// every failure joins two spans, so this ends with a single span at the latest
+		if(mergedOverlaps_.size() <= failedOverlap)
+			mergedOverlaps_.resize(failedOverlap + 1, false);
+		mergedOverlaps_[failedOverlap] = true;
+	}
+}
+
+double TemporalBlockFlowGraphBuilder::solve(SolverFunction solver, size_t numThreads)
+{
+	if(restriction_ != Restriction::None)
+		throw std::runtime_error("Solving all time blocks needs all hypotheses, use solveBlock and stitch for restricted models");
+	if(numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::vector<std::pair<size_t, size_t> > spans = getSpans();
+	std::vector<BlockResult> blocks(spans.size());
+	std::atomic<size_t> nextSpan(0);
+	auto worker = [&](){
+		for(size_t s = nextSpan++; s < spans.size(); s = nextSpan++)
+			blocks[s] = solveBlocks(spans[s].first, spans[s].second, solver);
+	};
+
+	numThreads = std::min(numThreads, spans.size());
+	if(numThreads <= 1)
+		worker();
+	else
+	{
+		std::vector<std::thread> threads;
+		for(size_t i = 0; i < numThreads; ++i)
+			threads.push_back(std::thread(worker));
+		for(std::thread& t : threads)
+			t.join();
+	}
+	return stitch(blocks, solver);
+}
+
+} // end namespace dpct
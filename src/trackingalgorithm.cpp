@@ -1,8 +1,10 @@
 #include <deque>
 #include <assert.h>
+#include <cstdint>
 #include <functional>
 #include <sstream>
 #include <algorithm>
+#include <thread>
 
 #include "trackingalgorithm.h"
 #include "graph.h"
@@ -22,8 +24,11 @@ TrackingAlgorithm::TrackingAlgorithm(Graph* graph):
 void TrackingAlgorithm::breadthFirstSearchVisitor(Node* begin, VisitorFunction func)
 {
     assert(begin != nullptr);
+    // every node is enqueued only once
+    std::vector<bool> enqueued(graph_->getNumNodeIndices(), false);
 	std::deque<Node*> queue;
 	queue.push_back(begin);
+    enqueued[begin->getIndex()] = true;
 
 	while(queue.size() > 0)
 	{
@@ -37,68 +42,97 @@ void TrackingAlgorithm::breadthFirstSearchVisitor(Node* begin, VisitorFunction f
 		{
             Node* next = (*outArc)->getTargetNode();
             assert(next != nullptr);
-
-            // only add if not yet present in queue (or should we remove it and only update at the end?)
-            if(std::find(queue.begin(), queue.end(), next) == queue.end())
+            if(!enqueued[next->getIndex()])
             {
+                enqueued[next->getIndex()] = true;
                 queue.push_back(next);
             }
 		}
 	}
 }
 
-void TrackingAlgorithm::findNonintersectingBackwardPaths(Node* begin, Node* end, Solution& paths)
+void TrackingAlgorithm::findNonintersectingBackwardPaths(Node* begin, Node* end, Solution& paths, size_t numThreads)
 {
-    // flow along the used arcs in the paths, where "forward flow" means from end to begin
-    std::map<const Arc*, uint8_t> forward_flows;
-
-    // init flows to zero
-    VisitorFunction vis = [&](Node* n)
-    {
-        forward_flows[n->getBestInArc()] = 0;
-    };
-    breadthFirstSearchVisitor(begin, vis);
-
-    // function to find a path with positive residual flow (recursively)
-    std::function<bool(const Node*, const Node*, Path&)> findGoodPath = [&](const Node* begin, const Node* end, Path& p)
+    // Every node has one best in arc, so following them backwards from the in arcs of end yields paths in the
+    // tree of best in arcs rooted at begin. Two such paths intersect exactly if they leave begin through the same
+    // node, hence the first path per node after begin is taken, in the order of the in arcs of end.
+    // The node after begin is found for all nodes with iterative walks that remember their result,
+    // and the taken paths are disjoint, such that they can be extracted in parallel.
+    enum BranchState : uint8_t { Unknown = 0, Walking, Known };
+    std::vector<uint8_t> state(graph_->getNumNodeIndices(), Unknown);
+    std::vector<const Node*> branch(graph_->getNumNodeIndices(), nullptr); // nullptr if begin is not reached
+    std::vector<bool> branchTaken(graph_->getNumNodeIndices(), false);
+    state[begin->getIndex()] = Known;
+
+    std::vector<const Node*> walk;
+    auto findBranch = [&](const Node* n)
     {
-        if(begin == end)
-            return true;
-
-        Arc* a = end->getBestInArc();
-        int residual_capacity = 1 - forward_flows[a];
-        if(residual_capacity > 0)
+        walk.clear();
+        while(state[n->getIndex()] == Unknown)
         {
-            p.insert(p.begin(), a);
-            return findGoodPath(begin, a->getSourceNode(), p);
+            state[n->getIndex()] = Walking;
+            walk.push_back(n);
+            const Arc* a = n->getBestInArc();
+            if(a == nullptr)
+                break;
+            if(a->getSourceNode() == begin)
+            {
+                branch[n->getIndex()] = n;
+                break;
+            }
+            n = a->getSourceNode();
         }
-        else
-            return false;
+        // a walk that runs into itself never reaches begin
+        const Node* result = state[n->getIndex()] == Known ? branch[n->getIndex()] : branch[walk.back()->getIndex()];
+        for(const Node* w : walk)
+        {
+            branch[w->getIndex()] = result;
+            state[w->getIndex()] = Known;
+        }
+        return result;
     };
 
-    std::function<bool(const Node*, const Node*, Path&)> findGoodPathFromSource = [&](const Node* begin, const Node* end, Path& p)
+    // the taken in arcs of end, in order
+    std::vector<Arc*> lastArcs;
+    for(Node::ArcIt a = end->getInArcsBegin(); a != end->getInArcsEnd(); ++a)
     {
-        for(Node::ConstArcIt a = end->getInArcsBegin(); a != end->getInArcsEnd(); ++a)
+        const Node* n = (*a)->getSourceNode();
+        const Node* b = n == begin ? n : findBranch(n);
+        if(b != nullptr && !branchTaken[b->getIndex()])
         {
-            p.clear();
-            p.push_back(*a);
-            if(findGoodPath(begin, (*a)->getSourceNode(), p))
-                return true;
+            branchTaken[b->getIndex()] = true;
+            lastArcs.push_back(*a);
         }
-        return false;
-    };  
+    }
 
     paths.clear();
-    Path currentPath;
-    while(findGoodPathFromSource(begin, end, currentPath))
+    paths.resize(lastArcs.size());
+    auto extractPaths = [&](size_t first, size_t last)
     {
-        // if we found a path, we know that its residual flow == 1
-        for(const Arc* a : currentPath)
+        for(size_t i = first; i < last; ++i)
         {
-            forward_flows[a] += 1;
+            Path& p = paths[i];
+            p.push_back(lastArcs[i]);
+            for(Node* n = lastArcs[i]->getSourceNode(); n != begin; n = p.back()->getSourceNode())
+                p.push_back(n->getBestInArc());
+            std::reverse(p.begin(), p.end());
         }
-        paths.push_back(currentPath);
+    };
+
+    const size_t minPathsPerThread = 256;
+    if(numThreads <= 1 || lastArcs.size() < numThreads * minPathsPerThread)
+    {
+        extractPaths(0, lastArcs.size());
+        return;
     }
+
+    size_t chunkSize = (lastArcs.size() + numThreads - 1) / numThreads;
+    std::vector<std::thread> threads;
+    for(size_t chunk = 1; chunk < numThreads; ++chunk)
+        threads.push_back(std::thread(extractPaths, std::min(lastArcs.size(), chunk * chunkSize), std::min(lastArcs.size(), (chunk + 1) * chunkSize)));
+    extractPaths(0, std::min(lastArcs.size(), chunkSize));
+    for(std::thread& t : threads)
+        t.join();
 }
 
 void TrackingAlgorithm::printPath(TrackingAlgorithm::Path& p)
@@ -0,0 +1,97 @@
+#include "workerpool.h"
+
+#include <algorithm>
+
+namespace dpct
+{
+
+WorkerPool::WorkerPool(size_t numThreads):
+	task_(nullptr),
+	numTasks_(0),
+	nextTask_(0),
+	numRunning_(0),
+	generation_(0),
+	stopping_(false)
+{
+	if(numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for(size_t i = 1; i < numThreads; ++i)
+		workers_.push_back(std::thread(&WorkerPool::work, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	startCondition_.notify_all();
+	for(std::thread& t : workers_)
+		t.join();
+}
+
+void WorkerPool::run(size_t numTasks, const Task& task)
+{
+	// nothing to share, avoid waking the workers
+	if(workers_.empty() || numTasks <= 1)
+	{
+		for(size_t i = 0; i < numTasks; ++i)
+			task(i);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	task_ = &task;
+	numTasks_ = numTasks;
+	nextTask_ = 0;
+	error_ = nullptr;
+	++generation_;
+	startCondition_.notify_all();
+
+	executeTasks(lock);
+	doneCondition_.wait(lock, [this](){ return nextTask_ >= numTasks_ && numRunning_ == 0; });
+	task_ = nullptr;
+	if(error_)
+		std::rethrow_exception(error_);
+}
+
+void WorkerPool::work()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	size_t seenGeneration = 0;
+	while(true)
+	{
+		startCondition_.wait(lock, [&](){ return stopping_ || generation_ != seenGeneration; });
+		if(stopping_)
+			return;
+		seenGeneration = generation_;
+		executeTasks(lock);
+	}
+}
+
+void WorkerPool::executeTasks(std::unique_lock<std::mutex>& lock)
+{
+	while(nextTask_ < numTasks_)
+	{
+		size_t i = nextTask_++;
+		numRunning_++;
+		lock.unlock();
+		std::exception_ptr error;
+		try
+		{
+			(*task_)(i);
+		}
+		catch(...)
+		{
+			error = std::current_exception();
+		}
+		lock.lock();
+		if(error && !error_)
+			error_ = error;
+		numRunning_--;
+	}
+	if(numRunning_ == 0)
+		doneCondition_.notify_all();
+}
+
+} // namespace dpct
@@ -1,4 +1,5 @@
 # run this as test? https://cmake.org/pipermail/cmake/2010-August/039174.html
+import copy
 import dpct
 
 weights = {"weights": [10, 10, 10, 500, 500]}
@@ -48,4 +49,116 @@ expectedResult = {'detectionResults': [{'id': 2, 'value': 1},
   {'dest': 5, 'src': 3, 'value': 0},
   {'dest': 6, 'src': 3, 'value': 1}]}
 
-assert(res == expectedResult)
\ No newline at end of file
+assert(res == expectedResult)
+
+# the solver telemetry records every iteration
+telemetry = dpct.Telemetry("flow")
+assert(dpct.trackFlowBased(graph, weights, telemetry=telemetry) == expectedResult)
+assert(len(telemetry.iterations) > 0)
+assert(telemetry.totals["numPaths"] > 0)
+assert(telemetry.totals["energy"] == telemetry.iterations[-1]["energy"])
+
+# anytime tracking reports every intermediate solution and can stop early
+progress = []
+def onProgress(p):
+	progress.append((p.numPaths, p.energy, p.getResult()))
+	return True
+assert(dpct.trackFlowBased(graph, weights, progress=onProgress) == expectedResult)
+assert(len(progress) > 1)
+assert(progress[-1][2] == expectedResult)
+assert(all(progress[i][1] > progress[i + 1][1] for i in range(len(progress) - 1)))
+firstResult = dpct.trackFlowBased(graph, weights, progress=lambda p: False)
+assert(firstResult == progress[0][2])
+assert(firstResult != expectedResult)
+assert(dpct.trackFlowBased(graph, weights, energyGap=1e9)["linkingResults"] == [dict(l, value=0) for l in expectedResult["linkingResults"]])
+assert(dpct.trackFlowBased(graph, weights, timeBudget=1e-9) == firstResult)
+try:
+	lateProgress = []
+	dpct.trackFlowBased(graph, weights, progress=lambda p: lateProgress.append(p))
+	lateProgress[0].getResult()
+	assert(False)
+except RuntimeError:
+	pass
+
+# the compiled model gives the same results, also after tracking it with other weights
+model = dpct.CompiledModel(graph, weights)
+assert(model.numWeights == 5)
+assert(model.trackFlowBased(weights) == expectedResult)
+assert(model.trackFlowBased({"weights": [10, 10, 10, 500, 500]}) == dpct.trackFlowBased(graph, {"weights": [10, 10, 10, 500, 500]}))
+otherWeights = {"weights": [1, 20, 0, 5, 1]}
+assert(model.trackFlowBased(otherWeights) == dpct.trackFlowBased(graph, otherWeights))
+assert(model.trackFlowBased(weights) == expectedResult)
+
+# the memory statistics report the containers of the graphs after tracking, the estimate only needs the graph
+memory = dpct.MemoryStatistics()
+assert(dpct.trackFlowBased(graph, weights, memory=memory) == expectedResult)
+assert([s["structure"] for s in memory.structures] == ["FlowGraph", "ResidualGraph"])
+assert(memory.totalBytes == sum(c["bytes"] for c in memory.containers))
+assert(memory.peakResidentBytes > memory.totalBytes)
+memory.clear()
+dpct.trackMagnusson(graph, weights, memory=memory)
+assert([s["structure"] for s in memory.structures] == ["Graph", "Magnusson"])
+assert(dpct.estimateMemory(graph, "magnusson-flow") == dpct.estimateMemory(graph) + dpct.estimateMemory(graph, "magnusson"))
+
+# pruning drops the link that costs more than a disappearance and an appearance, which keeps the result
+prunedGraph = copy.deepcopy(graph)
+prunedGraph["linkingHypotheses"].append({"src" : 2, "dest" : 6, "features" : [[0], [5001]]})
+pruning = dpct.PruningReport()
+prunedResult = dpct.trackFlowBased(prunedGraph, weights, pruning=pruning)
+assert(pruning.removedLinks == [(2, 6)] and pruning.numDominatedLinks == 1 and pruning.numRemovedStates == 0)
+assert(prunedResult["linkingResults"][:-1] == expectedResult["linkingResults"])
+assert(prunedResult["linkingResults"][-1] == {"src" : 2, "dest" : 6, "value" : 0})
+assert(prunedResult["detectionResults"] == expectedResult["detectionResults"])
+magnussonResult = dpct.trackMagnusson(copy.deepcopy(graph), weights)
+assert(dpct.trackMagnusson(prunedGraph, weights, pruning=dpct.PruningReport())["detectionResults"] == magnussonResult["detectionResults"])
+
+# several paths per sweep need fewer sweeps
+telemetry = dpct.Telemetry("magnusson")
+multiPathResult = dpct.trackMagnusson(copy.deepcopy(graph), weights, telemetry=telemetry, pathsPerSweep=10)
+assert(len(multiPathResult["detectionResults"]) == len(magnussonResult["detectionResults"]))
+numSweeps = len(telemetry.iterations)
+telemetry.clear()
+dpct.trackMagnusson(copy.deepcopy(graph), weights, telemetry=telemetry)
+assert(numSweeps <= len(telemetry.iterations))
+
+# background jobs track on a worker thread, report their progress and can be cancelled
+job = dpct.trackFlowBasedAsync(graph, weights)
+assert(job.result() == expectedResult)
+assert(job.done() and job.progress()["done"] and not job.progress()["cancelled"])
+assert(job.progress()["energy"] == progress[-1][1])
+assert(job.progress()["numPaths"] == progress[-1][0])
+assert(dpct.trackMagnussonAsync(graph, weights).result() == dpct.trackMagnusson(graph, weights))
+assert(dpct.trackMaxFlowAsync(graph, weights).result() == dpct.trackMaxFlow(graph, weights))
+# cancelling after the first path keeps the first solution
+job = dpct.trackFlowBasedAsync(graph, weights, progress=lambda p: False)
+cancelledResult = job.result()
+assert(job.progress()["cancelled"])
+assert(cancelledResult == progress[0][2])
+assert(job.progress()["numPaths"] == 1)
+del job
+def failingProgress(p):
+	raise ValueError("stop")
+try:
+	dpct.trackFlowBasedAsync(graph, weights, progress=failingProgress).result()
+	assert(False)
+except RuntimeError as e:
+	assert("stop" in str(e))
+
+# the same graph given as numpy arrays
+import numpy as np
+res = dpct.trackFlowBasedArrays(
+	nodeIds=np.array([2, 3, 4, 5, 6], dtype=np.int64),
+	nodeTimesteps=np.array([[1, 1], [1, 1], [2, 2], [2, 2], [2, 2]], dtype=np.int64),
+	detectionFeatures=np.array([[[1.0], [0.0]]] * 5),
+	appearanceFeatures=np.array([[[0], [0]], [[0], [0]], [[0], [50]], [[0], [50]], [[0], [50]]], dtype=np.float64),
+	disappearanceFeatures=np.array([[[0], [50]], [[0], [50]], [[0], [-2]], [[0], [-2]], [[0], [-4]]], dtype=np.float64),
+	linkSrcIds=np.array([2, 2, 3, 3], dtype=np.int64),
+	linkDestIds=np.array([4, 5, 5, 6], dtype=np.int64),
+	linkFeatures=np.array([[[0], [-4]], [[0], [-3]], [[0], [-1]], [[0], [-4]]], dtype=np.float64),
+	divisionIds=np.array([2, 3], dtype=np.int64),
+	divisionFeatures=np.array([[[0], [-5]], [[0], [-5]]], dtype=np.float64),
+	weights=np.array(weights["weights"], dtype=np.float64))
+
+assert(list(res["nodeValues"]) == [1, 1, 1, 1, 1])
+assert(list(res["linkValues"]) == [1, 1, 0, 1])
+assert(list(res["divisionValues"]) == [True, False])
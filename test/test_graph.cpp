@@ -3,6 +3,9 @@
 #include <iostream>
 #include <boost/test/unit_test.hpp>
 #include "graph.h"
+#include "jsonstreamparser.h"
+
+#include <sstream>
 
 using namespace dpct;
 
@@ -215,3 +218,93 @@ BOOST_AUTO_TEST_CASE(node_active_arc_counts)
     BOOST_CHECK_EQUAL(n2.getMoveInArcUsedSum(), 0);
     BOOST_CHECK_EQUAL(n2.getMoveOutArcUsedSum(), 0);
 }
+
+BOOST_AUTO_TEST_CASE(arena_storage)
+{
+    Graph::Configuration config(true, true, false, true);
+    Graph g(config);
+
+    std::vector<Graph::NodePtr> nodes;
+    for(size_t i = 0; i < 200; i++)
+        nodes.push_back(g.addNode(i % 2, {0.0, 1.0 * i}));
+    for(size_t i = 0; i + 1 < nodes.size(); i += 2)
+        g.addMoveArc(nodes[i], nodes[i + 1], {0.5, -1.0});
+
+    BOOST_CHECK_EQUAL(g.getNumNodes(), 200);
+    BOOST_CHECK_EQUAL(g.getNumArcs(), 500);
+
+    // nodes keep their address and scores while the arenas grow
+    for(size_t i = 0; i < nodes.size(); i++)
+    {
+        BOOST_CHECK_EQUAL(nodes[i]->getTimestep(), i % 2);
+        BOOST_CHECK_EQUAL(nodes[i]->getCurrentScore(), 1.0 * i);
+        BOOST_CHECK_EQUAL(nodes[i]->getNumInArcs(), 1 + i % 2);
+        BOOST_CHECK_EQUAL(nodes[i]->getNumOutArcs(), 2 - i % 2);
+    }
+
+    // the first nodes of a timestep are stored back to back
+    BOOST_CHECK_EQUAL(nodes[2].get(), nodes[0].get() + 1);
+    BOOST_CHECK_EQUAL(nodes[3].get(), nodes[1].get() + 1);
+
+    Arc* a = *(nodes[0]->getOutArcsBegin());
+    BOOST_CHECK_EQUAL(a->getType(), Arc::Disappearance);
+    a = *(nodes[0]->getOutArcsBegin() + 1);
+    BOOST_CHECK_EQUAL(a->getType(), Arc::Move);
+    BOOST_CHECK_EQUAL(a->getScoreDelta(), 0.5);
+    a->markUsed();
+    BOOST_CHECK_EQUAL(a->getScoreDelta(), -1.0);
+}
+
+BOOST_AUTO_TEST_CASE(json_stream_parser)
+{
+    typedef JsonStreamParser::Token Token;
+    std::stringstream input(
+        "{\n"
+        "  // a comment\n"
+        "  \"features\" : [[1.5, -2e1], [0]], /* another\n"
+        "  comment */\n"
+        "  \"name\" : \"a \\\"quoted\\\" \\u00e9\",\n"
+        "  \"skipped\" : {\"a\" : [1, {\"b\" : null}]},\n"
+        "  \"flag\" : true\n"
+        "}\n");
+
+    // a tiny buffer makes tokens span refills
+    JsonStreamParser parser(input, 3);
+    BOOST_CHECK(parser.next() == Token::BeginObject);
+    BOOST_REQUIRE(parser.next() == Token::Key);
+    BOOST_CHECK_EQUAL(parser.getString(), "features");
+    BOOST_CHECK(parser.next() == Token::BeginArray);
+    BOOST_CHECK(parser.next() == Token::BeginArray);
+    BOOST_REQUIRE(parser.next() == Token::Number);
+    BOOST_CHECK_EQUAL(parser.getNumber(), 1.5);
+    BOOST_REQUIRE(parser.next() == Token::Number);
+    BOOST_CHECK_EQUAL(parser.getNumber(), -20.0);
+    BOOST_CHECK(parser.next() == Token::EndArray);
+    BOOST_CHECK(parser.next() == Token::BeginArray);
+    BOOST_CHECK(parser.next() == Token::Number);
+    BOOST_CHECK(parser.next() == Token::EndArray);
+    BOOST_CHECK(parser.next() == Token::EndArray);
+
+    BOOST_REQUIRE(parser.next() == Token::Key);
+    BOOST_CHECK_EQUAL(parser.getString(), "name");
+    BOOST_REQUIRE(parser.next() == Token::String);
+    BOOST_CHECK_EQUAL(parser.getString(), "a \"quoted\" \xc3\xa9");
+
+    BOOST_REQUIRE(parser.next() == Token::Key);
+    BOOST_CHECK_EQUAL(parser.getString(), "skipped");
+    BOOST_CHECK(parser.next() == Token::BeginObject);
+    parser.skipValue();
+    BOOST_CHECK(parser.getToken() == Token::EndObject);
+
+    BOOST_REQUIRE(parser.next() == Token::Key);
+    BOOST_CHECK_EQUAL(parser.getString(), "flag");
+    BOOST_CHECK(parser.next() == Token::True);
+    BOOST_CHECK(parser.next() == Token::EndObject);
+    BOOST_CHECK(parser.next() == Token::EndOfInput);
+
+    std::stringstream broken("[1, tru]");
+    JsonStreamParser brokenParser(broken);
+    brokenParser.next();
+    brokenParser.next();
+    BOOST_CHECK_THROW(brokenParser.next(), std::runtime_error);
+}
@@ -1,6 +1,14 @@
 #define BOOST_TEST_MODULE test_lemon
 
 #include <iostream>
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <tuple>
 #include <boost/test/unit_test.hpp>
 
 #include <lemon/adaptors.h>
@@ -10,6 +18,14 @@
 #include "graph.h"
 #include "flowgraph.h"
 #include "residualgraph.h"
+#include "flowgraphbuilder.h"
+#include "compiledmodel.h"
+#include "streamingflowtracker.h"
+#include "componentflowgraphbuilder.h"
+#include "pruninggraphbuilder.h"
+#include "temporalblockflowgraphbuilder.h"
+#include "jsongraphreader.h"
+#include "binarymodel.h"
 
 
 using namespace dpct;
@@ -475,16 +491,2035 @@ BOOST_AUTO_TEST_CASE( flowgraph_simple )
     BOOST_CHECK_EQUAL(g.getFlowMap()[div1], 1);
     BOOST_CHECK_EQUAL(g.getFlowMap()[div2], 0);
 
-    BOOST_CHECK_EQUAL(g.getFlowMap()[move1], 1);
-    BOOST_CHECK_EQUAL(g.getFlowMap()[move2], 1);
-    BOOST_CHECK_EQUAL(g.getFlowMap()[move3], 0);
-    BOOST_CHECK_EQUAL(g.getFlowMap()[move4], 1);
-    BOOST_CHECK_EQUAL(g.getFlowMap()[move5], 0);
+    // the links count the objects of both children of the division
+    BOOST_CHECK_EQUAL(g.getLinkFlow(move1), 1);
+    BOOST_CHECK_EQUAL(g.getLinkFlow(move2), 1);
+    BOOST_CHECK_EQUAL(g.getLinkFlow(move3), 0);
+    BOOST_CHECK_EQUAL(g.getLinkFlow(move4), 1);
+    BOOST_CHECK_EQUAL(g.getLinkFlow(move5), 0);
+}
+
+BOOST_AUTO_TEST_CASE( residualgraph_dense_arc_origin )
+{
+    typedef lemon::ListDigraph LGraph;
+    LGraph g;
+    LGraph::Node s = g.addNode();
+    LGraph::Node unused = g.addNode();
+    LGraph::Node n = g.addNode();
+    LGraph::Node t = g.addNode();
+    g.erase(unused); // leave a gap in the node ids
+
+    LGraph::Arc a1 = g.addArc(s, n);
+    LGraph::Arc a2 = g.addArc(n, t);
+
+    std::vector<size_t> timesteps(g.maxNodeId() + 1, 0);
+    timesteps[g.id(s)] = 0;
+    timesteps[g.id(n)] = 1;
+    timesteps[g.id(t)] = 2;
+
+    ResidualGraph rg(g, s, timesteps, ResidualGraph::SharedArcs());
+    rg.updateArc(a1, ResidualGraph::Forward, -1.0, 1);
+    rg.updateArc(a1, ResidualGraph::Backward, 1.0, 0);
+    rg.updateArc(a2, ResidualGraph::Forward, -2.0, 1);
+    rg.updateArc(a2, ResidualGraph::Backward, 2.0, 1);
+    BOOST_CHECK_EQUAL(lemon::countArcs(rg), 3);
+
+    // every residual arc knows its original arc and direction, and connects the matching residual nodes
+    for(ResidualGraph::ArcIt a(rg); a != lemon::INVALID; ++a)
+    {
+        const ResidualGraph::ArcOrigin& origin = rg.residualArcToOriginalArc(a);
+        LGraph::Node os = origin.second ? g.source(origin.first) : g.target(origin.first);
+        LGraph::Node ot = origin.second ? g.target(origin.first) : g.source(origin.first);
+        BOOST_CHECK(rg.originNode(rg.source(a)) == os);
+        BOOST_CHECK(rg.originNode(rg.target(a)) == ot);
+    }
+
+    // disabling and re-enabling keeps the back reference in sync with the reused residual arc ids
+    rg.enableArc(a2, false);
+    BOOST_CHECK_EQUAL(lemon::countArcs(rg), 1);
+    rg.enableArc(a2, true);
+    BOOST_CHECK_EQUAL(lemon::countArcs(rg), 3);
+    ResidualGraph::Arc backArc = rg.residualArcs_[rg.residualArcIndex(a2, ResidualGraph::Backward)].arc;
+    BOOST_CHECK(rg.residualArcToOriginalArc(backArc).first == a2);
+    BOOST_CHECK(rg.residualArcToOriginalArc(backArc).second == ResidualGraph::Backward);
+
+    ResidualGraph::ShortestPathResult sp = rg.findShortestPath({t});
+    BOOST_CHECK_EQUAL(sp.second, -3.0);
+    BOOST_CHECK_EQUAL(sp.first.size(), 2);
+}
+
+// a small model with two possible divisions, used to compare the different residual graph backends
+void buildDivisionFlowGraph(FlowGraph& g)
+{
+    typedef FlowGraph::FullNode Node;
+    Node n_1_1 = g.addNode({0.0});
+    Node n_1_2 = g.addNode({0.0});
+    Node n_2_1 = g.addNode({0.0}, 1);
+    Node n_2_2 = g.addNode({0.0}, 1);
+    Node n_2_3 = g.addNode({0.0}, 1);
+    FlowGraph::Node s = g.getSource();
+    FlowGraph::Node t = g.getTarget();
+
+    g.addArc(s, n_1_1.u, {0.0});
+    g.addArc(s, n_1_2.u, {0.0});
+    g.addArc(s, n_2_1.u, {10.0});
+    g.addArc(s, n_2_2.u, {10.0});
+    g.addArc(s, n_2_3.u, {10.0});
+    g.addArc(n_1_1, n_2_1, {-4.0});
+    g.addArc(n_1_1, n_2_2, {-3.0});
+    g.addArc(n_1_2, n_2_2, {-1.0});
+    g.addArc(n_1_2, n_2_3, {-4.0});
+    g.addArc(n_2_1.v, t, {-2.0});
+    g.addArc(n_2_2.v, t, {-2.0});
+    g.addArc(n_2_3.v, t, {-4.0});
+    g.addArc(n_1_1.v, t, {10.0});
+    g.addArc(n_1_2.v, t, {10.0});
+    g.allowMitosis(n_1_1, {-4.0});
+    g.allowMitosis(n_1_2, {-4.0});
+}
+
+// check that both graphs were built the same way and carry the same flow on every arc
+void checkSameFlows(FlowGraph& a, FlowGraph& b)
+{
+    FlowGraph::Graph::ArcIt arcA(a.getGraph());
+    FlowGraph::Graph::ArcIt arcB(b.getGraph());
+    for(; arcA != lemon::INVALID && arcB != lemon::INVALID; ++arcA, ++arcB)
+    {
+        BOOST_CHECK_EQUAL(a.getFlowMap()[arcA], b.getFlowMap()[arcB]);
+        BOOST_CHECK_EQUAL(a.getSharedFlowMap()[arcA], b.getSharedFlowMap()[arcB]);
+    }
+    BOOST_CHECK(arcA == lemon::INVALID && arcB == lemon::INVALID);
+}
+
+// every node but the source and the targets passes on its in-flow, a division duplicate along the arcs of its parent
+void checkFlowConservation(FlowGraph& g)
+{
+    const FlowGraph::Graph& graph = g.getGraph();
+    for(FlowGraph::Graph::NodeIt n(graph); n != lemon::INVALID; ++n)
+    {
+        if(n == g.getSource() || g.isTarget(n))
+            continue;
+
+        int outFlow = g.sumOutFlow(n);
+        auto parentIt = g.duplicateToParentMap_.find(n);
+        if(parentIt != g.duplicateToParentMap_.end())
+        {
+            BOOST_CHECK_EQUAL(outFlow, 0);
+            for(FlowGraph::Graph::OutArcIt oa(graph, parentIt->second); oa != lemon::INVALID; ++oa)
+                outFlow += g.getSharedFlowMap()[oa];
+        }
+        BOOST_CHECK_EQUAL(g.sumInFlow(n), outFlow);
+    }
+    for(FlowGraph::Graph::ArcIt a(graph); a != lemon::INVALID; ++a)
+        BOOST_CHECK(g.getSharedFlowMap()[a] == 0 || g.getSharedFlowMap()[a] == 1);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_reserve )
+{
+    FlowGraph plainGraph;
+    buildDivisionFlowGraph(plainGraph);
+
+    // underestimating the counts must not matter
+    FlowGraph reservedGraph;
+    reservedGraph.reserve(2, 2, 1);
+    buildDivisionFlowGraph(reservedGraph);
+    BOOST_CHECK_EQUAL(reservedGraph.arcCostRanges_.size(), (size_t)reservedGraph.getGraph().maxArcId() + 1);
+
+    BOOST_CHECK_EQUAL(plainGraph.maxFlowMinCostTracking(), reservedGraph.maxFlowMinCostTracking());
+    checkSameFlows(plainGraph, reservedGraph);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_static_residual_arcs )
+{
+    // the same model tracked with dynamically added and with statically allocated residual arcs
+    FlowGraph dynamicGraph;
+    buildDivisionFlowGraph(dynamicGraph);
+    double dynamicEnergy = dynamicGraph.maxFlowMinCostTracking();
+
+    FlowGraph staticGraph;
+    buildDivisionFlowGraph(staticGraph);
+    double staticEnergy = staticGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, true);
+
+    BOOST_CHECK_EQUAL(dynamicEnergy, staticEnergy);
+    // and both residual arcs of the four links the duplicates share with their parents
+    BOOST_CHECK_EQUAL(lemon::countArcs(*staticGraph.residualGraph_), 2 * lemon::countArcs(staticGraph.getGraph()) + 2 * 4);
+    checkSameFlows(dynamicGraph, staticGraph);
+}
+
+// check that a split and an unsplit graph were built the same way and carry the same flow on every arc but the detection arcs
+void checkSameUnsplitFlows(FlowGraph& split, FlowGraph& unsplit)
+{
+    FlowGraph::Graph::ArcIt arcA(split.getGraph());
+    FlowGraph::Graph::ArcIt arcB(unsplit.getGraph());
+    for(; arcA != lemon::INVALID && arcB != lemon::INVALID; ++arcA, ++arcB)
+    {
+        while(arcA != lemon::INVALID && split.isIntermediateArc(arcA))
+            ++arcA;
+        if(arcA == lemon::INVALID)
+            break;
+        BOOST_CHECK_EQUAL(split.getFlowMap()[arcA], unsplit.getFlowMap()[arcB]);
+        BOOST_CHECK_EQUAL(split.getSharedFlowMap()[arcA], unsplit.getSharedFlowMap()[arcB]);
+    }
+    while(arcA != lemon::INVALID && split.isIntermediateArc(arcA))
+        ++arcA;
+    BOOST_CHECK(arcA == lemon::INVALID && arcB == lemon::INVALID);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_unsplit_detections )
+{
+    // detections as in- and out-node or as a single node with costs find the same flow, with dynamic and static 
+    // residual arcs, the CSR backend, Dijkstra and local cycle repair
+    for(size_t backend = 0; backend < 5; ++backend)
+    {
+        bool staticArcs = backend == 1;
+        bool csr = backend >= 2;
+        bool dijkstra = backend == 3;
+        FlowGraph splitGraph;
+        buildDivisionFlowGraph(splitGraph);
+        FlowGraph unsplitGraph(false);
+        buildDivisionFlowGraph(unsplitGraph);
+        BOOST_CHECK_EQUAL(lemon::countNodes(unsplitGraph.getGraph()) + 5, lemon::countNodes(splitGraph.getGraph()));
+        BOOST_CHECK_EQUAL(lemon::countArcs(unsplitGraph.getGraph()) + 5, lemon::countArcs(splitGraph.getGraph()));
+        for(FlowGraph* g : {&splitGraph, &unsplitGraph})
+            g->setLocalCycleRepair(backend == 4);
+
+        double splitEnergy = splitGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, staticArcs, csr, 1, dijkstra);
+        double unsplitEnergy = unsplitGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, staticArcs, csr, 1, dijkstra);
+        BOOST_CHECK_EQUAL(splitEnergy, unsplitEnergy);
+        BOOST_CHECK_EQUAL(unsplitEnergy, unsplitGraph.getFlowEnergy());
+        checkSameUnsplitFlows(splitGraph, unsplitGraph);
+
+        // the residual graph gives every detection an in- and an out-side, but has no arcs between them
+        BOOST_CHECK_EQUAL(lemon::countNodes(*unsplitGraph.residualGraph_), lemon::countNodes(*splitGraph.residualGraph_));
+        if(staticArcs || csr)
+            BOOST_CHECK_EQUAL(lemon::countArcs(*unsplitGraph.residualGraph_) + 2 * 5, lemon::countArcs(*splitGraph.residualGraph_));
+
+        // changing the costs of a used detection releases its tracks in both
+        for(FlowGraph::Graph::ArcIt a(splitGraph.getGraph()); a != lemon::INVALID; ++a)
+        {
+            if(!splitGraph.isIntermediateArc(a) || splitGraph.getFlowMap()[a] == 0)
+                continue;
+            // the k-th detection follows source and target, with the ids 2 + 2k and 2 + k
+            int k = (splitGraph.getGraph().id(splitGraph.getGraph().source(a)) - 2) / 2;
+            FlowGraph::FullNode unsplitNode;
+            unsplitNode.u = unsplitNode.v = unsplitGraph.getGraph().nodeFromId(2 + k);
+            unsplitNode.a = lemon::INVALID;
+            BOOST_REQUIRE(unsplitGraph.isDetectionNode(unsplitNode.u));
+            BOOST_CHECK_EQUAL(unsplitGraph.getNodeFlow(unsplitNode), splitGraph.getFlowMap()[a]);
+            splitGraph.setArcCosts(a, {3.0});
+            unsplitGraph.setNodeCosts(unsplitNode, {3.0});
+            break;
+        }
+        BOOST_CHECK_EQUAL(splitGraph.getFlowEnergy(), unsplitGraph.getFlowEnergy());
+        checkSameUnsplitFlows(splitGraph, unsplitGraph);
+        BOOST_CHECK_EQUAL(splitGraph.maxFlowMinCostRetracking(0.0, true, 0, true, true, staticArcs, csr, 1, dijkstra), 
+                          unsplitGraph.maxFlowMinCostRetracking(0.0, true, 0, true, true, staticArcs, csr, 1, dijkstra));
+        checkSameUnsplitFlows(splitGraph, unsplitGraph);
+        checkFlowConservation(unsplitGraph);
+    }
+
+    // detections that can hold two objects, their flow is read from the node
+    auto build = [](GraphBuilder& builder)
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> score(0.0, 1.0);
+        const size_t numTimesteps = 6;
+        const size_t numNodesPerTimestep = 12;
+        for(size_t t = 0; t < numTimesteps; ++t)
+        {
+            for(size_t i = 0; i < numNodesPerTimestep; ++i)
+            {
+                double detection = -6.0 + 7.0 * score(rng);
+                double secondDetection = detection + 1.0 + 4.0 * score(rng);
+                double appearance = t == 0 ? 0.0 : 2.0 + 4.0 * score(rng);
+                double disappearance = t + 1 == numTimesteps ? 0.0 : 2.0 + 4.0 * score(rng);
+                builder.setNodeTimesteps(t * numNodesPerTimestep + i, std::make_pair(t, t));
+                builder.addNode(t * numNodesPerTimestep + i, {0.0, detection, detection + secondDetection}, 
+                                {detection, secondDetection}, {appearance, appearance + 2.0}, {disappearance, disappearance + 2.0}, 0);
+            }
+        }
+        for(size_t t = 0; t + 1 < numTimesteps; ++t)
+        {
+            for(size_t i = 0; i < numNodesPerTimestep; ++i)
+            {
+                for(size_t k = 0; k < 3; ++k)
+                {
+                    double link = -4.0 + 6.0 * score(rng);
+                    builder.addArc(t * numNodesPerTimestep + i, (t + 1) * numNodesPerTimestep + (i + k) % numNodesPerTimestep,
+                                   {link, link + 1.0 + 3.0 * score(rng)});
+                }
+                if(i % 4 == 0)
+                    builder.allowMitosis(t * numNodesPerTimestep + i, -1.0 + 5.0 * score(rng));
+            }
+        }
+    };
+    for(size_t backend = 0; backend < 3; ++backend)
+    {
+        FlowGraph splitGraph;
+        FlowGraphBuilder splitBuilder(&splitGraph);
+        build(splitBuilder);
+        FlowGraph unsplitGraph(false);
+        FlowGraphBuilder unsplitBuilder(&unsplitGraph);
+        build(unsplitBuilder);
+        BOOST_CHECK(unsplitBuilder.getNodeArc(0) == lemon::INVALID);
+
+        double splitEnergy = splitGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, backend > 0, backend > 1);
+        double unsplitEnergy = unsplitGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, backend > 0, backend > 1);
+        BOOST_CHECK_EQUAL(splitEnergy, unsplitEnergy);
+        BOOST_CHECK_CLOSE(unsplitEnergy, unsplitGraph.getFlowEnergy(), 1e-9);
+        BOOST_CHECK(splitBuilder.getNodeValues() == unsplitBuilder.getNodeValues());
+        BOOST_CHECK(splitBuilder.getArcValues() == unsplitBuilder.getArcValues());
+        BOOST_CHECK(splitBuilder.getDivisionValues() == unsplitBuilder.getDivisionValues());
+        checkSameUnsplitFlows(splitGraph, unsplitGraph);
+    }
+
+    // a min cost flow cannot take the node costs into account
+    FlowGraph unsplitGraph(false);
+    buildDivisionFlowGraph(unsplitGraph);
+    BOOST_CHECK_THROW(unsplitGraph.maxFlow(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_division_duplicate_arcs )
+{
+    FlowGraph g;
+    buildDivisionFlowGraph(g);
+
+    // arcs added to a parent after its division was allowed are shared as well
+    FlowGraph::Node parent = g.parentToDuplicateMap_.begin()->first;
+    FlowGraph::FullNode child = g.addNode({0.0}, 1);
+    g.addArc(g.getSource(), child.u, {10.0});
+    g.addArc(child.v, g.getTarget(), {-1.0});
+    FlowGraph::Arc lateArc = g.addArc(parent, child.u, {-2.0});
+
+    // duplicates have no arcs but their division arc
+    const FlowGraph::Graph& graph = g.getGraph();
+    for(auto& parentAndDuplicate : g.parentToDuplicateMap_)
+    {
+        BOOST_CHECK(FlowGraph::Graph::OutArcIt(graph, parentAndDuplicate.second) == lemon::INVALID);
+        FlowGraph::Graph::InArcIt divisionArc(graph, parentAndDuplicate.second);
+        BOOST_CHECK(graph.source(divisionArc) == g.getSource() && ++divisionArc == lemon::INVALID);
+    }
+
+    // the residual graph shares every parent out arc except the disappearance with the duplicate
+    g.initializeResidualGraph(true, true);
+    size_t numSharedArcs = 0;
+    for(FlowGraph::Graph::ArcIt a(graph); a != lemon::INVALID; ++a)
+    {
+        bool shared = g.parentToDuplicateMap_.count(graph.source(a)) > 0 && !g.isTarget(graph.target(a));
+        BOOST_CHECK_EQUAL(g.residualGraph_->isSharedArc(a), shared);
+        if(shared)
+            numSharedArcs++;
+    }
+    BOOST_CHECK_EQUAL(numSharedArcs, 5);
+    BOOST_CHECK(g.residualGraph_->isSharedArc(lateArc));
+
+    // the flow of a division leaves the duplicate along the parent's arcs, apart from the parent's own flow
+    double energy = g.maxFlowMinCostTracking();
+    checkFlowConservation(g);
+    size_t numDivisions = 0;
+    for(auto& parentAndDuplicate : g.parentToDuplicateMap_)
+    {
+        FlowGraph::Graph::InArcIt divisionArc(graph, parentAndDuplicate.second);
+        if(g.getFlowMap()[divisionArc] > 0)
+        {
+            BOOST_CHECK_EQUAL(g.sumInFlow(parentAndDuplicate.first), 1);
+            BOOST_CHECK_EQUAL(g.sumOutFlow(parentAndDuplicate.first), 1);
+            // the two children are different objects
+            for(FlowGraph::Graph::OutArcIt oa(graph, parentAndDuplicate.first); oa != lemon::INVALID; ++oa)
+                BOOST_CHECK(g.getLinkFlow(oa) <= 1);
+            numDivisions++;
+        }
+    }
+    BOOST_CHECK(numDivisions > 0);
+    BOOST_CHECK_CLOSE(energy, g.getFlowEnergy(), 1e-9);
+
+    // removing the parent's track releases the division as well
+    FlowGraph::Node dividing = lemon::INVALID;
+    for(auto& parentAndDuplicate : g.parentToDuplicateMap_)
+        if(g.getFlowMap()[FlowGraph::Graph::InArcIt(graph, parentAndDuplicate.second)] > 0)
+            dividing = parentAndDuplicate.first;
+    BOOST_CHECK(g.releaseTracksAt(dividing));
+    BOOST_CHECK_EQUAL(g.getFlowMap()[FlowGraph::Graph::InArcIt(graph, g.parentToDuplicateMap_[dividing])], 0);
+    checkFlowConservation(g);
+}
+
+BOOST_AUTO_TEST_CASE( csr_digraph )
+{
+    typedef lemon::ListDigraph LGraph;
+    LGraph g;
+    LGraph::Node a = g.addNode();
+    LGraph::Node b = g.addNode();
+    LGraph::Node c = g.addNode();
+    LGraph::Arc ab = g.addArc(a, b);
+    LGraph::Arc cb = g.addArc(c, b);
+    LGraph::Arc ca = g.addArc(c, a);
+    LGraph::NodeMap<size_t> timestep(g);
+    timestep[a] = 1;
+    timestep[b] = 2;
+    timestep[c] = 0;
+
+    CsrDigraph csr(g, timestep);
+    BOOST_CHECK_EQUAL(lemon::countNodes(csr), 3);
+    BOOST_CHECK_EQUAL(lemon::countArcs(csr), 3);
+
+    // nodes are sorted by timestep
+    BOOST_CHECK_EQUAL(csr.inputNodeId(CsrDigraph::nodeFromId(0)), g.id(c));
+    BOOST_CHECK_EQUAL(csr.inputNodeId(CsrDigraph::nodeFromId(1)), g.id(a));
+    BOOST_CHECK_EQUAL(csr.inputNodeId(CsrDigraph::nodeFromId(2)), g.id(b));
+
+    // out arcs of c are consecutive and map back to the input arcs
+    std::set<int> outArcsOfC;
+    for(CsrDigraph::OutArcIt oa(csr, csr.nodeFromInputId(g.id(c))); oa != lemon::INVALID; ++oa)
+    {
+        BOOST_CHECK(csr.source(oa) == csr.nodeFromInputId(g.id(c)));
+        outArcsOfC.insert(csr.inputArcId(oa));
+    }
+    BOOST_CHECK(outArcsOfC == std::set<int>({g.id(cb), g.id(ca)}));
+
+    int numInArcsOfB = 0;
+    for(CsrDigraph::InArcIt ia(csr, csr.nodeFromInputId(g.id(b))); ia != lemon::INVALID; ++ia)
+        ++numInArcsOfB;
+    BOOST_CHECK_EQUAL(numInArcsOfB, 2);
+    BOOST_CHECK(csr.target(csr.arcFromInputId(g.id(ab))) == csr.nodeFromInputId(g.id(b)));
+
+    // disabled arcs are skipped by the adjacency iterators but keep their ids
+    auto countArcsAround = [&](const LGraph::Node& n, bool out)
+    {
+        int count = 0;
+        if(out)
+            for(CsrDigraph::OutArcIt oa(csr, csr.nodeFromInputId(g.id(n))); oa != lemon::INVALID; ++oa)
+                ++count;
+        else
+            for(CsrDigraph::InArcIt ia(csr, csr.nodeFromInputId(g.id(n))); ia != lemon::INVALID; ++ia)
+                ++count;
+        return count;
+    };
+    CsrDigraph::Arc csrCb = csr.arcFromInputId(g.id(cb));
+    csr.setArcEnabled(csrCb, false);
+    BOOST_CHECK(!csr.arcEnabled(csrCb));
+    BOOST_CHECK_EQUAL(countArcsAround(c, true), 1);
+    BOOST_CHECK_EQUAL(countArcsAround(b, false), 1);
+    for(CsrDigraph::OutArcIt oa(csr, csr.nodeFromInputId(g.id(c))); oa != lemon::INVALID; ++oa)
+        BOOST_CHECK_EQUAL(csr.inputArcId(oa), g.id(ca));
+    BOOST_CHECK_EQUAL(lemon::countArcs(csr), 3);
+    BOOST_CHECK(csr.arcFromInputId(g.id(cb)) == csrCb);
+    csr.setArcEnabled(csrCb, true);
+    BOOST_CHECK(csr.arcEnabled(csrCb));
+    BOOST_CHECK_EQUAL(countArcsAround(c, true), 2);
+    BOOST_CHECK_EQUAL(countArcsAround(b, false), 2);
+
+    // the order map yields one group per timestep
+    CsrDigraph::NodeOrderMap order(csr);
+    size_t numGroups = 0;
+    for(auto v = order.beginValue(); v != order.endValue(); ++v, ++numGroups)
+    {
+        CsrDigraph::NodeOrderMap::ItemIt it(order, *v);
+        BOOST_CHECK_EQUAL(csr.orderKey(it), *v);
+    }
+    BOOST_CHECK_EQUAL(numGroups, 3);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_csr_backend )
+{
+    FlowGraph listGraph;
+    buildDivisionFlowGraph(listGraph);
+    double listEnergy = listGraph.maxFlowMinCostTracking();
+
+    FlowGraph csrGraph;
+    buildDivisionFlowGraph(csrGraph);
+    double csrEnergy = csrGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, false, true);
+
+    BOOST_CHECK_EQUAL(listEnergy, csrEnergy);
+    checkSameFlows(listGraph, csrGraph);
+
+    // the same without the timestep ordered initialization
+    FlowGraph unorderedCsrGraph;
+    buildDivisionFlowGraph(unorderedCsrGraph);
+    BOOST_CHECK_EQUAL(unorderedCsrGraph.maxFlowMinCostTracking(0.0, true, 0, false, true, false, true), listEnergy);
+}
+
+// layered graph with distinct, partially negative arc lengths, returns the first node
+lemon::ListDigraph::Node buildLayeredGraph(lemon::ListDigraph& g, lemon::ListDigraph::ArcMap<double>& length)
+{
+    typedef lemon::ListDigraph LGraph;
+    const int numLayers = 6;
+    const int layerSize = 40;
+    LGraph::Node s = g.addNode();
+    std::vector<LGraph::Node> previousLayer(1, s);
+    for(int l = 0; l < numLayers; ++l)
+    {
+        std::vector<LGraph::Node> layer;
+        for(int i = 0; i < layerSize; ++i)
+            layer.push_back(g.addNode());
+        int k = 0;
+        for(LGraph::Node& u : previousLayer)
+            for(LGraph::Node& v : layer)
+            {
+                ++k;
+                length[g.addArc(u, v)] = double((k * 7919 + l * 104729) % 1009) / 100.0 - 3.0 + k * 1e-7;
+            }
+        previousLayer = layer;
+    }
+    return s;
+}
+
+BOOST_AUTO_TEST_CASE( bellmanford_parallel_weak_rounds )
+{
+    typedef lemon::ListDigraph LGraph;
+    typedef LGraph::ArcMap<double> LengthMap;
+    typedef lemon::EarlyStoppingBellmanFord<LGraph, LengthMap> BellmanFord;
+
+    LGraph g;
+    LengthMap length(g);
+    LGraph::Node s = buildLayeredGraph(g, length);
+
+    std::vector<LGraph::Node> processA, nextProcessA, processB, nextProcessB;
+    BellmanFord serialBf(g, length, processA, nextProcessA);
+    serialBf.run(s);
+
+    BellmanFord parallelBf(g, length, processB, nextProcessB);
+    parallelBf.numThreads(4, 1);
+    BOOST_CHECK_EQUAL(parallelBf.numThreads(), 4);
+    parallelBf.run(s);
+
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+    {
+        BOOST_CHECK_CLOSE(serialBf.dist(n), parallelBf.dist(n), 1e-9);
+        BOOST_CHECK(serialBf.predArc(n) == parallelBf.predArc(n));
+    }
+
+    // two searches can share the threads of one pool
+    WorkerPool pool(3);
+    std::vector<LGraph::Node> processC, nextProcessC;
+    BellmanFord pooledBf(g, length, processC, nextProcessC);
+    pooledBf.workerPool(pool, 1);
+    parallelBf.workerPool(pool, 1);
+    BOOST_CHECK_EQUAL(pooledBf.numThreads(), 3);
+    pooledBf.run(s);
+    parallelBf.run(s);
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+    {
+        BOOST_CHECK_CLOSE(serialBf.dist(n), pooledBf.dist(n), 1e-9);
+        BOOST_CHECK(serialBf.predArc(n) == pooledBf.predArc(n));
+        BOOST_CHECK(serialBf.predArc(n) == parallelBf.predArc(n));
+    }
+
+    // the whole tracking is unaffected by the number of threads
+    FlowGraph serialGraph;
+    buildDivisionFlowGraph(serialGraph);
+    double serialEnergy = serialGraph.maxFlowMinCostTracking();
+
+    FlowGraph threadedGraph;
+    buildDivisionFlowGraph(threadedGraph);
+    double threadedEnergy = threadedGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, false, false, 4);
+    BOOST_CHECK_EQUAL(serialEnergy, threadedEnergy);
+    checkSameFlows(serialGraph, threadedGraph);
+}
+
+BOOST_AUTO_TEST_CASE( bellmanford_parallel_ties )
+{
+    typedef lemon::ListDigraph LGraph;
+    typedef LGraph::ArcMap<double> LengthMap;
+    typedef lemon::EarlyStoppingBellmanFord<LGraph, LengthMap> BellmanFord;
+
+    // few different lengths, such that many nodes are reached by equally short paths
+    LGraph g;
+    LengthMap length(g);
+    LGraph::Node s = buildLayeredGraph(g, length);
+    for(LGraph::ArcIt a(g); a != lemon::INVALID; ++a)
+        length[a] = std::floor(length[a]);
+
+    // the predecessors only depend on the chunk size, not on the number of threads running the chunks
+    for(size_t minNodesPerThread : {1, 16, 1024})
+    {
+        std::vector<LGraph::Node> process, nextProcess;
+        BellmanFord serialBf(g, length, process, nextProcess);
+        serialBf.numThreads(1, minNodesPerThread);
+        serialBf.run(s);
+
+        for(size_t numThreads : {2, 3, 4})
+        {
+            std::vector<LGraph::Node> parallelProcess, parallelNextProcess;
+            BellmanFord parallelBf(g, length, parallelProcess, parallelNextProcess);
+            parallelBf.numThreads(numThreads, minNodesPerThread);
+            parallelBf.run(s);
+            for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+            {
+                BOOST_CHECK_EQUAL(serialBf.dist(n), parallelBf.dist(n));
+                BOOST_CHECK(serialBf.predArc(n) == parallelBf.predArc(n));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( residualgraph_layered_sweep )
+{
+    FlowGraph g;
+    buildDivisionFlowGraph(g);
+    g.initializeResidualGraph(true, true);
+    ResidualGraph& r = *g.residualGraph_;
+
+    // before any flow is sent there are no backward arcs, so the graph is layered by timesteps
+    BOOST_CHECK_EQUAL(r.numActiveBackwardArcs_, 0);
+
+    std::map<int, double> sweepDistances;
+    r.bf.init();
+    r.bf.addSource(r.source_, r.nodeUpdateOrderMap_);
+    BOOST_CHECK(r.bf.layeredStart(r.nodeUpdateOrderMap_));
+    for(ResidualGraph::NodeIt n(r); n != lemon::INVALID; ++n)
+        sweepDistances[r.id(n)] = r.bf.dist(n);
+
+    // the same with several threads per layer
+    r.bf.numThreads(3, 1);
+    r.bf.init();
+    r.bf.addSource(r.source_, r.nodeUpdateOrderMap_);
+    BOOST_CHECK(r.bf.layeredStart(r.nodeUpdateOrderMap_));
+    for(ResidualGraph::NodeIt n(r); n != lemon::INVALID; ++n)
+        BOOST_CHECK_EQUAL(sweepDistances[r.id(n)], r.bf.dist(n));
+    r.bf.numThreads(1);
+
+    r.bf.init();
+    r.bf.addSource(r.source_, r.nodeUpdateOrderMap_);
+    BOOST_CHECK(r.bf.checkedStart());
+    for(ResidualGraph::NodeIt n(r); n != lemon::INVALID; ++n)
+        BOOST_CHECK_EQUAL(sweepDistances[r.id(n)], r.bf.dist(n));
+
+    // once flow is sent, backward arcs appear and the sweep detects that the order is violated
+    g.maxFlowMinCostTracking(0.0, true, 1);
+    BOOST_CHECK(r.numActiveBackwardArcs_ > 0);
+    r.bf.init();
+    r.bf.addSource(r.source_, r.nodeUpdateOrderMap_);
+    BOOST_CHECK(!r.bf.layeredStart(r.nodeUpdateOrderMap_));
+}
+
+BOOST_AUTO_TEST_CASE( bellmanford_potential_dijkstra )
+{
+    typedef lemon::ListDigraph LGraph;
+    typedef LGraph::ArcMap<double> LengthMap;
+    typedef lemon::EarlyStoppingBellmanFord<LGraph, LengthMap> BellmanFord;
+
+    LGraph g;
+    LengthMap length(g);
+    LGraph::Node s = buildLayeredGraph(g, length);
+
+    std::vector<LGraph::Node> processA, nextProcessA, processB, nextProcessB;
+    BellmanFord bf(g, length, processA, nextProcessA);
+    bf.run(s);
+
+    // zero potentials leave negative reduced costs, the affected nodes are scanned again
+    BellmanFord dijkstra(g, length, processB, nextProcessB);
+    LGraph::NodeMap<double> potential(g, 0.0);
+    dijkstra.init();
+    dijkstra.addSource(s);
+    BOOST_CHECK(dijkstra.potentialStart(potential, 100 * lemon::countNodes(g)));
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+        BOOST_CHECK_CLOSE(bf.dist(n), dijkstra.dist(n), 1e-9);
+
+    // with the exact distances as potentials every node is scanned exactly once
+    dijkstra.updatePotentials(potential);
+    dijkstra.init();
+    dijkstra.addSource(s);
+    BOOST_CHECK(dijkstra.potentialStart(potential, lemon::countNodes(g)));
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+        BOOST_CHECK_CLOSE(bf.dist(n), dijkstra.dist(n), 1e-9);
+
+    // at the scan limit Bellman-Ford continues from the nodes that have to be scanned again
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+        potential[n] = 0.0;
+    dijkstra.init();
+    dijkstra.addSource(s);
+    BOOST_CHECK(!dijkstra.potentialStart(potential, lemon::countNodes(g) / 2));
+    BOOST_CHECK(dijkstra.predArc(s) == lemon::INVALID);
+    BOOST_CHECK(dijkstra.checkedStart());
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+        BOOST_CHECK_CLOSE(bf.dist(n), dijkstra.dist(n), 1e-9);
+
+    // a negative cycle through the source is reported
+    LGraph::Node last = lemon::INVALID;
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+        if(n != s && (last == lemon::INVALID || bf.dist(n) < bf.dist(last)))
+            last = n;
+    length[g.addArc(last, s)] = -bf.dist(last) - 1.0;
+    dijkstra.init();
+    dijkstra.addSource(s);
+    BOOST_CHECK(!dijkstra.potentialStart(potential, 100 * lemon::countNodes(g)));
+}
+
+BOOST_AUTO_TEST_CASE( bellmanford_partial_update )
+{
+    typedef lemon::ListDigraph LGraph;
+    typedef LGraph::ArcMap<double> LengthMap;
+    typedef lemon::EarlyStoppingBellmanFord<LGraph, LengthMap> BellmanFord;
+
+    LGraph g;
+    LengthMap length(g);
+    LGraph::Node s = buildLayeredGraph(g, length);
+    // the layer index as update order, nodes were created layer by layer
+    lemon::IterableValueMap<LGraph, LGraph::Node, size_t> order(g);
+    for(int id = 0; id <= g.maxNodeId(); ++id)
+    {
+        LGraph::Node n = g.nodeFromId(id);
+        size_t nodeLayer = 0;
+        for(LGraph::InArcIt ia(g, n); ia != lemon::INVALID; ++ia)
+            nodeLayer = std::max(nodeLayer, order[g.source(ia)] + 1);
+        order.set(n, nodeLayer);
+    }
+
+    std::vector<LGraph::Node> processA, nextProcessA, processB, nextProcessB;
+    BellmanFord bf(g, length, processA, nextProcessA);
+    bf.init();
+    bf.addSource(s, order);
+    BOOST_CHECK(bf.checkedStart());
+
+    // make some tree arcs more expensive and some other arcs cheaper, the targets are dirty
+    std::vector<LGraph::Node> dirtyNodes;
+    int k = 0;
+    for(LGraph::ArcIt a(g); a != lemon::INVALID; ++a, ++k)
+    {
+        if(k % 37 == 0)
+        {
+            length[a] += (bf.predArc(g.target(a)) == a) ? 5.0 : -2.0;
+            dirtyNodes.push_back(g.target(a));
+        }
+    }
+    bf.update(dirtyNodes, order);
+    BOOST_CHECK(bf.checkedStart());
+
+    BellmanFord fresh(g, length, processB, nextProcessB);
+    fresh.run(s);
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+        BOOST_CHECK_CLOSE(bf.dist(n), fresh.dist(n), 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE( bellmanford_subtree_disassembly )
+{
+    typedef lemon::ListDigraph LGraph;
+    typedef LGraph::ArcMap<double> LengthMap;
+    typedef lemon::EarlyStoppingBellmanFord<LGraph, LengthMap> BellmanFord;
+
+    LGraph g;
+    LengthMap length(g);
+    LGraph::Node s = buildLayeredGraph(g, length);
+
+    // same distances as lemon's Bellman-Ford without cycles
+    std::vector<LGraph::Node> process, nextProcess;
+    BellmanFord bf(g, length, process, nextProcess);
+    bf.init();
+    bf.addSource(s);
+    BOOST_CHECK(bf.checkedStart());
+    BOOST_CHECK(bf.negativeCycle().empty());
+    lemon::BellmanFord<LGraph, LengthMap> reference(g, length);
+    reference.init();
+    reference.addSource(s);
+    BOOST_CHECK(reference.checkedStart());
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+        BOOST_CHECK_CLOSE(bf.dist(n), reference.dist(n), 1e-9);
+
+    // close a negative cycle from the deepest node back to the first node of its shortest path
+    LGraph::Node deepest = s;
+    size_t deepestLength = 0;
+    for(LGraph::NodeIt n(g); n != lemon::INVALID; ++n)
+    {
+        size_t pathLength = 0;
+        for(LGraph::Node v = n; bf.predArc(v) != lemon::INVALID; v = g.source(bf.predArc(v)))
+            pathLength++;
+        if(pathLength > deepestLength)
+        {
+            deepest = n;
+            deepestLength = pathLength;
+        }
+    }
+    BOOST_REQUIRE(deepestLength > 2);
+    LGraph::Node first = deepest;
+    while(g.source(bf.predArc(first)) != s)
+        first = g.source(bf.predArc(first));
+    length[g.addArc(deepest, first)] = bf.dist(first) - bf.dist(deepest) - 1.0;
+
+    for(size_t numThreads : {1, 4})
+    {
+        BellmanFord cycleBf(g, length, process, nextProcess);
+        cycleBf.numThreads(numThreads, 1);
+        cycleBf.init();
+        cycleBf.addSource(s);
+        BOOST_CHECK(!cycleBf.checkedStart());
+
+        // found as soon as closed, not after a fixed number of rounds
+        BOOST_CHECK(cycleBf.numRounds() <= 2 * (deepestLength + 1));
+        lemon::Path<LGraph> cycle = cycleBf.negativeCycle();
+        BOOST_REQUIRE(cycle.length() > 0);
+        double cycleLength = 0.0;
+        for(int i = 0; i < cycle.length(); i++)
+        {
+            cycleLength += length[cycle.nth(i)];
+            BOOST_CHECK(g.target(cycle.nth(i)) == g.source(cycle.nth((i + 1) % cycle.length())));
+        }
+        BOOST_CHECK(cycleLength < 0.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( bellmanford_cycle_through_disassembled_subtree )
+{
+    typedef lemon::ListDigraph LGraph;
+    typedef LGraph::ArcMap<double> LengthMap;
+    typedef lemon::EarlyStoppingBellmanFord<LGraph, LengthMap> BellmanFord;
+
+    // s reaches a directly and slightly cheaper over a detour, a leads into a negative cycle b, c_1, ..., c_9.
+    // When the detour improves a, the part of the cycle reached so far is disassembled and its stale
+    // distances would keep running around the cycle outside of the tree, killing every subtree that
+    // a grows again and hiding the cycle until the round limit.
+    LGraph g;
+    LengthMap length(g);
+    LGraph::Node s = g.addNode();
+    LGraph::Node a = g.addNode();
+    length[g.addArc(s, a)] = 10.0;
+    LGraph::Node previous = s;
+    for(int i = 0; i < 4; ++i)
+    {
+        LGraph::Node x = g.addNode();
+        length[g.addArc(previous, x)] = 0.0;
+        previous = x;
+    }
+    length[g.addArc(previous, a)] = 9.5;
+
+    std::vector<LGraph::Node> cycleNodes(1, g.addNode());
+    length[g.addArc(a, cycleNodes[0])] = 1.0;
+    for(int i = 0; i < 9; ++i)
+    {
+        cycleNodes.push_back(g.addNode());
+        length[g.addArc(cycleNodes[i], cycleNodes[i + 1])] = 1.0;
+    }
+    length[g.addArc(cycleNodes.back(), cycleNodes[0])] = -10.0;
+
+    // unrelated nodes make the round limit large
+    for(int i = 0; i < 1000; ++i)
+        g.addNode();
+
+    for(size_t numThreads : {1, 4})
+    {
+        std::vector<LGraph::Node> process, nextProcess;
+        BellmanFord bf(g, length, process, nextProcess);
+        bf.numThreads(numThreads, 1);
+        bf.init();
+        bf.addSource(s);
+        BOOST_CHECK(!bf.checkedStart());
+
+        // detected once the subtree regrown from a closes the cycle
+        BOOST_CHECK(bf.numRounds() <= 2 * (6 + cycleNodes.size()));
+        lemon::Path<LGraph> cycle = bf.negativeCycle();
+        BOOST_REQUIRE_EQUAL(cycle.length(), int(cycleNodes.size()));
+        for(int i = 0; i < cycle.length(); ++i)
+            BOOST_CHECK(std::find(cycleNodes.begin(), cycleNodes.end(), g.source(cycle.nth(i))) != cycleNodes.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_dijkstra )
+{
+    FlowGraph bfGraph;
+    buildDivisionFlowGraph(bfGraph);
+    double bfEnergy = bfGraph.maxFlowMinCostTracking();
+
+    FlowGraph dijkstraGraph;
+    buildDivisionFlowGraph(dijkstraGraph);
+    double dijkstraEnergy = dijkstraGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, false, false, 1, true);
+    BOOST_CHECK_EQUAL(bfEnergy, dijkstraEnergy);
+    checkSameFlows(bfGraph, dijkstraGraph);
+
+    FlowGraph csrDijkstraGraph;
+    buildDivisionFlowGraph(csrDijkstraGraph);
+    BOOST_CHECK_EQUAL(csrDijkstraGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, false, true, 1, true), bfEnergy);
+    checkSameFlows(bfGraph, csrDijkstraGraph);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_batch_augmentation )
+{
+    // independent chains of detections, all found in the first shortest path tree
+    auto buildChains = [](FlowGraph& g)
+    {
+        const size_t numChains = 5;
+        const size_t numTimesteps = 3;
+        std::vector<FlowGraph::FullNode> previous;
+        for(size_t t = 0; t < numTimesteps; ++t)
+        {
+            std::vector<FlowGraph::FullNode> current;
+            for(size_t c = 0; c < numChains; ++c)
+            {
+                FlowGraph::FullNode n = g.addNode({-2.0 - 0.1 * c}, t);
+                if(t == 0)
+                    g.addArc(g.getSource(), n.u, {0.0});
+                else
+                    g.addArc(g.getSource(), n.u, {5.0});
+                if(t == numTimesteps - 1)
+                    g.addArc(n.v, g.getTarget(), {0.0});
+                else
+                    g.addArc(n.v, g.getTarget(), {5.0});
+                if(t > 0)
+                    for(size_t p = 0; p < numChains; ++p)
+                        g.addArc(previous[p], n, {p == c ? -1.0 : 3.0});
+                current.push_back(n);
+            }
+            previous = current;
+        }
+    };
+
+    FlowGraph sequentialGraph;
+    buildChains(sequentialGraph);
+    double sequentialEnergy = sequentialGraph.maxFlowMinCostTracking();
+
+    FlowGraph batchGraph;
+    buildChains(batchGraph);
+    double batchEnergy = batchGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, false, false, 1, false, 10);
+    BOOST_CHECK_CLOSE(sequentialEnergy, batchEnergy, 1e-9);
+    checkSameFlows(sequentialGraph, batchGraph);
+
+    // the path limit counts every augmented path of a batch
+    FlowGraph limitedGraph;
+    buildChains(limitedGraph);
+    limitedGraph.maxFlowMinCostTracking(0.0, true, 3, true, true, false, false, 1, false, 10);
+    int numTracks = 0;
+    for(FlowGraph::Graph::OutArcIt oa(limitedGraph.getGraph(), limitedGraph.getSource()); oa != lemon::INVALID; ++oa)
+        numTracks += limitedGraph.getFlowMap()[oa];
+    BOOST_CHECK_EQUAL(numTracks, 3);
+
+    // the first tree holds one path per chain, further paths must be nearly as cheap as the shortest one
+    FlowGraph treeGraph;
+    buildChains(treeGraph);
+    treeGraph.initializeResidualGraph(true, true);
+    ResidualGraph& r = *treeGraph.residualGraph_;
+    ResidualGraph::ShortestPathResult shortestPath = r.findShortestPath(treeGraph.targets_);
+    std::vector<int> conflictKeys = treeGraph.conflictKeys();
+    std::vector<ResidualGraph::ShortestPathResult> treePaths = r.collectDisjointTreePaths(
+        shortestPath, treeGraph.targets_, conflictKeys, 10);
+    BOOST_CHECK_EQUAL(treePaths.size(), 5);
+    for(size_t i = 1; i < treePaths.size(); ++i)
+        BOOST_CHECK(treePaths[i - 1].second <= treePaths[i].second);
+    BOOST_CHECK_EQUAL(r.collectDisjointTreePaths(shortestPath, treeGraph.targets_, conflictKeys, 3).size(), 3);
+    BOOST_CHECK_EQUAL(r.collectDisjointTreePaths(shortestPath, treeGraph.targets_, conflictKeys, 10, 0.999).size(), 1);
+
+    // paths sharing a key are never taken together
+    std::fill(conflictKeys.begin(), conflictKeys.end(), 0);
+    conflictKeys[treeGraph.getGraph().id(treeGraph.getSource())] = -1;
+    for(const FlowGraph::Node& t : treeGraph.targets_)
+        conflictKeys[treeGraph.getGraph().id(t)] = -1;
+    BOOST_CHECK_EQUAL(r.collectDisjointTreePaths(shortestPath, treeGraph.targets_, conflictKeys, 10).size(), 1);
+
+    // paths through a division share the arcs of their parent and are never augmented together with it
+    FlowGraph divisionGraph;
+    buildDivisionFlowGraph(divisionGraph);
+    FlowGraph batchDivisionGraph;
+    buildDivisionFlowGraph(batchDivisionGraph);
+    BOOST_CHECK_EQUAL(divisionGraph.maxFlowMinCostTracking(), 
+                      batchDivisionGraph.maxFlowMinCostTracking(0.0, true, 0, true, true, false, false, 1, false, 10));
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_retracking )
+{
+    // chains of detections, with the nodes and links of every timestep
+    struct Chains
+    {
+        std::vector<std::vector<FlowGraph::FullNode>> nodes;
+        std::vector<FlowGraph::Arc> links;
+    };
+    auto buildChains = [](FlowGraph& g)
+    {
+        Chains chains;
+        const size_t numChains = 4;
+        for(size_t t = 0; t < 3; ++t)
+        {
+            chains.nodes.push_back(std::vector<FlowGraph::FullNode>());
+            for(size_t c = 0; c < numChains; ++c)
+            {
+                FlowGraph::FullNode n = g.addNode({-2.0 - 0.1 * c}, t);
+                g.addArc(g.getSource(), n.u, {t == 0 ? 0.0 : 5.0});
+                g.addArc(n.v, g.getTarget(), {t == 2 ? 0.0 : 5.0});
+                if(t > 0)
+                    for(size_t p = 0; p < numChains; ++p)
+                        chains.links.push_back(g.addArc(chains.nodes[t - 1][p], n, {p == c ? -1.0 : 0.5}));
+                chains.nodes.back().push_back(n);
+            }
+        }
+        return chains;
+    };
+
+    // every modification is applied to a tracked graph and to a fresh copy that is tracked from scratch
+    std::vector<std::function<void(FlowGraph&, Chains&)>> modifications = {
+        [](FlowGraph& g, Chains& c){ g.setArcCosts(c.links[0], {4.0}); },
+        [](FlowGraph& g, Chains& c){ g.setArcCosts(c.nodes[1][2].a, {3.0}); },
+        [](FlowGraph& g, Chains& c){ g.removeNode(c.nodes[1][1]); },
+        [](FlowGraph& g, Chains& c){ g.removeArc(c.links[5]); },
+        [](FlowGraph& g, Chains& c){ 
+            FlowGraph::FullNode n = g.addNode({-3.0}, 3);
+            g.addArc(c.nodes[2][0], n, {-1.0});
+            g.addArc(n.v, g.getTarget(), {0.0});
+        }
+    };
+
+    FlowGraph warmGraph;
+    Chains warmChains = buildChains(warmGraph);
+    double energy = warmGraph.maxFlowMinCostTracking();
+    BOOST_CHECK_CLOSE(energy, warmGraph.getFlowEnergy(), 1e-9);
+
+    FlowGraph coldGraph;
+    Chains coldChains = buildChains(coldGraph);
+    for(auto& modify : modifications)
+    {
+        modify(warmGraph, warmChains);
+        double warmEnergy = warmGraph.maxFlowMinCostRetracking();
+        BOOST_CHECK_CLOSE(warmEnergy, warmGraph.getFlowEnergy(), 1e-9);
+
+        modify(coldGraph, coldChains);
+        coldGraph.invalidateResidualGraph();
+        for(FlowGraph::Graph::ArcIt a(coldGraph.getGraph()); a != lemon::INVALID; ++a)
+            coldGraph.getFlowMap()[a] = 0;
+        BOOST_CHECK_CLOSE(warmEnergy, coldGraph.maxFlowMinCostTracking(), 1e-9);
+    }
+
+    // removing a used division leaves a feasible flow that can be improved again
+    FlowGraph divisionGraph;
+    buildDivisionFlowGraph(divisionGraph);
+    energy = divisionGraph.maxFlowMinCostTracking();
+    BOOST_CHECK_CLOSE(energy, divisionGraph.getFlowEnergy(), 1e-9);
+
+    FlowGraph::Graph::OutArcIt divisionArc(divisionGraph.getGraph(), divisionGraph.getSource());
+    for(; divisionArc != lemon::INVALID; ++divisionArc)
+    {
+        if(divisionGraph.duplicateToParentMap_.count(divisionGraph.getGraph().target(divisionArc)) > 0 
+            && divisionGraph.getFlowMap()[divisionArc] > 0)
+            break;
+    }
+    BOOST_REQUIRE(divisionArc != lemon::INVALID);
+    divisionGraph.removeArc(divisionArc);
+    for(FlowGraph::Graph::ArcIt a(divisionGraph.getGraph()); a != lemon::INVALID; ++a)
+        BOOST_CHECK(divisionGraph.getFlowMap()[a] >= 0);
+    checkFlowConservation(divisionGraph);
+    double removedEnergy = divisionGraph.getFlowEnergy();
+    BOOST_CHECK(removedEnergy > energy);
+
+    double repairedEnergy = divisionGraph.maxFlowMinCostRetracking();
+    BOOST_CHECK(repairedEnergy <= removedEnergy);
+    BOOST_CHECK_CLOSE(repairedEnergy, divisionGraph.getFlowEnergy(), 1e-9);
+    checkFlowConservation(divisionGraph);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_streaming_window )
+{
+    // chains of detections with one swapped link per timestep, fed to the tracker frame by frame
+    const size_t numTimesteps = 12;
+    const size_t numChains = 3;
+    auto feed = [&](std::function<void(size_t)> finishTimestep, GraphBuilder& builder)
+    {
+        for(size_t t = 0; t < numTimesteps; ++t)
+        {
+            for(size_t c = 0; c < numChains; ++c)
+            {
+                size_t id = t * numChains + c;
+                builder.setNodeTimesteps(id, std::make_pair(t, t));
+                builder.addNode(id, {0.0, -2.0}, {-2.0 - 0.1 * c}, {t == 0 ? 0.0 : 5.0}, {t + 1 == numTimesteps ? 0.0 : 5.0}, 0);
+                if(t > 0)
+                    for(size_t p = 0; p < numChains; ++p)
+                        builder.addArc((t - 1) * numChains + p, id, {(p + t) % numChains == c ? -1.0 : 0.5});
+            }
+            if(t % 4 == 1)
+                builder.allowMitosis(t * numChains, -0.5);
+            finishTimestep(t);
+        }
+    };
+
+    FlowGraph fullGraph;
+    FlowGraphBuilder fullBuilder(&fullGraph);
+    feed([](size_t){}, fullBuilder);
+    double fullEnergy = fullGraph.maxFlowMinCostTracking();
+
+    for(size_t windowSize : {size_t(1), size_t(3), numTimesteps})
+    {
+        std::vector<size_t> committedTimesteps;
+        size_t numCommittedLinks = 0;
+        StreamingFlowTracker tracker(windowSize, [&](const StreamingFlowTracker::TimestepResult& result){
+            committedTimesteps.push_back(result.timestep);
+            for(auto& link : result.arcValues)
+                numCommittedLinks += link.second;
+            BOOST_CHECK_EQUAL(result.nodeValues.size(), numChains);
+        });
+
+        size_t maxNumNodes = 0;
+        feed([&](size_t t){
+            tracker.finishTimestep(t);
+            BOOST_CHECK(tracker.getNumWindowTimesteps() <= windowSize);
+            maxNumNodes = std::max(maxNumNodes, (size_t)lemon::countNodes(tracker.graph_.getGraph()));
+        }, tracker);
+        double energy = tracker.getEnergy();
+        tracker.flush();
+
+        BOOST_CHECK_CLOSE(energy, tracker.getEnergy(), 1e-9);
+        BOOST_CHECK_EQUAL(tracker.getNumWindowNodes(), 0);
+        BOOST_REQUIRE_EQUAL(committedTimesteps.size(), numTimesteps);
+        for(size_t t = 0; t < numTimesteps; ++t)
+            BOOST_CHECK_EQUAL(committedTimesteps[t], t);
+
+        // the flow graph only holds the window: two nodes per detection, duplicates, source and target
+        BOOST_CHECK(maxNumNodes <= 2 + (windowSize + 1) * (2 * numChains + 1));
+
+        // every chain is followed through all timesteps, which is optimal even with the shortest window here
+        BOOST_CHECK_EQUAL(numCommittedLinks, (numTimesteps - 1) * numChains);
+        BOOST_CHECK_CLOSE(energy, fullEnergy, 1e-9);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_connected_components )
+{
+    // independent groups of parallel chains, one of them with a division, that share no links
+    const size_t numGroups = 5;
+    const size_t numTimesteps = 6;
+    const size_t numChains = 3;
+    auto build = [&](GraphBuilder& builder)
+    {
+        for(size_t g = 0; g < numGroups; ++g)
+        {
+            for(size_t t = 0; t < numTimesteps; ++t)
+            {
+                for(size_t c = 0; c < numChains; ++c)
+                {
+                    size_t id = (g * numTimesteps + t) * numChains + c;
+                    builder.setNodeTimesteps(id, std::make_pair(t, t));
+                    builder.addNode(id, {0.0, -2.0}, {-2.0 - 0.1 * c - 0.01 * g}, {t == 0 ? 0.0 : 5.0}, {t + 1 == numTimesteps ? 0.0 : 5.0}, 0);
+                    if(t > 0)
+                        for(size_t p = 0; p < numChains; ++p)
+                            builder.addArc(id - numChains - c + p, id, {p == c ? -1.0 - 0.01 * p : 0.5});
+                }
+            }
+            if(g == 2)
+                builder.allowMitosis((g * numTimesteps + 2) * numChains, -3.0);
+        }
+    };
+
+    FlowGraph fullGraph;
+    FlowGraphBuilder fullBuilder(&fullGraph);
+    build(fullBuilder);
+    double fullEnergy = fullGraph.maxFlowMinCostTracking();
+
+    for(size_t minNodesPerGraph : {size_t(1), size_t(20), size_t(256)})
+    {
+        ComponentFlowGraphBuilder componentBuilder(minNodesPerGraph);
+        build(componentBuilder);
+        double energy = componentBuilder.solve([](FlowGraph& g){ return g.maxFlowMinCostTracking(); }, 3);
+
+        // small components are packed into the same flow graph
+        size_t nodesPerGroup = numTimesteps * numChains;
+        BOOST_CHECK_EQUAL(componentBuilder.getNumComponentGraphs(), (numGroups + (minNodesPerGraph + nodesPerGroup - 1) / nodesPerGroup - 1) / ((minNodesPerGraph + nodesPerGroup - 1) / nodesPerGroup));
+        BOOST_CHECK_CLOSE(energy, fullEnergy, 1e-9);
+        BOOST_CHECK(componentBuilder.getNodeValues() == fullBuilder.getNodeValues());
+        BOOST_CHECK(componentBuilder.getArcValues() == fullBuilder.getArcValues());
+        BOOST_CHECK(componentBuilder.getDivisionValues() == fullBuilder.getDivisionValues());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( json_binary_model_roundtrip )
+{
+    // links stored before the detections, with comments, a division and disappearance features
+    std::ofstream("roundtrip_model.json") << R"({
+        "linkingHypotheses" : [
+            {"src" : 1, "dest" : 3, "features" : [[0], [-1.5]]},
+            {"src" : 1, "dest" : 4, "features" : [[0], [-1.2]]},
+            {"src" : 2, "dest" : 4, "features" : [[0], [-1.0]]}
+        ],
+        // detections
+        "segmentationHypotheses" : [
+            {"id" : 1, "timestep" : [0, 0], "features" : [[1.0], [-2.0], [-1.0]], "appearanceFeatures" : [[0], [0.5], [2]],
+             "divisionFeatures" : [[0], [-1.0]]},
+            {"id" : 2, "timestep" : [0, 0], "features" : [[1.0], [-1.0]], "appearanceFeatures" : [[0], [0.5]]},
+            {"id" : 3, "timestep" : [1, 1], "features" : [[1.0], [-2.0]], "disappearanceFeatures" : [[0], [0.5]]},
+            {"id" : 4, "timestep" : [1, 1], "features" : [[1.0], [-2.0], [-3.0]], "disappearanceFeatures" : [[0], [0.5], [2]]}
+        ],
+        "settings" : {"statesShareWeights" : true, "optimizerNumThreads" : 2}
+    })";
+    std::ofstream("roundtrip_weights.json") << R"({"weights" : [1.0, 1.0, 1.0, 1.0, 1.0]})";
+
+    auto solve = [](const std::string& modelFilename, GraphBuilder::ArcValueMap& arcValues, GraphBuilder::DivisionValueMap& divisionValues)
+    {
+        FlowGraph graph;
+        FlowGraphBuilder builder(&graph);
+        JsonGraphReader reader(modelFilename, "roundtrip_weights.json", &builder);
+        reader.createGraphFromJson();
+        BOOST_CHECK_EQUAL(reader.getNumThreads(), 2);
+        double energy = graph.maxFlowMinCostTracking(reader.getInitialStateEnergy());
+        arcValues = builder.getArcValues();
+        divisionValues = builder.getDivisionValues();
+        return energy;
+    };
+
+    {
+        FlowGraph graph;
+        FlowGraphBuilder builder(&graph);
+        JsonGraphReader("roundtrip_model.json", "", &builder).convertToBinary("roundtrip_model.bin");
+    }
+
+    GraphBuilder::ArcValueMap jsonArcValues, binaryArcValues;
+    GraphBuilder::DivisionValueMap jsonDivisionValues, binaryDivisionValues;
+    double jsonEnergy = solve("roundtrip_model.json", jsonArcValues, jsonDivisionValues);
+    double binaryEnergy = solve("roundtrip_model.bin", binaryArcValues, binaryDivisionValues);
+
+    BOOST_CHECK_EQUAL(jsonEnergy, binaryEnergy);
+    BOOST_CHECK(jsonArcValues == binaryArcValues);
+    BOOST_CHECK(jsonDivisionValues == binaryDivisionValues);
+    BOOST_CHECK_EQUAL(jsonArcValues[std::make_pair(size_t(1), size_t(3))], 1);
+    BOOST_CHECK(jsonDivisionValues[1]);
+
+    // the weight layout is stored with the binary model
+    std::ofstream("roundtrip_weights.json") << R"({"weights" : [1.0, 1.0]})";
+    GraphBuilder::ArcValueMap arcValues;
+    GraphBuilder::DivisionValueMap divisionValues;
+    BOOST_CHECK_THROW(solve("roundtrip_model.bin", arcValues, divisionValues), std::runtime_error);
+
+    std::remove("roundtrip_model.json");
+    std::remove("roundtrip_model.bin");
+    std::remove("roundtrip_weights.json");
+}
+
+BOOST_AUTO_TEST_CASE( json_result_streaming )
+{
+    std::ofstream("result_model.json") << R"({
+        "segmentationHypotheses" : [
+            {"id" : 1, "timestep" : [0, 0], "features" : [[1.0], [-2.0], [-1.0]], "appearanceFeatures" : [[0], [0.5], [2]],
+             "divisionFeatures" : [[0], [-1.0]]},
+            {"id" : 2, "timestep" : [0, 0], "features" : [[1.0], [-1.0]], "appearanceFeatures" : [[0], [0.5]]},
+            {"id" : 3, "timestep" : [1, 1], "features" : [[1.0], [-2.0]], "disappearanceFeatures" : [[0], [0.5]]},
+            {"id" : 4, "timestep" : [1, 1], "features" : [[1.0], [-2.0], [-3.0]], "disappearanceFeatures" : [[0], [0.5], [2]]}
+        ],
+        "linkingHypotheses" : [
+            {"src" : 1, "dest" : 3, "features" : [[0], [-1.5]]},
+            {"src" : 1, "dest" : 4, "features" : [[0], [-1.2]]},
+            {"src" : 2, "dest" : 4, "features" : [[0], [-1.0]]}
+        ],
+        "settings" : {"statesShareWeights" : true}
+    })";
+    std::ofstream("result_weights.json") << R"({"weights" : [1.0, 1.0, 1.0, 1.0, 1.0]})";
+
+    // the result as it used to be written, through a jsoncpp value
+    auto domResult = [](GraphBuilder& builder)
+    {
+        Json::Value root;
+        Json::Value& links = root["linkingResults"];
+        for(auto iter : builder.getArcValues())
+        {
+            if(iter.second == 0)
+                continue;
+            Json::Value val;
+            val["src"] = Json::Value((unsigned int)iter.first.first);
+            val["dest"] = Json::Value((unsigned int)iter.first.second);
+            val["value"] = Json::Value((unsigned int)iter.second);
+            links.append(val);
+        }
+        Json::Value& divisions = root["divisionResults"];
+        for(auto iter : builder.getDivisionValues())
+        {
+            if(!iter.second)
+                continue;
+            Json::Value val;
+            val["id"] = Json::Value((unsigned int)iter.first);
+            val["value"] = Json::Value(true);
+            divisions.append(val);
+        }
+        Json::Value& detections = root["detectionResults"];
+        for(auto iter : builder.getNodeValues())
+        {
+            if(iter.second == 0)
+                continue;
+            Json::Value val;
+            val["id"] = Json::Value((unsigned int)iter.first);
+            val["value"] = Json::Value((unsigned int)iter.second);
+            detections.append(val);
+        }
+        std::stringstream s;
+        s << root << std::endl;
+        return s.str();
+    };
+    auto readFile = [](const std::string& filename)
+    {
+        std::ifstream input(filename.c_str(), std::ios::binary);
+        std::stringstream s;
+        s << input.rdbuf();
+        return s.str();
+    };
+
+    FlowGraph graph;
+    FlowGraphBuilder builder(&graph);
+    JsonGraphReader reader("result_model.json", "result_weights.json", &builder);
+    reader.createGraphFromJson();
+
+    // nothing tracked yet: all result arrays are null
+    reader.saveResultJson("result.json");
+    BOOST_CHECK_EQUAL(readFile("result.json"), domResult(builder));
+
+    graph.maxFlowMinCostTracking(reader.getInitialStateEnergy());
+    reader.saveResultJson("result.json");
+    BOOST_CHECK_EQUAL(readFile("result.json"), domResult(builder));
+
+    // the binary result holds the same used hypotheses, column by column
+    reader.saveResultBinary("result.bin");
+    std::string binary = readFile("result.bin");
+    BOOST_REQUIRE(binary.size() >= sizeof(BinaryResultHeader));
+    BinaryResultHeader header;
+    std::memcpy(&header, binary.data(), sizeof(header));
+    BOOST_CHECK(header.hasValidMagic());
+    BOOST_REQUIRE_EQUAL(binary.size(), sizeof(header) + 8 * (2 * header.numDetections + 3 * header.numLinks + header.numDivisions));
+    const uint64_t* columns = reinterpret_cast<const uint64_t*>(binary.data() + sizeof(header));
+
+    std::vector<std::pair<size_t, size_t> > nodeValues;
+    builder.visitNodeValues([&](size_t id, size_t value){ nodeValues.push_back(std::make_pair(id, value)); });
+    BOOST_REQUIRE_EQUAL(header.numDetections, nodeValues.size());
+    for(size_t i = 0; i < nodeValues.size(); i++)
+    {
+        BOOST_CHECK_EQUAL(columns[i], nodeValues[i].first);
+        BOOST_CHECK_EQUAL(columns[header.numDetections + i], nodeValues[i].second);
+    }
+    columns += 2 * header.numDetections;
+
+    GraphBuilder::ArcValueMap arcValues = builder.getArcValues();
+    for(size_t i = 0; i < header.numLinks; i++)
+        BOOST_CHECK_EQUAL(arcValues[std::make_pair(columns[i], columns[header.numLinks + i])], columns[2 * header.numLinks + i]);
+    columns += 3 * header.numLinks;
+
+    GraphBuilder::DivisionValueMap divisionValues = builder.getDivisionValues();
+    BOOST_CHECK_EQUAL(header.numDivisions, 1);
+    BOOST_CHECK(divisionValues[columns[0]]);
+
+    std::remove("result_model.json");
+    std::remove("result_weights.json");
+    std::remove("result.json");
+    std::remove("result.bin");
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_telemetry )
+{
+    FlowGraph g;
+    typedef FlowGraph::FullNode Node;
+
+    Node n_1_1 = g.addNode({0.0});
+    Node n_1_2 = g.addNode({0.0});
+    Node n_2_1 = g.addNode({0.0});
+    Node n_2_2 = g.addNode({0.0});
+
+    FlowGraph::Node s = g.getSource();
+    FlowGraph::Node t = g.getTarget();
+
+    g.addArc(s, n_1_1.u, {0.0});
+    g.addArc(s, n_1_2.u, {0.0});
+    g.addArc(n_1_1, n_2_1, {-4.0});
+    g.addArc(n_1_1, n_2_2, {-3.0});
+    g.addArc(n_1_2, n_2_2, {-1.0});
+    g.addArc(n_2_1.v, t, {-2.0});
+    g.addArc(n_2_2.v, t, {-2.0});
+    g.allowMitosis(n_1_1, -4.0);
+
+    SolverTelemetry telemetry("flow");
+    g.setTelemetry(&telemetry);
+    double energy = g.maxFlowMinCostTracking();
+
+    // one iteration per augmented path, and the final search that finds no improvement
+    const std::vector<IterationTelemetry>& iterations = telemetry.getIterations();
+    BOOST_REQUIRE(iterations.size() >= 2);
+    IterationTelemetry totals = telemetry.getTotals();
+    BOOST_CHECK_EQUAL(totals.numPaths, iterations.size() - 1);
+    BOOST_CHECK_EQUAL(iterations.back().numPaths, 0);
+    BOOST_CHECK_EQUAL(totals.energy, energy);
+    BOOST_CHECK_SMALL(totals.pathCost - energy, 1e-9);
+    BOOST_CHECK(totals.bfRounds > 0);
+    BOOST_CHECK(totals.relaxations > 0);
+    BOOST_CHECK(totals.arcsToggled > 0);
+    for(size_t i = 0; i < iterations.size(); i++)
+        BOOST_CHECK_EQUAL(iterations[i].iteration, i);
+
+    std::stringstream csv;
+    telemetry.writeCsv(csv);
+    std::string header;
+    std::getline(csv, header);
+    BOOST_CHECK_EQUAL(header.substr(0, 18), "iteration,seconds,");
+    size_t numLines = 0;
+    for(std::string line; std::getline(csv, line);)
+        numLines++;
+    BOOST_CHECK_EQUAL(numLines, iterations.size());
+
+    // without telemetry the next run records nothing
+    g.setTelemetry(nullptr);
+    g.resetFlow();
+    BOOST_CHECK_EQUAL(g.maxFlowMinCostTracking(), energy);
+    BOOST_CHECK_EQUAL(telemetry.getIterations().size(), iterations.size());
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_local_cycle_repair )
+{
+    // the greedy first paths have to be rerouted through a negative cycle
+    std::ofstream("cycle_model.json") << R"({
+        "settings" : {"statesShareWeights" : true, "requireSeparateChildrenOfDivision" : true},
+        "segmentationHypotheses" : [
+            {"id" : 2, "timestep" : [1, 1], "features" : [[1.0], [0.0]], "divisionFeatures" : [[0], [-5]], "appearanceFeatures" : [[0], [0]], "disappearanceFeatures" : [[0], [50]]},
+            {"id" : 3, "timestep" : [1, 1], "features" : [[1.0], [0.0]], "divisionFeatures" : [[0], [-5]], "appearanceFeatures" : [[0], [0]], "disappearanceFeatures" : [[0], [50]]},
+            {"id" : 4, "timestep" : [2, 2], "features" : [[1.0], [0.0]], "appearanceFeatures" : [[0], [50]], "disappearanceFeatures" : [[0], [-2]]},
+            {"id" : 5, "timestep" : [2, 2], "features" : [[1.0], [0.0]], "appearanceFeatures" : [[0], [50]], "disappearanceFeatures" : [[0], [-2]]},
+            {"id" : 6, "timestep" : [2, 2], "features" : [[1.0], [0.0]], "appearanceFeatures" : [[0], [50]], "disappearanceFeatures" : [[0], [-4]]}
+        ],
+        "linkingHypotheses" : [
+            {"src" : 2, "dest" : 4, "features" : [[0], [-4]]},
+            {"src" : 2, "dest" : 5, "features" : [[0], [-3]]},
+            {"src" : 3, "dest" : 5, "features" : [[0], [-1]]},
+            {"src" : 3, "dest" : 6, "features" : [[0], [-4]]}
+        ]
+    })";
+    std::ofstream("cycle_weights.json") << R"({"weights" : [1.0, 1.0, 1.0, 1.0, 1.0]})";
+
+    auto solve = [](bool localCycleRepair, bool useCsrBackend, GraphBuilder::ArcValueMap& arcValues, IterationTelemetry& totals)
+    {
+        FlowGraph graph;
+        FlowGraphBuilder builder(&graph);
+        JsonGraphReader reader("cycle_model.json", "cycle_weights.json", &builder);
+        reader.createGraphFromJson();
+        SolverTelemetry telemetry("flow");
+        graph.setTelemetry(&telemetry);
+        graph.setLocalCycleRepair(localCycleRepair);
+        double energy = graph.maxFlowMinCostTracking(reader.getInitialStateEnergy(), true, 0, true, true, false, useCsrBackend);
+        arcValues = builder.getArcValues();
+        totals = telemetry.getTotals();
+        return energy;
+    };
+
+    GraphBuilder::ArcValueMap restartArcValues;
+    IterationTelemetry restartTotals;
+    double restartEnergy = solve(false, false, restartArcValues, restartTotals);
+    BOOST_CHECK_EQUAL(restartEnergy, -24.0);
+    BOOST_REQUIRE(restartTotals.negativeCycles > 0);
+    BOOST_CHECK_EQUAL(restartTotals.cycleRepairs, 0);
+
+    for(bool useCsrBackend : {false, true})
+    {
+        GraphBuilder::ArcValueMap arcValues;
+        IterationTelemetry totals;
+        BOOST_CHECK_EQUAL(solve(true, useCsrBackend, arcValues, totals), restartEnergy);
+        BOOST_CHECK(arcValues == restartArcValues);
+        BOOST_CHECK_EQUAL(totals.negativeCycles, restartTotals.negativeCycles);
+        BOOST_CHECK_EQUAL(totals.cycleRepairs, totals.negativeCycles);
+    }
+
+    std::remove("cycle_model.json");
+    std::remove("cycle_weights.json");
+}
+
+BOOST_AUTO_TEST_CASE( compiled_model_weight_sweep )
+{
+    std::ofstream("sweep_model.json") << R"({
+        "segmentationHypotheses" : [
+            {"id" : 1, "timestep" : [0, 0], "features" : [[1.0], [-2.0], [-1.0]], "appearanceFeatures" : [[0], [0.5], [2]],
+             "divisionFeatures" : [[0], [-1.0]]},
+            {"id" : 2, "timestep" : [0, 0], "features" : [[1.0], [-1.0]], "appearanceFeatures" : [[0], [0.5]]},
+            {"id" : 3, "timestep" : [1, 1], "features" : [[1.0], [-2.0]], "disappearanceFeatures" : [[0], [0.5]]},
+            {"id" : 4, "timestep" : [1, 1], "features" : [[1.0], [-2.0], [-3.0]], "disappearanceFeatures" : [[0], [0.5], [2]]}
+        ],
+        "linkingHypotheses" : [
+            {"src" : 1, "dest" : 3, "features" : [[0], [-1.5]]},
+            {"src" : 1, "dest" : 4, "features" : [[0], [-1.2]]},
+            {"src" : 2, "dest" : 4, "features" : [[0], [-1.0]]}
+        ],
+        "settings" : {"statesShareWeights" : true}
+    })";
+
+    std::vector< std::vector<double> > sweep = {
+        {1.0, 1.0, 1.0, 1.0, 1.0}, 
+        {0.5, 2.0, 0.1, 1.0, 3.0}, 
+        {2.0, 0.2, 5.0, 0.5, 0.1},
+        {1.0, 1.0, 1.0, 1.0, 1.0}};
+
+    auto writeWeights = [](const std::vector<double>& weights)
+    {
+        std::ofstream weightsFile("sweep_weights.json");
+        weightsFile << "{\"weights\" : [";
+        for(size_t i = 0; i < weights.size(); i++)
+            weightsFile << (i > 0 ? ", " : "") << weights[i];
+        weightsFile << "]}";
+    };
+
+    writeWeights(sweep[0]);
+    FlowGraph compiledGraph;
+    CompiledModel compiledModel(&compiledGraph);
+    JsonGraphReader("sweep_model.json", "sweep_weights.json", &compiledModel).createGraphFromJson();
+    BOOST_CHECK_EQUAL(compiledModel.getNumWeights(), 5);
+    BOOST_CHECK_THROW(compiledModel.setWeights({1.0, 1.0}), std::runtime_error);
+
+    for(const std::vector<double>& weights : sweep)
+    {
+        writeWeights(weights);
+        FlowGraph graph;
+        FlowGraphBuilder builder(&graph);
+        JsonGraphReader reader("sweep_model.json", "sweep_weights.json", &builder);
+        reader.createGraphFromJson();
+        double energy = graph.maxFlowMinCostTracking(reader.getInitialStateEnergy());
+
+        compiledModel.setWeights(weights);
+        BOOST_CHECK_SMALL(compiledModel.getInitialStateEnergy() - reader.getInitialStateEnergy(), 1e-9);
+        double compiledEnergy = compiledGraph.maxFlowMinCostTracking(compiledModel.getInitialStateEnergy());
+        BOOST_CHECK_SMALL(compiledEnergy - energy, 1e-9);
+        BOOST_CHECK(compiledModel.getNodeValues() == builder.getNodeValues());
+        BOOST_CHECK(compiledModel.getArcValues() == builder.getArcValues());
+        BOOST_CHECK(compiledModel.getDivisionValues() == builder.getDivisionValues());
+    }
+
+    std::remove("sweep_model.json");
+    std::remove("sweep_weights.json");
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_anytime )
+{
+    FlowGraph g;
+    typedef FlowGraph::FullNode Node;
+
+    Node n_1_1 = g.addNode({0.0});
+    Node n_1_2 = g.addNode({0.0});
+    Node n_2_1 = g.addNode({0.0});
+    Node n_2_2 = g.addNode({0.0});
+
+    FlowGraph::Node s = g.getSource();
+    FlowGraph::Node t = g.getTarget();
+
+    g.addArc(s, n_1_1.u, {0.0});
+    g.addArc(s, n_1_2.u, {0.0});
+    g.addArc(n_1_1, n_2_1, {-4.0});
+    g.addArc(n_1_1, n_2_2, {-3.0});
+    g.addArc(n_1_2, n_2_2, {-1.0});
+    g.addArc(n_2_1.v, t, {-2.0});
+    g.addArc(n_2_2.v, t, {-2.0});
+    g.allowMitosis(n_1_1, -4.0);
+
+    // the callback sees every intermediate solution, whose flow matches the reported energy
+    std::vector<FlowGraph::Progress> progress;
+    g.setProgressCallback([&](const FlowGraph::Progress& p){
+        BOOST_CHECK_SMALL(g.getFlowEnergy() - p.energy, 1e-9);
+        progress.push_back(p);
+        return true;
+    });
+    double energy = g.maxFlowMinCostTracking();
+    BOOST_CHECK(g.getStopReason() == FlowGraph::StopReason::Converged);
+    BOOST_REQUIRE(progress.size() >= 2);
+    BOOST_CHECK_EQUAL(progress.back().energy, energy);
+    for(size_t i = 1; i < progress.size(); i++)
+    {
+        BOOST_CHECK(progress[i].numPaths > progress[i-1].numPaths);
+        BOOST_CHECK(progress[i].energy < progress[i-1].energy);
+    }
+    double firstEnergy = progress.front().energy;
+
+    // the callback can stop tracking with the current solution
+    g.resetFlow();
+    g.setProgressCallback([](const FlowGraph::Progress&){ return false; });
+    BOOST_CHECK_EQUAL(g.maxFlowMinCostTracking(), firstEnergy);
+    BOOST_CHECK(g.getStopReason() == FlowGraph::StopReason::Callback);
+    BOOST_CHECK_EQUAL(g.getFlowEnergy(), firstEnergy);
+
+    // a used up time budget stops after the first iteration
+    g.resetFlow();
+    g.setProgressCallback(FlowGraph::ProgressCallback());
+    g.setAnytimeLimits(1e-12, 0.0);
+    BOOST_CHECK_EQUAL(g.maxFlowMinCostTracking(), firstEnergy);
+    BOOST_CHECK(g.getStopReason() == FlowGraph::StopReason::TimeBudget);
+
+    // no path improves the energy by more than the tolerance
+    g.resetFlow();
+    g.setAnytimeLimits(0.0, 100.0);
+    BOOST_CHECK_EQUAL(g.maxFlowMinCostTracking(), 0.0);
+    BOOST_CHECK(g.getStopReason() == FlowGraph::StopReason::EnergyGap);
+
+    g.setAnytimeLimits(0.0, 0.0);
+    BOOST_CHECK_EQUAL(g.maxFlowMinCostTracking(), energy);
+    BOOST_CHECK(g.getStopReason() == FlowGraph::StopReason::Converged);
+    BOOST_CHECK_THROW(g.setAnytimeLimits(-1.0, 0.0), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_memory_statistics )
+{
+    FlowGraph g;
+    typedef FlowGraph::FullNode Node;
+
+    Node n_1_1 = g.addNode({0.0});
+    Node n_1_2 = g.addNode({0.0});
+    Node n_2_1 = g.addNode({0.0});
+    Node n_2_2 = g.addNode({0.0});
+
+    FlowGraph::Node s = g.getSource();
+    FlowGraph::Node t = g.getTarget();
+
+    g.addArc(s, n_1_1.u, {0.0});
+    g.addArc(s, n_1_2.u, {0.0});
+    g.addArc(n_1_1, n_2_1, {-4.0});
+    g.addArc(n_1_1, n_2_2, {-3.0});
+    g.addArc(n_1_2, n_2_2, {-1.0});
+    g.addArc(n_2_1.v, t, {-2.0});
+    g.addArc(n_2_2.v, t, {-2.0});
+    g.allowMitosis(n_1_1, -4.0);
+
+    // before tracking there is no residual graph yet
+    MemoryStatistics before;
+    g.collectMemoryStatistics(before);
+    BOOST_REQUIRE_EQUAL(before.getStructures().size(), 1);
+    BOOST_CHECK_EQUAL(before.getStructures()[0].numNodes, lemon::countNodes(g.getGraph()));
+    BOOST_CHECK_EQUAL(before.getStructures()[0].numArcs, lemon::countArcs(g.getGraph()));
+    BOOST_CHECK(before.getTotalBytes() > 0);
+
+    g.maxFlowMinCostTracking();
+    MemoryStatistics after;
+    g.collectMemoryStatistics(after);
+    BOOST_REQUIRE_EQUAL(after.getStructures().size(), 2);
+    BOOST_CHECK_EQUAL(after.getStructures()[1].structure, "ResidualGraph");
+    BOOST_CHECK_EQUAL(after.getStructureBytes("FlowGraph"), before.getTotalBytes());
+    BOOST_CHECK_EQUAL(after.getTotalBytes(), after.getStructureBytes("FlowGraph") + after.getStructureBytes("ResidualGraph"));
+    after.updatePeakResidentBytes();
+    BOOST_CHECK(after.getPeakResidentBytes() > after.getTotalBytes());
+
+    // the dry run estimate grows with every kind of hypothesis, and tracking twice needs more
+    size_t estimate = MemoryStatistics::estimateTrackingBytes(100, 300, 10, "flow");
+    BOOST_CHECK(MemoryStatistics::estimateTrackingBytes(200, 300, 10, "flow") > estimate);
+    BOOST_CHECK(MemoryStatistics::estimateTrackingBytes(100, 400, 10, "flow") > estimate);
+    BOOST_CHECK(MemoryStatistics::estimateTrackingBytes(100, 300, 20, "flow") > estimate);
+    BOOST_CHECK(MemoryStatistics::estimateTrackingBytes(100, 300, 10, "magnusson-flow") > estimate);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_hypothesis_pruning )
+{
+    // two chains 0-2-4 and 1-3-5 with expensive cross links, detection 6 can never be reached
+    auto build = [](GraphBuilder& builder)
+    {
+        for(size_t id = 0; id < 7; ++id)
+        {
+            size_t t = id == 6 ? 1 : id / 2;
+            builder.setNodeTimesteps(id, std::make_pair(t, t));
+            if(id == 6)
+                builder.addNode(id, {0.0, -10.0}, {-10.0}, {}, {2.0}, 0);
+            else if(id == 5)
+                builder.addNode(id, {0.0, -3.0, -4.0}, {-3.0, -1.0}, {}, {2.0, 2.0}, 0);
+            else
+                builder.addNode(id, {0.0, -3.0, -4.0}, {-3.0, -1.0}, {2.0, 2.0}, {2.0, 2.0}, 0);
+        }
+        builder.addArc(0, 2, {-1.0});
+        builder.addArc(1, 3, {-1.0});
+        builder.addArc(2, 4, {-1.0});
+        builder.addArc(3, 5, {-1.0});
+        builder.addArc(0, 3, {5.0, 6.0});
+        builder.addArc(1, 2, {3.0});
+        builder.addArc(3, 4, {4.0});
+        builder.addArc(6, 4, {-5.0});
+        builder.allowMitosis(0, -1.0);
+    };
+    auto nonzeroValues = [](GraphBuilder& builder)
+    {
+        std::vector<size_t> values;
+        builder.visitNodeValues([&](size_t id, size_t value){ values.insert(values.end(), {id, value}); });
+        builder.visitArcValues([&](size_t srcId, size_t destId, size_t value){ values.insert(values.end(), {srcId, destId, value}); });
+        builder.visitDivisions([&](size_t id){ values.push_back(id); });
+        return values;
+    };
+
+    FlowGraph fullGraph;
+    FlowGraphBuilder fullBuilder(&fullGraph);
+    build(fullBuilder);
+    double fullEnergy = fullGraph.maxFlowMinCostTracking();
+
+    FlowGraph graph;
+    FlowGraphBuilder builder(&graph);
+    PruningGraphBuilder pruningBuilder(&builder);
+    build(pruningBuilder);
+    pruningBuilder.prune();
+    BOOST_CHECK_THROW(pruningBuilder.prune(), std::runtime_error);
+
+    // 0->3 and 3->4 are dominated, 6 has no way in, and 5 can only be entered by one object
+    const PruningReport& report = pruningBuilder.getReport();
+    BOOST_CHECK_EQUAL(report.numLinks, 8);
+    BOOST_CHECK_EQUAL(report.numDominatedLinks, 2);
+    BOOST_CHECK_EQUAL(report.numUnreachableLinks, 1);
+    BOOST_CHECK_EQUAL(report.numUnreachableDetections, 1);
+    BOOST_CHECK_EQUAL(report.numUnreachableDivisions, 0);
+    BOOST_CHECK_EQUAL(report.numRemovedStates, 2);
+    BOOST_CHECK(report.removedDetections == std::vector<size_t>({6}));
+    // the three links, and the detection and disappearance arcs of 6
+    BOOST_CHECK_EQUAL(countArcs(graph.getGraph()) + 3 + 2, countArcs(fullGraph.getGraph()));
+
+    BOOST_CHECK_CLOSE(graph.maxFlowMinCostTracking(), fullEnergy, 1e-9);
+    BOOST_CHECK(nonzeroValues(pruningBuilder) == nonzeroValues(fullBuilder));
+
+    // costs that are recomputed for other weights cannot be pruned
+    CompiledModel compiledModel(&graph);
+    BOOST_CHECK_THROW(PruningGraphBuilder pruningCompiledModel(&compiledModel), std::runtime_error);
+}
+
+/// the used hypotheses of a value map
+template<class ValueMap>
+ValueMap usedValues(const ValueMap& values)
+{
+    ValueMap used;
+    for(const auto& value : values)
+    {
+        if(value.second)
+            used.insert(value);
+    }
+    return used;
+}
+
+/// every detection of a stitched solution, in particular around the overlaps, keeps its objects like a detection of a flow graph:
+/// all of them arrive along links or appear, and all of them, together with a second child, leave along links or disappear
+void checkStitchedSolution(TemporalBlockFlowGraphBuilder& builder)
+{
+    GraphBuilder::NodeValueMap nodeValues = builder.getNodeValues();
+    GraphBuilder::DivisionValueMap divisionValues = builder.getDivisionValues();
+    std::map<size_t, size_t> inFlow;
+    std::map<size_t, size_t> outFlow;
+    for(const auto& arc : builder.getArcValues())
+    {
+        inFlow[arc.first.second] += arc.second;
+        outFlow[arc.first.first] += arc.second;
+    }
+    for(const auto& node : builder.nodes_)
+    {
+        size_t value = nodeValues[node.id];
+        size_t divisions = divisionValues[node.id] ? 1 : 0;
+        BOOST_CHECK(inFlow[node.id] == 0 || inFlow[node.id] == value);
+        BOOST_CHECK(outFlow[node.id] == 0 || outFlow[node.id] == value + divisions);
+        if(divisions > 0)
+            BOOST_CHECK(value == 1 && outFlow[node.id] == 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_temporal_blocks )
+{
+    // two objects moving straight through six timesteps, with costly cross links between them
+    auto build = [](GraphBuilder& builder)
+    {
+        for(size_t t = 0; t < 6; ++t)
+        {
+            for(size_t k = 0; k < 2; ++k)
+            {
+                builder.setNodeTimesteps(2 * t + k, std::make_pair(t, t));
+                builder.addNode(2 * t + k, {0.0, -5.0}, {-5.0}, {2.0}, {2.0}, 0);
+            }
+        }
+        for(size_t t = 0; t + 1 < 6; ++t)
+        {
+            builder.addArc(2 * t, 2 * t + 2, {-1.0});
+            builder.addArc(2 * t + 1, 2 * t + 3, {-1.0});
+            builder.addArc(2 * t, 2 * t + 3, {1.0});
+        }
+    };
+    auto solver = [](FlowGraph& graph){ return graph.maxFlowMinCostTracking(); };
+
+    FlowGraph fullGraph;
+    FlowGraphBuilder fullBuilder(&fullGraph);
+    build(fullBuilder);
+    double fullEnergy = fullGraph.maxFlowMinCostTracking();
+    BOOST_CHECK_CLOSE(fullEnergy, -62.0, 1e-9);
+
+    // blocks [0,3] and [2,5] share two timesteps
+    TemporalBlockFlowGraphBuilder blockBuilder(4, 2);
+    build(blockBuilder);
+    BOOST_CHECK_EQUAL(blockBuilder.getNumBlocks(), 2);
+    BOOST_CHECK_EQUAL(blockBuilder.getNumSkippedLinks(), 0);
+    BOOST_CHECK_CLOSE(blockBuilder.solve(solver, 2), fullEnergy, 1e-9);
+    BOOST_CHECK(blockBuilder.getNodeValues() == fullBuilder.getNodeValues());
+    for(const auto& arc : fullBuilder.getArcValues())
+        BOOST_CHECK_EQUAL(blockBuilder.getArcValues()[arc.first], arc.second);
+    BOOST_CHECK(blockBuilder.getDivisionValues().empty());
+
+    // workers that only keep their block, and a process that only keeps the overlaps, find the same solution
+    std::vector<BlockResult> results;
+    for(size_t b = 0; b < 2; ++b)
+    {
+        TemporalBlockFlowGraphBuilder workerBuilder(4, 2);
+        workerBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Block, b);
+        build(workerBuilder);
+        BOOST_CHECK_THROW(workerBuilder.solveBlock(1 - b, solver), std::runtime_error);
+        std::string filename = "block_" + std::to_string(b) + ".json";
+        workerBuilder.solveBlock(b, solver).save(filename);
+        results.push_back(BlockResult::load(filename));
+        std::remove(filename.c_str());
+    }
+    TemporalBlockFlowGraphBuilder stitchBuilder(4, 2);
+    stitchBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Overlaps);
+    build(stitchBuilder);
+    BOOST_CHECK_THROW(stitchBuilder.stitch({results[0]}, solver), std::runtime_error);
+    BOOST_CHECK_CLOSE(stitchBuilder.stitch(results, solver), fullEnergy, 1e-9);
+    BOOST_CHECK(stitchBuilder.getNodeValues() == blockBuilder.getNodeValues());
+    BOOST_CHECK(stitchBuilder.getArcValues() == blockBuilder.getArcValues());
+    BOOST_CHECK_THROW(stitchBuilder.solve(solver), std::runtime_error);
+
+    BOOST_CHECK_THROW(TemporalBlockFlowGraphBuilder(4, 0), std::runtime_error);
+    BOOST_CHECK_THROW(TemporalBlockFlowGraphBuilder(4, 3), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_temporal_blocks_divisions )
+{
+    // lanes of one object each, where lane i + 1 starts as a child of lane i at timestep 3 * (i + 1). Every used hypothesis
+    // lowers the energy and every other one raises it, so every block tracks the lanes it contains and the windows keep the divisions
+    const size_t numTimesteps = 13;
+    const size_t numLanes = 4;
+    auto startOf = [](size_t lane){ return lane == 0 ? 0 : 3 * lane; };
+    auto build = [&](GraphBuilder& builder)
+    {
+        for(size_t t = 0; t < numTimesteps; ++t)
+        {
+            for(size_t lane = 0; lane < numLanes; ++lane)
+            {
+                size_t id = t * numLanes + lane;
+                builder.setNodeTimesteps(id, std::make_pair(t, t));
+                double detection = t >= startOf(lane) ? -5.0 : 3.0;
+                builder.addNode(id, {0.0, detection, detection + 6.0}, {detection, 6.0}, {2.0, 9.0}, {2.0, 9.0}, 0);
+            }
+        }
+        for(size_t t = 0; t + 1 < numTimesteps; ++t)
+        {
+            for(size_t lane = 0; lane < numLanes; ++lane)
+            {
+                size_t id = t * numLanes + lane;
+                builder.addArc(id, id + numLanes, {t + 1 >= startOf(lane) ? -4.0 : 3.0, 9.0});
+                if(lane + 1 < numLanes)
+                    builder.addArc(id, id + numLanes + 1, {t + 1 == startOf(lane + 1) ? -4.0 : 3.0, 9.0});
+                builder.allowMitosis(id, t + 1 == startOf(lane + 1) ? -3.0 : 4.0);
+            }
+        }
+    };
+    auto solver = [](FlowGraph& graph){ return graph.maxFlowMinCostTracking(); };
+
+    FlowGraph fullGraph;
+    FlowGraphBuilder fullBuilder(&fullGraph);
+    build(fullBuilder);
+    double fullEnergy = fullGraph.maxFlowMinCostTracking();
+    BOOST_CHECK_EQUAL(usedValues(fullBuilder.getDivisionValues()).size(), numLanes - 1);
+
+    // overlaps at the divisions, right before and behind them, and windows that reach the neighbouring overlaps or not
+    for(const std::pair<size_t, size_t>& blocks : std::vector<std::pair<size_t, size_t>>({{4, 2}, {5, 2}, {6, 2}, {7, 3}}))
+    {
+        TemporalBlockFlowGraphBuilder blockBuilder(blocks.first, blocks.second);
+        build(blockBuilder);
+        BOOST_CHECK_CLOSE(blockBuilder.solve(solver, 2), fullEnergy, 1e-9);
+        BOOST_CHECK_EQUAL(blockBuilder.getNumMergedOverlaps(), 0);
+        BOOST_CHECK(usedValues(blockBuilder.getNodeValues()) == usedValues(fullBuilder.getNodeValues()));
+        BOOST_CHECK(usedValues(blockBuilder.getArcValues()) == usedValues(fullBuilder.getArcValues()));
+        BOOST_CHECK(usedValues(blockBuilder.getDivisionValues()) == usedValues(fullBuilder.getDivisionValues()));
+        checkStitchedSolution(blockBuilder);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_temporal_blocks_random )
+{
+    // a random model where a quarter of the detections can divide, on which the blocks disagree
+    const size_t numTimesteps = 20;
+    const size_t numNodesPerTimestep = 40;
+    auto build = [&](GraphBuilder& builder)
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<double> score(0.0, 1.0);
+        for(size_t t = 0; t < numTimesteps; ++t)
+        {
+            for(size_t i = 0; i < numNodesPerTimestep; ++i)
+            {
+                size_t id = t * numNodesPerTimestep + i;
+                double detection = -6.0 + 7.0 * score(rng);
+                double secondDetection = detection + 1.0 + 4.0 * score(rng);
+                double appearance = t == 0 ? 0.0 : 2.0 + 4.0 * score(rng);
+                double disappearance = t + 1 == numTimesteps ? 0.0 : 2.0 + 4.0 * score(rng);
+                builder.setNodeTimesteps(id, std::make_pair(t, t));
+                builder.addNode(id, {0.0, detection, detection + secondDetection}, {detection, secondDetection},
+                                {appearance, appearance + 2.0}, {disappearance, disappearance + 2.0}, 0);
+            }
+        }
+        for(size_t t = 0; t + 1 < numTimesteps; ++t)
+        {
+            for(size_t i = 0; i < numNodesPerTimestep; ++i)
+            {
+                for(size_t k = 0; k < 3; ++k)
+                {
+                    double link = -4.0 + 6.0 * score(rng);
+                    builder.addArc(t * numNodesPerTimestep + i, (t + 1) * numNodesPerTimestep + (i + k) % numNodesPerTimestep,
+                                   {link, link + 1.0 + 3.0 * score(rng)});
+                }
+                if(i % 4 == 0)
+                    builder.allowMitosis(t * numNodesPerTimestep + i, -1.0 + 5.0 * score(rng));
+            }
+        }
+    };
+    auto solver = [](FlowGraph& graph){ return graph.maxFlowMinCostTracking(); };
+
+    FlowGraph fullGraph;
+    FlowGraphBuilder fullBuilder(&fullGraph);
+    build(fullBuilder);
+    double fullEnergy = fullGraph.maxFlowMinCostTracking();
+
+    // the stitched solution is one of the model, whose energy is the one returned, and close to tracking at once
+    for(const std::tuple<size_t, size_t, double>& blocks : std::vector<std::tuple<size_t, size_t, double>>({
+        std::make_tuple(6, 2, 0.97), std::make_tuple(10, 4, 0.99)}))
+    {
+        TemporalBlockFlowGraphBuilder blockBuilder(std::get<0>(blocks), std::get<1>(blocks));
+        build(blockBuilder);
+        double energy = blockBuilder.solve(solver, 2);
+        checkStitchedSolution(blockBuilder);
+        BOOST_CHECK_CLOSE(energy, blockBuilder.computeEnergy([](const TemporalBlockFlowGraphBuilder::NodeHypothesis&){ return true; },
+            blockBuilder.getNodeValues(), blockBuilder.getArcValues(), blockBuilder.getDivisionValues()), 1e-9);
+        BOOST_CHECK_LE(energy, std::get<2>(blocks) * fullEnergy);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( flowgraph_temporal_blocks_merged )
+{
+    // with blocks [0,3], [2,5] and [4,7], the link from 1 to 9 skips the overlap [2,3] and joins the first two blocks.
+    // 1 can only send its object along this link, and 9 can only get one from there
+    auto buildSkip = [](GraphBuilder& builder)
+    {
+        for(size_t t = 0; t < 8; ++t)
+        {
+            builder.setNodeTimesteps(2 * t, std::make_pair(t, t));
+            builder.addNode(2 * t, {0.0, -5.0}, {-5.0}, {2.0}, {2.0}, 0);
+            builder.setNodeTimesteps(2 * t + 1, std::make_pair(t, t));
+            if(t == 0)
+                builder.addNode(2 * t + 1, {0.0, -5.0}, {-5.0}, {2.0}, {}, 0);
+            else
+                builder.addNode(2 * t + 1, {0.0, t == 4 ? -9.0 : 1.0}, {t == 4 ? -9.0 : 1.0}, {}, {2.0}, 0);
+        }
+        for(size_t t = 0; t + 1 < 8; ++t)
+            builder.addArc(2 * t, 2 * t + 2, {-1.0});
+        builder.addArc(1, 9, {-1.0});
+    };
+    auto solver = [](FlowGraph& graph){ return graph.maxFlowMinCostTracking(); };
+
+    FlowGraph skipGraph;
+    FlowGraphBuilder skipBuilder(&skipGraph);
+    buildSkip(skipBuilder);
+    double skipEnergy = skipGraph.maxFlowMinCostTracking();
+    BOOST_CHECK_EQUAL(skipBuilder.getArcValues()[std::make_pair(1, 9)], 1);
+
+    TemporalBlockFlowGraphBuilder skipBlocks(4, 2);
+    buildSkip(skipBlocks);
+    BOOST_CHECK_EQUAL(skipBlocks.getNumBlocks(), 3);
+    BOOST_CHECK_EQUAL(skipBlocks.getNumSkippedLinks(), 1);
+    BOOST_CHECK_EQUAL(skipBlocks.getNumMergedOverlaps(), 1);
+    std::vector<std::pair<size_t, size_t>> spans = {{0, 1}, {2, 2}};
+    BOOST_CHECK(skipBlocks.getSpans() == spans);
+    BOOST_CHECK_CLOSE(skipBlocks.solve(solver), skipEnergy, 1e-9);
+    BOOST_CHECK(usedValues(skipBlocks.getNodeValues()) == usedValues(skipBuilder.getNodeValues()));
+    BOOST_CHECK(usedValues(skipBlocks.getArcValues()) == usedValues(skipBuilder.getArcValues()));
+    BOOST_CHECK_EQUAL(skipBlocks.getArcValues()[std::make_pair(1, 9)], 1);
+    checkStitchedSolution(skipBlocks);
+
+    // Two objects reach 4 at timestep 3 in block [0,3], but only one in block [2,5]. Both must move on together from there,
+    // block [2,5] does not use 6, and neither 2 nor 4 let objects disappear, so the window [2,3] cannot keep the objects of 2 and 5
+    auto buildConflict = [](GraphBuilder& builder)
+    {
+        auto addNode = [&](size_t id, size_t t, const GraphBuilder::CostDeltaVector& detectionCostDeltas,
+                           const GraphBuilder::CostDeltaVector& appearanceCostDeltas, const GraphBuilder::CostDeltaVector& disappearanceCostDeltas){
+            GraphBuilder::CostDeltaVector detectionCosts(1, 0.0);
+            for(double c : detectionCostDeltas)
+                detectionCosts.push_back(detectionCosts.back() + c);
+            builder.setNodeTimesteps(id, std::make_pair(t, t));
+            builder.addNode(id, detectionCosts, detectionCostDeltas, appearanceCostDeltas, disappearanceCostDeltas, 0);
+        };
+        addNode(0, 0, {-10.0, -10.0}, {1.0, 1.0}, {});
+        addNode(1, 1, {-10.0, -10.0}, {}, {});
+        addNode(2, 2, {-10.0, -10.0}, {}, {});
+        addNode(3, 3, {-10.0, -10.0}, {1.0, 30.0}, {1.0, 1.0});
+        addNode(4, 4, {-10.0}, {}, {1.0});
+        addNode(5, 4, {-10.0}, {1.0}, {1.0});
+        addNode(6, 4, {-0.5}, {}, {1.0});
+        builder.addArc(0, 1, {-1.0, -1.0});
+        builder.addArc(1, 2, {-1.0, -1.0});
+        builder.addArc(2, 3, {-1.0, -1.0});
+        builder.addArc(3, 4, {-1.0});
+        builder.addArc(3, 6, {0.0});
+    };
+
+    FlowGraph conflictGraph;
+    FlowGraphBuilder conflictBuilder(&conflictGraph);
+    buildConflict(conflictBuilder);
+    double conflictEnergy = conflictGraph.maxFlowMinCostTracking();
+    BOOST_CHECK_EQUAL(conflictBuilder.getNodeValues()[3], 2);
+    BOOST_CHECK_EQUAL(conflictBuilder.getNodeValues()[6], 1);
+
+    TemporalBlockFlowGraphBuilder conflictBlocks(4, 2);
+    buildConflict(conflictBlocks);
+    BOOST_CHECK_EQUAL(conflictBlocks.getNumMergedOverlaps(), 0);
+    BOOST_CHECK_EQUAL(conflictBlocks.solveBlock(1, solver).nodeValues[3], 1);
+    BOOST_CHECK_CLOSE(conflictBlocks.solve(solver), conflictEnergy, 1e-9);
+    BOOST_CHECK_EQUAL(conflictBlocks.getNumMergedOverlaps(), 1);
+    BOOST_CHECK(usedValues(conflictBlocks.getNodeValues()) == usedValues(conflictBuilder.getNodeValues()));
+    BOOST_CHECK(usedValues(conflictBlocks.getArcValues()) == usedValues(conflictBuilder.getArcValues()));
+    checkStitchedSolution(conflictBlocks);
+
+    // a process that only kept the overlaps needs a function to track the joined blocks
+    std::vector<BlockResult> results;
+    for(size_t b = 0; b < 2; ++b)
+    {
+        TemporalBlockFlowGraphBuilder workerBuilder(4, 2);
+        workerBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Block, b);
+        buildConflict(workerBuilder);
+        results.push_back(workerBuilder.solveBlock(b, solver));
+    }
+    auto solveSpan = [&](size_t firstBlock, size_t lastBlock){
+        TemporalBlockFlowGraphBuilder spanBuilder(4, 2);
+        spanBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Block, firstBlock, lastBlock);
+        buildConflict(spanBuilder);
+        BOOST_CHECK_THROW(spanBuilder.solveBlocks(firstBlock, lastBlock + 1, solver), std::runtime_error);
+        return spanBuilder.solveBlocks(firstBlock, lastBlock, solver);
+    };
+    TemporalBlockFlowGraphBuilder stitchBuilder(4, 2);
+    stitchBuilder.setRestriction(TemporalBlockFlowGraphBuilder::Restriction::Overlaps);
+    buildConflict(stitchBuilder);
+    BOOST_CHECK_THROW(stitchBuilder.stitch(results, solver), std::runtime_error);
+    BOOST_CHECK_CLOSE(stitchBuilder.stitch(results, solver, solveSpan), conflictEnergy, 1e-9);
+    BOOST_CHECK(usedValues(stitchBuilder.getNodeValues()) == usedValues(conflictBuilder.getNodeValues()));
+    BOOST_CHECK(usedValues(stitchBuilder.getArcValues()) == usedValues(conflictBuilder.getArcValues()));
 }
 
 /*
 The following test cannot work as long as we use the alternative way of checking for tokens on a path
 
+BOOST_AUTO_TEST_CASE( residualgraph_token_checks )
+{
+    typedef lemon::ListDigraph LGraph;
+    LGraph original;
+    LGraph::Node s = original.addNode();
+    LGraph::Node a = original.addNode();
+    LGraph::Node b = original.addNode();
+    LGraph::Arc sa = original.addArc(s, a);
+    LGraph::Arc ab = original.addArc(a, b);
+    LGraph::Arc sb = original.addArc(s, b);
+    std::vector<size_t> timesteps = {0, 1, 2};
+    ResidualGraph residualGraph(original, s, timesteps);
+
+    ResidualGraph::Token a_id = original.id(a);
+    residualGraph.addProvidedToken(ab, ResidualGraph::Forward, a_id);
+    residualGraph.addForbiddenToken(sa, ResidualGraph::Backward, a_id);
+    residualGraph.addForbiddenToken(sb, ResidualGraph::Forward, 42);
+
+    // a token is violated when it is provided and forbidden along the same path, in any order
+    ResidualGraph::Token violated = ResidualGraph::NoToken;
+    residualGraph.beginTokenCheck();
+    BOOST_CHECK(residualGraph.checkArcTokens(residualGraph.residualArcIndex(ab, ResidualGraph::Forward), violated));
+    BOOST_CHECK(residualGraph.checkArcTokens(residualGraph.residualArcIndex(sb, ResidualGraph::Forward), violated));
+    BOOST_CHECK(!residualGraph.checkArcTokens(residualGraph.residualArcIndex(sa, ResidualGraph::Backward), violated));
+    BOOST_CHECK_EQUAL(violated, a_id);
+
+    violated = ResidualGraph::NoToken;
+    residualGraph.beginTokenCheck();
+    BOOST_CHECK(residualGraph.checkArcTokens(residualGraph.residualArcIndex(sa, ResidualGraph::Backward), violated));
+    BOOST_CHECK(!residualGraph.checkArcTokens(residualGraph.residualArcIndex(ab, ResidualGraph::Forward), violated));
+    BOOST_CHECK_EQUAL(violated, a_id);
+
+    // the tokens of earlier paths are forgotten
+    violated = ResidualGraph::NoToken;
+    residualGraph.beginTokenCheck();
+    BOOST_CHECK(residualGraph.checkArcTokens(residualGraph.residualArcIndex(ab, ResidualGraph::Forward), violated));
+    BOOST_CHECK(residualGraph.checkArcTokens(residualGraph.residualArcIndex(ab, ResidualGraph::Backward), violated));
+    BOOST_CHECK_EQUAL(violated, ResidualGraph::NoToken);
+
+    // every residual arc holds at most one token of each kind
+    BOOST_CHECK_THROW(residualGraph.addProvidedToken(ab, ResidualGraph::Forward, a_id + 1), std::runtime_error);
+    residualGraph.removeProvidedToken(ab, ResidualGraph::Forward, a_id);
+    residualGraph.addProvidedToken(ab, ResidualGraph::Forward, a_id + 1);
+    violated = ResidualGraph::NoToken;
+    residualGraph.beginTokenCheck();
+    BOOST_CHECK(residualGraph.checkArcTokens(residualGraph.residualArcIndex(ab, ResidualGraph::Forward), violated));
+    BOOST_CHECK(residualGraph.checkArcTokens(residualGraph.residualArcIndex(sa, ResidualGraph::Backward), violated));
+}
+
 BOOST_AUTO_TEST_CASE( tokenizedbellmanford_have_tokens )
 {
     FlowGraph g;
@@ -1,6 +1,7 @@
 #define BOOST_TEST_MODULE test_magnusson
 
 #include <iostream>
+#include <random>
 #include <boost/test/unit_test.hpp>
 #include "graph.h"
 #include "magnusson.h"
@@ -45,6 +46,54 @@ BOOST_AUTO_TEST_CASE(two_cell_test_magnusson)
     BOOST_CHECK_EQUAL(paths.size(), 2);
 }
 
+BOOST_AUTO_TEST_CASE(magnusson_telemetry)
+{
+    Graph::Configuration config(false, false, false);
+    Graph g(config);
+
+    Graph::NodePtr n1 = g.addNode(0, {0, 3, 5, -10}, {0.0}, {0.0}, true, false, std::make_shared<NameData>("Timestep 1: Node 1"));
+    Graph::NodePtr n2 = g.addNode(1, {0, 3, 4, -10}, {0.0}, {0.0}, false, true, std::make_shared<NameData>("Timestep 2: Node 1"));
+
+    g.addMoveArc(n1, n2, {1.0, 1.0});
+
+    SolverTelemetry telemetry("magnusson");
+    Magnusson tracker(&g, false);
+    tracker.setTelemetry(&telemetry);
+    std::vector<TrackingAlgorithm::Path> paths;
+    double score = tracker.track(paths);
+
+    // one iteration per path, and the last one that found no improving path
+    BOOST_CHECK_EQUAL(paths.size(), 2);
+    BOOST_REQUIRE_EQUAL(telemetry.getIterations().size(), 3);
+    BOOST_CHECK_EQUAL(telemetry.getTotals().numPaths, 2);
+    BOOST_CHECK_EQUAL(telemetry.getTotals().energy, -score);
+    BOOST_CHECK_EQUAL(telemetry.getIterations()[0].pathLength, paths[0].size());
+}
+
+BOOST_AUTO_TEST_CASE(magnusson_progress_callback_stops_tracking)
+{
+    Graph::Configuration config(false, false, false);
+    Graph g(config);
+
+    Graph::NodePtr n1 = g.addNode(0, {0, 3, 5, -10}, {0.0}, {0.0}, true, false, std::make_shared<NameData>("Timestep 1: Node 1"));
+    Graph::NodePtr n2 = g.addNode(1, {0, 3, 4, -10}, {0.0}, {0.0}, false, true, std::make_shared<NameData>("Timestep 2: Node 1"));
+
+    g.addMoveArc(n1, n2, {1.0, 1.0});
+
+    std::vector<Magnusson::Progress> progress;
+    Magnusson tracker(&g, false);
+    tracker.setProgressCallback([&](const Magnusson::Progress& p){ progress.push_back(p); return false; });
+    std::vector<TrackingAlgorithm::Path> paths;
+    double score = tracker.track(paths);
+
+    // the second path would be found without the callback, see two_cell_test_magnusson
+    BOOST_CHECK_EQUAL(paths.size(), 1);
+    BOOST_CHECK_EQUAL(score, 7.0);
+    BOOST_REQUIRE_EQUAL(progress.size(), 1);
+    BOOST_CHECK_EQUAL(progress[0].numPaths, 1);
+    BOOST_CHECK_EQUAL(progress[0].energy, -score);
+}
+
 BOOST_AUTO_TEST_CASE(magnusson_no_swap_failure_case)
 {
     Graph::Configuration config(false, false, false);
@@ -291,6 +340,279 @@ BOOST_AUTO_TEST_CASE(test_full_magnusson_with_swap)
     std::cout << "Tracker returned score " << score << std::endl;
 }
 
+BOOST_AUTO_TEST_CASE(test_full_magnusson_arena_storage)
+{
+    Graph::Configuration config(true, true, true, true);
+    Graph g(config);
+
+    buildGraph(g);
+
+    // -----------------------------------------------------
+    // Tracking
+    Magnusson tracker(&g, true, true);
+    std::vector<TrackingAlgorithm::Path> paths;
+    double score = tracker.track(paths);
+
+    BOOST_CHECK_EQUAL(paths.size(), 5);
+    BOOST_CHECK_EQUAL(score, 44.0);
+
+    std::cout << "Tracker returned score " << score << std::endl;
+}
+
+void buildRandomGraph(Graph& g, size_t numTimesteps, size_t numNodesPerTimestep, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> score(-5.0, 10.0);
+    std::uniform_int_distribution<size_t> node(0, numNodesPerTimestep - 1);
+
+    std::vector<Graph::NodePtr> previous;
+    for(size_t t = 0; t < numTimesteps; t++)
+    {
+        std::vector<Graph::NodePtr> current;
+        for(size_t i = 0; i < numNodesPerTimestep; i++)
+        {
+            double detection = score(rng);
+            current.push_back(g.addNode(t, {0.0, detection, detection + score(rng) - 5.0}, {-score(rng), -20.0}, {-score(rng), -20.0},
+                                        t == 0, t + 1 == numTimesteps));
+        }
+
+        for(size_t i = 0; i < previous.size(); i++)
+        {
+            size_t first = node(rng);
+            size_t second = (first + 1 + node(rng) % (numNodesPerTimestep - 1)) % numNodesPerTimestep;
+            g.addMoveArc(previous[i], current[first], {score(rng) - 5.0, -10.0});
+            g.addMoveArc(previous[i], current[second], {score(rng) - 5.0, -10.0});
+            if(i % 3 == 0)
+                g.allowMitosis(previous[i], current[second], score(rng) - 5.0);
+        }
+        previous = current;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_magnusson_incremental_updates)
+{
+    for(unsigned int seed = 0; seed < 20; seed++)
+    {
+        for(bool withSwap : {false, true})
+        {
+            Graph::Configuration config(true, true, true);
+            Graph fullGraph(config);
+            Graph incrementalGraph(config);
+            buildRandomGraph(fullGraph, 6, 8, seed);
+            buildRandomGraph(incrementalGraph, 6, 8, seed);
+
+            Magnusson fullTracker(&fullGraph, withSwap, true);
+            std::vector<TrackingAlgorithm::Path> fullPaths;
+            double fullScore = fullTracker.track(fullPaths);
+
+            Magnusson incrementalTracker(&incrementalGraph, withSwap, true);
+            incrementalTracker.setIncrementalUpdates(true);
+            std::vector<TrackingAlgorithm::Path> incrementalPaths;
+            double incrementalScore = incrementalTracker.track(incrementalPaths);
+
+            BOOST_CHECK_EQUAL(fullScore, incrementalScore);
+            BOOST_REQUIRE_EQUAL(fullPaths.size(), incrementalPaths.size());
+            for(size_t i = 0; i < fullPaths.size(); i++)
+                BOOST_CHECK_EQUAL(fullPaths[i].size(), incrementalPaths[i].size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_magnusson_paths_per_sweep)
+{
+    for(unsigned int seed = 0; seed < 20; seed++)
+    {
+        for(bool withSwap : {false, true})
+        {
+            Graph::Configuration config(true, true, true);
+            Graph singleGraph(config);
+            Graph multiGraph(config);
+            buildRandomGraph(singleGraph, 6, 8, seed);
+            buildRandomGraph(multiGraph, 6, 8, seed);
+
+            SolverTelemetry singleTelemetry;
+            Magnusson singleTracker(&singleGraph, withSwap, true);
+            singleTracker.setTelemetry(&singleTelemetry);
+            std::vector<TrackingAlgorithm::Path> singlePaths;
+            double singleScore = singleTracker.track(singlePaths);
+
+            SolverTelemetry multiTelemetry;
+            Magnusson multiTracker(&multiGraph, withSwap, true);
+            multiTracker.setPathsPerSweep(10, 0.0);
+            multiTracker.setTelemetry(&multiTelemetry);
+            std::vector<TrackingAlgorithm::Path> multiPaths;
+            double multiScore = multiTracker.track(multiPaths);
+            std::cout << "Seed " << seed << ": " << multiScore << " in " << multiTelemetry.getIterations().size()
+                      << " sweeps instead of " << singleScore << " in " << singleTelemetry.getIterations().size() << std::endl;
+
+            // the score of every iteration is exact and the solution is feasible
+            BOOST_CHECK(multiScore >= 0.0);
+            BOOST_CHECK(multiTelemetry.getIterations().size() <= singleTelemetry.getIterations().size());
+            double iterationScores = 0.0;
+            size_t numPaths = 0;
+            for(const IterationTelemetry& it : multiTelemetry.getIterations())
+            {
+                if(it.numPaths > 0)
+                {
+                    iterationScores -= it.pathCost;
+                    numPaths += it.numPaths;
+                }
+            }
+            BOOST_CHECK_CLOSE(iterationScores, multiScore, 1e-8);
+            BOOST_CHECK_EQUAL(numPaths, multiPaths.size());
+            for(size_t t = 0; t < multiGraph.getNumTimesteps(); t++)
+                multiGraph.forEachNodeInTimestep(t, [](Node* n){ BOOST_CHECK(n->getCellCount() < n->getNumStates()); });
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_magnusson_parallel_sweep)
+{
+    // deterministic motion model, using only its arguments
+    auto motionModel = [](Node* a, Node* b, Node* c){
+        return (a == nullptr ? 0.5 : -0.5 * (a->getNumStates() % 2)) - (c == nullptr ? 0.0 : 0.1 * c->getTimestep());
+    };
+
+    for(size_t motionModelMode = 0; motionModelMode < 3; motionModelMode++)
+    {
+        Graph::Configuration config(true, true, true);
+        Graph serialGraph(config);
+        Graph parallelGraph(config);
+        buildRandomGraph(serialGraph, 5, 200, 42);
+        buildRandomGraph(parallelGraph, 5, 200, 42);
+
+        Magnusson serialTracker(&serialGraph, true, true);
+        Magnusson parallelTracker(&parallelGraph, true, true);
+        parallelTracker.setNumThreads(4, 16);
+        if(motionModelMode > 0)
+        {
+            serialTracker.setMotionModelScoreFunction(motionModel);
+            parallelTracker.setMotionModelScoreFunction(motionModel, motionModelMode == 2);
+        }
+
+        std::vector<TrackingAlgorithm::Path> serialPaths;
+        double serialScore = serialTracker.track(serialPaths);
+        std::vector<TrackingAlgorithm::Path> parallelPaths;
+        double parallelScore = parallelTracker.track(parallelPaths);
+
+        BOOST_CHECK_EQUAL(serialScore, parallelScore);
+        BOOST_REQUIRE_EQUAL(serialPaths.size(), parallelPaths.size());
+        for(size_t i = 0; i < serialPaths.size(); i++)
+            BOOST_CHECK_EQUAL(serialPaths[i].size(), parallelPaths[i].size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_magnusson_swap_arc_store)
+{
+    for(bool recycle : {false, true})
+    {
+        Graph::Configuration config(true, true, true);
+        Graph g(config);
+        buildRandomGraph(g, 6, 30, 7);
+
+        size_t numArcsAtNodes = 0;
+        for(size_t t = 0; t < g.getNumTimesteps(); t++)
+            g.visitNodesInTimestep(t, [&](Node* n){ numArcsAtNodes += n->getNumInArcs() + n->getNumOutArcs(); });
+
+        {
+            Magnusson tracker(&g, true, true);
+            tracker.setRecycleStaleSwapArcs(recycle);
+            std::vector<TrackingAlgorithm::Path> paths;
+            double score = tracker.track(paths);
+            BOOST_CHECK(score > 0.0);
+
+            for(TrackingAlgorithm::Path& p : paths)
+                for(Arc* a : p)
+                    BOOST_CHECK(a->getType() != Arc::Swap);
+        }
+
+        // the tracker takes all its swap arcs with it
+        size_t numArcsAfterTracking = 0;
+        size_t numSwapArcs = 0;
+        for(size_t t = 0; t < g.getNumTimesteps(); t++)
+        {
+            g.visitNodesInTimestep(t, [&](Node* n){
+                numArcsAfterTracking += n->getNumInArcs() + n->getNumOutArcs();
+                n->visitInArcs([&](Arc* a){ numSwapArcs += (a->getType() == Arc::Swap); });
+            });
+        }
+        BOOST_CHECK_EQUAL(numArcsAtNodes, numArcsAfterTracking);
+        BOOST_CHECK_EQUAL(numSwapArcs, 0);
+    }
+}
+
+// same motion model as a policy, scoring all move arcs of a node at once
+struct TimestepMotionModel
+{
+    static const bool enabled = true;
+    bool isThreadSafe() const { return true; }
+    void scoreMoveArcs(Node* a, Node* b, const std::vector<Node*>& targets, std::vector<double>& scores) const
+    {
+        for(size_t i = 0; i < targets.size(); i++)
+            scores[i] = (a == nullptr ? 0.5 : -0.5 * (a->getNumStates() % 2)) - (targets[i] == nullptr ? 0.0 : 0.1 * targets[i]->getTimestep());
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_magnusson_static_dispatch)
+{
+    auto motionModel = [](Node* a, Node* b, Node* c){
+        return (a == nullptr ? 0.5 : -0.5 * (a->getNumStates() % 2)) - (c == nullptr ? 0.0 : 0.1 * c->getTimestep());
+    };
+    auto batchMotionModel = [](Node* a, Node* b, const std::vector<Node*>& targets, std::vector<double>& scores){
+        TimestepMotionModel().scoreMoveArcs(a, b, targets, scores);
+    };
+
+    for(unsigned int seed = 0; seed < 5; seed++)
+    {
+        // 0: callbacks, 1: batch callback, 2: policies, 3: callbacks with a selector that is not inlined
+        std::vector<double> scores;
+        std::vector<size_t> numPaths;
+        for(size_t mode = 0; mode < 4; mode++)
+        {
+            Graph::Configuration config(true, true, true);
+            Graph g(config);
+            buildRandomGraph(g, 6, 20, seed);
+
+            Magnusson tracker(&g, true, true);
+            std::vector<TrackingAlgorithm::Path> paths;
+            if(mode == 0)
+                tracker.setMotionModelScoreFunction(motionModel);
+            else if(mode == 1)
+                tracker.setBatchMotionModelScoreFunction(batchMotionModel);
+            else if(mode == 3)
+            {
+                tracker.setMotionModelScoreFunction(motionModel);
+                tracker.setPathStartSelectorFunction([](Node* n){ return selectBestInArc(n); });
+            }
+
+            if(mode == 2)
+                scores.push_back(tracker.track(paths, TimestepMotionModel(), BestInArcSelector()));
+            else
+                scores.push_back(tracker.track(paths));
+            numPaths.push_back(paths.size());
+        }
+
+        for(size_t mode = 1; mode < 4; mode++)
+        {
+            BOOST_CHECK_CLOSE(scores[0], scores[mode], 0.0001);
+            BOOST_CHECK_EQUAL(numPaths[0], numPaths[mode]);
+        }
+
+        // without a motion model
+        Graph::Configuration config(true, true, true);
+        Graph g1(config);
+        Graph g2(config);
+        buildRandomGraph(g1, 6, 20, seed);
+        buildRandomGraph(g2, 6, 20, seed);
+        Magnusson tracker1(&g1, true, true);
+        Magnusson tracker2(&g2, true, true);
+        std::vector<TrackingAlgorithm::Path> paths1;
+        std::vector<TrackingAlgorithm::Path> paths2;
+        BOOST_CHECK_EQUAL(tracker1.track(paths1), tracker2.track(paths2, NoMotionModel(), BestInArcSelector()));
+        BOOST_CHECK_EQUAL(paths1.size(), paths2.size());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_full_magnusson_graph_constness)
 {
     Graph::Configuration config(true, true, true);
@@ -357,6 +679,20 @@ BOOST_AUTO_TEST_CASE(test_backward_path)
             arcUseCount[a] = 1;
         }
     }
+
+    // all paths lead from source to sink along best in arcs
+    for(TrackingAlgorithm::Path& p : paths)
+    {
+        BOOST_CHECK(p.front()->getSourceNode() == &g.getSourceNode());
+        BOOST_CHECK(p.back()->getTargetNode() == &g.getSinkNode());
+        for(size_t i = 0; i + 1 < p.size(); i++)
+            BOOST_CHECK(p[i + 1]->getSourceNode()->getBestInArc() == p[i]);
+    }
+
+    // extracting on several threads gives the same paths
+    TrackingAlgorithm::Solution threadedPaths;
+    tracker.findNonintersectingBackwardPaths(&g.getSourceNode(), &g.getSinkNode(), threadedPaths, 4);
+    BOOST_CHECK(threadedPaths == paths);
 }
 
 BOOST_AUTO_TEST_CASE(test_full_magnusson_fast_1st_iter)